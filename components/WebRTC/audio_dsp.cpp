@@ -0,0 +1,301 @@
+#include "audio_dsp.hpp"
+
+#include <string.h>
+#include <math.h>
+#include <inttypes.h>
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#if CONFIG_IDF_TARGET_ESP32S3
+#include "esp_dsp.h"
+#define AUDIO_DSP_SIMD 1
+#else
+#define AUDIO_DSP_SIMD 0
+#endif
+
+static const char *TAG = "audio_dsp";
+
+#if AUDIO_DSP_SIMD
+// audio_dsp_aes3.S：blocks个8采样块的饱和加，两个指针需16字节对齐
+extern "C" void audio_dsp_mix_sat_aes3(int16_t *acc, const int16_t *in, size_t blocks);
+#endif
+
+static inline int16_t sat16(int32_t v)
+{
+    return v > INT16_MAX ? INT16_MAX : (v < INT16_MIN ? INT16_MIN : (int16_t)v);
+}
+
+/* ---------------- 混音 ---------------- */
+
+void audio_dsp_mix_sat_ansi(int16_t *acc, const int16_t *in, size_t samples)
+{
+    for (size_t i = 0; i < samples; i++) {
+        acc[i] = sat16((int32_t)acc[i] + in[i]);
+    }
+}
+
+void audio_dsp_mix_sat(int16_t *acc, const int16_t *in, size_t samples)
+{
+#if AUDIO_DSP_SIMD
+    if (samples >= 8 && (((uintptr_t)acc | (uintptr_t)in) & 15) == 0) {
+        size_t blocks = samples / 8;
+        audio_dsp_mix_sat_aes3(acc, in, blocks);
+        acc += blocks * 8;
+        in += blocks * 8;
+        samples -= blocks * 8;
+    }
+#endif
+    audio_dsp_mix_sat_ansi(acc, in, samples);
+}
+
+/* ---------------- 重采样 ---------------- */
+
+#define RESAMPLER_POOL_SIZE 4
+#define UP_PHASE_TAPS (AUDIO_RESAMPLE_TAPS / 3)
+
+// 偶数抽头的对称滤波器中心不落在采样点上，设计时无需处理sinc(0)
+static_assert(AUDIO_RESAMPLE_TAPS % 24 == 0, "taps must be a multiple of 3 and 8, and even");
+
+struct audio_resampler {
+    bool used;
+    audio_resample_dir_t dir;
+    int16_t coeffs[AUDIO_RESAMPLE_TAPS];                            // Q15低通
+    int16_t phases[3][UP_PHASE_TAPS];                               // 升采样多相系数，含3倍插零增益
+    int16_t work[AUDIO_RESAMPLE_TAPS - 1 + AUDIO_RESAMPLE_MAX_BLOCK]; // 历史采样 + 当前块
+#if AUDIO_DSP_SIMD
+    fir_s16_t fir;
+    alignas(16) int16_t delay[AUDIO_RESAMPLE_TAPS + 8];
+    alignas(16) int16_t in[AUDIO_RESAMPLE_MAX_BLOCK];
+    alignas(16) int16_t out[AUDIO_RESAMPLE_MAX_BLOCK / 3];
+#endif
+};
+
+static audio_resampler_t g_resamplers[RESAMPLER_POOL_SIZE];
+static portMUX_TYPE g_pool_lock = portMUX_INITIALIZER_UNLOCKED;
+
+/**
+ * @brief Blackman窗低通，截止6.8kHz，为16kHz的奈奎斯特频率留出过渡带
+ */
+static void design_lowpass(int16_t *coeffs)
+{
+    const int taps = AUDIO_RESAMPLE_TAPS;
+    const float fc = 6800.0f / 48000.0f;
+    float h[AUDIO_RESAMPLE_TAPS];
+    float sum = 0.0f;
+    for (int i = 0; i < taps; i++) {
+        float m = i - (taps - 1) / 2.0f;
+        float sinc = sinf((float)M_PI * 2.0f * fc * m) / ((float)M_PI * m);
+        float window = 0.42f - 0.5f * cosf(2.0f * (float)M_PI * i / (taps - 1)) +
+                       0.08f * cosf(4.0f * (float)M_PI * i / (taps - 1));
+        h[i] = sinc * window;
+        sum += h[i];
+    }
+    // 归一化为单位直流增益
+    for (int i = 0; i < taps; i++) {
+        coeffs[i] = sat16((int32_t)lrintf(h[i] / sum * 32767.0f));
+    }
+}
+
+audio_resampler_t *audio_resampler_create(audio_resample_dir_t dir)
+{
+    audio_resampler_t *rs = NULL;
+    portENTER_CRITICAL(&g_pool_lock);
+    for (int i = 0; i < RESAMPLER_POOL_SIZE; i++) {
+        if (!g_resamplers[i].used) {
+            rs = &g_resamplers[i];
+            rs->used = true;
+            break;
+        }
+    }
+    portEXIT_CRITICAL(&g_pool_lock);
+    if (!rs) {
+        ESP_LOGE(TAG, "重采样器已用完（最多%d个）", RESAMPLER_POOL_SIZE);
+        return NULL;
+    }
+
+    rs->dir = dir;
+    design_lowpass(rs->coeffs);
+    for (int p = 0; p < 3; p++) {
+        for (int j = 0; j < UP_PHASE_TAPS; j++) {
+            rs->phases[p][j] = sat16(3 * (int32_t)rs->coeffs[3 * j + p]);
+        }
+    }
+    memset(rs->work, 0, sizeof(rs->work));
+#if AUDIO_DSP_SIMD
+    if (dir == AUDIO_RESAMPLE_48K_TO_16K) {
+        memset(rs->delay, 0, sizeof(rs->delay));
+        esp_err_t ret = dsps_fird_init_s16(&rs->fir, rs->coeffs, rs->delay, AUDIO_RESAMPLE_TAPS, 3, 0, 0);
+        if (ret != ESP_OK) {
+            ESP_LOGE(TAG, "初始化FIR降采样失败: %s", esp_err_to_name(ret));
+            audio_resampler_destroy(rs);
+            return NULL;
+        }
+    }
+#endif
+    return rs;
+}
+
+void audio_resampler_destroy(audio_resampler_t *rs)
+{
+    if (!rs) {
+        return;
+    }
+#if AUDIO_DSP_SIMD
+    if (rs->dir == AUDIO_RESAMPLE_48K_TO_16K) {
+        dsps_fird_s16_aexx_free(&rs->fir);
+    }
+#endif
+    portENTER_CRITICAL(&g_pool_lock);
+    rs->used = false;
+    portEXIT_CRITICAL(&g_pool_lock);
+}
+
+static int downsample_ansi(audio_resampler_t *rs, const int16_t *in, size_t in_samples, int16_t *out)
+{
+    const size_t history = AUDIO_RESAMPLE_TAPS - 1;
+    memcpy(rs->work + history, in, in_samples * sizeof(int16_t));
+    size_t out_samples = in_samples / 3;
+    for (size_t k = 0; k < out_samples; k++) {
+        const int16_t *x = rs->work + history + 3 * k + 2;
+        int32_t acc = 1 << 14;
+        for (int j = 0; j < AUDIO_RESAMPLE_TAPS; j++) {
+            acc += (int32_t)rs->coeffs[j] * x[-j];
+        }
+        out[k] = sat16(acc >> 15);
+    }
+    memmove(rs->work, rs->work + in_samples, history * sizeof(int16_t));
+    return (int)out_samples;
+}
+
+static int upsample_ansi(audio_resampler_t *rs, const int16_t *in, size_t in_samples, int16_t *out)
+{
+    const size_t history = UP_PHASE_TAPS - 1;
+    memcpy(rs->work + history, in, in_samples * sizeof(int16_t));
+    for (size_t n = 0; n < in_samples; n++) {
+        const int16_t *x = rs->work + history + n;
+        for (int p = 0; p < 3; p++) {
+            int32_t acc = 1 << 14;
+            for (int j = 0; j < UP_PHASE_TAPS; j++) {
+                acc += (int32_t)rs->phases[p][j] * x[-j];
+            }
+            out[3 * n + p] = sat16(acc >> 15);
+        }
+    }
+    memmove(rs->work, rs->work + in_samples, history * sizeof(int16_t));
+    return (int)(in_samples * 3);
+}
+
+int audio_resampler_process(audio_resampler_t *rs, const int16_t *in, size_t in_samples, int16_t *out)
+{
+    if (!rs || !in || !out || in_samples > AUDIO_RESAMPLE_MAX_BLOCK) {
+        return -1;
+    }
+    if (rs->dir == AUDIO_RESAMPLE_16K_TO_48K) {
+        // esp-dsp没有插值FIR，升采样统一用多相实现（每个输出采样16个乘加）
+        return upsample_ansi(rs, in, in_samples, out);
+    }
+    if (in_samples % 3 != 0) {
+        return -1;
+    }
+#if AUDIO_DSP_SIMD
+    memcpy(rs->in, in, in_samples * sizeof(int16_t));
+    int32_t out_samples = dsps_fird_s16(&rs->fir, rs->in, rs->out, (int32_t)(in_samples / 3));
+    memcpy(out, rs->out, out_samples * sizeof(int16_t));
+    return (int)out_samples;
+#else
+    return downsample_ansi(rs, in, in_samples, out);
+#endif
+}
+
+/* ---------------- 基准测试 ---------------- */
+
+#if CONFIG_WEBRTC_AUDIO_MIXER_BENCHMARK
+
+#define BENCH_STREAMS    4
+#define BENCH_ITERATIONS 50
+#define BENCH_FRAME      AUDIO_RESAMPLE_MAX_BLOCK
+#define BENCH_FRAME_US   20000
+
+alignas(16) static int16_t s_bench_streams[BENCH_STREAMS][BENCH_FRAME];
+alignas(16) static int16_t s_bench_mix[BENCH_FRAME];
+alignas(16) static int16_t s_bench_check[BENCH_FRAME];
+alignas(16) static int16_t s_bench_out[BENCH_FRAME * 3];
+
+typedef void (*mix_fn_t)(int16_t *acc, const int16_t *in, size_t samples);
+
+static int64_t bench_mix(mix_fn_t mix, int16_t *result)
+{
+    int64_t start = esp_timer_get_time();
+    for (int it = 0; it < BENCH_ITERATIONS; it++) {
+        memset(result, 0, BENCH_FRAME * sizeof(int16_t));
+        for (int s = 0; s < BENCH_STREAMS; s++) {
+            mix(result, s_bench_streams[s], BENCH_FRAME);
+        }
+    }
+    return (esp_timer_get_time() - start) / BENCH_ITERATIONS;
+}
+
+// 每路每帧耗时占20ms帧周期的比例，保留两位小数
+static void log_cpu(const char *name, int64_t simd_us, int64_t ansi_us)
+{
+    uint32_t simd_pct = (uint32_t)(simd_us * 10000 / BENCH_FRAME_US);
+    uint32_t ansi_pct = (uint32_t)(ansi_us * 10000 / BENCH_FRAME_US);
+    ESP_LOGI(TAG, "[Performance][%s]: SIMD %" PRId64 "us (%" PRIu32 ".%02" PRIu32 "%%) 可移植 %" PRId64 "us (%" PRIu32 ".%02" PRIu32 "%%)",
+             name, simd_us, simd_pct / 100, simd_pct % 100, ansi_us, ansi_pct / 100, ansi_pct % 100);
+}
+
+void audio_dsp_run_benchmark(void)
+{
+    // 接近满幅的伪随机信号，确保饱和路径被覆盖
+    uint32_t seed = 12345;
+    for (int s = 0; s < BENCH_STREAMS; s++) {
+        for (int i = 0; i < BENCH_FRAME; i++) {
+            seed = seed * 1103515245u + 12345u;
+            s_bench_streams[s][i] = (int16_t)(seed >> 16);
+        }
+    }
+
+    int64_t mix_simd_us = bench_mix(audio_dsp_mix_sat, s_bench_mix);
+    int64_t mix_ansi_us = bench_mix(audio_dsp_mix_sat_ansi, s_bench_check);
+    bool mix_ok = memcmp(s_bench_mix, s_bench_check, sizeof(s_bench_mix)) == 0;
+
+    audio_resampler_t *down = audio_resampler_create(AUDIO_RESAMPLE_48K_TO_16K);
+    audio_resampler_t *up = audio_resampler_create(AUDIO_RESAMPLE_16K_TO_48K);
+    int64_t down_simd_us = 0, down_ansi_us = 0, up_us = 0;
+    if (down && up) {
+        int64_t start = esp_timer_get_time();
+        for (int it = 0; it < BENCH_ITERATIONS; it++) {
+            audio_resampler_process(down, s_bench_streams[it % BENCH_STREAMS], BENCH_FRAME, s_bench_out);
+        }
+        down_simd_us = (esp_timer_get_time() - start) / BENCH_ITERATIONS;
+
+        start = esp_timer_get_time();
+        for (int it = 0; it < BENCH_ITERATIONS; it++) {
+            downsample_ansi(down, s_bench_streams[it % BENCH_STREAMS], BENCH_FRAME, s_bench_out);
+        }
+        down_ansi_us = (esp_timer_get_time() - start) / BENCH_ITERATIONS;
+
+        start = esp_timer_get_time();
+        for (int it = 0; it < BENCH_ITERATIONS; it++) {
+            audio_resampler_process(up, s_bench_streams[it % BENCH_STREAMS], BENCH_FRAME / 3, s_bench_out);
+        }
+        up_us = (esp_timer_get_time() - start) / BENCH_ITERATIONS;
+    }
+    audio_resampler_destroy(down);
+    audio_resampler_destroy(up);
+
+    ESP_LOGI(TAG, "基准: %d路 x %d采样(48kHz 20ms)，%s", BENCH_STREAMS, BENCH_FRAME,
+             AUDIO_DSP_SIMD ? "ESP32-S3 PIE" : "无SIMD，两列均为可移植实现");
+    log_cpu("audio_mix_us_per_stream", mix_simd_us / BENCH_STREAMS, mix_ansi_us / BENCH_STREAMS);
+    log_cpu("audio_resample_48k_16k_us", down_simd_us, down_ansi_us);
+    log_cpu("audio_resample_16k_48k_us", up_us, up_us);
+    ESP_LOGI(TAG, "SIMD混音结果校验: %s", mix_ok ? "通过" : "失败");
+}
+
+#else
+
+void audio_dsp_run_benchmark(void)
+{
+}
+
+#endif /* CONFIG_WEBRTC_AUDIO_MIXER_BENCHMARK */
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * 音频DSP内核：饱和混音和48kHz<->16kHz重采样
+ *
+ * ESP32-S3上混音使用PIE 128位SIMD（一次8个采样），降采样使用esp-dsp的
+ * dsps_fird_s16；其他目标使用可移植实现。
+ */
+
+#define AUDIO_RESAMPLE_TAPS      48         // 需同时是3（多相）和8（PIE）的倍数
+#define AUDIO_RESAMPLE_MAX_BLOCK 960        // 单次处理的最大48kHz采样数（20ms）
+
+/**
+ * @brief acc[i] = sat16(acc[i] + in[i])
+ *
+ * 两个缓冲区都16字节对齐时走SIMD路径，否则（或剩余不足8个采样时）逐个计算
+ */
+void audio_dsp_mix_sat(int16_t *acc, const int16_t *in, size_t samples);
+
+// 可移植实现，供基准测试对比
+void audio_dsp_mix_sat_ansi(int16_t *acc, const int16_t *in, size_t samples);
+
+typedef enum {
+    AUDIO_RESAMPLE_48K_TO_16K = 0,
+    AUDIO_RESAMPLE_16K_TO_48K,
+} audio_resample_dir_t;
+
+typedef struct audio_resampler audio_resampler_t;
+
+// 从静态池中分配（对齐要求），不使用时调用audio_resampler_destroy归还
+audio_resampler_t *audio_resampler_create(audio_resample_dir_t dir);
+void audio_resampler_destroy(audio_resampler_t *rs);
+
+/**
+ * @brief 单声道重采样，保留跨块的滤波器状态
+ *
+ * 降采样时in_samples需为3的倍数，输出in_samples/3个采样；升采样输出in_samples*3个采样
+ * @return 输出采样数，参数错误返回-1
+ */
+int audio_resampler_process(audio_resampler_t *rs, const int16_t *in, size_t in_samples, int16_t *out);
+
+// 混音和重采样内核的SIMD/可移植实现耗时对比，结果以[Performance]日志输出
+void audio_dsp_run_benchmark(void);
+
+#ifdef __cplusplus
+}
+#endif
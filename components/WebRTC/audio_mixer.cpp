@@ -0,0 +1,418 @@
+#include "audio_mixer.hpp"
+
+#include <string.h>
+#include <inttypes.h>
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/queue.h"
+#include "freertos/event_groups.h"
+#include "task_topology.hpp"
+#include "audio_dsp.hpp"
+#include "esp_opus_dec.h"
+
+/*
+ * 多路音频混音
+ *
+ *   Peer回调 → audio_mixer_push(leg) → 每路包队列
+ *                                          │ 混音任务每20ms
+ *                                          ↓
+ *                    逐路Opus解码(48kHz) → 饱和累加 → [降采样到16kHz] → sink
+ *
+ * 每路最多排队MIXER_QUEUE_LEN个包，混音时积压超过MIXER_MAX_BACKLOG个则丢弃最旧的，
+ * 把网络抖动带来的额外延迟限制在两帧以内。一路超过MIXER_LEG_IDLE_US没有数据即
+ * 视为离开，释放解码器，不再计入欠载。
+ */
+
+static const char *TAG = "audio_mixer";
+
+#define MIXER_FRAME_US       (AUDIO_MIXER_FRAME_MS * 1000)
+#define MIXER_FRAME_SAMPLES  (48000 / 1000 * AUDIO_MIXER_FRAME_MS)
+#define MIXER_MAX_PACKET     512            // 单包上限，VoIP码率下远大于实际包长
+#define MIXER_QUEUE_LEN      4
+#define MIXER_MAX_BACKLOG    2
+#define MIXER_LEG_IDLE_US    (500 * 1000)
+
+#define MIXER_EXITED BIT0
+
+typedef struct {
+    uint16_t size;
+    uint8_t data[MIXER_MAX_PACKET];
+} mixer_packet_t;
+
+typedef struct {
+    QueueHandle_t queue;
+    void *decoder;
+    bool active;
+    int64_t last_packet_us;
+    alignas(16) int16_t pcm[MIXER_FRAME_SAMPLES];
+} mixer_leg_t;
+
+static mixer_leg_t g_legs[CONFIG_WEBRTC_AUDIO_MIXER_MAX_LEGS];
+static mixer_packet_t g_packet;             // 仅混音任务使用
+alignas(16) static int16_t g_mix[MIXER_FRAME_SAMPLES];
+alignas(16) static int16_t g_out[MIXER_FRAME_SAMPLES];
+
+static audio_mixer_config_t g_config;
+static audio_resampler_t *g_resampler = NULL;
+static EventGroupHandle_t g_exit_bits = NULL;
+static volatile bool g_running = false;
+
+static portMUX_TYPE g_stats_lock = portMUX_INITIALIZER_UNLOCKED;
+static audio_mixer_stats_t g_stats;
+static uint64_t g_window_decode_us = 0;
+static uint64_t g_window_mix_us = 0;
+static uint64_t g_window_resample_us = 0;
+static uint64_t g_window_frame_us = 0;
+static uint32_t g_window_leg_frames = 0;     // 区间内解码混音的路帧数
+static uint32_t g_window_frames = 0;
+
+/* ---------------- Opus解码器 ---------------- */
+
+static void *decoder_open(void)
+{
+    esp_opus_dec_cfg_t opus_cfg = ESP_OPUS_DEC_CONFIG_DEFAULT();
+    opus_cfg.sample_rate = 48000;
+    opus_cfg.channel = 1;
+    opus_cfg.frame_duration = ESP_OPUS_DEC_FRAME_DURATION_20_MS;
+    void *decoder = NULL;
+    esp_audio_err_t ret = esp_opus_dec_open(&opus_cfg, sizeof(opus_cfg), &decoder);
+    if (ret != ESP_AUDIO_ERR_OK) {
+        ESP_LOGE(TAG, "创建Opus解码器失败: %d", ret);
+        return NULL;
+    }
+    return decoder;
+}
+
+static int decoder_process(void *decoder, const uint8_t *data, size_t size, int16_t *pcm)
+{
+    esp_audio_dec_in_raw_t raw = {
+        .buffer = (uint8_t *)data,
+        .len = (uint32_t)size,
+    };
+    esp_audio_dec_out_frame_t frame = {
+        .buffer = (uint8_t *)pcm,
+        .len = MIXER_FRAME_SAMPLES * sizeof(int16_t),
+    };
+    esp_audio_dec_info_t info;
+    if (esp_opus_dec_decode(decoder, &raw, &frame, &info) != ESP_AUDIO_ERR_OK) {
+        return -1;
+    }
+    return (int)(frame.decoded_size / sizeof(int16_t));
+}
+
+static void decoder_close(void *decoder)
+{
+    esp_opus_dec_close(decoder);
+}
+
+/* ---------------- 混音任务 ---------------- */
+
+static void stats_add(uint32_t *counter, uint32_t n)
+{
+    portENTER_CRITICAL(&g_stats_lock);
+    *counter += n;
+    portEXIT_CRITICAL(&g_stats_lock);
+}
+
+/**
+ * @brief 取出一路本帧的包并解码到leg->pcm
+ *
+ * @return 解码出的采样数，本帧无数据返回0，出错返回-1
+ */
+static int decode_leg(mixer_leg_t *leg, int64_t now)
+{
+    UBaseType_t backlog = uxQueueMessagesWaiting(leg->queue);
+    uint32_t dropped = 0;
+    while (backlog > MIXER_MAX_BACKLOG && xQueueReceive(leg->queue, &g_packet, 0) == pdTRUE) {
+        backlog--;
+        dropped++;
+    }
+    if (dropped > 0) {
+        stats_add(&g_stats.packets_dropped, dropped);
+    }
+
+    if (xQueueReceive(leg->queue, &g_packet, 0) != pdTRUE) {
+        if (leg->active && now - leg->last_packet_us > MIXER_LEG_IDLE_US) {
+            // 对端离开或静音：释放解码器
+            leg->active = false;
+            decoder_close(leg->decoder);
+            leg->decoder = NULL;
+        } else if (leg->active) {
+            stats_add(&g_stats.underruns, 1);
+        }
+        return 0;
+    }
+
+    leg->last_packet_us = now;
+    if (!leg->decoder) {
+        leg->decoder = decoder_open();
+        if (!leg->decoder) {
+            return -1;
+        }
+    }
+    leg->active = true;
+
+    int samples = decoder_process(leg->decoder, g_packet.data, g_packet.size, leg->pcm);
+    if (samples <= 0) {
+        return -1;
+    }
+    if (samples < MIXER_FRAME_SAMPLES) {
+        memset(leg->pcm + samples, 0, (MIXER_FRAME_SAMPLES - samples) * sizeof(int16_t));
+    }
+    return samples;
+}
+
+/**
+ * @brief 混音任务：按20ms节拍解码各路、饱和混音、降采样后交给sink
+ */
+static void mixer_task(void *arg)
+{
+    const TickType_t period = pdMS_TO_TICKS(AUDIO_MIXER_FRAME_MS);
+    const uint32_t report_frames = CONFIG_WEBRTC_AUDIO_REPORT_S * 1000 / AUDIO_MIXER_FRAME_MS;
+    uint32_t frames_since_report = 0;
+    TickType_t last_wake = xTaskGetTickCount();
+
+    while (g_running) {
+        vTaskDelayUntil(&last_wake, period);
+
+        int64_t frame_start = esp_timer_get_time();
+        uint32_t decode_us = 0;
+        uint32_t mix_us = 0;
+        uint32_t mixed_legs = 0;
+        uint32_t active_legs = 0;
+        uint32_t decode_errors = 0;
+        memset(g_mix, 0, sizeof(g_mix));
+
+        for (int i = 0; i < CONFIG_WEBRTC_AUDIO_MIXER_MAX_LEGS; i++) {
+            mixer_leg_t *leg = &g_legs[i];
+            int64_t t0 = esp_timer_get_time();
+            int samples = decode_leg(leg, t0);
+            int64_t t1 = esp_timer_get_time();
+            if (leg->active) {
+                active_legs++;
+            }
+            if (samples < 0) {
+                decode_errors++;
+                continue;
+            }
+            if (samples == 0) {
+                continue;
+            }
+            audio_dsp_mix_sat(g_mix, leg->pcm, MIXER_FRAME_SAMPLES);
+            int64_t t2 = esp_timer_get_time();
+            decode_us += (uint32_t)(t1 - t0);
+            mix_us += (uint32_t)(t2 - t1);
+            mixed_legs++;
+        }
+
+        const int16_t *out = g_mix;
+        size_t out_samples = MIXER_FRAME_SAMPLES;
+        int64_t resample_start = esp_timer_get_time();
+        if (g_resampler) {
+            int got = audio_resampler_process(g_resampler, g_mix, MIXER_FRAME_SAMPLES, g_out);
+            out = g_out;
+            out_samples = got > 0 ? (size_t)got : 0;
+        }
+        int64_t resample_end = esp_timer_get_time();
+
+        if (g_config.sink && out_samples > 0) {
+            g_config.sink(out, out_samples, g_config.output_rate, g_config.sink_ctx);
+        }
+        int64_t frame_end = esp_timer_get_time();
+
+        portENTER_CRITICAL(&g_stats_lock);
+        g_stats.frames_mixed++;
+        g_stats.decode_errors += decode_errors;
+        g_stats.active_legs = active_legs;
+        g_window_decode_us += decode_us;
+        g_window_mix_us += mix_us;
+        g_window_resample_us += (uint64_t)(resample_end - resample_start);
+        g_window_frame_us += (uint64_t)(frame_end - frame_start);
+        g_window_leg_frames += mixed_legs;
+        g_window_frames++;
+        portEXIT_CRITICAL(&g_stats_lock);
+
+        if (report_frames > 0 && ++frames_since_report >= report_frames) {
+            frames_since_report = 0;
+            audio_mixer_report();
+        }
+    }
+
+    xEventGroupSetBits(g_exit_bits, MIXER_EXITED);
+    vTaskDelete(NULL);
+}
+
+/* ---------------- 对外接口 ---------------- */
+
+static void release_resources(void)
+{
+    for (int i = 0; i < CONFIG_WEBRTC_AUDIO_MIXER_MAX_LEGS; i++) {
+        mixer_leg_t *leg = &g_legs[i];
+        if (leg->decoder) {
+            decoder_close(leg->decoder);
+            leg->decoder = NULL;
+        }
+        if (leg->queue) {
+            vQueueDelete(leg->queue);
+            leg->queue = NULL;
+        }
+        leg->active = false;
+    }
+    if (g_resampler) {
+        audio_resampler_destroy(g_resampler);
+        g_resampler = NULL;
+    }
+}
+
+esp_err_t audio_mixer_start(const audio_mixer_config_t *config)
+{
+    if (!config || !config->sink || (config->output_rate != 16000 && config->output_rate != 48000)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (g_running) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    g_config = *config;
+
+    if (!g_exit_bits) {
+        g_exit_bits = xEventGroupCreate();
+        if (!g_exit_bits) {
+            return ESP_ERR_NO_MEM;
+        }
+    }
+    for (int i = 0; i < CONFIG_WEBRTC_AUDIO_MIXER_MAX_LEGS; i++) {
+        g_legs[i].queue = xQueueCreate(MIXER_QUEUE_LEN, sizeof(mixer_packet_t));
+        if (!g_legs[i].queue) {
+            release_resources();
+            return ESP_ERR_NO_MEM;
+        }
+    }
+    if (g_config.output_rate == 16000) {
+        g_resampler = audio_resampler_create(AUDIO_RESAMPLE_48K_TO_16K);
+        if (!g_resampler) {
+            release_resources();
+            return ESP_ERR_NO_MEM;
+        }
+    }
+
+#if CONFIG_WEBRTC_AUDIO_MIXER_BENCHMARK
+    audio_dsp_run_benchmark();
+#endif
+
+    portENTER_CRITICAL(&g_stats_lock);
+    memset(&g_stats, 0, sizeof(g_stats));
+    g_window_decode_us = 0;
+    g_window_mix_us = 0;
+    g_window_resample_us = 0;
+    g_window_frame_us = 0;
+    g_window_leg_frames = 0;
+    g_window_frames = 0;
+    portEXIT_CRITICAL(&g_stats_lock);
+
+    xEventGroupClearBits(g_exit_bits, MIXER_EXITED);
+    g_running = true;
+    esp_err_t ret = task_topology_create(APP_TASK_MIXER, mixer_task, NULL, NULL);
+    if (ret != ESP_OK) {
+        g_running = false;
+        release_resources();
+        return ret;
+    }
+
+    ESP_LOGI(TAG, "混音已启动: 最多%d路，输出%" PRIu32 "Hz，%dms/帧",
+             CONFIG_WEBRTC_AUDIO_MIXER_MAX_LEGS, g_config.output_rate, AUDIO_MIXER_FRAME_MS);
+    return ESP_OK;
+}
+
+esp_err_t audio_mixer_stop(void)
+{
+    if (!g_running) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    g_running = false;
+
+    EventBits_t bits = xEventGroupWaitBits(g_exit_bits, MIXER_EXITED, pdFALSE, pdTRUE,
+                                           pdMS_TO_TICKS(AUDIO_MIXER_FRAME_MS * 10));
+    if (!(bits & MIXER_EXITED)) {
+        ESP_LOGE(TAG, "混音任务未按时退出");
+        return ESP_ERR_TIMEOUT;
+    }
+    release_resources();
+    audio_mixer_report();
+    ESP_LOGI(TAG, "混音已停止");
+    return ESP_OK;
+}
+
+esp_err_t audio_mixer_push(int leg, const uint8_t *data, size_t size)
+{
+    if (leg < 0 || leg >= CONFIG_WEBRTC_AUDIO_MIXER_MAX_LEGS || !data || size == 0) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    QueueHandle_t queue = g_legs[leg].queue;
+    if (!g_running || !queue) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    stats_add(&g_stats.packets_received, 1);
+    if (size > MIXER_MAX_PACKET) {
+        stats_add(&g_stats.packets_dropped, 1);
+        return ESP_ERR_INVALID_SIZE;
+    }
+
+    // 在Peer任务栈上组包，队列按值拷贝
+    mixer_packet_t packet;
+    packet.size = (uint16_t)size;
+    memcpy(packet.data, data, size);
+    if (xQueueSend(queue, &packet, 0) != pdTRUE) {
+        // 队列已满：混音任务会丢弃积压，这里直接丢弃新包
+        stats_add(&g_stats.packets_dropped, 1);
+        return ESP_ERR_NO_MEM;
+    }
+    return ESP_OK;
+}
+
+// 调用方需持有g_stats_lock
+static void fill_window_averages(audio_mixer_stats_t *stats)
+{
+    *stats = g_stats;
+    if (g_window_leg_frames > 0) {
+        stats->decode_us_per_leg = (uint32_t)(g_window_decode_us / g_window_leg_frames);
+        stats->mix_us_per_leg = (uint32_t)(g_window_mix_us / g_window_leg_frames);
+        stats->cpu_per_leg_pct_x100 = (stats->decode_us_per_leg + stats->mix_us_per_leg) * 10000 / MIXER_FRAME_US;
+    }
+    if (g_window_frames > 0) {
+        stats->resample_us = (uint32_t)(g_window_resample_us / g_window_frames);
+        stats->frame_us = (uint32_t)(g_window_frame_us / g_window_frames);
+    }
+}
+
+void audio_mixer_get_stats(audio_mixer_stats_t *stats)
+{
+    if (!stats) {
+        return;
+    }
+    portENTER_CRITICAL(&g_stats_lock);
+    fill_window_averages(stats);
+    portEXIT_CRITICAL(&g_stats_lock);
+}
+
+void audio_mixer_report(void)
+{
+    audio_mixer_stats_t stats;
+    portENTER_CRITICAL(&g_stats_lock);
+    fill_window_averages(&stats);
+    g_window_decode_us = 0;
+    g_window_mix_us = 0;
+    g_window_resample_us = 0;
+    g_window_frame_us = 0;
+    g_window_leg_frames = 0;
+    g_window_frames = 0;
+    portEXIT_CRITICAL(&g_stats_lock);
+
+    ESP_LOGI(TAG, "[Performance][audio_mixer_cpu_per_stream_pct]: %" PRIu32 ".%02" PRIu32 " (解码%" PRIu32 "us + 混音%" PRIu32 "us，%" PRIu32 "路活跃)",
+             stats.cpu_per_leg_pct_x100 / 100, stats.cpu_per_leg_pct_x100 % 100,
+             stats.decode_us_per_leg, stats.mix_us_per_leg, stats.active_legs);
+    ESP_LOGI(TAG, "[Performance][audio_mixer_frame_us]: %" PRIu32 " (重采样%" PRIu32 "us，输出%" PRIu32 "Hz)",
+             stats.frame_us, stats.resample_us, g_config.output_rate);
+    ESP_LOGI(TAG, "[Performance][audio_mixer_underruns]: %" PRIu32 " (收包%" PRIu32 "，丢弃%" PRIu32 "，解码错误%" PRIu32 ")",
+             stats.underruns, stats.packets_received, stats.packets_dropped, stats.decode_errors);
+}
@@ -0,0 +1,71 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define AUDIO_MIXER_FRAME_MS 20
+
+/**
+ * @brief 混音输出（单声道），每20ms调用一次
+ *
+ * sample_rate为16000时samples为320，为48000时为960
+ */
+typedef void (*audio_mixer_sink_t)(const int16_t *pcm, size_t samples, uint32_t sample_rate, void *ctx);
+
+typedef struct {
+    uint32_t output_rate;                   // 16000或48000
+    audio_mixer_sink_t sink;
+    void *sink_ctx;
+} audio_mixer_config_t;
+
+#define AUDIO_MIXER_DEFAULT_CONFIG() {                      \
+    .output_rate = CONFIG_WEBRTC_AUDIO_MIXER_OUTPUT_RATE,   \
+    .sink = NULL,                                           \
+    .sink_ctx = NULL,                                       \
+}
+
+typedef struct {
+    uint32_t frames_mixed;
+    uint32_t packets_received;
+    uint32_t packets_dropped;               // 队列满或超过最大包长
+    uint32_t decode_errors;
+    uint32_t underruns;                     // 活跃的一路在混音时刻没有数据
+    uint32_t active_legs;
+    // 以下为自上次audio_mixer_report()以来的平均值
+    uint32_t decode_us_per_leg;
+    uint32_t mix_us_per_leg;
+    uint32_t resample_us;
+    uint32_t frame_us;                      // 一帧的总处理时间
+    uint32_t cpu_per_leg_pct_x100;          // 每路（解码+混音）占20ms帧周期的比例，x100
+} audio_mixer_stats_t;
+
+/**
+ * @brief 启动混音任务（APP_TASK_MIXER）
+ *
+ * 每20ms从各路取一个Opus包解码（48kHz单声道），饱和混音后按需降采样交给sink
+ */
+esp_err_t audio_mixer_start(const audio_mixer_config_t *config);
+
+esp_err_t audio_mixer_stop(void);
+
+/**
+ * @brief 投递一路收到的Opus包，可在任意任务（如Peer回调）中调用
+ *
+ * @param leg 0到CONFIG_WEBRTC_AUDIO_MIXER_MAX_LEGS-1，由调用方为每路远端音频分配
+ */
+esp_err_t audio_mixer_push(int leg, const uint8_t *data, size_t size);
+
+void audio_mixer_get_stats(audio_mixer_stats_t *stats);
+
+// 打印每路CPU占用和各阶段耗时，并开始新的统计区间
+void audio_mixer_report(void);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,426 @@
+#include "audio_sender.hpp"
+
+#include <string.h>
+#include <inttypes.h>
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/queue.h"
+#include "freertos/event_groups.h"
+#include "task_topology.hpp"
+#include "esp_opus_enc.h"
+
+/*
+ * 音频发送管线
+ *
+ *   采集任务: source->read() → 空闲帧 ──full队列──→ 编码任务: Opus编码 → sink
+ *                  ↑                                        │
+ *                  └──────────────free队列──────────────────┘
+ *
+ * 两个PCM帧在free/full队列间轮转，采集和编码互不阻塞。编码跟不上时采集端
+ * 把新帧读进丢弃缓冲（overrun），保证I2S DMA不溢出；采集断流时编码端在
+ * 1.5个帧周期后记一次underrun。
+ */
+
+static const char *TAG = "audio_sender";
+
+#define AUDIO_FRAME_US          (AUDIO_SENDER_FRAME_MS * 1000)
+#define AUDIO_MAX_FRAME_SAMPLES (48000 / 1000 * AUDIO_SENDER_FRAME_MS * 2)
+#define AUDIO_MAX_PACKET        1276        // RFC 6716单帧上限
+#define AUDIO_FRAME_COUNT       2
+
+#define CAPTURE_EXITED BIT0
+#define ENCODER_EXITED BIT1
+
+typedef struct {
+    uint32_t seq;                           // 采集序号，用于推算pts
+    int64_t captured_us;                    // 帧内首个采样的时刻
+    int16_t pcm[AUDIO_MAX_FRAME_SAMPLES];
+} audio_frame_t;
+
+static audio_frame_t g_frames[AUDIO_FRAME_COUNT];
+static int16_t g_discard[AUDIO_MAX_FRAME_SAMPLES];
+static uint8_t g_packet[AUDIO_MAX_PACKET];
+
+static audio_sender_config_t g_config;
+static size_t g_frame_samples = 0;          // 每帧采样数（含所有声道）
+static QueueHandle_t g_free_queue = NULL;
+static QueueHandle_t g_full_queue = NULL;
+static EventGroupHandle_t g_exit_bits = NULL;
+static volatile bool g_running = false;
+// 停止超时：任务退出之前不释放资源，也不允许重新启动
+static bool g_stop_pending = false;
+
+static portMUX_TYPE g_stats_lock = portMUX_INITIALIZER_UNLOCKED;
+static audio_sender_stats_t g_stats;
+static uint64_t g_window_encode_us = 0;
+static uint64_t g_window_latency_us = 0;
+static uint32_t g_window_frames = 0;         // 区间内编码的帧数
+static uint32_t g_window_sent = 0;           // 区间内发送成功的帧数
+
+/* ---------------- Opus编码器 ---------------- */
+
+static void *g_encoder = NULL;
+
+static esp_err_t encoder_open(const audio_sender_config_t *config)
+{
+    esp_opus_enc_config_t opus_cfg = ESP_OPUS_ENC_CONFIG_DEFAULT();
+    opus_cfg.sample_rate = (int)config->sample_rate;
+    opus_cfg.channel = config->channels;
+    opus_cfg.bits_per_sample = 16;
+    opus_cfg.bitrate = (int)config->bitrate;
+    opus_cfg.frame_duration = ESP_OPUS_ENC_FRAME_DURATION_20_MS;
+    opus_cfg.application_mode = ESP_OPUS_ENC_APPLICATION_VOIP;
+    opus_cfg.complexity = config->complexity;
+    esp_audio_err_t ret = esp_opus_enc_open(&opus_cfg, sizeof(opus_cfg), &g_encoder);
+    if (ret != ESP_AUDIO_ERR_OK) {
+        ESP_LOGE(TAG, "创建Opus编码器失败: %d", ret);
+        g_encoder = NULL;
+        return ESP_FAIL;
+    }
+    return ESP_OK;
+}
+
+static int encoder_process(const int16_t *pcm, uint8_t *out, size_t out_size)
+{
+    esp_audio_enc_in_frame_t in_frame = {
+        .buffer = (uint8_t *)pcm,
+        .len = (uint32_t)(g_frame_samples * sizeof(int16_t)),
+    };
+    esp_audio_enc_out_frame_t out_frame = {
+        .buffer = out,
+        .len = (uint32_t)out_size,
+        .encoded_bytes = 0,
+        .pts = 0,
+    };
+    if (esp_opus_enc_process(g_encoder, &in_frame, &out_frame) != ESP_AUDIO_ERR_OK) {
+        return -1;
+    }
+    return (int)out_frame.encoded_bytes;
+}
+
+static void encoder_close(void)
+{
+    if (g_encoder) {
+        esp_opus_enc_close(g_encoder);
+        g_encoder = NULL;
+    }
+}
+
+/* ---------------- 采集与编码任务 ---------------- */
+
+static void stats_add(uint32_t *counter)
+{
+    portENTER_CRITICAL(&g_stats_lock);
+    (*counter)++;
+    portEXIT_CRITICAL(&g_stats_lock);
+}
+
+/**
+ * @brief 采集任务：按帧读取PCM并交给编码任务
+ *
+ * 非实时信号源（文件）按帧周期节拍，模拟麦克风的产出速率
+ */
+static void capture_task(void *arg)
+{
+    const audio_source_t *source = g_config.source;
+    const TickType_t period = pdMS_TO_TICKS(AUDIO_SENDER_FRAME_MS);
+    TickType_t last_wake = xTaskGetTickCount();
+    uint32_t seq = 0;
+
+    while (g_running) {
+        if (!source->realtime) {
+            vTaskDelayUntil(&last_wake, period);
+        }
+
+        int index = -1;
+        int16_t *pcm = g_discard;
+        if (xQueueReceive(g_free_queue, &index, 0) == pdTRUE) {
+            pcm = g_frames[index].pcm;
+        } else {
+            // 两帧都在等待编码：照常读出本帧后丢弃，保持采集节拍
+            stats_add(&g_stats.overruns);
+        }
+
+        int got = source->read(pcm, g_frame_samples);
+        int64_t now = esp_timer_get_time();
+        if (got < 0) {
+            stats_add(&g_stats.source_errors);
+            if (index >= 0) {
+                xQueueSend(g_free_queue, &index, 0);
+            }
+            vTaskDelay(period);
+            continue;
+        }
+        if ((size_t)got < g_frame_samples) {
+            memset(pcm + got, 0, (g_frame_samples - got) * sizeof(int16_t));
+        }
+
+        uint32_t frame_seq = seq++;
+        stats_add(&g_stats.frames_captured);
+        if (index < 0) {
+            continue;
+        }
+        g_frames[index].seq = frame_seq;
+        g_frames[index].captured_us = now - AUDIO_FRAME_US;
+        xQueueSend(g_full_queue, &index, 0);
+    }
+
+    xEventGroupSetBits(g_exit_bits, CAPTURE_EXITED);
+    vTaskDelete(NULL);
+}
+
+static void record_frame(uint32_t encode_us, uint32_t latency_us, size_t bytes, esp_err_t sink_ret)
+{
+    portENTER_CRITICAL(&g_stats_lock);
+    g_window_encode_us += encode_us;
+    g_window_frames++;
+    if (encode_us > g_stats.encode_us_max) {
+        g_stats.encode_us_max = encode_us;
+    }
+    if (sink_ret == ESP_OK) {
+        g_stats.frames_sent++;
+        g_stats.bytes_sent += bytes;
+        g_window_sent++;
+        g_window_latency_us += latency_us;
+        if (latency_us > g_stats.latency_us_max) {
+            g_stats.latency_us_max = latency_us;
+        }
+    } else if (sink_ret == ESP_ERR_INVALID_STATE) {
+        g_stats.frames_skipped++;
+    } else {
+        g_stats.send_errors++;
+    }
+    portEXIT_CRITICAL(&g_stats_lock);
+}
+
+/**
+ * @brief 编码发送任务：取满帧编码，归还PCM后把Opus帧交给sink
+ */
+static void encoder_task(void *arg)
+{
+    // 等一个帧周期再留半帧余量，超时说明采集断流，对端将听到空隙
+    const TickType_t wait = pdMS_TO_TICKS(AUDIO_SENDER_FRAME_MS * 3 / 2);
+    const uint32_t report_frames = CONFIG_WEBRTC_AUDIO_REPORT_S * 1000 / AUDIO_SENDER_FRAME_MS;
+    uint32_t frames_since_report = 0;
+    bool streaming = false;
+
+    while (g_running) {
+        int index;
+        if (xQueueReceive(g_full_queue, &index, wait) != pdTRUE) {
+            // 首帧到达前的等待（I2S启动）不算欠载
+            if (streaming && g_running) {
+                stats_add(&g_stats.underruns);
+            }
+            continue;
+        }
+        streaming = true;
+
+        audio_frame_t *frame = &g_frames[index];
+        int64_t encode_start = esp_timer_get_time();
+        int encoded = encoder_process(frame->pcm, g_packet, sizeof(g_packet));
+        int64_t encode_end = esp_timer_get_time();
+        uint32_t seq = frame->seq;
+        int64_t captured_us = frame->captured_us;
+        // PCM已编码完毕，尽早归还给采集端
+        xQueueSend(g_free_queue, &index, 0);
+
+        if (encoded <= 0) {
+            stats_add(&g_stats.encode_errors);
+            continue;
+        }
+
+        // pts按采集序号推算，采集端丢帧时对端能看到对应的时间跳变
+        esp_err_t ret = g_config.sink(g_packet, encoded, seq * AUDIO_SENDER_FRAME_MS, g_config.sink_ctx);
+        int64_t sent_us = esp_timer_get_time();
+        record_frame((uint32_t)(encode_end - encode_start), (uint32_t)(sent_us - captured_us), encoded, ret);
+
+        if (report_frames > 0 && ++frames_since_report >= report_frames) {
+            frames_since_report = 0;
+            audio_sender_report();
+        }
+    }
+
+    xEventGroupSetBits(g_exit_bits, ENCODER_EXITED);
+    vTaskDelete(NULL);
+}
+
+/* ---------------- 对外接口 ---------------- */
+
+static bool tasks_exited(TickType_t wait)
+{
+    EventBits_t bits = xEventGroupWaitBits(g_exit_bits, CAPTURE_EXITED | ENCODER_EXITED, pdFALSE, pdTRUE, wait);
+    return (bits & (CAPTURE_EXITED | ENCODER_EXITED)) == (CAPTURE_EXITED | ENCODER_EXITED);
+}
+
+static void release_resources(void)
+{
+    encoder_close();
+    if (g_config.source) {
+        g_config.source->close();
+    }
+    if (g_free_queue) {
+        vQueueDelete(g_free_queue);
+        g_free_queue = NULL;
+    }
+    if (g_full_queue) {
+        vQueueDelete(g_full_queue);
+        g_full_queue = NULL;
+    }
+}
+
+esp_err_t audio_sender_start(const audio_sender_config_t *config)
+{
+    if (!config || !config->sink || config->channels < 1 || config->channels > 2 ||
+        (config->sample_rate != 8000 && config->sample_rate != 12000 && config->sample_rate != 16000 &&
+         config->sample_rate != 24000 && config->sample_rate != 48000)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (g_running) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    if (g_stop_pending) {
+        // 上次停止超时的任务仍在运行时，新任务会与之共用队列、信号源和编码器
+        if (!tasks_exited(0)) {
+            ESP_LOGE(TAG, "上次停止的音频任务尚未退出，不能启动");
+            return ESP_ERR_INVALID_STATE;
+        }
+        g_stop_pending = false;
+        release_resources();
+    }
+
+    g_config = *config;
+    if (!g_config.source) {
+        g_config.source = audio_source_default();
+    }
+    g_frame_samples = g_config.sample_rate / 1000 * AUDIO_SENDER_FRAME_MS * g_config.channels;
+
+    if (!g_exit_bits) {
+        g_exit_bits = xEventGroupCreate();
+    }
+    g_free_queue = xQueueCreate(AUDIO_FRAME_COUNT, sizeof(int));
+    g_full_queue = xQueueCreate(AUDIO_FRAME_COUNT, sizeof(int));
+    if (!g_exit_bits || !g_free_queue || !g_full_queue) {
+        g_config.source = NULL;
+        release_resources();
+        return ESP_ERR_NO_MEM;
+    }
+    for (int i = 0; i < AUDIO_FRAME_COUNT; i++) {
+        xQueueSend(g_free_queue, &i, 0);
+    }
+
+    esp_err_t ret = g_config.source->open(g_config.sample_rate, g_config.channels);
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "打开音频源%s失败: %s", g_config.source->name, esp_err_to_name(ret));
+        g_config.source = NULL;
+        release_resources();
+        return ret;
+    }
+    ret = encoder_open(&g_config);
+    if (ret != ESP_OK) {
+        release_resources();
+        return ret;
+    }
+
+    portENTER_CRITICAL(&g_stats_lock);
+    memset(&g_stats, 0, sizeof(g_stats));
+    g_window_encode_us = 0;
+    g_window_latency_us = 0;
+    g_window_frames = 0;
+    g_window_sent = 0;
+    portEXIT_CRITICAL(&g_stats_lock);
+
+    xEventGroupClearBits(g_exit_bits, CAPTURE_EXITED | ENCODER_EXITED);
+    g_running = true;
+    ret = task_topology_create(APP_TASK_MEDIA, encoder_task, NULL, NULL);
+    if (ret != ESP_OK) {
+        g_running = false;
+        release_resources();
+        return ret;
+    }
+    ret = task_topology_create(APP_TASK_CAPTURE, capture_task, NULL, NULL);
+    if (ret != ESP_OK) {
+        g_running = false;
+        xEventGroupWaitBits(g_exit_bits, ENCODER_EXITED, pdFALSE, pdTRUE, portMAX_DELAY);
+        release_resources();
+        return ret;
+    }
+
+    ESP_LOGI(TAG, "音频发送已启动: 信号源%s，%" PRIu32 "Hz %u声道，Opus %" PRIu32 "bps，%dms/帧",
+             g_config.source->name, g_config.sample_rate, g_config.channels, g_config.bitrate,
+             AUDIO_SENDER_FRAME_MS);
+    return ESP_OK;
+}
+
+esp_err_t audio_sender_stop(void)
+{
+    if (!g_running && !g_stop_pending) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    g_running = false;
+
+    // I2S读取最多阻塞一帧，编码任务等待最多1.5帧
+    if (!tasks_exited(pdMS_TO_TICKS(AUDIO_SENDER_FRAME_MS * 10))) {
+        // 任务仍可能访问信号源和编码器，不能释放；再次调用stop继续等待
+        g_stop_pending = true;
+        ESP_LOGE(TAG, "音频任务未按时退出");
+        return ESP_ERR_TIMEOUT;
+    }
+    g_stop_pending = false;
+    release_resources();
+    audio_sender_report();
+    ESP_LOGI(TAG, "音频发送已停止");
+    return ESP_OK;
+}
+
+bool audio_sender_is_running(void)
+{
+    return g_running;
+}
+
+// 调用方需持有g_stats_lock
+static void fill_window_averages(audio_sender_stats_t *stats)
+{
+    *stats = g_stats;
+    if (g_window_frames > 0) {
+        stats->encode_us_avg = (uint32_t)(g_window_encode_us / g_window_frames);
+        stats->encoder_load_pct = stats->encode_us_avg * 100 / AUDIO_FRAME_US;
+    }
+    if (g_window_sent > 0) {
+        stats->latency_us_avg = (uint32_t)(g_window_latency_us / g_window_sent);
+    }
+}
+
+void audio_sender_get_stats(audio_sender_stats_t *stats)
+{
+    if (!stats) {
+        return;
+    }
+    portENTER_CRITICAL(&g_stats_lock);
+    fill_window_averages(stats);
+    portEXIT_CRITICAL(&g_stats_lock);
+}
+
+void audio_sender_report(void)
+{
+    audio_sender_stats_t stats;
+    portENTER_CRITICAL(&g_stats_lock);
+    fill_window_averages(&stats);
+    g_window_encode_us = 0;
+    g_window_latency_us = 0;
+    g_window_frames = 0;
+    g_window_sent = 0;
+    g_stats.encode_us_max = 0;
+    g_stats.latency_us_max = 0;
+    portEXIT_CRITICAL(&g_stats_lock);
+
+    ESP_LOGI(TAG, "[Performance][audio_encode_us]: 平均%" PRIu32 " 最大%" PRIu32 " (编码负载%" PRIu32 "%%)",
+             stats.encode_us_avg, stats.encode_us_max, stats.encoder_load_pct);
+    ESP_LOGI(TAG, "[Performance][audio_pipeline_latency_ms]: 平均%" PRIu32 ".%01" PRIu32 " 最大%" PRIu32 ".%01" PRIu32,
+             stats.latency_us_avg / 1000, stats.latency_us_avg % 1000 / 100,
+             stats.latency_us_max / 1000, stats.latency_us_max % 1000 / 100);
+    ESP_LOGI(TAG, "[Performance][audio_underruns]: %" PRIu32 " (采集丢帧%" PRIu32 "，编码错误%" PRIu32 "，发送错误%" PRIu32 ")",
+             stats.underruns, stats.overruns, stats.encode_errors, stats.send_errors);
+    ESP_LOGI(TAG, "音频帧: 采集%" PRIu32 " 发送%" PRIu32 " 未连接跳过%" PRIu32 "，共%" PRIu64 "字节",
+             stats.frames_captured, stats.frames_sent, stats.frames_skipped, stats.bytes_sent);
+}
@@ -0,0 +1,89 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include "esp_err.h"
+#include "audio_source.hpp"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define AUDIO_SENDER_FRAME_MS 20
+
+/**
+ * @brief 编码后的Opus帧输出
+ *
+ * pts为毫秒，按采集帧序号推算。返回ESP_ERR_INVALID_STATE表示暂不发送（如连接未建立），
+ * 不计为发送错误。
+ */
+typedef esp_err_t (*audio_sender_sink_t)(const uint8_t *data, size_t size, uint32_t pts, void *ctx);
+
+typedef struct {
+    const audio_source_t *source;           // NULL使用audio_source_default()
+    uint32_t sample_rate;                   // 8000/12000/16000/24000/48000
+    uint8_t channels;                       // 1或2
+    uint32_t bitrate;
+    int complexity;                         // 0-10
+    audio_sender_sink_t sink;
+    void *sink_ctx;
+} audio_sender_config_t;
+
+#define AUDIO_SENDER_DEFAULT_CONFIG() {                 \
+    .source = NULL,                                     \
+    .sample_rate = 48000,                               \
+    .channels = 1,                                      \
+    .bitrate = CONFIG_WEBRTC_AUDIO_BITRATE,             \
+    .complexity = CONFIG_WEBRTC_AUDIO_COMPLEXITY,       \
+    .sink = NULL,                                       \
+    .sink_ctx = NULL,                                   \
+}
+
+typedef struct {
+    uint32_t frames_captured;
+    uint32_t frames_sent;
+    uint32_t frames_skipped;                // sink返回ESP_ERR_INVALID_STATE
+    uint32_t underruns;                     // 编码任务在一帧周期内未等到PCM
+    uint32_t overruns;                      // 双缓冲都在排队，采集帧被丢弃
+    uint32_t source_errors;
+    uint32_t encode_errors;
+    uint32_t send_errors;
+    uint64_t bytes_sent;
+    // 以下为自上次audio_sender_report()以来的统计
+    uint32_t encode_us_avg;
+    uint32_t encode_us_max;
+    uint32_t latency_us_avg;                // 帧内首个采样到交给sink完成
+    uint32_t latency_us_max;
+    uint32_t encoder_load_pct;              // 平均编码耗时占帧周期的比例
+} audio_sender_stats_t;
+
+/**
+ * @brief 启动采集任务（APP_TASK_CAPTURE）和编码发送任务（APP_TASK_MEDIA）
+ *
+ * 两个20ms PCM帧在两任务间轮转：采集端填满一帧后交给编码端，编码完成立即归还。
+ */
+esp_err_t audio_sender_start(const audio_sender_config_t *config);
+
+/**
+ * @brief 通知两个任务退出并等待，然后关闭信号源和编码器
+ *
+ * @return 任务未按时退出时返回ESP_ERR_TIMEOUT，资源保留到任务退出；
+ *         此后audio_sender_start返回ESP_ERR_INVALID_STATE，直到任务退出或再次调用stop成功
+ */
+esp_err_t audio_sender_stop(void);
+
+bool audio_sender_is_running(void);
+
+void audio_sender_get_stats(audio_sender_stats_t *stats);
+
+/**
+ * @brief 打印编码耗时、管线延迟和欠载，并开始新的统计区间
+ *
+ * 运行中每CONFIG_WEBRTC_AUDIO_REPORT_S秒由编码任务自动调用
+ */
+void audio_sender_report(void);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,215 @@
+#include "audio_source.hpp"
+
+#include <stdio.h>
+#include <string.h>
+#include <inttypes.h>
+#include "esp_log.h"
+#include "freertos/FreeRTOS.h"
+#include "driver/i2s_std.h"
+
+static const char *TAG = "audio_source";
+
+/* ---------------- WAV文件源 ---------------- */
+
+static FILE *g_wav_file = NULL;
+static long g_wav_data_offset = 0;
+static uint32_t g_wav_data_size = 0;
+static uint32_t g_wav_data_pos = 0;
+
+static uint16_t le16(const uint8_t *p)
+{
+    return (uint16_t)(p[0] | (p[1] << 8));
+}
+
+static uint32_t le32(const uint8_t *p)
+{
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static void wav_close(void)
+{
+    if (g_wav_file) {
+        fclose(g_wav_file);
+        g_wav_file = NULL;
+    }
+}
+
+/**
+ * @brief 打开WAV文件并定位到data块，只接受与请求一致的16位PCM
+ */
+static esp_err_t wav_open(uint32_t sample_rate, uint8_t channels)
+{
+    g_wav_file = fopen(CONFIG_WEBRTC_AUDIO_WAV_PATH, "rb");
+    if (!g_wav_file) {
+        ESP_LOGE(TAG, "无法打开WAV文件: %s", CONFIG_WEBRTC_AUDIO_WAV_PATH);
+        return ESP_ERR_NOT_FOUND;
+    }
+
+    uint8_t header[12];
+    if (fread(header, 1, sizeof(header), g_wav_file) != sizeof(header) ||
+        memcmp(header, "RIFF", 4) != 0 || memcmp(header + 8, "WAVE", 4) != 0) {
+        ESP_LOGE(TAG, "不是RIFF/WAVE文件");
+        wav_close();
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    bool have_fmt = false;
+    uint8_t chunk[8];
+    while (fread(chunk, 1, sizeof(chunk), g_wav_file) == sizeof(chunk)) {
+        uint32_t size = le32(chunk + 4);
+        if (memcmp(chunk, "fmt ", 4) == 0) {
+            uint8_t fmt[16];
+            if (size < sizeof(fmt) || fread(fmt, 1, sizeof(fmt), g_wav_file) != sizeof(fmt)) {
+                break;
+            }
+            uint16_t format = le16(fmt);
+            uint16_t file_channels = le16(fmt + 2);
+            uint32_t file_rate = le32(fmt + 4);
+            uint16_t bits = le16(fmt + 14);
+            // 0xFFFE为WAVE_FORMAT_EXTENSIBLE，16位时样本布局与PCM相同
+            if ((format != 1 && format != 0xFFFE) || bits != 16 ||
+                file_channels != channels || file_rate != sample_rate) {
+                ESP_LOGE(TAG, "WAV格式不匹配: 格式%u %u位 %u声道 %" PRIu32 "Hz，需要16位PCM %u声道 %" PRIu32 "Hz",
+                         format, bits, file_channels, file_rate, channels, sample_rate);
+                wav_close();
+                return ESP_ERR_NOT_SUPPORTED;
+            }
+            have_fmt = true;
+            size -= sizeof(fmt);
+        } else if (memcmp(chunk, "data", 4) == 0) {
+            if (!have_fmt) {
+                break;
+            }
+            g_wav_data_offset = ftell(g_wav_file);
+            g_wav_data_size = size - size % (channels * sizeof(int16_t));
+            g_wav_data_pos = 0;
+            if (g_wav_data_size == 0) {
+                break;
+            }
+            ESP_LOGI(TAG, "WAV文件: %s，%" PRIu32 "字节PCM", CONFIG_WEBRTC_AUDIO_WAV_PATH, g_wav_data_size);
+            return ESP_OK;
+        }
+        // 块按偶数字节对齐
+        if (fseek(g_wav_file, (long)(size + (size & 1)), SEEK_CUR) != 0) {
+            break;
+        }
+    }
+
+    ESP_LOGE(TAG, "WAV文件缺少fmt或data块");
+    wav_close();
+    return ESP_ERR_INVALID_ARG;
+}
+
+static int wav_read(int16_t *samples, size_t count)
+{
+    if (!g_wav_file) {
+        return -1;
+    }
+    size_t filled = 0;
+    while (filled < count) {
+        if (g_wav_data_pos >= g_wav_data_size) {
+            // 读到结尾从头循环
+            if (fseek(g_wav_file, g_wav_data_offset, SEEK_SET) != 0) {
+                return -1;
+            }
+            g_wav_data_pos = 0;
+        }
+        size_t want = count - filled;
+        size_t left = (g_wav_data_size - g_wav_data_pos) / sizeof(int16_t);
+        if (want > left) {
+            want = left;
+        }
+        size_t got = fread(samples + filled, sizeof(int16_t), want, g_wav_file);
+        if (got == 0) {
+            return filled > 0 ? (int)filled : -1;
+        }
+        filled += got;
+        g_wav_data_pos += got * sizeof(int16_t);
+    }
+    return (int)filled;
+}
+
+const audio_source_t audio_source_wav = {
+    .name = "wav",
+    .realtime = false,
+    .open = wav_open,
+    .read = wav_read,
+    .close = wav_close,
+};
+
+/* ---------------- I2S麦克风源 ---------------- */
+
+static i2s_chan_handle_t g_i2s_rx = NULL;
+
+static void i2s_source_close(void)
+{
+    if (g_i2s_rx) {
+        i2s_channel_disable(g_i2s_rx);
+        i2s_del_channel(g_i2s_rx);
+        g_i2s_rx = NULL;
+    }
+}
+
+static esp_err_t i2s_source_open(uint32_t sample_rate, uint8_t channels)
+{
+    i2s_chan_config_t chan_cfg = I2S_CHANNEL_DEFAULT_CONFIG(I2S_NUM_AUTO, I2S_ROLE_MASTER);
+    // DMA缓冲共40ms（两帧），编码任务短暂抖动时采样不丢失
+    chan_cfg.dma_desc_num = 4;
+    chan_cfg.dma_frame_num = sample_rate / 100;
+    esp_err_t ret = i2s_new_channel(&chan_cfg, NULL, &g_i2s_rx);
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "创建I2S接收通道失败: %s", esp_err_to_name(ret));
+        return ret;
+    }
+
+    i2s_std_config_t std_cfg = {
+        .clk_cfg = I2S_STD_CLK_DEFAULT_CONFIG(sample_rate),
+        .slot_cfg = I2S_STD_PHILIPS_SLOT_DEFAULT_CONFIG(I2S_DATA_BIT_WIDTH_16BIT,
+                                                        channels == 1 ? I2S_SLOT_MODE_MONO : I2S_SLOT_MODE_STEREO),
+        .gpio_cfg = {
+            .mclk = I2S_GPIO_UNUSED,
+            .bclk = (gpio_num_t)CONFIG_WEBRTC_AUDIO_I2S_BCLK_GPIO,
+            .ws = (gpio_num_t)CONFIG_WEBRTC_AUDIO_I2S_WS_GPIO,
+            .dout = I2S_GPIO_UNUSED,
+            .din = (gpio_num_t)CONFIG_WEBRTC_AUDIO_I2S_DIN_GPIO,
+            .invert_flags = {},
+        },
+    };
+    ret = i2s_channel_init_std_mode(g_i2s_rx, &std_cfg);
+    if (ret == ESP_OK) {
+        ret = i2s_channel_enable(g_i2s_rx);
+    }
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "启动I2S接收失败: %s", esp_err_to_name(ret));
+        i2s_del_channel(g_i2s_rx);
+        g_i2s_rx = NULL;
+        return ret;
+    }
+    ESP_LOGI(TAG, "I2S麦克风: BCLK=%d WS=%d DIN=%d，%" PRIu32 "Hz %u声道",
+             CONFIG_WEBRTC_AUDIO_I2S_BCLK_GPIO, CONFIG_WEBRTC_AUDIO_I2S_WS_GPIO,
+             CONFIG_WEBRTC_AUDIO_I2S_DIN_GPIO, sample_rate, channels);
+    return ESP_OK;
+}
+
+static int i2s_source_read(int16_t *samples, size_t count)
+{
+    size_t bytes_read = 0;
+    esp_err_t ret = i2s_channel_read(g_i2s_rx, samples, count * sizeof(int16_t), &bytes_read, portMAX_DELAY);
+    if (ret != ESP_OK) {
+        return -1;
+    }
+    return (int)(bytes_read / sizeof(int16_t));
+}
+
+const audio_source_t audio_source_i2s = {
+    .name = "i2s",
+    .realtime = true,
+    .open = i2s_source_open,
+    .read = i2s_source_read,
+    .close = i2s_source_close,
+};
+
+const audio_source_t *audio_source_default(void)
+{
+    return &audio_source_i2s;
+}
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief PCM信号源（16位有符号，多声道交错）
+ *
+ * realtime为true的信号源按采样率实时产出（read阻塞到数据就绪，如I2S）；
+ * 否则采集任务按帧周期节拍读取（如WAV文件）。
+ */
+typedef struct {
+    const char *name;
+    bool realtime;
+    esp_err_t (*open)(uint32_t sample_rate, uint8_t channels);
+    int (*read)(int16_t *samples, size_t count);    // 返回读到的采样数，<0表示出错
+    void (*close)(void);
+} audio_source_t;
+
+// WAV文件源：CONFIG_WEBRTC_AUDIO_WAV_PATH，读到结尾后从头循环
+extern const audio_source_t audio_source_wav;
+
+// I2S标准模式麦克风，引脚由Kconfig配置
+extern const audio_source_t audio_source_i2s;
+
+// I2S麦克风
+const audio_source_t *audio_source_default(void);
+
+#ifdef __cplusplus
+}
+#endif
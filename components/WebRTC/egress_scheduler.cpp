@@ -0,0 +1,677 @@
+#include "egress_scheduler.hpp"
+
+#include <string.h>
+#include <inttypes.h>
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "heap_monitor.hpp"
+
+static const char *TAG = "egress";
+
+#define EGRESS_AUDIO_SLOTS 8
+#define EGRESS_AUDIO_MAX 512                // 单帧音频上限，Opus 20ms远小于此
+#define EGRESS_DATA_QUANTUM 1024            // 每次授予数据通道的字节数，决定与视频交错的粒度
+#define EGRESS_WEIGHT_SCALE 256
+#define EGRESS_DECREASE_INTERVAL_US 100000  // 两次降低链路估计的最小间隔
+#define EGRESS_INCREASE_INTERVAL_US 1000000
+
+typedef struct {
+    uint16_t size;
+    uint32_t pts;
+    int64_t submit_us;
+    uint8_t data[EGRESS_AUDIO_MAX];
+} audio_slot_t;
+
+static egress_config_t g_config;
+static egress_ops_t g_ops;
+static bool g_ready = false;
+static int64_t (*g_now)(void) = esp_timer_get_time;    // 基准测试换成模拟时钟
+
+// 提交队列，提交方与发送任务共用
+static portMUX_TYPE g_lock = portMUX_INITIALIZER_UNLOCKED;
+static audio_slot_t g_audio[EGRESS_AUDIO_SLOTS];
+static int g_audio_head = 0;
+static int g_audio_count = 0;
+static bool g_video_pending = false;
+static bool g_video_in_flight = false;      // 发送任务已取走，drop_all不再完成它
+static const uint8_t *g_video_data = NULL;
+static size_t g_video_size = 0;
+static uint32_t g_video_pts = 0;
+static int64_t g_video_submit_us = 0;
+static egress_done_cb_t g_video_done = NULL;
+static void *g_video_user_data = NULL;
+static uint32_t g_link_kbps = 0;
+
+// 以下仅发送任务访问
+static audio_slot_t g_audio_out;
+static int64_t g_tokens = 0;
+static int64_t g_refill_us = 0;
+static uint64_t g_vtime[2];                 // 视频、数据的虚拟时间
+static bool g_backlogged[2];
+static int64_t g_data_wait_since_us = 0;
+static int64_t g_last_decrease_us = 0;
+static int64_t g_window_start_us = 0;
+static bool g_window_shaped = false;
+static bool g_window_stalled = false;
+static int64_t g_last_report_us = 0;
+
+static portMUX_TYPE g_stats_lock = portMUX_INITIALIZER_UNLOCKED;
+static egress_stats_t g_stats;
+static uint64_t g_delay_sum_us[EGRESS_CLASS_MAX];
+static uint32_t g_delay_count[EGRESS_CLASS_MAX];
+
+static void record_sent(egress_class_t cls, size_t bytes, int64_t delay_us)
+{
+    portENTER_CRITICAL(&g_stats_lock);
+    g_stats.packets[cls]++;
+    g_stats.bytes[cls] += bytes;
+    if (delay_us >= 0) {
+        g_delay_sum_us[cls] += delay_us;
+        g_delay_count[cls]++;
+        if (delay_us > g_stats.delay_max_us[cls]) {
+            g_stats.delay_max_us[cls] = (uint32_t)delay_us;
+        }
+    }
+    portEXIT_CRITICAL(&g_stats_lock);
+}
+
+static void refill(int64_t now)
+{
+    portENTER_CRITICAL(&g_lock);
+    uint32_t kbps = g_link_kbps;
+    portEXIT_CRITICAL(&g_lock);
+    // kbps * 1000 / 8 字节每秒，即每微秒kbps / 8000字节
+    g_tokens += (now - g_refill_us) * kbps / 8000;
+    if (g_tokens > (int64_t)g_config.burst_bytes) {
+        g_tokens = g_config.burst_bytes;
+    }
+    g_refill_us = now;
+}
+
+// SCTP拒绝或视频发送失败：乘性降低链路估计
+static void link_decrease(int64_t now)
+{
+    g_window_stalled = true;
+    if (now - g_last_decrease_us < EGRESS_DECREASE_INTERVAL_US) {
+        return;
+    }
+    g_last_decrease_us = now;
+    portENTER_CRITICAL(&g_lock);
+    uint32_t kbps = g_link_kbps * 85 / 100;
+    g_link_kbps = kbps > g_config.min_kbps ? kbps : g_config.min_kbps;
+    portEXIT_CRITICAL(&g_lock);
+}
+
+// 每个窗口内受限于整形且没有拒绝：加性恢复5%
+static void link_update_window(int64_t now)
+{
+    if (now - g_window_start_us < EGRESS_INCREASE_INTERVAL_US) {
+        return;
+    }
+    if (g_window_shaped && !g_window_stalled) {
+        portENTER_CRITICAL(&g_lock);
+        uint32_t kbps = g_link_kbps + g_link_kbps / 20 + 1;
+        g_link_kbps = kbps < g_config.max_kbps ? kbps : g_config.max_kbps;
+        portEXIT_CRITICAL(&g_lock);
+    }
+    g_window_start_us = now;
+    g_window_shaped = false;
+    g_window_stalled = false;
+}
+
+// 类别从空闲变为积压时追上另一类的虚拟时间，空闲期间不积攒份额
+static void update_backlog(int cls, bool backlogged)
+{
+    if (backlogged && !g_backlogged[cls] && g_vtime[cls] < g_vtime[1 - cls]) {
+        g_vtime[cls] = g_vtime[1 - cls];
+    }
+    g_backlogged[cls] = backlogged;
+}
+
+static void send_audio(int64_t now)
+{
+    for (;;) {
+        portENTER_CRITICAL(&g_lock);
+        if (g_audio_count == 0) {
+            portEXIT_CRITICAL(&g_lock);
+            break;
+        }
+        const audio_slot_t *slot = &g_audio[g_audio_head];
+        g_audio_out.size = slot->size;
+        g_audio_out.pts = slot->pts;
+        g_audio_out.submit_us = slot->submit_us;
+        memcpy(g_audio_out.data, slot->data, slot->size);
+        g_audio_head = (g_audio_head + 1) % EGRESS_AUDIO_SLOTS;
+        g_audio_count--;
+        portEXIT_CRITICAL(&g_lock);
+
+        int ret = g_ops.send_audio(g_audio_out.data, g_audio_out.size, g_audio_out.pts, g_ops.ctx);
+        g_tokens -= g_audio_out.size;
+        if (ret != 0) {
+            portENTER_CRITICAL(&g_stats_lock);
+            g_stats.send_errors++;
+            portEXIT_CRITICAL(&g_stats_lock);
+            continue;
+        }
+        record_sent(EGRESS_CLASS_AUDIO, g_audio_out.size, now - g_audio_out.submit_us);
+    }
+}
+
+static void send_video(int64_t now)
+{
+    portENTER_CRITICAL(&g_lock);
+    g_video_in_flight = true;
+    const uint8_t *data = g_video_data;
+    size_t size = g_video_size;
+    uint32_t pts = g_video_pts;
+    int64_t submit_us = g_video_submit_us;
+    egress_done_cb_t done = g_video_done;
+    void *user_data = g_video_user_data;
+    portEXIT_CRITICAL(&g_lock);
+
+    int ret = g_ops.send_video(data, size, pts, g_ops.ctx);
+    g_tokens -= size;
+    g_vtime[0] += (uint64_t)size * EGRESS_WEIGHT_SCALE / g_config.video_weight;
+
+    // 先清除再回调：提交方可能在回调返回后立即提交下一个访问单元
+    portENTER_CRITICAL(&g_lock);
+    g_video_pending = false;
+    g_video_in_flight = false;
+    portEXIT_CRITICAL(&g_lock);
+    if (ret != 0) {
+        portENTER_CRITICAL(&g_stats_lock);
+        g_stats.send_errors++;
+        portEXIT_CRITICAL(&g_stats_lock);
+        link_decrease(now);
+    } else {
+        record_sent(EGRESS_CLASS_VIDEO, size, now - submit_us);
+    }
+    if (done) {
+        done(data, ret == 0, user_data);
+    }
+}
+
+// 返回false表示数据通道本轮不能再发（被拒绝或没有可发的内容）
+static bool send_data(int64_t now)
+{
+    int budget = g_tokens < EGRESS_DATA_QUANTUM ? (int)g_tokens : EGRESS_DATA_QUANTUM;
+    bool stalled = false;
+    int sent = g_ops.send_data(budget, &stalled, g_ops.ctx);
+    if (sent > 0) {
+        g_tokens -= sent;
+        g_vtime[1] += (uint64_t)sent * EGRESS_WEIGHT_SCALE / g_config.data_weight;
+        record_sent(EGRESS_CLASS_DATA, sent, g_data_wait_since_us ? now - g_data_wait_since_us : 0);
+        g_data_wait_since_us = 0;
+    }
+    if (stalled) {
+        portENTER_CRITICAL(&g_stats_lock);
+        g_stats.data_stalls++;
+        portEXIT_CRITICAL(&g_stats_lock);
+        link_decrease(now);
+    }
+    return sent > 0 && !stalled;
+}
+
+esp_err_t egress_scheduler_init(const egress_config_t *config, const egress_ops_t *ops)
+{
+    if (!config || !ops || !ops->send_audio || !ops->send_video || !ops->send_data || !ops->data_backlog) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    g_config = *config;
+    if (g_config.video_weight == 0) {
+        g_config.video_weight = 1;
+    }
+    if (g_config.data_weight == 0) {
+        g_config.data_weight = 1;
+    }
+    g_ops = *ops;
+
+    int64_t now = g_now();
+    g_audio_head = 0;
+    g_audio_count = 0;
+    g_video_pending = false;
+    g_video_in_flight = false;
+    g_link_kbps = g_config.link_kbps;
+    g_tokens = g_config.burst_bytes;
+    g_refill_us = now;
+    memset(g_vtime, 0, sizeof(g_vtime));
+    memset(g_backlogged, 0, sizeof(g_backlogged));
+    g_data_wait_since_us = 0;
+    g_last_decrease_us = 0;
+    g_window_start_us = now;
+    g_window_shaped = false;
+    g_window_stalled = false;
+    g_last_report_us = now;
+    memset(&g_stats, 0, sizeof(g_stats));
+    memset(g_delay_sum_us, 0, sizeof(g_delay_sum_us));
+    memset(g_delay_count, 0, sizeof(g_delay_count));
+    g_ready = true;
+
+    ESP_LOGI(TAG, "发送调度已启用: 链路估计%" PRIu32 "kbps（%" PRIu32 "-%" PRIu32 "），突发%" PRIu32 "字节，视频:数据=%d:%d",
+             g_config.link_kbps, g_config.min_kbps, g_config.max_kbps, g_config.burst_bytes,
+             g_config.video_weight, g_config.data_weight);
+    return ESP_OK;
+}
+
+void egress_scheduler_deinit(void)
+{
+    egress_scheduler_drop_all();
+    g_ready = false;
+}
+
+esp_err_t egress_scheduler_submit_audio(const uint8_t *data, size_t size, uint32_t pts)
+{
+    if (!data || size == 0 || size > EGRESS_AUDIO_MAX) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (!g_ready) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    int64_t now = g_now();
+    bool dropped = false;
+    portENTER_CRITICAL(&g_lock);
+    if (g_audio_count == EGRESS_AUDIO_SLOTS) {
+        // 积压的音频已过时，丢弃最旧的一帧
+        g_audio_head = (g_audio_head + 1) % EGRESS_AUDIO_SLOTS;
+        g_audio_count--;
+        dropped = true;
+    }
+    audio_slot_t *slot = &g_audio[(g_audio_head + g_audio_count) % EGRESS_AUDIO_SLOTS];
+    slot->size = (uint16_t)size;
+    slot->pts = pts;
+    slot->submit_us = now;
+    memcpy(slot->data, data, size);
+    g_audio_count++;
+    portEXIT_CRITICAL(&g_lock);
+
+    if (dropped) {
+        portENTER_CRITICAL(&g_stats_lock);
+        g_stats.audio_dropped++;
+        portEXIT_CRITICAL(&g_stats_lock);
+    }
+    if (g_ops.wake) {
+        g_ops.wake(g_ops.ctx);
+    }
+    return ESP_OK;
+}
+
+esp_err_t egress_scheduler_submit_video(const uint8_t *data, size_t size, uint32_t pts,
+                                        egress_done_cb_t done, void *user_data)
+{
+    if (!data || size == 0) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (!g_ready) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    int64_t now = g_now();
+    portENTER_CRITICAL(&g_lock);
+    if (g_video_pending) {
+        portEXIT_CRITICAL(&g_lock);
+        return ESP_ERR_INVALID_STATE;
+    }
+    g_video_pending = true;
+    g_video_data = data;
+    g_video_size = size;
+    g_video_pts = pts;
+    g_video_submit_us = now;
+    g_video_done = done;
+    g_video_user_data = user_data;
+    portEXIT_CRITICAL(&g_lock);
+    if (g_ops.wake) {
+        g_ops.wake(g_ops.ctx);
+    }
+    return ESP_OK;
+}
+
+void egress_scheduler_run(void)
+{
+    if (!g_ready) {
+        return;
+    }
+    int64_t now = g_now();
+    refill(now);
+
+    // 1. 音频严格优先，不等令牌
+    send_audio(now);
+
+    // 2. 视频与数据按虚拟时间轮流，令牌用完即停，欠账由之后偿还
+    bool data_open = true;
+    for (;;) {
+        portENTER_CRITICAL(&g_lock);
+        bool video_ready = g_video_pending && !g_video_in_flight;
+        portEXIT_CRITICAL(&g_lock);
+        bool data_ready = data_open && g_ops.data_backlog(g_ops.ctx) > 0;
+        update_backlog(0, video_ready);
+        update_backlog(1, data_ready);
+        if (!video_ready && !data_ready) {
+            break;
+        }
+        if (g_tokens <= 0) {
+            if (data_ready && !g_data_wait_since_us) {
+                g_data_wait_since_us = now;
+            }
+            g_window_shaped = true;
+            portENTER_CRITICAL(&g_stats_lock);
+            g_stats.shaped_rounds++;
+            portEXIT_CRITICAL(&g_stats_lock);
+            break;
+        }
+        if (video_ready && (!data_ready || g_vtime[0] <= g_vtime[1])) {
+            send_video(now);
+        } else {
+            data_open = send_data(now);
+        }
+    }
+    link_update_window(now);
+
+#if CONFIG_WEBRTC_EGRESS_REPORT_S > 0
+    if (now - g_last_report_us >= (int64_t)CONFIG_WEBRTC_EGRESS_REPORT_S * 1000000) {
+        g_last_report_us = now;
+        egress_scheduler_report();
+    }
+#endif
+}
+
+void egress_scheduler_drop_all(void)
+{
+    egress_done_cb_t done = NULL;
+    const uint8_t *data = NULL;
+    void *user_data = NULL;
+    portENTER_CRITICAL(&g_lock);
+    g_audio_count = 0;
+    if (g_video_pending && !g_video_in_flight) {
+        g_video_pending = false;
+        done = g_video_done;
+        data = g_video_data;
+        user_data = g_video_user_data;
+    }
+    portEXIT_CRITICAL(&g_lock);
+    if (done) {
+        done(data, false, user_data);
+    }
+}
+
+void egress_scheduler_set_link_kbps(uint32_t kbps)
+{
+    if (kbps < g_config.min_kbps) {
+        kbps = g_config.min_kbps;
+    }
+    if (kbps > g_config.max_kbps) {
+        kbps = g_config.max_kbps;
+    }
+    portENTER_CRITICAL(&g_lock);
+    g_link_kbps = kbps;
+    portEXIT_CRITICAL(&g_lock);
+}
+
+void egress_scheduler_get_stats(egress_stats_t *stats)
+{
+    if (!stats) {
+        return;
+    }
+    portENTER_CRITICAL(&g_stats_lock);
+    *stats = g_stats;
+    for (int i = 0; i < EGRESS_CLASS_MAX; i++) {
+        stats->delay_avg_us[i] = g_delay_count[i] ? (uint32_t)(g_delay_sum_us[i] / g_delay_count[i]) : 0;
+    }
+    portEXIT_CRITICAL(&g_stats_lock);
+    portENTER_CRITICAL(&g_lock);
+    stats->link_kbps = g_link_kbps;
+    portEXIT_CRITICAL(&g_lock);
+}
+
+void egress_scheduler_report(void)
+{
+    egress_stats_t stats;
+    egress_scheduler_get_stats(&stats);
+    static const char *const names[EGRESS_CLASS_MAX] = {"audio", "video", "data"};
+    for (int i = 0; i < EGRESS_CLASS_MAX; i++) {
+        if (stats.packets[i] == 0) {
+            continue;
+        }
+        ESP_LOGI(TAG, "[Performance][egress_queue_delay_us][%s]: 平均%" PRIu32 " 最大%" PRIu32 " (%" PRIu32 "次，%" PRIu64 "字节)",
+                 names[i], stats.delay_avg_us[i], stats.delay_max_us[i], stats.packets[i], stats.bytes[i]);
+    }
+    ESP_LOGI(TAG, "[Performance][egress_link_kbps]: %" PRIu32 " (整形%" PRIu32 "轮，SCTP拒绝%" PRIu32 "次，音频丢弃%" PRIu32 "，发送错误%" PRIu32 ")",
+             stats.link_kbps, stats.shaped_rounds, stats.data_stalls, stats.audio_dropped, stats.send_errors);
+
+    portENTER_CRITICAL(&g_stats_lock);
+    memset(g_delay_sum_us, 0, sizeof(g_delay_sum_us));
+    memset(g_delay_count, 0, sizeof(g_delay_count));
+    memset(g_stats.delay_max_us, 0, sizeof(g_stats.delay_max_us));
+    portEXIT_CRITICAL(&g_stats_lock);
+}
+
+#if CONFIG_WEBRTC_EGRESS_BENCHMARK
+/*
+ * 回环基准
+ *
+ * 模拟链路：一个按LINK_KBPS匀速排空的FIFO，代表Wi-Fi发送队列；包的时延为
+ * 提交到离开链路的时间（调度器队列+链路队列）。负载同时包含：
+ *   音频  每20ms一帧120字节
+ *   视频  30fps，P帧2500字节，每2秒一个40000字节的关键帧
+ *   数据  大块传输，应用始终保持64KB积压（16KB一条消息，1KB分片）
+ * SCTP在链路积压超过BENCH_SCTP_WINDOW时拒绝发送，近似其拥塞窗口。
+ *
+ * 直接发送：音视频到达即进入链路，数据每10ms按CONFIG_WEBRTC_DATA_CHANNEL_FLUSH_BYTES发送（现有行为）。
+ * 调度发送：经本调度器，音频到达时唤醒、其余每10ms调度一次，链路估计为真实容量的90%。
+ */
+
+#define BENCH_DURATION_US 10000000
+#define BENCH_LINK_KBPS 4000
+#define BENCH_AUDIO_BYTES 120
+#define BENCH_VIDEO_P_BYTES 2500
+#define BENCH_VIDEO_KEY_BYTES 40000
+#define BENCH_DATA_MSG 16384
+#define BENCH_DATA_BACKLOG 65536
+#define BENCH_DATA_FRAGMENT 1024
+#define BENCH_SCTP_WINDOW 65536
+#define BENCH_HIST_MS 1000                  // 时延直方图1ms一格，超出计入最后一格
+
+typedef struct {
+    uint32_t hist[EGRESS_CLASS_MAX][BENCH_HIST_MS + 1];
+    uint64_t sum_us[EGRESS_CLASS_MAX];
+    uint32_t count[EGRESS_CLASS_MAX];
+    uint32_t max_us[EGRESS_CLASS_MAX];
+} bench_result_t;
+
+static int64_t g_sim_us = 0;
+static int64_t g_link_free_us = 0;
+static bench_result_t *g_bench = NULL;
+// 数据源：积压的消息，按入队时间计算整条消息的时延
+static int64_t g_data_msgs_us[BENCH_DATA_BACKLOG / BENCH_DATA_MSG + 1];
+static int g_data_msg_count = 0;
+static uint32_t g_data_offset = 0;          // 队首消息已发出的字节
+static uint8_t g_bench_payload[BENCH_VIDEO_KEY_BYTES];
+
+static int64_t sim_now(void)
+{
+    return g_sim_us;
+}
+
+static void bench_record(egress_class_t cls, int64_t delay_us)
+{
+    uint32_t ms = (uint32_t)(delay_us / 1000);
+    g_bench->hist[cls][ms < BENCH_HIST_MS ? ms : BENCH_HIST_MS]++;
+    g_bench->sum_us[cls] += delay_us;
+    g_bench->count[cls]++;
+    if (delay_us > g_bench->max_us[cls]) {
+        g_bench->max_us[cls] = (uint32_t)delay_us;
+    }
+}
+
+// 放入链路，返回离开链路的时间
+static int64_t link_push(size_t bytes)
+{
+    int64_t start = g_link_free_us > g_sim_us ? g_link_free_us : g_sim_us;
+    g_link_free_us = start + (int64_t)bytes * 8000 / BENCH_LINK_KBPS;
+    return g_link_free_us;
+}
+
+static int64_t link_backlog_bytes(void)
+{
+    return g_link_free_us > g_sim_us ? (g_link_free_us - g_sim_us) * BENCH_LINK_KBPS / 8000 : 0;
+}
+
+// pts携带提交时间（模拟时钟，微秒）
+static int bench_send_audio(const uint8_t *data, size_t size, uint32_t pts, void *ctx)
+{
+    bench_record(EGRESS_CLASS_AUDIO, link_push(size) - pts);
+    return 0;
+}
+
+static int bench_send_video(const uint8_t *data, size_t size, uint32_t pts, void *ctx)
+{
+    bench_record(EGRESS_CLASS_VIDEO, link_push(size) - pts);
+    return 0;
+}
+
+static int bench_send_data(int budget, bool *stalled, void *ctx)
+{
+    int sent = 0;
+    while (sent < budget && g_data_msg_count > 0) {
+        if (link_backlog_bytes() > BENCH_SCTP_WINDOW) {
+            *stalled = true;
+            break;
+        }
+        uint32_t chunk = BENCH_DATA_MSG - g_data_offset;
+        chunk = chunk < BENCH_DATA_FRAGMENT ? chunk : BENCH_DATA_FRAGMENT;
+        int64_t departure = link_push(chunk + 12);
+        sent += chunk + 12;
+        g_data_offset += chunk;
+        if (g_data_offset == BENCH_DATA_MSG) {
+            bench_record(EGRESS_CLASS_DATA, departure - g_data_msgs_us[0]);
+            memmove(g_data_msgs_us, g_data_msgs_us + 1, (g_data_msg_count - 1) * sizeof(int64_t));
+            g_data_msg_count--;
+            g_data_offset = 0;
+        }
+    }
+    return sent;
+}
+
+static uint32_t bench_data_backlog(void *ctx)
+{
+    return g_data_msg_count * BENCH_DATA_MSG - g_data_offset;
+}
+
+static void bench_video_done(const uint8_t *data, bool sent, void *user_data)
+{
+}
+
+static void bench_run(bool scheduled)
+{
+    memset(g_bench, 0, sizeof(*g_bench));
+    g_sim_us = 0;
+    g_link_free_us = 0;
+    g_data_msg_count = 0;
+    g_data_offset = 0;
+    // 视频发送方等待上一访问单元发出才提交下一个，这里记下等待中的访问单元
+    size_t video_waiting[4];
+    int64_t video_waiting_us[4];
+    int video_waiting_count = 0;
+    uint32_t frame = 0;
+
+    for (g_sim_us = 0; g_sim_us < BENCH_DURATION_US; g_sim_us += 1000) {
+        while (g_data_msg_count * BENCH_DATA_MSG - g_data_offset + BENCH_DATA_MSG <= BENCH_DATA_BACKLOG) {
+            g_data_msgs_us[g_data_msg_count++] = g_sim_us;
+        }
+        bool audio_due = g_sim_us % 20000 == 0;
+        bool tick = g_sim_us % 10000 == 0;
+        if (audio_due) {
+            if (scheduled) {
+                egress_scheduler_submit_audio(g_bench_payload, BENCH_AUDIO_BYTES, (uint32_t)g_sim_us);
+            } else {
+                bench_send_audio(g_bench_payload, BENCH_AUDIO_BYTES, (uint32_t)g_sim_us, NULL);
+            }
+        }
+        if (g_sim_us * 30 / 1000000 >= frame) {
+            size_t size = frame % 60 == 0 ? BENCH_VIDEO_KEY_BYTES : BENCH_VIDEO_P_BYTES;
+            frame++;
+            if (!scheduled) {
+                bench_send_video(g_bench_payload, size, (uint32_t)g_sim_us, NULL);
+            } else if (video_waiting_count < 4) {
+                video_waiting[video_waiting_count] = size;
+                video_waiting_us[video_waiting_count++] = g_sim_us;
+            }
+        }
+        if (scheduled) {
+            if (video_waiting_count > 0 &&
+                egress_scheduler_submit_video(g_bench_payload, video_waiting[0], (uint32_t)video_waiting_us[0],
+                                              bench_video_done, NULL) == ESP_OK) {
+                memmove(video_waiting, video_waiting + 1, (video_waiting_count - 1) * sizeof(size_t));
+                memmove(video_waiting_us, video_waiting_us + 1, (video_waiting_count - 1) * sizeof(int64_t));
+                video_waiting_count--;
+            }
+            if (audio_due || tick) {
+                egress_scheduler_run();
+            }
+        } else if (tick) {
+            bool stalled = false;
+            bench_send_data(CONFIG_WEBRTC_DATA_CHANNEL_FLUSH_BYTES, &stalled, NULL);
+        }
+    }
+}
+
+static uint32_t bench_p99_ms(egress_class_t cls)
+{
+    uint32_t target = g_bench->count[cls] - g_bench->count[cls] / 100;
+    uint32_t seen = 0;
+    for (int ms = 0; ms <= BENCH_HIST_MS; ms++) {
+        seen += g_bench->hist[cls][ms];
+        if (seen >= target) {
+            return ms;
+        }
+    }
+    return BENCH_HIST_MS;
+}
+
+static void bench_print(const char *mode)
+{
+    static const char *const names[EGRESS_CLASS_MAX] = {"audio", "video", "data"};
+    for (int i = 0; i < EGRESS_CLASS_MAX; i++) {
+        egress_class_t cls = static_cast<egress_class_t>(i);
+        uint32_t count = g_bench->count[i];
+        ESP_LOGI(TAG, "[Performance][egress_bench_delay_ms][%s][%s]: 平均%" PRIu32 " p99 %" PRIu32 " 最大%" PRIu32 " (%" PRIu32 "个)",
+                 mode, names[i], count ? (uint32_t)(g_bench->sum_us[i] / count / 1000) : 0,
+                 count ? bench_p99_ms(cls) : 0, g_bench->max_us[i] / 1000, count);
+    }
+}
+
+void egress_scheduler_run_benchmark(void)
+{
+    g_bench = static_cast<bench_result_t*>(HEAP_MALLOC(HEAP_COMP_MEDIA, sizeof(bench_result_t)));
+    if (!g_bench) {
+        ESP_LOGE(TAG, "基准测试内存不足");
+        return;
+    }
+    ESP_LOGI(TAG, "回环基准: 链路%dkbps，音频+视频(关键帧%d字节)+大块数据，模拟%d秒",
+             BENCH_LINK_KBPS, BENCH_VIDEO_KEY_BYTES, BENCH_DURATION_US / 1000000);
+
+    bench_run(false);
+    bench_print("direct");
+
+    egress_config_t config = EGRESS_DEFAULT_CONFIG();
+    config.link_kbps = BENCH_LINK_KBPS * 9 / 10;
+    config.max_kbps = config.link_kbps;
+    egress_ops_t ops = {
+        .send_audio = bench_send_audio,
+        .send_video = bench_send_video,
+        .send_data = bench_send_data,
+        .data_backlog = bench_data_backlog,
+        .wake = NULL,
+        .ctx = NULL,
+    };
+    g_now = sim_now;
+    g_sim_us = 0;
+    egress_scheduler_init(&config, &ops);
+    bench_run(true);
+    bench_print("scheduled");
+    g_ready = false;
+    g_now = esp_timer_get_time;
+
+    HEAP_FREE(g_bench);
+    g_bench = NULL;
+}
+#endif /* CONFIG_WEBRTC_EGRESS_BENCHMARK */
@@ -0,0 +1,121 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * 发送调度（CONFIG_WEBRTC_EGRESS_SCHEDULER）
+ *
+ * 音频RTP、视频RTP和数据通道SCTP都由Peer任务经此发出：
+ * - 音频严格优先，每次调度先发完，不受整形限制（字节仍计入令牌桶，挤占视频和数据）
+ * - 视频与数据按权重分享剩余带宽（按字节/权重累计虚拟时间，小者先发）
+ * - 视频和数据经令牌桶整形，速率为链路容量估计；数据通道被SCTP拒绝或视频发送失败时
+ *   乘性降低估计，受限于整形且无拒绝时每秒加性恢复
+ *
+ * 视频以访问单元为粒度（RTP分包在esp_peer内完成），超出令牌的访问单元照常发出，
+ * 欠下的令牌由之后的视频和数据偿还，长期速率不超过估计值。
+ */
+
+typedef enum {
+    EGRESS_CLASS_AUDIO = 0,
+    EGRESS_CLASS_VIDEO,
+    EGRESS_CLASS_DATA,
+    EGRESS_CLASS_MAX,
+} egress_class_t;
+
+// 实际发送操作，在调用egress_scheduler_run的任务中执行
+typedef struct {
+    int (*send_audio)(const uint8_t *data, size_t size, uint32_t pts, void *ctx);     // 0为成功
+    int (*send_video)(const uint8_t *data, size_t size, uint32_t pts, void *ctx);     // 0为成功
+    // 按预算发送数据通道积压，返回交出的字节数；*stalled为true表示SCTP拒绝发送
+    int (*send_data)(int budget, bool *stalled, void *ctx);
+    uint32_t (*data_backlog)(void *ctx);
+    void (*wake)(void *ctx);                // 有音频或视频提交时唤醒发送任务，可为NULL
+    void *ctx;
+} egress_ops_t;
+
+typedef struct {
+    uint32_t link_kbps;                     // 初始链路容量估计
+    uint32_t min_kbps;
+    uint32_t max_kbps;
+    uint32_t burst_bytes;                   // 令牌桶深度
+    uint8_t video_weight;
+    uint8_t data_weight;
+} egress_config_t;
+
+#define EGRESS_DEFAULT_CONFIG() {                           \
+    .link_kbps = CONFIG_WEBRTC_EGRESS_LINK_KBPS,            \
+    .min_kbps = CONFIG_WEBRTC_EGRESS_MIN_KBPS,              \
+    .max_kbps = CONFIG_WEBRTC_EGRESS_MAX_KBPS,              \
+    .burst_bytes = CONFIG_WEBRTC_EGRESS_BURST_BYTES,        \
+    .video_weight = CONFIG_WEBRTC_EGRESS_VIDEO_WEIGHT,      \
+    .data_weight = CONFIG_WEBRTC_EGRESS_DATA_WEIGHT,        \
+}
+
+// 视频访问单元发出（sent=true）或被丢弃后调用，之后提交方才可释放data
+typedef void (*egress_done_cb_t)(const uint8_t *data, bool sent, void *user_data);
+
+typedef struct {
+    uint32_t link_kbps;                     // 当前链路容量估计
+    uint32_t packets[EGRESS_CLASS_MAX];     // 音频/视频为帧数，数据为发送批次数
+    uint64_t bytes[EGRESS_CLASS_MAX];
+    uint32_t audio_dropped;                 // 音频队列满丢弃的最旧帧
+    uint32_t send_errors;
+    uint32_t data_stalls;
+    uint32_t shaped_rounds;                 // 因令牌不足推迟视频/数据的调度轮数
+    // 以下为自上次egress_scheduler_report()以来的排队时延（提交到交给esp_peer）
+    uint32_t delay_avg_us[EGRESS_CLASS_MAX];    // 数据类为积压等待令牌的时间
+    uint32_t delay_max_us[EGRESS_CLASS_MAX];
+} egress_stats_t;
+
+esp_err_t egress_scheduler_init(const egress_config_t *config, const egress_ops_t *ops);
+void egress_scheduler_deinit(void);
+
+/**
+ * @brief 提交一帧音频（拷贝），可在任意任务中调用，不阻塞
+ *
+ * 队列满时丢弃最旧的一帧
+ */
+esp_err_t egress_scheduler_submit_audio(const uint8_t *data, size_t size, uint32_t pts);
+
+/**
+ * @brief 提交一个视频访问单元（引用），同一时刻只能有一个未完成的访问单元
+ *
+ * data须保持有效直到done被调用
+ */
+esp_err_t egress_scheduler_submit_video(const uint8_t *data, size_t size, uint32_t pts,
+                                        egress_done_cb_t done, void *user_data);
+
+// 在发送任务中调用：发出音频，再按权重和令牌发送视频与数据
+void egress_scheduler_run(void);
+
+// 丢弃排队的音频和视频（视频以sent=false完成），连接断开或停止时调用
+void egress_scheduler_drop_all(void);
+
+// 外部得到更准确的链路容量时设置（限制在min_kbps到max_kbps之间）
+void egress_scheduler_set_link_kbps(uint32_t kbps);
+
+void egress_scheduler_get_stats(egress_stats_t *stats);
+
+// 打印各类排队时延和链路估计，并开始新的统计区间
+void egress_scheduler_report(void);
+
+#if CONFIG_WEBRTC_EGRESS_BENCHMARK
+/**
+ * @brief 回环基准：模拟一条固定容量的链路，在音频、视频关键帧突发和大块数据同时发送时
+ *        分别按现有方式（直接发送）和经调度器发送，输出各类的排队时延
+ *
+ * 使用模拟时钟，须在egress_scheduler_init之前调用
+ */
+void egress_scheduler_run_benchmark(void);
+#endif
+
+#ifdef __cplusplus
+}
+#endif
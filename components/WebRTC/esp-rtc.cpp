@@ -1,14 +1,39 @@
+#include "esp-rtc.hpp"
+
 #include <stdio.h>
+#include <string.h>
 #include "esp_log.h"
 #include "webrtc_client.hpp"
+#include "webrtc_signaling.hpp"
+#include "task_topology.hpp"
+#include "heap_monitor.hpp"
+#include "webrtc_data_channel.hpp"
+#include "audio_sender.hpp"
+#include "video_sender.hpp"
+#include "audio_mixer.hpp"
+#include "latency_probe.hpp"
+#include "wifi_power.hpp"
 
 // 全局日志标签
 static const char *TAG = "Main";
 
+#if CONFIG_WEBRTC_MEDIA_DATA_CHANNEL
+// 控制通道可靠有序，遥测通道不可靠无序且优先级较低
+static int g_control_channel = -1;
+static int g_telemetry_channel = -1;
+#endif
+
 // 状态回调函数
 static void on_webrtc_state_change(webrtc_client_state_t state, void *user_data)
 {
     ESP_LOGI(TAG, "WebRTC状态变化: %d", state);
+    webrtc_signaling_on_state(state);
+#if CONFIG_WEBRTC_VIDEO_SEND
+    if (state == WEBRTC_CLIENT_STATE_CONNECTED) {
+        // 新订阅者：立即发送缓存的关键帧
+        video_sender_on_connected();
+    }
+#endif
     
     switch (state) {
         case WEBRTC_CLIENT_STATE_IDLE:
@@ -56,8 +81,13 @@ static void on_webrtc_state_change(webrtc_client_state_t state, void *user_data)
 // 音频数据回调函数
 static void on_audio_data(const uint8_t *data, size_t size, void *user_data)
 {
+#if CONFIG_WEBRTC_AUDIO_MIXER
+    // esp_peer每个连接只有一路远端音频，固定为第0路
+    audio_mixer_push(0, data, size);
+#else
     ESP_LOGI(TAG, "收到音频数据，大小: %d 字节", size);
     // 这里可以处理音频数据，比如播放或转发
+#endif
 }
 
 // 视频数据回调函数
@@ -72,111 +102,270 @@ static void on_data_channel_data(const uint8_t *data, size_t size, void *user_da
 {
     ESP_LOGI(TAG, "收到数据通道数据，大小: %d 字节", size);
     
-    // 将接收到的数据转换为字符串并打印
+    // 按长度直接打印，无需拷贝成以'\0'结尾的字符串
     if (size > 0 && data != NULL) {
-        char *str_data = (char *)malloc(size + 1);
-        if (str_data) {
-            memcpy(str_data, data, size);
-            str_data[size] = '\0';
-            ESP_LOGI(TAG, "数据内容: %s", str_data);
-            free(str_data);
-        }
+        ESP_LOGI(TAG, "数据内容: %.*s", (int)size, (const char *)data);
     }
 }
 
-// SDP Offer回调函数
-static void on_sdp_offer_created(const char *sdp_offer, void *user_data)
+#if CONFIG_WEBRTC_MEDIA_DATA_CHANNEL
+// 控制通道收到完整消息（大消息已在缓冲池中重组）
+static void on_control_message(int channel, const uint8_t *data, size_t size, bool text, void *user_data)
+{
+    ESP_LOGI(TAG, "控制通道收到%s消息，大小: %d 字节", text ? "文本" : "二进制", (int)size);
+    if (text) {
+        ESP_LOGI(TAG, "消息内容: %.*s", (int)(size > 256 ? 256 : size), (const char *)data);
+    }
+#if CONFIG_WEBRTC_VIDEO_SEND
+    // 对端（或SFU）转发的PLI/关键帧请求
+    static const char pli[] = "\"type\":\"pli\"";
+    if (text && memmem(data, size, pli, sizeof(pli) - 1) != NULL) {
+        video_sender_request_keyframe();
+    }
+#endif
+}
+
+// 数据通道缓冲降到低水位，可恢复发送
+static void on_data_channel_low_water(int channel, uint32_t buffered, void *user_data)
+{
+    ESP_LOGI(TAG, "数据通道%d缓冲已降到%" PRIu32 "字节", channel, buffered);
+}
+#endif
+
+#if CONFIG_WEBRTC_LATENCY_PROBE
+// "status"命令的回复附带时延探测结果
+static void on_status_request(cJSON *status, void *user_data)
+{
+    latency_probe_add_json(status);
+}
+
+#if CONFIG_APP_WIFI_POWER_SAVE
+// 往返时延样本按当时的Wi-Fi省电模式统计
+static void on_latency_sample(const latency_probe_stats_t *stats, void *user_data)
 {
-    ESP_LOGI(TAG, "🎯 SDP Offer已创建:");
-    ESP_LOGI(TAG, "=== SDP OFFER START ===");
-    ESP_LOGI(TAG, "%s", sdp_offer);
-    ESP_LOGI(TAG, "=== SDP OFFER END ===");
-    ESP_LOGI(TAG, "请将此SDP Offer发送给您的信令服务器");
+    wifi_power_note_rx_latency(stats->rtt_us);
 }
+#endif
+#endif
 
-// ICE候选回调函数
-static void on_ice_candidate_received(const char *candidate, void *user_data)
+#if CONFIG_WEBRTC_AUDIO_SEND
+// 编码后的音频帧交给esp_peer，连接建立前丢弃
+static esp_err_t on_audio_encoded(const uint8_t *data, size_t size, uint32_t pts, void *ctx)
 {
-    ESP_LOGI(TAG, "🧊 收到ICE候选: %s", candidate);
-    ESP_LOGI(TAG, "请将此ICE候选发送给您的信令服务器");
+    return webrtc_client_send_audio(data, size, pts);
+}
+#endif
+
+#if CONFIG_WEBRTC_AUDIO_MIXER
+// 混音后的PCM（单声道），这里可以接I2S扬声器或转发
+static void on_mixed_audio(const int16_t *pcm, size_t samples, uint32_t sample_rate, void *ctx)
+{
+}
+#endif
+
+#if CONFIG_WEBRTC_VIDEO_SEND
+static esp_err_t on_video_access_unit(const uint8_t *data, size_t size, uint32_t pts, void *ctx)
+{
+    return webrtc_client_send_video(data, size, pts);
+}
+#endif
+
+/**
+ * @brief 心跳任务：周期打印STUN连接和WebRTC状态
+ */
+static void heartbeat_task(void *arg)
+{
+    int loop_count = 0;
+    while (1) {
+        loop_count++;
+        ESP_LOGI(TAG, "💓 主程序运行中... (循环 %d)", loop_count);
+        
+        // 检查STUN连接状态
+        if (webrtc_client_is_stun_connected()) {
+            ESP_LOGI(TAG, "✅ STUN服务器连接状态: 已连接");
+            ESP_LOGI(TAG, "🌐 公网IP地址: %s", webrtc_client_get_public_ip());
+        } else {
+            ESP_LOGI(TAG, "❌ STUN服务器连接状态: 未连接");
+            
+            // 每5次循环测试一次STUN连通性
+            if (loop_count % 5 == 0) {
+                ESP_LOGI(TAG, "🔍 开始测试STUN服务器连通性...");
+                webrtc_client_test_stun_connectivity();
+            }
+        }
+        
+        // 检查WebRTC状态
+        webrtc_client_state_t state = webrtc_client_get_state();
+        ESP_LOGI(TAG, "📊 WebRTC状态: %d", state);
+
+#if CONFIG_WEBRTC_MEDIA_DATA_CHANNEL
+        // 经遥测通道发送心跳，缓冲区满时丢弃旧的心跳
+        if (webrtc_data_channel_is_open(g_telemetry_channel)) {
+            char telemetry[64];
+            int len = snprintf(telemetry, sizeof(telemetry), "{\"type\":\"heartbeat\",\"loop\":%d,\"state\":%d}",
+                               loop_count, state);
+            webrtc_data_channel_send(g_telemetry_channel, telemetry, len, true);
+        }
+#endif
+        
+        vTaskDelay(pdMS_TO_TICKS(30000)); // 每30秒打印一次心跳
+    }
 }
 
-extern "C" void app_main(void)
+static webrtc_client_config_t g_client_config;
+static bool g_prepared = false;
+
+esp_err_t webrtc_app_prepare(void)
 {
+    if (g_prepared) {
+        return ESP_OK;
+    }
     ESP_LOGI(TAG, "🚀 ESP32 WebRTC客户端启动...");
     
-    // 配置WebRTC客户端
+    // 配置WebRTC客户端（Wi-Fi由app_network统一连接）
     webrtc_client_config_t config = {
-        .wifi_ssid = "HOSHOO",           // 请修改为您的WiFi SSID
-        .wifi_password = "yc8449fyc",        // 请修改为您的WiFi密码
         .stun_server = "stun.freeswitch.org",    // 使用项目的STUN服务器
         .stun_port = 3478,                    // STUN服务器端口
-        .enable_audio = true,                  // 启用音频
-        .enable_video = false,                 // 暂时禁用视频（简化实现）
-        .enable_data_channel = true            // 启用数据通道
+        .enable_audio = WEBRTC_CLIENT_HAS_AUDIO,   // 启用音频（编译期关闭时为false）
+        .enable_video = WEBRTC_CLIENT_HAS_VIDEO,   // 启用视频（编译期关闭时为false）
+        .enable_data_channel = WEBRTC_CLIENT_HAS_DATA_CHANNEL  // 启用数据通道
     };
     
     ESP_LOGI(TAG, "配置信息:");
-    ESP_LOGI(TAG, "  WiFi SSID: %s", config.wifi_ssid);
     ESP_LOGI(TAG, "  STUN服务器: %s:%d", config.stun_server, config.stun_port);
     ESP_LOGI(TAG, "  音频: %s", config.enable_audio ? "启用" : "禁用");
     ESP_LOGI(TAG, "  视频: %s", config.enable_video ? "启用" : "禁用");
     ESP_LOGI(TAG, "  数据通道: %s", config.enable_data_channel ? "启用" : "禁用");
+    g_client_config = config;
     
     // 初始化WebRTC客户端
     esp_err_t ret = webrtc_client_init(&config);
     if (ret != ESP_OK) {
         ESP_LOGE(TAG, "❌ WebRTC客户端初始化失败: %s", esp_err_to_name(ret));
-        return;
+        return ret;
     }
     ESP_LOGI(TAG, "✅ WebRTC客户端初始化成功");
     
     // 设置基本回调函数
     ret = webrtc_client_set_callbacks(
         on_webrtc_state_change,    // 状态变化回调
-        on_audio_data,             // 音频数据回调
-        on_video_data,             // 视频数据回调
-        on_data_channel_data,      // 数据通道回调
+        // 未编译的媒体传NULL，对应回调随之从固件中移除
+        WEBRTC_CLIENT_HAS_AUDIO ? on_audio_data : NULL,                // 音频数据回调
+        WEBRTC_CLIENT_HAS_VIDEO ? on_video_data : NULL,                // 视频数据回调
+        WEBRTC_CLIENT_HAS_DATA_CHANNEL ? on_data_channel_data : NULL,  // 数据通道回调
         NULL                       // 用户数据
     );
     
     if (ret != ESP_OK) {
         ESP_LOGE(TAG, "❌ 设置基本回调函数失败: %s", esp_err_to_name(ret));
-        return;
+        return ret;
     }
     ESP_LOGI(TAG, "✅ 基本回调函数设置成功");
+
+#if CONFIG_WEBRTC_MEDIA_DATA_CHANNEL
+    // 注册数据通道，SCTP连接后按此创建
+    webrtc_data_channel_config_t control_channel = {
+        .label = "control", .reliable = true, .framed = true, .priority = 0, .buffer_size = 0, .low_water_mark = 0,
+    };
+    webrtc_data_channel_config_t telemetry_channel = {
+        .label = "telemetry", .reliable = false, .framed = false, .priority = 1, .buffer_size = 2048, .low_water_mark = 0,
+    };
+    g_control_channel = webrtc_data_channel_create(&control_channel, on_data_channel_low_water, NULL);
+    g_telemetry_channel = webrtc_data_channel_create(&telemetry_channel, NULL, NULL);
+    webrtc_data_channel_set_message_callback(g_control_channel, on_control_message, NULL);
+#endif
+
+#if CONFIG_WEBRTC_LATENCY_PROBE
+    // 时延探测通道，结果可经latency_probe_config_t.stats_cb实时获取
+    latency_probe_config_t probe_config = LATENCY_PROBE_DEFAULT_CONFIG();
+#if CONFIG_APP_WIFI_POWER_SAVE
+    probe_config.stats_cb = on_latency_sample;
+#endif
+    if (latency_probe_init(&probe_config) == ESP_OK) {
+        mqtt_client_set_status_handler(on_status_request, NULL);
+    }
+#endif
+
+    // 数据通道注册完成后即可打开Peer：DTLS密钥和证书在联网期间于后台生成
+    ret = webrtc_client_prepare();
+    if (ret != ESP_OK) {
+        ESP_LOGW(TAG, "⚠️ 预打开Peer失败，启动时再打开: %s", esp_err_to_name(ret));
+    }
+    g_prepared = true;
+    return ESP_OK;
+}
+
+esp_err_t webrtc_app_start(void)
+{
+    esp_err_t ret = webrtc_app_prepare();
+    if (ret != ESP_OK) {
+        return ret;
+    }
     
-    // 设置SDP和ICE候选回调函数
-    ret = webrtc_client_set_sdp_callbacks(
-        on_sdp_offer_created,      // SDP Offer创建回调
-        on_ice_candidate_received, // ICE候选接收回调
-        NULL                       // 用户数据
-    );
-    
+    // 设置MQTT信令：Offer/ICE候选经MQTT发布，Answer/远程候选从结果主题接收
+    webrtc_signaling_config_t signaling_config = WEBRTC_SIGNALING_DEFAULT_CONFIG();
+    ret = webrtc_signaling_init(&signaling_config);
     if (ret != ESP_OK) {
-        ESP_LOGE(TAG, "❌ 设置SDP回调函数失败: %s", esp_err_to_name(ret));
-        return;
+        ESP_LOGE(TAG, "❌ MQTT信令初始化失败: %s", esp_err_to_name(ret));
+        return ret;
     }
-    ESP_LOGI(TAG, "✅ SDP回调函数设置成功");
+    ESP_LOGI(TAG, "✅ MQTT信令初始化成功");
     
     // 启动WebRTC客户端
     ret = webrtc_client_start();
     if (ret != ESP_OK) {
         ESP_LOGE(TAG, "❌ WebRTC客户端启动失败: %s", esp_err_to_name(ret));
-        return;
+        return ret;
     }
     ESP_LOGI(TAG, "✅ WebRTC客户端启动成功");
+
+#if CONFIG_WEBRTC_AUDIO_SEND
+    // 音频发送管线：I2S麦克风→ Opus 48kHz单声道 → esp_peer
+    if (g_client_config.enable_audio) {
+        audio_sender_config_t audio_config = AUDIO_SENDER_DEFAULT_CONFIG();
+        audio_config.sink = on_audio_encoded;
+        ret = audio_sender_start(&audio_config);
+        if (ret != ESP_OK) {
+            ESP_LOGE(TAG, "❌ 音频发送启动失败: %s", esp_err_to_name(ret));
+        }
+    }
+#endif
+
+#if CONFIG_WEBRTC_AUDIO_MIXER
+    // 接收混音：各路远端Opus解码后饱和混音，按需降采样到16kHz
+    if (g_client_config.enable_audio) {
+        audio_mixer_config_t mixer_config = AUDIO_MIXER_DEFAULT_CONFIG();
+        mixer_config.sink = on_mixed_audio;
+        ret = audio_mixer_start(&mixer_config);
+        if (ret != ESP_OK) {
+            ESP_LOGE(TAG, "❌ 音频混音启动失败: %s", esp_err_to_name(ret));
+        }
+    }
+#endif
+
+#if CONFIG_WEBRTC_VIDEO_SEND
+    // 视频发送：H.264访问单元按节拍交给esp_peer，缓存最近的关键帧供新订阅者快速出图
+    if (g_client_config.enable_video) {
+        video_sender_config_t video_config = VIDEO_SENDER_DEFAULT_CONFIG();
+        video_config.sink = on_video_access_unit;
+        ret = video_sender_start(&video_config);
+        if (ret != ESP_OK) {
+            ESP_LOGE(TAG, "❌ 视频发送启动失败: %s", esp_err_to_name(ret));
+        }
+    }
+#endif
     
     ESP_LOGI(TAG, "🎉 WebRTC客户端已启动，准备与STUN服务器交互...");
     ESP_LOGI(TAG, "📋 使用说明:");
     ESP_LOGI(TAG, "1. 确保WiFi配置正确");
     ESP_LOGI(TAG, "2. 观察串口日志了解连接状态");
     ESP_LOGI(TAG, "3. ESP32将自动尝试与STUN服务器建立连接");
-    ESP_LOGI(TAG, "4. 当SDP Offer创建后，请将其发送给您的信令服务器");
-    ESP_LOGI(TAG, "5. 通过您的信令服务器接收Answer SDP和ICE候选");
+    ESP_LOGI(TAG, "4. SDP Offer和ICE候选自动通过MQTT发布到信令服务器");
+    ESP_LOGI(TAG, "5. Answer SDP和远程ICE候选从结果主题自动接收");
     
-    // 等待WiFi连接完成
-    vTaskDelay(pdMS_TO_TICKS(5000));
+    // 网络在webrtc_client_start中已就绪，无需再等待；MQTT子系统已启动时复用同一连接。
+    // 信令经发件箱发送，MQTT连上之前生成的Offer/候选会在连接后发出
+    mqtt_client_start();
     
     // 立即测试STUN服务器连通性
     ESP_LOGI(TAG, "🔍 立即测试STUN服务器连通性...");
@@ -191,30 +380,9 @@ extern "C" void app_main(void)
         ESP_LOGI(TAG, "✅ Offer创建成功");
     }
     
-    // 主循环 - 保持程序运行
-    int loop_count = 0;
-    while (1) {
-        loop_count++;
-        ESP_LOGI(TAG, "💓 主程序运行中... (循环 %d)", loop_count);
-        
-        // 检查STUN连接状态
-        if (webrtc_client_is_stun_connected()) {
-            ESP_LOGI(TAG, "✅ STUN服务器连接状态: 已连接");
-            ESP_LOGI(TAG, "🌐 公网IP地址: %s", webrtc_client_get_public_ip());
-        } else {
-            ESP_LOGI(TAG, "❌ STUN服务器连接状态: 未连接");
-            
-            // 每5次循环测试一次STUN连通性
-            if (loop_count % 5 == 0) {
-                ESP_LOGI(TAG, "🔍 开始测试STUN服务器连通性...");
-                webrtc_client_test_stun_connectivity();
-            }
-        }
-        
-        // 检查WebRTC状态
-        webrtc_client_state_t state = webrtc_client_get_state();
-        ESP_LOGI(TAG, "📊 WebRTC状态: %d", state);
-        
-        vTaskDelay(pdMS_TO_TICKS(30000)); // 每30秒打印一次心跳
-    }
+    // 心跳改由独立任务执行，app_main返回后释放主任务栈
+    task_topology_create(APP_TASK_HEARTBEAT, heartbeat_task, NULL, NULL);
+    task_topology_start_load_report();
+    heap_monitor_start();
+    return ESP_OK;
 }
@@ -0,0 +1,27 @@
+#pragma once
+
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief WebRTC子系统第一阶段：初始化客户端、注册回调和数据通道，并在后台预打开Peer
+ *
+ * 在app_network_init之后、app_network_start之前调用，DTLS密钥和证书的生成与联网并行。
+ * 不需要网络；webrtc_app_start未调用过本函数时会自动调用。
+ */
+esp_err_t webrtc_app_prepare(void);
+
+/**
+ * @brief WebRTC子系统第二阶段：初始化MQTT信令，启动客户端和媒体管线并发起Offer
+ *
+ * 网络由app_network_start统一连接（未连接时在此等待），MQTT连接与MQTT子系统共用。
+ * 由main中的app_main调用。
+ */
+esp_err_t webrtc_app_start(void);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,374 @@
+#include "latency_probe.hpp"
+
+#include <string.h>
+#include <inttypes.h>
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "webrtc_data_channel.hpp"
+
+/*
+ * 时延探测
+ *
+ * ping在webrtc_client主任务中发出（esp_peer_main_loop之后、数据通道flush之前），
+ * pong在同一任务的数据回调中处理，t1/t4与实际收发之间只差一次主循环内的处理时间。
+ * 时钟偏移取窗口内往返时延最小的样本（排队最少、两个方向最对称）。
+ */
+
+static const char *TAG = "latency_probe";
+
+#define PROBE_WINDOW 8
+#define PROBE_TIMEOUT_US 2000000            // 超过该时间未回复的ping计为丢失
+#define PROBE_EWMA_SHIFT 3                  // 滑动平均权重1/8
+#define PROBE_MAX_MEDIA_DELAY_US 10000000   // 超出即认为pts不连续，丢弃该样本
+
+static latency_probe_config_t g_config;
+static int g_channel = -1;
+
+// 以下仅Peer任务访问
+static bool g_was_open = false;
+static uint16_t g_seq = 0;
+static int64_t g_next_ping_us = 0;
+static bool g_in_flight = false;            // 最近一个ping尚未回复且未超时
+static uint16_t g_in_flight_seq = 0;
+static int64_t g_in_flight_us = 0;
+static uint32_t g_window_rtt[PROBE_WINDOW];
+static int64_t g_window_offset[PROBE_WINDOW];
+static int g_window_count = 0;
+static int g_window_next = 0;
+static bool g_remote_media_valid = false;   // 对端音频pts与对端时钟的对应关系
+static uint32_t g_remote_media_ms = 0;
+static int64_t g_remote_media_us = 0;
+static uint32_t g_audio_frames = 0;
+static int64_t g_last_report_us = 0;
+
+// 本端音频pts与时钟的对应关系，由发送任务写入
+static portMUX_TYPE g_local_lock = portMUX_INITIALIZER_UNLOCKED;
+static bool g_local_media_valid = false;
+static uint32_t g_local_media_ms = 0;
+static int64_t g_local_media_us = 0;
+
+static portMUX_TYPE g_stats_lock = portMUX_INITIALIZER_UNLOCKED;
+static latency_probe_stats_t g_stats;
+
+static void put_be16(uint8_t *p, uint16_t v)
+{
+    p[0] = v >> 8;
+    p[1] = v;
+}
+
+static void put_be32(uint8_t *p, uint32_t v)
+{
+    put_be16(p, v >> 16);
+    put_be16(p + 2, v);
+}
+
+static void put_be64(uint8_t *p, uint64_t v)
+{
+    put_be32(p, v >> 32);
+    put_be32(p + 4, v);
+}
+
+static uint16_t get_be16(const uint8_t *p)
+{
+    return (uint16_t)(p[0] << 8 | p[1]);
+}
+
+static uint32_t get_be32(const uint8_t *p)
+{
+    return (uint32_t)get_be16(p) << 16 | get_be16(p + 2);
+}
+
+static int64_t get_be64(const uint8_t *p)
+{
+    return (int64_t)((uint64_t)get_be32(p) << 32 | get_be32(p + 4));
+}
+
+// 本端此刻的音频pts（按最近一次发送外推）
+static uint32_t local_media_ms(int64_t now)
+{
+    uint32_t media_ms = LATENCY_PROBE_MEDIA_UNKNOWN;
+    portENTER_CRITICAL(&g_local_lock);
+    if (g_local_media_valid) {
+        media_ms = g_local_media_ms + (uint32_t)((now - g_local_media_us) / 1000);
+    }
+    portEXIT_CRITICAL(&g_local_lock);
+    return media_ms;
+}
+
+static void send_message(uint8_t type, uint16_t seq, int64_t t1, int64_t t2, int64_t t3, uint32_t media_ms)
+{
+    uint8_t msg[LATENCY_PROBE_MSG_SIZE];
+    msg[0] = type;
+    msg[1] = 0;
+    put_be16(msg + 2, seq);
+    put_be64(msg + 4, (uint64_t)t1);
+    put_be64(msg + 12, (uint64_t)t2);
+    put_be64(msg + 20, (uint64_t)t3);
+    put_be32(msg + 28, media_ms);
+    if (webrtc_data_channel_send(g_channel, msg, sizeof(msg), false) < 0) {
+        ESP_LOGD(TAG, "探测消息发送失败");
+    }
+}
+
+static void update_remote_media(uint32_t media_ms, int64_t remote_us)
+{
+    if (media_ms == LATENCY_PROBE_MEDIA_UNKNOWN) {
+        return;
+    }
+    g_remote_media_valid = true;
+    g_remote_media_ms = media_ms;
+    g_remote_media_us = remote_us;
+}
+
+// 新会话：对端可能已不是同一个，丢弃窗口和对应关系
+static void reset_session(void)
+{
+    g_in_flight = false;
+    g_window_count = 0;
+    g_window_next = 0;
+    g_remote_media_valid = false;
+    g_audio_frames = 0;
+    g_next_ping_us = 0;
+    portENTER_CRITICAL(&g_stats_lock);
+    g_stats.rtt_us = 0;
+    g_stats.rtt_min_us = 0;
+    g_stats.rtt_avg_us = 0;
+    g_stats.clock_offset_us = 0;
+    g_stats.offset_error_us = 0;
+    g_stats.media_delay_valid = false;
+    g_stats.media_delay_us = 0;
+    g_stats.media_delay_avg_us = 0;
+    portEXIT_CRITICAL(&g_stats_lock);
+}
+
+static void handle_pong(const uint8_t *msg, int64_t t4)
+{
+    uint16_t seq = get_be16(msg + 2);
+    int64_t t1 = get_be64(msg + 4);
+    int64_t t2 = get_be64(msg + 12);
+    int64_t t3 = get_be64(msg + 20);
+    // 只接受本会话最近一个ping的回复，且回显的t1必须是发出时的时间戳；
+    // 超时后迟到、重复或上一个会话的pong会给窗口带来错误的往返时延和偏移
+    if (!g_in_flight || seq != g_in_flight_seq || t1 != g_in_flight_us) {
+        portENTER_CRITICAL(&g_stats_lock);
+        g_stats.stale_pongs++;
+        portEXIT_CRITICAL(&g_stats_lock);
+        return;
+    }
+    g_in_flight = false;
+
+    int64_t rtt = (t4 - t1) - (t3 - t2);
+    if (rtt < 0) {
+        rtt = 0;
+    }
+    int64_t offset = ((t2 - t1) + (t3 - t4)) / 2;
+    g_window_rtt[g_window_next] = (uint32_t)rtt;
+    g_window_offset[g_window_next] = offset;
+    g_window_next = (g_window_next + 1) % PROBE_WINDOW;
+    if (g_window_count < PROBE_WINDOW) {
+        g_window_count++;
+    }
+    int best = 0;
+    for (int i = 1; i < g_window_count; i++) {
+        if (g_window_rtt[i] < g_window_rtt[best]) {
+            best = i;
+        }
+    }
+    update_remote_media(get_be32(msg + 28), t3);
+
+    latency_probe_stats_t stats;
+    portENTER_CRITICAL(&g_stats_lock);
+    g_stats.samples++;
+    g_stats.rtt_us = (uint32_t)rtt;
+    g_stats.rtt_min_us = g_window_rtt[best];
+    g_stats.rtt_avg_us = g_stats.samples == 1 ? (uint32_t)rtt
+                       : g_stats.rtt_avg_us - (g_stats.rtt_avg_us >> PROBE_EWMA_SHIFT) + ((uint32_t)rtt >> PROBE_EWMA_SHIFT);
+    g_stats.clock_offset_us = g_window_offset[best];
+    g_stats.offset_error_us = g_window_rtt[best] / 2;
+    stats = g_stats;
+    portEXIT_CRITICAL(&g_stats_lock);
+
+    if (g_config.stats_cb) {
+        g_config.stats_cb(&stats, g_config.user_data);
+    }
+}
+
+static void on_probe_message(int channel, const uint8_t *data, size_t size, bool text, void *user_data)
+{
+    int64_t now = esp_timer_get_time();
+    if (text || size != LATENCY_PROBE_MSG_SIZE) {
+        return;
+    }
+    if (data[0] == LATENCY_PROBE_PING) {
+        // 对端发起的探测：立即回复，并记下对端的音频pts
+        update_remote_media(get_be32(data + 28), get_be64(data + 4));
+        int64_t t3 = esp_timer_get_time();
+        send_message(LATENCY_PROBE_PONG, get_be16(data + 2), get_be64(data + 4), now, t3, local_media_ms(t3));
+        portENTER_CRITICAL(&g_stats_lock);
+        g_stats.pongs_sent++;
+        portEXIT_CRITICAL(&g_stats_lock);
+    } else if (data[0] == LATENCY_PROBE_PONG) {
+        handle_pong(data, now);
+    }
+}
+
+esp_err_t latency_probe_init(const latency_probe_config_t *config)
+{
+    if (!config) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (g_channel >= 0) {
+        return ESP_OK;
+    }
+    g_config = *config;
+    if (g_config.media_sample_frames == 0) {
+        g_config.media_sample_frames = 1;
+    }
+    memset(&g_stats, 0, sizeof(g_stats));
+
+    // 不可靠、最高优先级：迟到的探测没有意义，也不应排在其他消息之后
+    webrtc_data_channel_config_t channel = {
+        .label = "probe", .reliable = false, .framed = false, .priority = 0, .buffer_size = 256, .low_water_mark = 0,
+    };
+    g_channel = webrtc_data_channel_create(&channel, NULL, NULL);
+    if (g_channel < 0) {
+        ESP_LOGE(TAG, "注册探测通道失败");
+        return ESP_FAIL;
+    }
+    webrtc_data_channel_set_message_callback(g_channel, on_probe_message, NULL);
+    ESP_LOGI(TAG, "时延探测已启用，间隔%" PRIu32 "ms，每%" PRIu32 "个音频帧计算一次单向时延",
+             g_config.interval_ms, g_config.media_sample_frames);
+    return ESP_OK;
+}
+
+void latency_probe_poll(void)
+{
+    if (g_channel < 0) {
+        return;
+    }
+    bool open = webrtc_data_channel_is_open(g_channel);
+    if (open != g_was_open) {
+        g_was_open = open;
+        if (open) {
+            reset_session();
+        }
+    }
+    if (!open) {
+        return;
+    }
+
+    int64_t now = esp_timer_get_time();
+    if (g_in_flight && now - g_in_flight_us > PROBE_TIMEOUT_US) {
+        g_in_flight = false;
+    }
+#if CONFIG_WEBRTC_LATENCY_PROBE_REPORT_S > 0
+    if (now - g_last_report_us >= (int64_t)CONFIG_WEBRTC_LATENCY_PROBE_REPORT_S * 1000000) {
+        g_last_report_us = now;
+        latency_probe_report();
+    }
+#endif
+    if (g_config.interval_ms == 0 || now < g_next_ping_us) {
+        return;
+    }
+    g_next_ping_us = now + (int64_t)g_config.interval_ms * 1000;
+
+    g_seq++;
+    g_in_flight = true;
+    g_in_flight_seq = g_seq;
+    g_in_flight_us = now;
+    send_message(LATENCY_PROBE_PING, g_seq, now, 0, 0, local_media_ms(now));
+    portENTER_CRITICAL(&g_stats_lock);
+    g_stats.pings_sent++;
+    portEXIT_CRITICAL(&g_stats_lock);
+}
+
+void latency_probe_on_audio_received(uint32_t pts)
+{
+    if (g_channel < 0 || ++g_audio_frames % g_config.media_sample_frames != 0) {
+        return;
+    }
+    if (!g_remote_media_valid || g_window_count == 0) {
+        return;
+    }
+    int64_t now = esp_timer_get_time();
+    portENTER_CRITICAL(&g_stats_lock);
+    int64_t offset = g_stats.clock_offset_us;
+    portEXIT_CRITICAL(&g_stats_lock);
+
+    // pts在对端时钟上的发送时间，换算到本端时钟
+    int64_t remote_send_us = g_remote_media_us + (int64_t)(int32_t)(pts - g_remote_media_ms) * 1000;
+    int64_t delay = now - (remote_send_us - offset);
+    if (delay < -PROBE_MAX_MEDIA_DELAY_US || delay > PROBE_MAX_MEDIA_DELAY_US) {
+        return;
+    }
+
+    portENTER_CRITICAL(&g_stats_lock);
+    g_stats.media_delay_us = (int32_t)delay;
+    g_stats.media_delay_avg_us = g_stats.media_delay_valid
+        ? g_stats.media_delay_avg_us + (((int32_t)delay - g_stats.media_delay_avg_us) >> PROBE_EWMA_SHIFT)
+        : (int32_t)delay;
+    g_stats.media_delay_valid = true;
+    portEXIT_CRITICAL(&g_stats_lock);
+}
+
+void latency_probe_on_audio_sent(uint32_t pts)
+{
+    int64_t now = esp_timer_get_time();
+    portENTER_CRITICAL(&g_local_lock);
+    g_local_media_valid = true;
+    g_local_media_ms = pts;
+    g_local_media_us = now;
+    portEXIT_CRITICAL(&g_local_lock);
+}
+
+void latency_probe_get_stats(latency_probe_stats_t *stats)
+{
+    if (!stats) {
+        return;
+    }
+    portENTER_CRITICAL(&g_stats_lock);
+    *stats = g_stats;
+    uint32_t answered = g_stats.samples + (g_in_flight ? 1 : 0);
+    stats->lost = g_stats.pings_sent > answered ? g_stats.pings_sent - answered : 0;
+    portEXIT_CRITICAL(&g_stats_lock);
+}
+
+void latency_probe_add_json(cJSON *json)
+{
+    if (!json || g_channel < 0) {
+        return;
+    }
+    latency_probe_stats_t stats;
+    latency_probe_get_stats(&stats);
+    cJSON *latency = cJSON_AddObjectToObject(json, "latency");
+    cJSON_AddNumberToObject(latency, "samples", stats.samples);
+    cJSON_AddNumberToObject(latency, "lost", stats.lost);
+    cJSON_AddNumberToObject(latency, "stalePongs", stats.stale_pongs);
+    cJSON_AddNumberToObject(latency, "rttUs", stats.rtt_us);
+    cJSON_AddNumberToObject(latency, "rttMinUs", stats.rtt_min_us);
+    cJSON_AddNumberToObject(latency, "rttAvgUs", stats.rtt_avg_us);
+    cJSON_AddNumberToObject(latency, "clockOffsetUs", (double)stats.clock_offset_us);
+    cJSON_AddNumberToObject(latency, "offsetErrorUs", stats.offset_error_us);
+    if (stats.media_delay_valid) {
+        cJSON_AddNumberToObject(latency, "mediaDelayUs", stats.media_delay_us);
+        cJSON_AddNumberToObject(latency, "mediaDelayAvgUs", stats.media_delay_avg_us);
+    }
+}
+
+void latency_probe_report(void)
+{
+    latency_probe_stats_t stats;
+    latency_probe_get_stats(&stats);
+    if (stats.samples == 0) {
+        return;
+    }
+    ESP_LOGI(TAG, "[Performance][latency_rtt_us]: %" PRIu32 " (最小%" PRIu32 "，平均%" PRIu32 "，样本%" PRIu32 "，丢失%" PRIu32 "，过期pong%" PRIu32 ")",
+             stats.rtt_us, stats.rtt_min_us, stats.rtt_avg_us, stats.samples, stats.lost, stats.stale_pongs);
+    ESP_LOGI(TAG, "[Performance][latency_clock_offset_us]: %" PRId64 " (±%" PRIu32 ")",
+             stats.clock_offset_us, stats.offset_error_us);
+    if (stats.media_delay_valid) {
+        ESP_LOGI(TAG, "[Performance][latency_media_delay_us]: %" PRId32 " (平均%" PRId32 ")",
+                 stats.media_delay_us, stats.media_delay_avg_us);
+    }
+}
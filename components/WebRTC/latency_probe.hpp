@@ -0,0 +1,93 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include "esp_err.h"
+#include "cJSON.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * 时延探测（CONFIG_WEBRTC_LATENCY_PROBE）
+ *
+ * 在专用的不可靠数据通道"probe"上交换带时间戳的ping/pong，按NTP方式估计往返时延和
+ * 两端时钟偏移；再用对端报告的音频pts与其时钟的对应关系，把收到的音频帧pts换算成
+ * 对端发送时间，得到对端到本端的单向媒体时延。
+ *
+ * 消息格式（大端，32字节），两端都可发起ping，收到ping立即回复pong：
+ *   [0]      类型 1 ping / 2 pong
+ *   [1]      保留，填0
+ *   [2-3]    序号，pong原样带回
+ *   [4-11]   t1 发起方发出ping的时间（微秒，发起方时钟）
+ *   [12-19]  t2 应答方收到ping的时间（微秒，应答方时钟），ping中为0
+ *   [20-27]  t3 应答方发出pong的时间，ping中为0
+ *   [28-31]  media_ms 发出本消息一方此刻的音频pts（毫秒，与esp_peer帧pts同一基准），
+ *            0xFFFFFFFF表示未知
+ *
+ * 往返时延 = (t4 - t1) - (t3 - t2)，时钟偏移（对端减本端）= ((t2 - t1) + (t3 - t4)) / 2，
+ * 取最近若干样本中往返时延最小的一个，误差不超过其往返时延的一半。
+ */
+
+#define LATENCY_PROBE_MSG_SIZE  32
+#define LATENCY_PROBE_PING      1
+#define LATENCY_PROBE_PONG      2
+#define LATENCY_PROBE_MEDIA_UNKNOWN 0xFFFFFFFFu
+
+typedef struct {
+    uint32_t pings_sent;
+    uint32_t samples;                       // 收到的有效pong
+    uint32_t lost;                          // 超时未回复的ping
+    uint32_t pongs_sent;                    // 回复对端的pong
+    uint32_t stale_pongs;                   // 不是最近一个ping的回复（迟到、重复或上一个会话）而丢弃的pong
+    uint32_t rtt_us;                        // 最近一次往返时延
+    uint32_t rtt_min_us;                    // 窗口内最小
+    uint32_t rtt_avg_us;                    // 滑动平均
+    int64_t clock_offset_us;                // 对端时钟减本端时钟
+    uint32_t offset_error_us;               // 偏移误差上界
+    bool media_delay_valid;                 // 对端报告过音频pts且已收到音频
+    int32_t media_delay_us;                 // 对端到本端的音频单向时延（最近一次）
+    int32_t media_delay_avg_us;             // 滑动平均
+} latency_probe_stats_t;
+
+// 每得到一个往返样本后在Peer任务中调用
+typedef void (*latency_probe_stats_cb_t)(const latency_probe_stats_t *stats, void *user_data);
+
+typedef struct {
+    uint32_t interval_ms;                   // ping间隔，0只应答对端的ping
+    uint32_t media_sample_frames;           // 每N个收到的音频帧计算一次单向时延
+    latency_probe_stats_cb_t stats_cb;
+    void *user_data;
+} latency_probe_config_t;
+
+#define LATENCY_PROBE_DEFAULT_CONFIG() {                                \
+    .interval_ms = CONFIG_WEBRTC_LATENCY_PROBE_INTERVAL_MS,             \
+    .media_sample_frames = CONFIG_WEBRTC_LATENCY_PROBE_MEDIA_SAMPLE,    \
+    .stats_cb = NULL,                                                   \
+    .user_data = NULL,                                                  \
+}
+
+/**
+ * @brief 注册"probe"数据通道，需在webrtc_client_prepare之前（与其他数据通道一起）调用
+ */
+esp_err_t latency_probe_init(const latency_probe_config_t *config);
+
+void latency_probe_get_stats(latency_probe_stats_t *stats);
+
+// 把统计加入设备状态消息（"latency"对象）
+void latency_probe_add_json(cJSON *json);
+
+// 打印往返时延、时钟偏移和单向时延
+void latency_probe_report(void);
+
+// 以下由webrtc_client在Peer任务中调用
+void latency_probe_poll(void);
+void latency_probe_on_audio_received(uint32_t pts);
+// 在发送音频的任务中调用，记录本端pts与时钟的对应关系
+void latency_probe_on_audio_sent(uint32_t pts);
+
+#ifdef __cplusplus
+}
+#endif
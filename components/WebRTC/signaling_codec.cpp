@@ -0,0 +1,562 @@
+#include "signaling_codec.hpp"
+
+#include <string.h>
+#include <stdlib.h>
+
+#if CONFIG_WEBRTC_SIGNALING_CODEC_BENCHMARK
+#include <inttypes.h>
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "cJSON.h"
+#endif
+
+#define ESCAPE_BYTE 0x7F
+#define DICT_BASE   0x80
+
+// SDP/ICE高频片段字典，顺序即编码，只能在末尾追加（必须与tools/signaling_codec.py一致）
+static const char *const s_dict[] = {
+    "\r\n",
+    "a=candidate:",
+    "a=rtpmap:",
+    "a=fmtp:",
+    "a=rtcp-fb:",
+    "a=extmap:",
+    "a=ssrc:",
+    "a=mid:",
+    "a=ice-ufrag:",
+    "a=ice-pwd:",
+    "a=ice-options:trickle",
+    "a=fingerprint:sha-256 ",
+    "a=setup:actpass",
+    "a=setup:active",
+    "a=setup:passive",
+    "a=sendrecv",
+    "a=sendonly",
+    "a=recvonly",
+    "a=inactive",
+    "a=rtcp-mux",
+    "a=rtcp-rsize",
+    "a=group:BUNDLE ",
+    "a=msid-semantic: WMS",
+    "a=msid:",
+    "a=sctp-port:5000",
+    "a=max-message-size:262144",
+    "a=max-message-size:",
+    "a=end-of-candidates",
+    "a=rtcp:9 IN IP4 0.0.0.0",
+    "a=ssrc-group:FID ",
+    "a=sctpmap:5000 webrtc-datachannel 1024",
+    "m=audio 9 UDP/TLS/RTP/SAVPF ",
+    "m=video 9 UDP/TLS/RTP/SAVPF ",
+    "m=application 9 UDP/DTLS/SCTP webrtc-datachannel",
+    "m=application 9 DTLS/SCTP 5000",
+    "c=IN IP4 0.0.0.0",
+    "c=IN IP4 ",
+    "v=0",
+    "o=- ",
+    " IN IP4 127.0.0.1",
+    "s=-",
+    "t=0 0",
+    "candidate:",
+    " typ host",
+    " typ srflx",
+    " typ prflx",
+    " typ relay",
+    " raddr ",
+    " rport ",
+    " generation 0",
+    " network-id ",
+    " network-cost ",
+    " ufrag ",
+    " UDP ",
+    " udp ",
+    " TCP ",
+    " tcp ",
+    " tcptype active",
+    " tcptype passive",
+    "opus/48000/2",
+    "H264/90000",
+    "VP8/90000",
+    "VP9/90000",
+    "rtx/90000",
+    "red/90000",
+    "ulpfec/90000",
+    "PCMU/8000",
+    "PCMA/8000",
+    "G722/8000",
+    "telephone-event/8000",
+    "telephone-event/48000",
+    "minptime=10;useinbandfec=1",
+    "level-asymmetry-allowed=1;packetization-mode=1;profile-level-id=",
+    "packetization-mode=1",
+    "profile-level-id=42e01f",
+    "goog-remb",
+    "transport-cc",
+    "ccm fir",
+    "nack pli",
+    "nack",
+    "apt=",
+    "urn:ietf:params:rtp-hdrext:",
+    "sdes:mid",
+    "sdes:rtp-stream-id",
+    "sdes:repaired-rtp-stream-id",
+    "ssrc-audio-level",
+    "toffset",
+    "http://www.webrtc.org/experiments/rtp-hdrext/",
+    "abs-send-time",
+    "http://www.ietf.org/id/draft-holmer-rmcat-transport-wide-cc-extensions-01",
+    " cname:",
+    " msid:",
+    " mslabel:",
+    " label:",
+    "webrtc-datachannel",
+    "UDP/TLS/RTP/SAVPF",
+    "0.0.0.0",
+    "127.0.0.1",
+    "192.168.",
+    "10.0.",
+    "172.16.",
+    " 1 UDP ",
+    " 2 UDP ",
+    " 1 udp ",
+    " 2 udp ",
+    "2122260223",
+    "2122252543",
+    "1686052607",
+    "1686052863",
+    "41885439",
+    "a=",
+    "b=AS:",
+    "stun:",
+    "turn:",
+    ".local",
+    "sdpMid",
+    "sdpMLineIndex",
+};
+
+#define DICT_SIZE ((int)(sizeof(s_dict) / sizeof(s_dict[0])))
+static_assert(sizeof(s_dict) / sizeof(s_dict[0]) <= 128, "sdpz1 dictionary holds at most 128 entries");
+
+// 按首字节索引的候选字典项（按长度降序），首次编码时构建
+#define MAX_PER_BYTE 40
+static uint8_t s_index[128][MAX_PER_BYTE];
+static uint8_t s_index_count[128];
+static uint8_t s_dict_len[128];
+
+static bool build_index(void)
+{
+    memset(s_index_count, 0, sizeof(s_index_count));
+    for (int i = 0; i < DICT_SIZE; i++) {
+        s_dict_len[i] = (uint8_t)strlen(s_dict[i]);
+        uint8_t first = (uint8_t)s_dict[i][0];
+        if (first >= 128 || s_index_count[first] >= MAX_PER_BYTE) {
+            continue;
+        }
+        // 插入排序，保证最长匹配优先
+        int pos = s_index_count[first]++;
+        while (pos > 0 && s_dict_len[s_index[first][pos - 1]] < s_dict_len[i]) {
+            s_index[first][pos] = s_index[first][pos - 1];
+            pos--;
+        }
+        s_index[first][pos] = (uint8_t)i;
+    }
+    return true;
+}
+
+// 函数内静态变量的初始化是线程安全的，多个任务并发首次编码也只构建一次
+static void ensure_index(void)
+{
+    static const bool ready = build_index();
+    (void)ready;
+}
+
+// 贪心最长匹配编码
+int signaling_codec_encode_text(const char *text, size_t len, uint8_t *out, size_t cap)
+{
+    if (!text || !out) {
+        return -1;
+    }
+    ensure_index();
+
+    size_t in_pos = 0;
+    size_t out_pos = 0;
+    while (in_pos < len) {
+        uint8_t c = (uint8_t)text[in_pos];
+        int match = -1;
+        if (c < 128) {
+            for (int k = 0; k < s_index_count[c]; k++) {
+                int idx = s_index[c][k];
+                if (s_dict_len[idx] <= len - in_pos && memcmp(text + in_pos, s_dict[idx], s_dict_len[idx]) == 0) {
+                    match = idx;
+                    break;
+                }
+            }
+        }
+
+        if (match >= 0) {
+            if (out_pos + 1 > cap) {
+                return -1;
+            }
+            out[out_pos++] = (uint8_t)(DICT_BASE + match);
+            in_pos += s_dict_len[match];
+        } else if (c < ESCAPE_BYTE) {
+            if (out_pos + 1 > cap) {
+                return -1;
+            }
+            out[out_pos++] = c;
+            in_pos++;
+        } else {
+            if (out_pos + 2 > cap) {
+                return -1;
+            }
+            out[out_pos++] = ESCAPE_BYTE;
+            out[out_pos++] = c;
+            in_pos++;
+        }
+    }
+    return (int)out_pos;
+}
+
+// 计算解码后的长度（不含结尾'\0'）
+int signaling_codec_decoded_length(const uint8_t *in, size_t len)
+{
+    if (!in) {
+        return -1;
+    }
+    ensure_index();
+
+    int total = 0;
+    for (size_t i = 0; i < len; i++) {
+        uint8_t b = in[i];
+        if (b >= DICT_BASE) {
+            if (b - DICT_BASE >= DICT_SIZE) {
+                return -1;
+            }
+            total += s_dict_len[b - DICT_BASE];
+        } else if (b == ESCAPE_BYTE) {
+            if (++i >= len) {
+                return -1;
+            }
+            total++;
+        } else {
+            total++;
+        }
+    }
+    return total;
+}
+
+// 解码文本，输出以'\0'结尾
+int signaling_codec_decode_text(const uint8_t *in, size_t len, char *out, size_t cap)
+{
+    if (!in || !out || cap == 0) {
+        return -1;
+    }
+    ensure_index();
+
+    size_t out_pos = 0;
+    for (size_t i = 0; i < len; i++) {
+        uint8_t b = in[i];
+        if (b >= DICT_BASE) {
+            int idx = b - DICT_BASE;
+            if (idx >= DICT_SIZE || out_pos + s_dict_len[idx] >= cap) {
+                return -1;
+            }
+            memcpy(out + out_pos, s_dict[idx], s_dict_len[idx]);
+            out_pos += s_dict_len[idx];
+        } else {
+            if (b == ESCAPE_BYTE && ++i >= len) {
+                return -1;
+            }
+            if (out_pos + 1 >= cap) {
+                return -1;
+            }
+            out[out_pos++] = (char)in[i];
+        }
+    }
+    out[out_pos] = '\0';
+    return (int)out_pos;
+}
+
+bool signaling_codec_is_compact(const void *data, size_t len)
+{
+    return data && len >= 2 && ((const uint8_t *)data)[0] == SIGNALING_CODEC_MAGIC;
+}
+
+static void write_bytes(signaling_frame_writer_t *w, const void *data, size_t len)
+{
+    if (w->overflow || w->len + len > w->cap) {
+        w->overflow = true;
+        return;
+    }
+    memcpy(w->buf + w->len, data, len);
+    w->len += len;
+}
+
+static void write_varint(signaling_frame_writer_t *w, uint32_t value)
+{
+    uint8_t tmp[5];
+    size_t n = 0;
+    do {
+        uint8_t b = value & 0x7F;
+        value >>= 7;
+        tmp[n++] = value ? (b | 0x80) : b;
+    } while (value);
+    write_bytes(w, tmp, n);
+}
+
+static int read_varint(signaling_frame_reader_t *r, uint32_t *value)
+{
+    uint32_t result = 0;
+    for (int shift = 0; shift < 35; shift += 7) {
+        if (r->pos >= r->len) {
+            return -1;
+        }
+        uint8_t b = r->buf[r->pos++];
+        result |= (uint32_t)(b & 0x7F) << shift;
+        if (!(b & 0x80)) {
+            *value = result;
+            return 0;
+        }
+    }
+    return -1;
+}
+
+void signaling_frame_begin(signaling_frame_writer_t *w, uint8_t *buf, size_t cap,
+                           signaling_msg_type_t type, const char *device_id)
+{
+    w->buf = buf;
+    w->cap = cap;
+    w->len = 0;
+    w->overflow = false;
+
+    uint8_t header[2] = { SIGNALING_CODEC_MAGIC, (uint8_t)((SIGNALING_CODEC_VERSION << 4) | (type & 0x0F)) };
+    write_bytes(w, header, sizeof(header));
+    size_t id_len = device_id ? strlen(device_id) : 0;
+    write_varint(w, id_len);
+    write_bytes(w, device_id, id_len);
+}
+
+// 写入一个文本项：先编码到缓冲区尾部，再补写长度前缀
+void signaling_frame_add_text(signaling_frame_writer_t *w, const char *text)
+{
+    if (w->overflow) {
+        return;
+    }
+    // 长度前缀最多5字节，预留后直接编码到目标位置，避免临时缓冲区
+    const size_t reserve = 5;
+    if (w->len + reserve > w->cap) {
+        w->overflow = true;
+        return;
+    }
+    int enc_len = signaling_codec_encode_text(text, strlen(text), w->buf + w->len + reserve, w->cap - w->len - reserve);
+    if (enc_len < 0) {
+        w->overflow = true;
+        return;
+    }
+
+    uint8_t prefix[5];
+    size_t n = 0;
+    uint32_t value = enc_len;
+    do {
+        uint8_t b = value & 0x7F;
+        value >>= 7;
+        prefix[n++] = value ? (b | 0x80) : b;
+    } while (value);
+    memmove(w->buf + w->len + n, w->buf + w->len + reserve, enc_len);
+    memcpy(w->buf + w->len, prefix, n);
+    w->len += n + enc_len;
+}
+
+int signaling_frame_open(signaling_frame_reader_t *r, const void *data, size_t len,
+                         signaling_msg_type_t *type, char *device_id, size_t device_id_cap)
+{
+    r->buf = (const uint8_t *)data;
+    r->len = len;
+    r->pos = 0;
+    if (!signaling_codec_is_compact(data, len) || (r->buf[1] >> 4) != SIGNALING_CODEC_VERSION) {
+        return -1;
+    }
+    if (type) {
+        *type = (signaling_msg_type_t)(r->buf[1] & 0x0F);
+    }
+    r->pos = 2;
+
+    uint32_t id_len = 0;
+    if (read_varint(r, &id_len) != 0 || r->pos + id_len > r->len) {
+        return -1;
+    }
+    if (device_id && device_id_cap > 0) {
+        size_t copy = id_len < device_id_cap - 1 ? id_len : device_id_cap - 1;
+        memcpy(device_id, r->buf + r->pos, copy);
+        device_id[copy] = '\0';
+    }
+    r->pos += id_len;
+    return 0;
+}
+
+int signaling_frame_next_text_length(const signaling_frame_reader_t *r)
+{
+    signaling_frame_reader_t peek = *r;
+    uint32_t enc_len = 0;
+    if (read_varint(&peek, &enc_len) != 0 || peek.pos + enc_len > peek.len) {
+        return -1;
+    }
+    return signaling_codec_decoded_length(peek.buf + peek.pos, enc_len);
+}
+
+// 读取下一个文本项，没有更多项时返回-1
+int signaling_frame_next_text(signaling_frame_reader_t *r, char *out, size_t cap)
+{
+    uint32_t enc_len = 0;
+    if (r->pos >= r->len || read_varint(r, &enc_len) != 0 || r->pos + enc_len > r->len) {
+        return -1;
+    }
+    int ret = signaling_codec_decode_text(r->buf + r->pos, enc_len, out, cap);
+    r->pos += enc_len;
+    return ret;
+}
+
+#if CONFIG_WEBRTC_SIGNALING_CODEC_BENCHMARK
+static const char *BENCH_TAG = "Signaling_Codec";
+
+// 典型浏览器风格的音频+数据通道Offer
+static const char *s_bench_sdp =
+    "v=0\r\n"
+    "o=- 4611731400430051336 2 IN IP4 127.0.0.1\r\n"
+    "s=-\r\n"
+    "t=0 0\r\n"
+    "a=group:BUNDLE 0 1\r\n"
+    "a=msid-semantic: WMS\r\n"
+    "m=audio 9 UDP/TLS/RTP/SAVPF 111 63 9 0 8 13 110 126\r\n"
+    "c=IN IP4 0.0.0.0\r\n"
+    "a=rtcp:9 IN IP4 0.0.0.0\r\n"
+    "a=ice-ufrag:8hhY\r\n"
+    "a=ice-pwd:asd88fgpdd777uzjYhagZg+tU5\r\n"
+    "a=ice-options:trickle\r\n"
+    "a=fingerprint:sha-256 D2:FA:0E:C3:22:59:5E:14:95:69:92:3D:13:B4:84:24:2C:C2:A2:C0:3E:FD:34:8E:5E:EA:6F:AF:52:CE:E6:0F\r\n"
+    "a=setup:actpass\r\n"
+    "a=mid:0\r\n"
+    "a=extmap:1 urn:ietf:params:rtp-hdrext:ssrc-audio-level\r\n"
+    "a=extmap:2 http://www.webrtc.org/experiments/rtp-hdrext/abs-send-time\r\n"
+    "a=extmap:3 http://www.ietf.org/id/draft-holmer-rmcat-transport-wide-cc-extensions-01\r\n"
+    "a=extmap:4 urn:ietf:params:rtp-hdrext:sdes:mid\r\n"
+    "a=sendrecv\r\n"
+    "a=msid:- 750f6cfc-bd3b-4a03-9e4d-7e2e8a0e0e8a\r\n"
+    "a=rtcp-mux\r\n"
+    "a=rtcp-rsize\r\n"
+    "a=rtpmap:111 opus/48000/2\r\n"
+    "a=rtcp-fb:111 transport-cc\r\n"
+    "a=fmtp:111 minptime=10;useinbandfec=1\r\n"
+    "a=rtpmap:63 red/48000/2\r\n"
+    "a=fmtp:63 111/111\r\n"
+    "a=rtpmap:9 G722/8000\r\n"
+    "a=rtpmap:0 PCMU/8000\r\n"
+    "a=rtpmap:8 PCMA/8000\r\n"
+    "a=rtpmap:13 CN/8000\r\n"
+    "a=rtpmap:110 telephone-event/48000\r\n"
+    "a=rtpmap:126 telephone-event/8000\r\n"
+    "a=ssrc:2719937484 cname:9zX2a8mH1Ubk6xQF\r\n"
+    "a=ssrc:2719937484 msid:- 750f6cfc-bd3b-4a03-9e4d-7e2e8a0e0e8a\r\n"
+    "m=application 9 UDP/DTLS/SCTP webrtc-datachannel\r\n"
+    "c=IN IP4 0.0.0.0\r\n"
+    "a=ice-ufrag:8hhY\r\n"
+    "a=ice-pwd:asd88fgpdd777uzjYhagZg+tU5\r\n"
+    "a=ice-options:trickle\r\n"
+    "a=fingerprint:sha-256 D2:FA:0E:C3:22:59:5E:14:95:69:92:3D:13:B4:84:24:2C:C2:A2:C0:3E:FD:34:8E:5E:EA:6F:AF:52:CE:E6:0F\r\n"
+    "a=setup:actpass\r\n"
+    "a=mid:1\r\n"
+    "a=sctp-port:5000\r\n"
+    "a=max-message-size:262144\r\n";
+
+static const char *s_bench_candidates[] = {
+    "candidate:1 1 UDP 2122252543 192.168.1.100 50000 typ host",
+    "candidate:2 1 UDP 1686052607 203.0.113.7 50000 typ srflx raddr 192.168.1.100 rport 50000",
+    "candidate:3 1 UDP 41885439 198.51.100.20 3478 typ relay raddr 203.0.113.7 rport 50000",
+};
+
+void signaling_codec_run_benchmark(void)
+{
+    const int iterations = 50;
+    const size_t sdp_len = strlen(s_bench_sdp);
+    uint8_t *frame = (uint8_t *)malloc(sdp_len + 64);
+    char *decoded = (char *)malloc(sdp_len + 1);
+    if (!frame || !decoded) {
+        free(frame);
+        free(decoded);
+        return;
+    }
+
+    // JSON路径：构造 + 序列化 + 解析
+    int json_len = 0;
+    int64_t start = esp_timer_get_time();
+    for (int i = 0; i < iterations; i++) {
+        cJSON *json = cJSON_CreateObject();
+        cJSON_AddStringToObject(json, "type", "offer");
+        cJSON_AddStringToObject(json, "deviceId", "ESP32_000000000000");
+        cJSON_AddStringToObject(json, "sdp", s_bench_sdp);
+        char *text = cJSON_PrintUnformatted(json);
+        json_len = text ? strlen(text) : 0;
+        cJSON_Delete(json);
+        cJSON_free(text);
+    }
+    int64_t json_encode_us = (esp_timer_get_time() - start) / iterations;
+
+    cJSON *sample = cJSON_CreateObject();
+    cJSON_AddStringToObject(sample, "sdp", s_bench_sdp);
+    char *sample_text = cJSON_PrintUnformatted(sample);
+    cJSON_Delete(sample);
+    start = esp_timer_get_time();
+    for (int i = 0; i < iterations && sample_text; i++) {
+        cJSON *parsed = cJSON_Parse(sample_text);
+        cJSON_Delete(parsed);
+    }
+    int64_t json_decode_us = (esp_timer_get_time() - start) / iterations;
+    cJSON_free(sample_text);
+
+    // 紧凑路径：编码 + 解码
+    signaling_frame_writer_t w;
+    start = esp_timer_get_time();
+    for (int i = 0; i < iterations; i++) {
+        signaling_frame_begin(&w, frame, sdp_len + 64, SIGNALING_MSG_OFFER, "ESP32_000000000000");
+        signaling_frame_add_text(&w, s_bench_sdp);
+    }
+    int64_t compact_encode_us = (esp_timer_get_time() - start) / iterations;
+
+    start = esp_timer_get_time();
+    for (int i = 0; i < iterations; i++) {
+        signaling_frame_reader_t r;
+        signaling_frame_open(&r, frame, w.len, NULL, NULL, 0);
+        signaling_frame_next_text(&r, decoded, sdp_len + 1);
+    }
+    int64_t compact_decode_us = (esp_timer_get_time() - start) / iterations;
+    bool roundtrip_ok = !w.overflow && strcmp(decoded, s_bench_sdp) == 0;
+
+    // 候选消息大小
+    signaling_frame_begin(&w, frame, sdp_len + 64, SIGNALING_MSG_CANDIDATES, "ESP32_000000000000");
+    size_t candidates_text = 0;
+    for (size_t i = 0; i < sizeof(s_bench_candidates) / sizeof(s_bench_candidates[0]); i++) {
+        signaling_frame_add_text(&w, s_bench_candidates[i]);
+        candidates_text += strlen(s_bench_candidates[i]);
+    }
+    size_t candidates_compact = w.len;
+
+    ESP_LOGI(BENCH_TAG, "[Performance][signaling_offer_json_bytes]: %d", json_len);
+    signaling_frame_begin(&w, frame, sdp_len + 64, SIGNALING_MSG_OFFER, "ESP32_000000000000");
+    signaling_frame_add_text(&w, s_bench_sdp);
+    ESP_LOGI(BENCH_TAG, "[Performance][signaling_offer_compact_bytes]: %u", (unsigned)w.len);
+    ESP_LOGI(BENCH_TAG, "[Performance][signaling_candidates_text_bytes]: %u", (unsigned)candidates_text);
+    ESP_LOGI(BENCH_TAG, "[Performance][signaling_candidates_compact_bytes]: %u", (unsigned)candidates_compact);
+    ESP_LOGI(BENCH_TAG, "[Performance][signaling_json_encode_us]: %" PRId64, json_encode_us);
+    ESP_LOGI(BENCH_TAG, "[Performance][signaling_json_decode_us]: %" PRId64, json_decode_us);
+    ESP_LOGI(BENCH_TAG, "[Performance][signaling_compact_encode_us]: %" PRId64, compact_encode_us);
+    ESP_LOGI(BENCH_TAG, "[Performance][signaling_compact_decode_us]: %" PRId64, compact_decode_us);
+    ESP_LOGI(BENCH_TAG, "紧凑编码往返校验: %s", roundtrip_ok ? "通过" : "失败");
+
+    free(frame);
+    free(decoded);
+}
+#else
+void signaling_codec_run_benchmark(void)
+{
+}
+#endif /* CONFIG_WEBRTC_SIGNALING_CODEC_BENCHMARK */
@@ -0,0 +1,80 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * 紧凑信令编码（sdpz1）
+ *
+ * 帧格式：
+ *   [0]    魔数 0xB5（JSON消息总以'{'开头，据此区分两种格式）
+ *   [1]    高4位版本号(1)，低4位消息类型
+ *   varint 设备ID长度 + 设备ID原文
+ *   之后为若干文本项：varint 编码后长度 + 编码后文本
+ *   offer/answer 只有一个文本项（SDP），candidates 每个候选一项
+ *
+ * 文本编码：0x00~0x7E 为原文字节，0x7F 转义下一个原文字节，
+ * 0x80~0xFF 引用静态字典中的第(b-0x80)项。字典与 tools/signaling_codec.py 保持一致。
+ */
+
+#define SIGNALING_CODEC_MAGIC       0xB5
+#define SIGNALING_CODEC_VERSION     1
+#define SIGNALING_CODEC_NAME        "sdpz1"
+
+// 信令编码格式
+typedef enum {
+    SIGNALING_CODEC_JSON = 0,               // JSON文本（默认）
+    SIGNALING_CODEC_COMPACT,                // 紧凑二进制编码
+} signaling_codec_t;
+
+// 紧凑帧消息类型
+typedef enum {
+    SIGNALING_MSG_OFFER = 1,
+    SIGNALING_MSG_ANSWER = 2,
+    SIGNALING_MSG_CANDIDATES = 3,
+} signaling_msg_type_t;
+
+// 帧写入器
+typedef struct {
+    uint8_t *buf;
+    size_t cap;
+    size_t len;
+    bool overflow;                          // 缓冲区不足时置位
+} signaling_frame_writer_t;
+
+// 帧读取器
+typedef struct {
+    const uint8_t *buf;
+    size_t len;
+    size_t pos;
+} signaling_frame_reader_t;
+
+// 文本编解码，返回输出字节数，失败返回-1
+int signaling_codec_encode_text(const char *text, size_t len, uint8_t *out, size_t cap);
+int signaling_codec_decoded_length(const uint8_t *in, size_t len);
+int signaling_codec_decode_text(const uint8_t *in, size_t len, char *out, size_t cap);
+
+bool signaling_codec_is_compact(const void *data, size_t len);
+
+// 构造紧凑帧
+void signaling_frame_begin(signaling_frame_writer_t *w, uint8_t *buf, size_t cap,
+                           signaling_msg_type_t type, const char *device_id);
+void signaling_frame_add_text(signaling_frame_writer_t *w, const char *text);
+
+// 解析紧凑帧：先读帧头，再逐项读取文本（next_text_length给出解码所需缓冲区大小，不含结尾'\0'）
+int signaling_frame_open(signaling_frame_reader_t *r, const void *data, size_t len,
+                         signaling_msg_type_t *type, char *device_id, size_t device_id_cap);
+int signaling_frame_next_text_length(const signaling_frame_reader_t *r);
+int signaling_frame_next_text(signaling_frame_reader_t *r, char *out, size_t cap);
+
+// 编码大小和耗时基准测试，结果以[Performance]日志输出
+void signaling_codec_run_benchmark(void);
+
+#ifdef __cplusplus
+}
+#endif
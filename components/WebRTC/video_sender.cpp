@@ -0,0 +1,496 @@
+#include "video_sender.hpp"
+
+#include <string.h>
+#include <inttypes.h>
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/event_groups.h"
+#include "task_topology.hpp"
+#include "heap_monitor.hpp"
+
+/*
+ * 视频发送任务
+ *
+ * 1. 非实时信号源按pts对齐到本地时钟读取，避免一次性读出多帧突发发送
+ * 2. 每个IDR访问单元连同当时的SPS/PPS拼成一份缓存，新订阅者或PLI到来时
+ *    立即发送缓存，不必等下一个GOP
+ * 3. 发送节拍：上一帧按pacing_kbps发完所需的时间内不发下一帧，大关键帧之后
+ *    的P帧顺延，平滑链路上的瞬时速率
+ *
+ * RTP分包由esp_peer在esp_peer_send_video()内完成，这里的节拍以访问单元为粒度。
+ */
+
+static const char *TAG = "video_sender";
+
+#define VIDEO_SENDER_EXITED BIT0
+#define VIDEO_RATE_BUCKET_US 100000         // 峰值速率统计窗口
+#define VIDEO_SPS_MAX 256
+#define VIDEO_PPS_MAX 128
+
+static video_sender_config_t g_config;
+static TaskHandle_t g_task = NULL;
+static EventGroupHandle_t g_exit_bits = NULL;
+static volatile bool g_running = false;
+
+// 其他任务发来的请求，由发送任务处理
+static portMUX_TYPE g_request_lock = portMUX_INITIALIZER_UNLOCKED;
+static bool g_keyframe_requested = false;
+static bool g_connected_pending = false;
+static int64_t g_connected_us = 0;
+
+// 关键帧缓存，仅发送任务访问
+static uint8_t g_sps[VIDEO_SPS_MAX];
+static size_t g_sps_len = 0;
+static uint8_t g_pps[VIDEO_PPS_MAX];
+static size_t g_pps_len = 0;
+static uint8_t *g_cache = NULL;
+static size_t g_cache_len = 0;
+
+// 发送状态，仅发送任务访问
+static bool g_need_keyframe = true;
+static bool g_ttff_pending = false;
+static int64_t g_ttff_start_us = 0;
+static uint32_t g_last_pts = 0;
+static bool g_sent_any = false;
+static int64_t g_pacer_free_us = 0;
+
+static portMUX_TYPE g_stats_lock = portMUX_INITIALIZER_UNLOCKED;
+static video_sender_stats_t g_stats;
+static int64_t g_window_start_us = 0;
+static uint64_t g_window_bytes = 0;
+static uint64_t g_window_pacer_us = 0;
+static uint32_t g_window_pacer_count = 0;
+static int64_t g_bucket_start_us = 0;
+static uint32_t g_bucket_bytes = 0;
+static uint32_t g_peak_bucket_bytes = 0;
+
+/* ---------------- 关键帧缓存 ---------------- */
+
+static bool cache_append(size_t *len, const uint8_t *data, size_t size)
+{
+    if (*len + size > CONFIG_WEBRTC_VIDEO_MAX_FRAME) {
+        return false;
+    }
+    memcpy(g_cache + *len, data, size);
+    *len += size;
+    return true;
+}
+
+/**
+ * @brief 记录参数集；IDR访问单元与当前SPS/PPS拼成可独立解码的缓存
+ */
+static void cache_update(const uint8_t *data, size_t size, bool keyframe)
+{
+    size_t offset = 0;
+    h264_nal_t nal;
+    while (h264_next_nal(data, size, &offset, &nal)) {
+        if (nal.type == H264_NAL_SPS && nal.size <= VIDEO_SPS_MAX) {
+            memcpy(g_sps, nal.data, nal.size);
+            g_sps_len = nal.size;
+        } else if (nal.type == H264_NAL_PPS && nal.size <= VIDEO_PPS_MAX) {
+            memcpy(g_pps, nal.data, nal.size);
+            g_pps_len = nal.size;
+        }
+    }
+    if (!keyframe || !g_cache) {
+        return;
+    }
+
+    // 没有参数集的IDR无法独立解码，不缓存
+    size_t len = 0;
+    bool ok = g_sps_len > 0 && g_pps_len > 0 &&
+              cache_append(&len, g_sps, g_sps_len) && cache_append(&len, g_pps, g_pps_len);
+    offset = 0;
+    while (ok && h264_next_nal(data, size, &offset, &nal)) {
+        if (nal.type != H264_NAL_AUD && nal.type != H264_NAL_SPS && nal.type != H264_NAL_PPS) {
+            ok = cache_append(&len, nal.data, nal.size);
+        }
+    }
+    if (!ok && g_sps_len > 0 && g_pps_len > 0) {
+        portENTER_CRITICAL(&g_stats_lock);
+        g_stats.cache_oversize++;
+        portEXIT_CRITICAL(&g_stats_lock);
+    }
+    g_cache_len = ok ? len : 0;
+}
+
+/* ---------------- 发送 ---------------- */
+
+static void record_rate(int64_t now, size_t bytes)
+{
+    if (now - g_bucket_start_us >= VIDEO_RATE_BUCKET_US) {
+        g_bucket_start_us = now;
+        g_bucket_bytes = 0;
+    }
+    g_bucket_bytes += bytes;
+    if (g_bucket_bytes > g_peak_bucket_bytes) {
+        g_peak_bucket_bytes = g_bucket_bytes;
+    }
+    g_window_bytes += bytes;
+}
+
+static void send_frame(const uint8_t *data, size_t size, uint32_t pts, bool keyframe, bool cached)
+{
+    // 解码端还没有关键帧时P帧无法解码，直接丢弃
+    if (g_need_keyframe && !keyframe) {
+        portENTER_CRITICAL(&g_stats_lock);
+        g_stats.frames_waiting_keyframe++;
+        portEXIT_CRITICAL(&g_stats_lock);
+        return;
+    }
+
+    // RTP时间戳必须递增，缓存关键帧插在两帧之间时顺延1ms
+    if (g_sent_any && pts <= g_last_pts) {
+        pts = g_last_pts + 1;
+    }
+    esp_err_t ret = g_config.sink(data, size, pts, g_config.sink_ctx);
+    int64_t now = esp_timer_get_time();
+    g_last_pts = pts;
+    g_sent_any = true;
+
+    uint32_t ttff_ms = 0;
+    portENTER_CRITICAL(&g_stats_lock);
+    if (ret == ESP_OK) {
+        g_stats.frames_sent++;
+        g_stats.bytes_sent += size;
+        record_rate(now, size);
+        if (keyframe) {
+            g_stats.keyframes_sent++;
+            if (cached) {
+                g_stats.cached_keyframes_served++;
+            }
+            if (g_ttff_pending) {
+                ttff_ms = (uint32_t)((now - g_ttff_start_us) / 1000);
+                g_stats.time_to_first_frame_ms = ttff_ms;
+            }
+        }
+    } else if (ret == ESP_ERR_INVALID_STATE) {
+        g_stats.frames_skipped++;
+    } else {
+        g_stats.send_errors++;
+    }
+    portEXIT_CRITICAL(&g_stats_lock);
+
+    if (ret == ESP_OK && keyframe) {
+        // 信号源随后的P帧参考的是缓存IDR之后的帧，解码端没有，继续丢弃到新的IDR
+        g_need_keyframe = cached;
+        if (g_ttff_pending) {
+            g_ttff_pending = false;
+            ESP_LOGI(TAG, "[Performance][video_time_to_first_frame_ms]: %" PRIu32 " (%s)",
+                     ttff_ms, cached ? "缓存关键帧" : "新关键帧");
+        }
+    }
+
+    if (g_config.pacing_kbps > 0) {
+        int64_t base = g_pacer_free_us > now ? g_pacer_free_us : now;
+        g_pacer_free_us = base + (int64_t)size * 8000 / g_config.pacing_kbps;
+    }
+}
+
+/**
+ * @brief 处理连接建立和关键帧请求
+ */
+static void handle_requests(void)
+{
+    portENTER_CRITICAL(&g_request_lock);
+    bool connected = g_connected_pending;
+    bool requested = g_keyframe_requested || connected;
+    int64_t connected_us = g_connected_us;
+    g_connected_pending = false;
+    g_keyframe_requested = false;
+    portEXIT_CRITICAL(&g_request_lock);
+
+    if (connected) {
+        g_need_keyframe = true;
+        g_ttff_pending = true;
+        g_ttff_start_us = connected_us;
+    }
+    if (!requested) {
+        return;
+    }
+    if (g_cache_len > 0) {
+        send_frame(g_cache, g_cache_len, g_last_pts + 1, true, true);
+    }
+    if (g_config.source->request_keyframe) {
+        g_config.source->request_keyframe();
+    }
+}
+
+/**
+ * @brief 等到指定时刻，期间收到请求立即处理
+ */
+static void wait_until(int64_t target_us)
+{
+    while (g_running) {
+        int64_t now = esp_timer_get_time();
+        if (now >= target_us) {
+            return;
+        }
+        TickType_t ticks = pdMS_TO_TICKS((target_us - now + 999) / 1000);
+        if (ticks == 0) {
+            ticks = 1;
+        }
+        if (ulTaskNotifyTake(pdTRUE, ticks) > 0) {
+            handle_requests();
+        }
+    }
+}
+
+static void video_task(void *arg)
+{
+    const video_source_t *source = g_config.source;
+    const int64_t frame_us = 1000000 / g_config.fps;
+    const int64_t report_us = (int64_t)CONFIG_WEBRTC_VIDEO_REPORT_S * 1000000;
+    int64_t start_us = 0;
+    bool started = false;
+    int64_t last_report_us = esp_timer_get_time();
+
+    while (g_running) {
+        handle_requests();
+
+        video_frame_t frame;
+        esp_err_t ret = source->read(&frame);
+        if (ret != ESP_OK) {
+            portENTER_CRITICAL(&g_stats_lock);
+            g_stats.source_errors++;
+            portEXIT_CRITICAL(&g_stats_lock);
+            wait_until(esp_timer_get_time() + frame_us);
+            continue;
+        }
+        portENTER_CRITICAL(&g_stats_lock);
+        g_stats.frames_read++;
+        portEXIT_CRITICAL(&g_stats_lock);
+
+        // 文件等非实时源：第pts毫秒的帧在开始后第pts毫秒发出
+        if (!source->realtime) {
+            if (!started) {
+                start_us = esp_timer_get_time() - (int64_t)frame.pts * 1000;
+                started = true;
+            }
+            wait_until(start_us + (int64_t)frame.pts * 1000);
+        }
+
+        bool keyframe = h264_is_keyframe(frame.data, frame.size);
+        cache_update(frame.data, frame.size, keyframe);
+
+        if (g_config.pacing_kbps > 0 && !(g_need_keyframe && !keyframe)) {
+            int64_t now = esp_timer_get_time();
+            if (g_pacer_free_us > now) {
+                uint32_t delay_us = (uint32_t)(g_pacer_free_us - now);
+                portENTER_CRITICAL(&g_stats_lock);
+                g_window_pacer_us += delay_us;
+                g_window_pacer_count++;
+                if (delay_us > g_stats.pacer_delay_us_max) {
+                    g_stats.pacer_delay_us_max = delay_us;
+                }
+                portEXIT_CRITICAL(&g_stats_lock);
+                wait_until(g_pacer_free_us);
+            }
+        }
+        if (!g_running) {
+            break;
+        }
+        send_frame(frame.data, frame.size, frame.pts, keyframe, false);
+
+        if (report_us > 0 && esp_timer_get_time() - last_report_us >= report_us) {
+            last_report_us = esp_timer_get_time();
+            video_sender_report();
+        }
+    }
+
+    xEventGroupSetBits(g_exit_bits, VIDEO_SENDER_EXITED);
+    vTaskDelete(NULL);
+}
+
+/* ---------------- 对外接口 ---------------- */
+
+// 启动时任务创建完成前和停止后句柄为空
+static void notify_task(void)
+{
+    portENTER_CRITICAL(&g_request_lock);
+    TaskHandle_t task = g_task;
+    portEXIT_CRITICAL(&g_request_lock);
+    if (task) {
+        xTaskNotifyGive(task);
+    }
+}
+
+static void release_resources(void)
+{
+    if (g_config.source) {
+        g_config.source->close();
+    }
+    if (g_cache) {
+        HEAP_FREE(g_cache);
+        g_cache = NULL;
+    }
+    g_cache_len = 0;
+}
+
+esp_err_t video_sender_start(const video_sender_config_t *config)
+{
+    if (!config || !config->sink || config->fps == 0 || config->fps > 120) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (g_running) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    g_config = *config;
+    if (!g_config.source) {
+        g_config.source = &video_source_annexb_file;
+    }
+    if (!g_exit_bits) {
+        g_exit_bits = xEventGroupCreate();
+        if (!g_exit_bits) {
+            return ESP_ERR_NO_MEM;
+        }
+    }
+    g_cache = (uint8_t *)HEAP_MALLOC(HEAP_COMP_MEDIA, CONFIG_WEBRTC_VIDEO_MAX_FRAME);
+    if (!g_cache) {
+        return ESP_ERR_NO_MEM;
+    }
+    g_cache_len = 0;
+    g_sps_len = 0;
+    g_pps_len = 0;
+
+    esp_err_t ret = g_config.source->open(g_config.fps);
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "打开视频源%s失败: %s", g_config.source->name, esp_err_to_name(ret));
+        g_config.source = NULL;
+        release_resources();
+        return ret;
+    }
+
+    g_need_keyframe = true;
+    g_ttff_pending = false;
+    g_sent_any = false;
+    g_last_pts = 0;
+    g_pacer_free_us = 0;
+    portENTER_CRITICAL(&g_stats_lock);
+    memset(&g_stats, 0, sizeof(g_stats));
+    g_window_start_us = esp_timer_get_time();
+    g_window_bytes = 0;
+    g_window_pacer_us = 0;
+    g_window_pacer_count = 0;
+    g_bucket_start_us = g_window_start_us;
+    g_bucket_bytes = 0;
+    g_peak_bucket_bytes = 0;
+    portEXIT_CRITICAL(&g_stats_lock);
+
+    xEventGroupClearBits(g_exit_bits, VIDEO_SENDER_EXITED);
+    g_running = true;
+    TaskHandle_t task = NULL;
+    ret = task_topology_create(APP_TASK_VIDEO, video_task, NULL, &task);
+    portENTER_CRITICAL(&g_request_lock);
+    g_task = task;
+    portEXIT_CRITICAL(&g_request_lock);
+    if (ret != ESP_OK) {
+        g_running = false;
+        release_resources();
+        return ret;
+    }
+
+    ESP_LOGI(TAG, "视频发送已启动: 信号源%s，%" PRIu32 "fps，节拍%" PRIu32 "kbps",
+             g_config.source->name, g_config.fps, g_config.pacing_kbps);
+    return ESP_OK;
+}
+
+esp_err_t video_sender_stop(void)
+{
+    if (!g_running) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    g_running = false;
+    notify_task();
+
+    // 节拍等待会被通知打断，文件读取不阻塞；实时源最多阻塞一帧
+    EventBits_t bits = xEventGroupWaitBits(g_exit_bits, VIDEO_SENDER_EXITED, pdFALSE, pdTRUE, pdMS_TO_TICKS(500));
+    if (!(bits & VIDEO_SENDER_EXITED)) {
+        ESP_LOGE(TAG, "视频任务未按时退出");
+        return ESP_ERR_TIMEOUT;
+    }
+    portENTER_CRITICAL(&g_request_lock);
+    g_task = NULL;
+    portEXIT_CRITICAL(&g_request_lock);
+    release_resources();
+    video_sender_report();
+    ESP_LOGI(TAG, "视频发送已停止");
+    return ESP_OK;
+}
+
+void video_sender_request_keyframe(void)
+{
+    if (!g_running) {
+        return;
+    }
+    portENTER_CRITICAL(&g_request_lock);
+    g_keyframe_requested = true;
+    portEXIT_CRITICAL(&g_request_lock);
+    notify_task();
+}
+
+void video_sender_on_connected(void)
+{
+    if (!g_running) {
+        return;
+    }
+    portENTER_CRITICAL(&g_request_lock);
+    g_connected_pending = true;
+    g_connected_us = esp_timer_get_time();
+    portEXIT_CRITICAL(&g_request_lock);
+    notify_task();
+}
+
+// 调用方需持有g_stats_lock
+static void fill_window(video_sender_stats_t *stats, int64_t now)
+{
+    *stats = g_stats;
+    if (g_window_pacer_count > 0) {
+        stats->pacer_delay_us_avg = (uint32_t)(g_window_pacer_us / g_window_pacer_count);
+    }
+    int64_t elapsed_ms = (now - g_window_start_us) / 1000;
+    if (elapsed_ms > 0) {
+        stats->avg_kbps = (uint32_t)(g_window_bytes * 8 / elapsed_ms);
+    }
+    stats->peak_kbps = g_peak_bucket_bytes * 8 / (VIDEO_RATE_BUCKET_US / 1000);
+}
+
+void video_sender_get_stats(video_sender_stats_t *stats)
+{
+    if (!stats) {
+        return;
+    }
+    int64_t now = esp_timer_get_time();
+    portENTER_CRITICAL(&g_stats_lock);
+    fill_window(stats, now);
+    portEXIT_CRITICAL(&g_stats_lock);
+}
+
+void video_sender_report(void)
+{
+    video_sender_stats_t stats;
+    int64_t now = esp_timer_get_time();
+    portENTER_CRITICAL(&g_stats_lock);
+    fill_window(&stats, now);
+    g_window_start_us = now;
+    g_window_bytes = 0;
+    g_window_pacer_us = 0;
+    g_window_pacer_count = 0;
+    g_peak_bucket_bytes = 0;
+    g_stats.pacer_delay_us_max = 0;
+    portEXIT_CRITICAL(&g_stats_lock);
+
+    // 突发度：100ms窗口峰值速率与区间平均速率之比（x100）
+    uint32_t burst = stats.avg_kbps > 0 ? stats.peak_kbps * 100 / stats.avg_kbps : 0;
+    ESP_LOGI(TAG, "[Performance][video_send_kbps]: 平均%" PRIu32 " 峰值%" PRIu32, stats.avg_kbps, stats.peak_kbps);
+    ESP_LOGI(TAG, "[Performance][video_send_burst_ratio]: %" PRIu32 ".%02" PRIu32, burst / 100, burst % 100);
+    ESP_LOGI(TAG, "[Performance][video_pacer_delay_ms]: 平均%" PRIu32 " 最大%" PRIu32,
+             stats.pacer_delay_us_avg / 1000, stats.pacer_delay_us_max / 1000);
+    ESP_LOGI(TAG, "视频帧: 读取%" PRIu32 " 发送%" PRIu32 " 关键帧%" PRIu32 "(缓存%" PRIu32 ") 等待关键帧丢弃%" PRIu32
+             " 未连接跳过%" PRIu32 " 发送错误%" PRIu32 "，首帧%" PRIu32 "ms",
+             stats.frames_read, stats.frames_sent, stats.keyframes_sent, stats.cached_keyframes_served,
+             stats.frames_waiting_keyframe, stats.frames_skipped, stats.send_errors, stats.time_to_first_frame_ms);
+}
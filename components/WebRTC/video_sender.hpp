@@ -0,0 +1,83 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include "esp_err.h"
+#include "video_source.hpp"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief 访问单元输出，pts为毫秒
+ *
+ * 返回ESP_ERR_INVALID_STATE表示暂不发送（如连接未建立），不计为发送错误
+ */
+typedef esp_err_t (*video_sender_sink_t)(const uint8_t *data, size_t size, uint32_t pts, void *ctx);
+
+typedef struct {
+    const video_source_t *source;           // NULL使用Annex-B文件源
+    uint32_t fps;
+    uint32_t pacing_kbps;                   // 发送节拍速率，0表示不限速
+    video_sender_sink_t sink;
+    void *sink_ctx;
+} video_sender_config_t;
+
+#define VIDEO_SENDER_DEFAULT_CONFIG() {                 \
+    .source = NULL,                                     \
+    .fps = 30,                                          \
+    .pacing_kbps = CONFIG_WEBRTC_VIDEO_PACING_KBPS,     \
+    .sink = NULL,                                       \
+    .sink_ctx = NULL,                                   \
+}
+
+typedef struct {
+    uint32_t frames_read;
+    uint32_t frames_sent;
+    uint32_t keyframes_sent;
+    uint32_t cached_keyframes_served;       // 用缓存关键帧响应的请求数
+    uint32_t frames_waiting_keyframe;       // 解码端尚无关键帧而丢弃的P帧
+    uint32_t frames_skipped;                // sink返回ESP_ERR_INVALID_STATE
+    uint32_t send_errors;
+    uint32_t source_errors;
+    uint32_t cache_oversize;                // 关键帧超过CONFIG_WEBRTC_VIDEO_MAX_FRAME未缓存
+    uint64_t bytes_sent;
+    uint32_t time_to_first_frame_ms;        // 最近一次连接到首个关键帧发出
+    // 以下为自上次video_sender_report()以来的统计
+    uint32_t pacer_delay_us_avg;            // 因节拍推迟发送的时间
+    uint32_t pacer_delay_us_max;
+    uint32_t avg_kbps;
+    uint32_t peak_kbps;                     // 100ms窗口内的最高发送速率
+} video_sender_stats_t;
+
+/**
+ * @brief 启动视频发送任务（APP_TASK_VIDEO）
+ *
+ * 任务按pts节拍读取访问单元，缓存最近的SPS/PPS/IDR，再按pacing_kbps匀速交给sink
+ */
+esp_err_t video_sender_start(const video_sender_config_t *config);
+
+esp_err_t video_sender_stop(void);
+
+/**
+ * @brief 请求关键帧（PLI或新订阅者加入）
+ *
+ * 有缓存时立即发送缓存的SPS+PPS+IDR，同时要求信号源输出新的IDR
+ */
+void video_sender_request_keyframe(void);
+
+/**
+ * @brief 连接建立时调用：开始计算首帧时间，关键帧发出前丢弃P帧
+ */
+void video_sender_on_connected(void);
+
+void video_sender_get_stats(video_sender_stats_t *stats);
+
+// 打印首帧时间、节拍延迟和发送突发度，并开始新的统计区间
+void video_sender_report(void);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,199 @@
+#include "video_source.hpp"
+
+#include <stdio.h>
+#include <string.h>
+#include <inttypes.h>
+#include "esp_log.h"
+#include "heap_monitor.hpp"
+
+static const char *TAG = "video_source";
+
+/* ---------------- Annex-B解析 ---------------- */
+
+// 返回起始码位置（4字节起始码返回其首个0），找不到返回size
+static size_t find_start_code(const uint8_t *data, size_t size, size_t from)
+{
+    for (size_t i = from; i + 3 <= size; i++) {
+        if (data[i + 2] > 1) {
+            i += 2;
+            continue;
+        }
+        if (data[i] == 0 && data[i + 1] == 0 && data[i + 2] == 1) {
+            return (i > from && data[i - 1] == 0) ? i - 1 : i;
+        }
+    }
+    return size;
+}
+
+bool h264_next_nal(const uint8_t *data, size_t size, size_t *offset, h264_nal_t *nal)
+{
+    size_t start = find_start_code(data, size, *offset);
+    if (start >= size) {
+        return false;
+    }
+    size_t header = start + (data[start + 2] == 1 ? 3 : 4);
+    if (header >= size) {
+        return false;
+    }
+    size_t end = find_start_code(data, size, header);
+    nal->data = data + start;
+    nal->size = end - start;
+    nal->payload = data + header;
+    nal->type = data[header] & 0x1F;
+    *offset = end;
+    return true;
+}
+
+bool h264_is_keyframe(const uint8_t *data, size_t size)
+{
+    size_t offset = 0;
+    h264_nal_t nal;
+    while (h264_next_nal(data, size, &offset, &nal)) {
+        if (nal.type == H264_NAL_IDR) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * @brief 查找缓冲区中第一个访问单元的结尾
+ *
+ * 已出现slice后，遇到AUD/SEI/SPS/PPS或first_mb_in_slice为0的slice即为新访问单元
+ * @return 访问单元长度，数据不足以判断时返回0
+ */
+static size_t find_access_unit_end(const uint8_t *data, size_t size, bool eof)
+{
+    size_t offset = 0;
+    h264_nal_t nal;
+    bool have_slice = false;
+    while (h264_next_nal(data, size, &offset, &nal)) {
+        bool slice = nal.type >= H264_NAL_SLICE && nal.type <= H264_NAL_IDR;
+        if (have_slice) {
+            if (nal.type == H264_NAL_AUD || nal.type == H264_NAL_SEI ||
+                nal.type == H264_NAL_SPS || nal.type == H264_NAL_PPS) {
+                return nal.data - data;
+            }
+            if (slice) {
+                size_t first_mb = nal.payload + 1 - data;
+                if (first_mb >= size) {
+                    return 0;
+                }
+                // first_mb_in_slice为ue(v)，值为0时编码为单个'1'比特
+                if (data[first_mb] & 0x80) {
+                    return nal.data - data;
+                }
+            }
+        }
+        have_slice = have_slice || slice;
+    }
+    return (eof && have_slice) ? size : 0;
+}
+
+/* ---------------- Annex-B文件源 ---------------- */
+
+// 缓冲区可容纳两个最大访问单元，保证总能看到下一个访问单元的开头
+#define FILE_BUFFER_SIZE (CONFIG_WEBRTC_VIDEO_MAX_FRAME * 2)
+
+static FILE *g_file = NULL;
+static uint8_t *g_buffer = NULL;
+static size_t g_buffer_len = 0;
+static size_t g_consumed = 0;               // 上一次返回的访问单元长度
+static bool g_eof = false;
+static uint32_t g_frame_index = 0;
+static uint32_t g_fps = 30;
+
+static void file_close(void)
+{
+    if (g_file) {
+        fclose(g_file);
+        g_file = NULL;
+    }
+    if (g_buffer) {
+        HEAP_FREE(g_buffer);
+        g_buffer = NULL;
+    }
+}
+
+static esp_err_t file_open(uint32_t fps)
+{
+    g_file = fopen(CONFIG_WEBRTC_VIDEO_FILE_PATH, "rb");
+    if (!g_file) {
+        ESP_LOGE(TAG, "无法打开H.264文件: %s", CONFIG_WEBRTC_VIDEO_FILE_PATH);
+        return ESP_ERR_NOT_FOUND;
+    }
+    g_buffer = (uint8_t *)HEAP_MALLOC(HEAP_COMP_MEDIA, FILE_BUFFER_SIZE);
+    if (!g_buffer) {
+        file_close();
+        return ESP_ERR_NO_MEM;
+    }
+    g_buffer_len = 0;
+    g_consumed = 0;
+    g_eof = false;
+    g_frame_index = 0;
+    g_fps = fps > 0 ? fps : 30;
+    ESP_LOGI(TAG, "H.264文件: %s，%" PRIu32 "fps", CONFIG_WEBRTC_VIDEO_FILE_PATH, g_fps);
+    return ESP_OK;
+}
+
+static esp_err_t file_read(video_frame_t *frame)
+{
+    if (!g_file) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    // 丢弃上一次返回的访问单元
+    if (g_consumed > 0) {
+        memmove(g_buffer, g_buffer + g_consumed, g_buffer_len - g_consumed);
+        g_buffer_len -= g_consumed;
+        g_consumed = 0;
+    }
+
+    bool rewound = false;
+    while (true) {
+        size_t au_size = find_access_unit_end(g_buffer, g_buffer_len, g_eof);
+        if (au_size > 0) {
+            frame->data = g_buffer;
+            frame->size = au_size;
+            frame->pts = (uint32_t)((uint64_t)g_frame_index * 1000 / g_fps);
+            g_frame_index++;
+            g_consumed = au_size;
+            return ESP_OK;
+        }
+
+        if (g_eof) {
+            // 读到结尾：剩余数据不成帧则丢弃，从头循环
+            if (rewound) {
+                ESP_LOGE(TAG, "文件中没有完整的访问单元");
+                return ESP_ERR_INVALID_SIZE;
+            }
+            g_buffer_len = 0;
+            g_eof = false;
+            rewound = true;
+            if (fseek(g_file, 0, SEEK_SET) != 0) {
+                return ESP_FAIL;
+            }
+            continue;
+        }
+
+        if (g_buffer_len == FILE_BUFFER_SIZE) {
+            // 访问单元超出上限：丢弃缓冲区，从下一个起始码重新同步
+            ESP_LOGW(TAG, "访问单元超过%d字节，丢弃", CONFIG_WEBRTC_VIDEO_MAX_FRAME);
+            g_buffer_len = 0;
+        }
+        size_t got = fread(g_buffer + g_buffer_len, 1, FILE_BUFFER_SIZE - g_buffer_len, g_file);
+        g_buffer_len += got;
+        if (got == 0) {
+            g_eof = true;
+        }
+    }
+}
+
+const video_source_t video_source_annexb_file = {
+    .name = "annexb_file",
+    .realtime = false,
+    .open = file_open,
+    .read = file_read,
+    .request_keyframe = NULL,
+    .close = file_close,
+};
@@ -0,0 +1,65 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// H.264 NAL单元类型
+#define H264_NAL_SLICE 1
+#define H264_NAL_IDR   5
+#define H264_NAL_SEI   6
+#define H264_NAL_SPS   7
+#define H264_NAL_PPS   8
+#define H264_NAL_AUD   9
+
+typedef struct {
+    const uint8_t *data;                    // 含起始码
+    size_t size;
+    const uint8_t *payload;                 // NAL头所在位置
+    uint8_t type;
+} h264_nal_t;
+
+/**
+ * @brief 遍历Annex-B数据中的NAL单元
+ *
+ * @param offset 输入为开始查找的位置，输出为下一个NAL的位置，首次调用置0
+ * @return 找到NAL返回true
+ */
+bool h264_next_nal(const uint8_t *data, size_t size, size_t *offset, h264_nal_t *nal);
+
+// 访问单元是否包含IDR slice
+bool h264_is_keyframe(const uint8_t *data, size_t size);
+
+// 一个编码后的访问单元（Annex-B），数据在下一次read前有效
+typedef struct {
+    const uint8_t *data;
+    size_t size;
+    uint32_t pts;                           // 毫秒
+} video_frame_t;
+
+/**
+ * @brief H.264访问单元信号源
+ *
+ * realtime为true的信号源（摄像头+编码器）在read中阻塞到下一帧；
+ * 否则发送任务按pts节拍读取（如Annex-B文件）。
+ */
+typedef struct {
+    const char *name;
+    bool realtime;
+    esp_err_t (*open)(uint32_t fps);
+    esp_err_t (*read)(video_frame_t *frame);
+    void (*request_keyframe)(void);         // 让编码器尽快输出IDR，可为NULL
+    void (*close)(void);
+} video_source_t;
+
+// Annex-B文件源：CONFIG_WEBRTC_VIDEO_FILE_PATH，按访问单元切分，读到结尾后从头循环
+extern const video_source_t video_source_annexb_file;
+
+#ifdef __cplusplus
+}
+#endif
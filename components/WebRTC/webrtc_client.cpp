@@ -2,11 +2,30 @@
 
 #include <string.h>
 #include <stdlib.h>
+#include <inttypes.h>
+#include "esp_timer.h"
+#include "freertos/event_groups.h"
 #include "lwip/netdb.h"
+#include "task_topology.hpp"
+#include "app_network.hpp"
+#include "event_capture.hpp"
+#include "webrtc_data_channel.hpp"
+#include "webrtc_signaling.hpp"
+#include "wifi_power.hpp"
+#if CONFIG_WEBRTC_LATENCY_PROBE
+#include "latency_probe.hpp"
+#endif
+#if CONFIG_WEBRTC_EGRESS_SCHEDULER
+#include "freertos/semphr.h"
+#include "egress_scheduler.hpp"
+#endif
 
 // 日志标签
 static const char *TAG = "WebRTC_Client";
 
+#define WEBRTC_STR_(x) #x
+#define WEBRTC_STR(x) WEBRTC_STR_(x)
+
 // 全局WebRTC客户端实例
 static webrtc_client_t g_webrtc_client;
 
@@ -22,39 +41,223 @@ static webrtc_data_callback_t g_data_callback = NULL;
 static webrtc_sdp_offer_callback_t g_sdp_offer_callback = NULL;
 static webrtc_ice_candidate_callback_t g_ice_candidate_callback = NULL;
 static void *g_user_data = NULL;
+static void *g_sdp_user_data = NULL;
+static esp_event_handler_instance_t g_wifi_event_instance = NULL;
+static esp_event_handler_instance_t g_ip_event_instance = NULL;
+
+// 预打开Peer（CONFIG_WEBRTC_PEER_PREOPEN）
+#if CONFIG_WEBRTC_PEER_PREOPEN
+#define PEER_PREOPEN 1
+#else
+#define PEER_PREOPEN 0
+#endif
+#define PEER_OPEN_DONE BIT0
+#define PEER_OPEN_TIMEOUT_MS 30000
+static EventGroupHandle_t g_open_bits = NULL;
+static volatile bool g_open_pending = false;
+static int g_open_result = 0;
+static int64_t g_peer_opened_us = 0;      // 当前DTLS身份的生成时间
+static int open_peer(const char *when);
+
+// 主任务协作退出：stop清除is_running后等待主任务在两次esp_peer_main_loop之间自行退出
+#define MAIN_TASK_EXITED BIT0
+#define MAIN_TASK_STOP_TIMEOUT_MS 2000
+static EventGroupHandle_t g_main_bits = NULL;
+
+#if CONFIG_WEBRTC_EGRESS_SCHEDULER
+// 发送调度：音视频只提交，由主任务在esp_peer_main_loop之后统一发出
+static SemaphoreHandle_t g_video_done_sem = NULL;
+// 完成回调的user_data为提交序号，序号和结果在g_video_done_lock下一起写入
+static uint32_t g_video_seq = 0;
+static portMUX_TYPE g_video_done_lock = portMUX_INITIALIZER_UNLOCKED;
+static uint32_t g_video_done_seq = 0;
+static bool g_video_done_sent = false;
+#endif
+
+// 热重启（webrtc_client_restart / CONFIG_WEBRTC_WARM_RESTART）：在主任务中执行
+#define WARM_RESTART_MAX_DELAY_MS 30000
+static portMUX_TYPE g_restart_lock = portMUX_INITIALIZER_UNLOCKED;
+static bool g_restart_requested = false;
+static bool g_restarting = false;          // 热重启自身引起的断开不再触发重启
+static int64_t g_restart_due_us = 0;
+static int64_t g_failed_us = 0;            // 检测到连接失败的时间，重新连接后计算恢复耗时
+static uint32_t g_restart_delay_ms = 0;    // 连续失败时加倍
+static uint32_t g_restart_count = 0;
+static const char *g_restart_reason = NULL;
+static bool g_restart_cancel_on_connect = false;   // 等待期间连接自行恢复则取消
+
+// ICE重启（CONFIG_WEBRTC_ICE_RESTART）：重新获得IP或连通性检查失败时走热重启路径
+#if CONFIG_WEBRTC_ICE_RESTART
+#define ICE_RESTART 1
+#define ICE_RESTART_GRACE_MS CONFIG_WEBRTC_ICE_RESTART_GRACE_MS
+#else
+#define ICE_RESTART 0
+#define ICE_RESTART_GRACE_MS 0
+#endif
+static uint32_t g_ip_addr = 0;             // 最近一次获得的IPv4地址
+static esp_timer_handle_t g_net_test_timer = NULL;
+
+// 媒体中断：从失败前最后一帧媒体到恢复后第一帧的时间，输出为[Performance][media_gap_ms]
+static int64_t g_last_media_us = 0;
+static int64_t g_gap_start_us = 0;
+static bool g_gap_open = false;
+
+// 记录连接失败的时间并开始统计媒体中断（调用者持有g_restart_lock）
+static void mark_failed_locked(int64_t now)
+{
+    if (g_failed_us == 0) {
+        g_failed_us = now;
+    }
+    if (!g_gap_open) {
+        g_gap_open = true;
+        g_gap_start_us = g_last_media_us ? g_last_media_us : now;
+    }
+}
+
+// 记录连接失败（esp_peer自动重连成功时同样统计恢复耗时）
+static void mark_failed(void)
+{
+    int64_t now = esp_timer_get_time();
+    portENTER_CRITICAL(&g_restart_lock);
+    mark_failed_locked(now);
+    portEXIT_CRITICAL(&g_restart_lock);
+}
+
+/**
+ * @brief 安排一次热重启，delay_ms后由主任务执行；已有待执行的请求时保留较早的时间
+ *
+ * cancel_on_connect为true时，等待期间连接自行恢复（如esp_peer自动重连）则不再重启
+ */
+static void schedule_restart(uint32_t delay_ms, const char *reason, bool cancel_on_connect)
+{
+    int64_t now = esp_timer_get_time();
+    portENTER_CRITICAL(&g_restart_lock);
+    int64_t due = now + (int64_t)delay_ms * 1000;
+    if (!g_restart_requested || due < g_restart_due_us) {
+        g_restart_due_us = due;
+        g_restart_reason = reason;
+        g_restart_cancel_on_connect = cancel_on_connect;
+    } else if (!cancel_on_connect) {
+        g_restart_cancel_on_connect = false;
+    }
+    g_restart_requested = true;
+    mark_failed_locked(now);
+    portEXIT_CRITICAL(&g_restart_lock);
+}
 
-// WiFi事件处理函数
+// 收发了一帧媒体：连接恢复后的第一帧结束本次媒体中断
+static void note_media(void)
+{
+    int64_t now = esp_timer_get_time();
+    int64_t gap_us = 0;
+    portENTER_CRITICAL(&g_restart_lock);
+    if (g_gap_open && g_webrtc_client.state == WEBRTC_CLIENT_STATE_CONNECTED) {
+        gap_us = now - g_gap_start_us;
+        g_gap_open = false;
+    }
+    g_last_media_us = now;
+    portEXIT_CRITICAL(&g_restart_lock);
+    if (gap_us) {
+        ESP_LOGI(TAG, "[Performance][media_gap_ms]: %" PRIu32, (uint32_t)(gap_us / 1000));
+    }
+}
+
+// 状态变化后调用：按连接状态占用/释放Wi-Fi省电，再通知应用
+static void notify_state(void)
+{
+#if CONFIG_APP_WIFI_POWER_SAVE
+    switch (g_webrtc_client.state) {
+        case WEBRTC_CLIENT_STATE_CONNECTED:
+            wifi_power_acquire(WIFI_POWER_HOLD_MEDIA);
+            wifi_power_release(WIFI_POWER_HOLD_ICE);
+            break;
+        case WEBRTC_CLIENT_STATE_PEER_CREATED:
+        case WEBRTC_CLIENT_STATE_OFFER_CREATED:
+        case WEBRTC_CLIENT_STATE_ANSWER_RECEIVED:
+        case WEBRTC_CLIENT_STATE_CONNECTING:
+            // 候选收集和连通性检查的STUN应答不能等到下一个信标
+            wifi_power_acquire(WIFI_POWER_HOLD_ICE);
+            wifi_power_release(WIFI_POWER_HOLD_MEDIA);
+            break;
+        case WEBRTC_CLIENT_STATE_DISCONNECTED:
+            // esp_peer仍在做连通性检查，等待恢复或ICE重启
+            if (g_webrtc_client.is_running) {
+                wifi_power_acquire(WIFI_POWER_HOLD_ICE);
+            } else {
+                wifi_power_release(WIFI_POWER_HOLD_ICE);
+            }
+            wifi_power_release(WIFI_POWER_HOLD_MEDIA);
+            break;
+        default:
+            wifi_power_release(WIFI_POWER_HOLD_ICE | WIFI_POWER_HOLD_MEDIA);
+            break;
+    }
+#endif
+    if (g_state_callback) {
+        g_state_callback(g_webrtc_client.state, g_user_data);
+    }
+}
+
+// WiFi事件处理函数：连接和重连由app_network（example_connect）负责，这里跟踪状态并在重新获得IP后重启ICE
 static void wifi_event_handler(void* arg, esp_event_base_t event_base,
                               int32_t event_id, void* event_data)
 {
-    if (event_base == WIFI_EVENT && event_id == WIFI_EVENT_STA_START) {
-        ESP_LOGI(TAG, "WiFi连接开始...");
-        g_webrtc_client.state = WEBRTC_CLIENT_STATE_WIFI_CONNECTING;
-        if (g_state_callback) {
-            g_state_callback(g_webrtc_client.state, g_user_data);
+    if (event_base == WIFI_EVENT && event_id == WIFI_EVENT_STA_DISCONNECTED) {
+        ESP_LOGI(TAG, "WiFi连接断开，等待重连...");
+        if (g_webrtc_client.is_running) {
+            mark_failed();
         }
-        esp_wifi_connect();
-    } else if (event_base == WIFI_EVENT && event_id == WIFI_EVENT_STA_DISCONNECTED) {
-        ESP_LOGI(TAG, "WiFi连接断开，尝试重连...");
         g_webrtc_client.state = WEBRTC_CLIENT_STATE_WIFI_CONNECTING;
-        if (g_state_callback) {
-            g_state_callback(g_webrtc_client.state, g_user_data);
-        }
-        esp_wifi_connect();
+        notify_state();
     } else if (event_base == IP_EVENT && event_id == IP_EVENT_STA_GOT_IP) {
         ip_event_got_ip_t* event = (ip_event_got_ip_t*) event_data;
         ESP_LOGI(TAG, "WiFi已连接，IP地址: " IPSTR, IP2STR(&event->ip_info.ip));
+        bool ip_changed = g_ip_addr != 0 && g_ip_addr != event->ip_info.ip.addr;
+        g_ip_addr = event->ip_info.ip.addr;
         g_webrtc_client.state = WEBRTC_CLIENT_STATE_WIFI_CONNECTED;
-        if (g_state_callback) {
-            g_state_callback(g_webrtc_client.state, g_user_data);
+        notify_state();
+        // 会话进行中重新联网：旧的候选对已不可用（地址变化）或状态未知，重新收集候选并重新发送Offer
+        if (ICE_RESTART && g_webrtc_client.is_running) {
+            schedule_restart(0, ip_changed ? "IP地址变化" : "WiFi重连", false);
         }
     }
 }
 
+#if CONFIG_WEBRTC_ICE_RESTART_TEST_S > 0
+// 模拟一次网络变化，走与重新获得IP相同的路径，用于测量媒体中断
+static void net_test_timer_cb(void *arg)
+{
+    if (g_webrtc_client.is_running && g_webrtc_client.state == WEBRTC_CLIENT_STATE_CONNECTED) {
+        ESP_LOGI(TAG, "模拟网络变化");
+        schedule_restart(0, "模拟网络变化", false);
+    }
+}
+#endif
+
+// 连接建立：输出从失败到恢复的耗时并重置退避
+static void mark_recovered(void)
+{
+    portENTER_CRITICAL(&g_restart_lock);
+    int64_t failed_us = g_failed_us;
+    uint32_t restarts = g_restart_count;
+    g_failed_us = 0;
+    g_restart_count = 0;
+    g_restart_delay_ms = 0;
+    if (g_restart_requested && g_restart_cancel_on_connect) {
+        g_restart_requested = false;
+    }
+    portEXIT_CRITICAL(&g_restart_lock);
+    if (failed_us) {
+        ESP_LOGI(TAG, "[Performance][webrtc_recovery_ms]: %" PRIu32 " (热重启%" PRIu32 "次)",
+                 (uint32_t)((esp_timer_get_time() - failed_us) / 1000), restarts);
+    }
+}
+
 // ESP Peer状态回调函数
 static int peer_state_callback(esp_peer_state_t state, void *ctx)
 {
     ESP_LOGI(TAG, "Peer状态变化: %d", state);
+    EVENT_CAPTURE(EVENT_CAPTURE_SRC_PEER_STATE, (uint8_t)state, 0, NULL, 0);
     
     switch (state) {
         case ESP_PEER_STATE_CLOSED:
@@ -64,6 +267,14 @@ static int peer_state_callback(esp_peer_state_t state, void *ctx)
         case ESP_PEER_STATE_DISCONNECTED:
             ESP_LOGI(TAG, "WebRTC连接已断开");
             g_webrtc_client.state = WEBRTC_CLIENT_STATE_DISCONNECTED;
+            if (!g_restarting && g_webrtc_client.is_running) {
+                // 连通性检查（consent freshness）失败：留出esp_peer自行重连的时间，仍未恢复则重启ICE
+                if (ICE_RESTART) {
+                    schedule_restart(ICE_RESTART_GRACE_MS, "连通性检查失败", true);
+                } else {
+                    mark_failed();
+                }
+            }
             break;
         case ESP_PEER_STATE_NEW_CONNECTION:
             ESP_LOGI(TAG, "新连接创建，开始收集ICE候选...");
@@ -82,13 +293,27 @@ static int peer_state_callback(esp_peer_state_t state, void *ctx)
         case ESP_PEER_STATE_CONNECTED:
             ESP_LOGI(TAG, "WebRTC连接已建立！");
             g_webrtc_client.state = WEBRTC_CLIENT_STATE_CONNECTED;
+            mark_recovered();
             break;
         case ESP_PEER_STATE_CONNECT_FAILED:
             ESP_LOGI(TAG, "连接失败");
             g_webrtc_client.state = WEBRTC_CLIENT_STATE_ERROR;
+#if CONFIG_WEBRTC_WARM_RESTART
+            if (!g_restarting && g_webrtc_client.is_running) {
+                ESP_LOGI(TAG, "%dms后热重启Peer连接", CONFIG_WEBRTC_WARM_RESTART_DELAY_MS);
+                schedule_restart(CONFIG_WEBRTC_WARM_RESTART_DELAY_MS, "连接失败", false);
+            }
+#else
+            mark_failed();
+#endif
             break;
         case ESP_PEER_STATE_DATA_CHANNEL_CONNECTED:
             ESP_LOGI(TAG, "数据通道已连接");
+            if constexpr (WEBRTC_CLIENT_HAS_DATA_CHANNEL) {
+                if (webrtc_data_channel_manual()) {
+                    webrtc_data_channel_on_connected(g_webrtc_client.peer);
+                }
+            }
             break;
         case ESP_PEER_STATE_DATA_CHANNEL_OPENED:
             ESP_LOGI(TAG, "数据通道已打开");
@@ -98,15 +323,16 @@ static int peer_state_callback(esp_peer_state_t state, void *ctx)
             break;
         case ESP_PEER_STATE_DATA_CHANNEL_DISCONNECTED:
             ESP_LOGI(TAG, "数据通道已断开");
+            if constexpr (WEBRTC_CLIENT_HAS_DATA_CHANNEL) {
+                webrtc_data_channel_on_disconnected();
+            }
             break;
         default:
             ESP_LOGI(TAG, "未知状态: %d", state);
             break;
     }
     
-    if (g_state_callback) {
-        g_state_callback(g_webrtc_client.state, g_user_data);
-    }
+    notify_state();
     return ESP_OK;
 }
 
@@ -114,15 +340,23 @@ static int peer_state_callback(esp_peer_state_t state, void *ctx)
 static int peer_message_callback(esp_peer_msg_t *msg, void *ctx)
 {
     ESP_LOGI(TAG, "收到Peer消息，类型: %d", msg->type);
+    EVENT_CAPTURE(EVENT_CAPTURE_SRC_PEER_MSG, (uint8_t)msg->type, 0, msg->data, msg->size > 0 ? msg->size : 0);
     
     switch (msg->type) {
         case ESP_PEER_MSG_TYPE_SDP:
             ESP_LOGI(TAG, "收到SDP消息");
             if (msg->data && msg->size > 0) {
-                // 处理收到的SDP
-                strncpy(g_webrtc_client.remote_sdp, (char*)msg->data, sizeof(g_webrtc_client.remote_sdp) - 1);
-                g_webrtc_client.remote_sdp[sizeof(g_webrtc_client.remote_sdp) - 1] = '\0';
-                ESP_LOGI(TAG, "远程SDP: %s", g_webrtc_client.remote_sdp);
+                // esp_peer通过on_msg输出的是本地SDP，需要经信令发送给对端
+                int len = msg->size < (int)sizeof(g_webrtc_client.local_sdp) - 1 ? msg->size : (int)sizeof(g_webrtc_client.local_sdp) - 1;
+                memcpy(g_webrtc_client.local_sdp, msg->data, len);
+                g_webrtc_client.local_sdp[len] = '\0';
+                ESP_LOGI(TAG, "本地SDP: %s", g_webrtc_client.local_sdp);
+
+                g_webrtc_client.state = WEBRTC_CLIENT_STATE_OFFER_CREATED;
+                notify_state();
+                if (g_sdp_offer_callback) {
+                    g_sdp_offer_callback(g_webrtc_client.local_sdp, g_sdp_user_data);
+                }
             }
             break;
         case ESP_PEER_MSG_TYPE_CANDIDATE:
@@ -161,7 +395,7 @@ static int peer_message_callback(esp_peer_msg_t *msg, void *ctx)
                 
                 // 通知外部处理ICE候选
                 if (g_ice_candidate_callback) {
-                    g_ice_candidate_callback(candidate, g_user_data);
+                    g_ice_candidate_callback(candidate, g_sdp_user_data);
                 }
             }
             break;
@@ -176,6 +410,13 @@ static int peer_message_callback(esp_peer_msg_t *msg, void *ctx)
 // ESP Peer音频数据回调函数
 static int peer_audio_callback(esp_peer_audio_frame_t *frame, void *ctx)
 {
+    if (frame && frame->size > 0) {
+        EVENT_CAPTURE(EVENT_CAPTURE_SRC_AUDIO, 0, 0, frame->data, frame->size);
+        note_media();
+#if CONFIG_WEBRTC_LATENCY_PROBE
+        latency_probe_on_audio_received(frame->pts);
+#endif
+    }
     if (g_audio_callback && frame && frame->data && frame->size > 0) {
         g_audio_callback(frame->data, frame->size, g_user_data);
     }
@@ -185,6 +426,10 @@ static int peer_audio_callback(esp_peer_audio_frame_t *frame, void *ctx)
 // ESP Peer视频数据回调函数
 static int peer_video_callback(esp_peer_video_frame_t *frame, void *ctx)
 {
+    if (frame && frame->size > 0) {
+        EVENT_CAPTURE(EVENT_CAPTURE_SRC_VIDEO, 0, 0, frame->data, frame->size);
+        note_media();
+    }
     if (g_video_callback && frame && frame->data && frame->size > 0) {
         g_video_callback(frame->data, frame->size, g_user_data);
     }
@@ -194,25 +439,250 @@ static int peer_video_callback(esp_peer_video_frame_t *frame, void *ctx)
 // ESP Peer数据通道回调函数
 static int peer_data_callback(esp_peer_data_frame_t *frame, void *ctx)
 {
+    if (frame && frame->size > 0) {
+        EVENT_CAPTURE(EVENT_CAPTURE_SRC_DATA, (uint8_t)frame->type, frame->stream_id, frame->data, frame->size);
+        note_media();
+    }
+    if constexpr (WEBRTC_CLIENT_HAS_DATA_CHANNEL) {
+        if (frame && webrtc_data_channel_on_data(frame)) {
+            return ESP_OK;
+        }
+    }
     if (g_data_callback && frame && frame->data && frame->size > 0) {
         g_data_callback(frame->data, frame->size, g_user_data);
     }
     return ESP_OK;
 }
 
+// ESP Peer数据通道打开/关闭回调函数
+static int peer_channel_open_callback(esp_peer_data_channel_info_t *info, void *ctx)
+{
+    if (info) {
+        EVENT_CAPTURE(EVENT_CAPTURE_SRC_CHANNEL, 0, info->stream_id, info->label, info->label ? strlen(info->label) : 0);
+    }
+    if constexpr (WEBRTC_CLIENT_HAS_DATA_CHANNEL) {
+        webrtc_data_channel_on_open(info);
+    }
+    return ESP_OK;
+}
+
+static int peer_channel_close_callback(esp_peer_data_channel_info_t *info, void *ctx)
+{
+    if (info) {
+        EVENT_CAPTURE(EVENT_CAPTURE_SRC_CHANNEL, 1, info->stream_id, info->label, info->label ? strlen(info->label) : 0);
+    }
+    if constexpr (WEBRTC_CLIENT_HAS_DATA_CHANNEL) {
+        webrtc_data_channel_on_close(info);
+    }
+    return ESP_OK;
+}
+
+/**
+ * @brief 热重启：只关闭并重新建立Peer连接，在主任务中两次esp_peer_main_loop之间执行
+ *
+ * WiFi、NVS、主任务、数据通道缓冲区和Peer（含DTLS身份和套接字）都保留，
+ * esp_peer_new_connection生成的新Offer经on_msg交给信令重新发布。
+ * Peer无法复用时关闭后按原配置重新打开。
+ */
+static void warm_restart(void)
+{
+    int64_t start_us = esp_timer_get_time();
+    portENTER_CRITICAL(&g_restart_lock);
+    g_restart_requested = false;
+    uint32_t attempt = ++g_restart_count;
+    const char *reason = g_restart_reason ? g_restart_reason : "手动";
+    portEXIT_CRITICAL(&g_restart_lock);
+    ESP_LOGI(TAG, "🔄 热重启Peer连接（%s，第%" PRIu32 "次），保留WiFi和Peer", reason, attempt);
+
+    g_restarting = true;
+    g_webrtc_client.local_sdp[0] = '\0';
+    g_webrtc_client.remote_sdp[0] = '\0';
+    g_webrtc_client.ice_candidate_count = 0;
+    g_stun_connected = false;
+    if constexpr (WEBRTC_CLIENT_HAS_DATA_CHANNEL) {
+        webrtc_data_channel_on_disconnected();
+    }
+#if CONFIG_WEBRTC_EGRESS_SCHEDULER
+    egress_scheduler_drop_all();
+#endif
+
+    webrtc_signaling_reset_session();
+
+    int ret = -1;
+    if (g_webrtc_client.peer) {
+        esp_peer_disconnect(g_webrtc_client.peer);
+        ret = esp_peer_new_connection(g_webrtc_client.peer);
+        if (ret != 0) {
+            ESP_LOGW(TAG, "复用Peer失败: %d，关闭后重新打开", ret);
+            esp_peer_close(g_webrtc_client.peer);
+            g_webrtc_client.peer = NULL;
+        }
+    }
+    if (!g_webrtc_client.peer && open_peer("热重启") == 0) {
+        ret = esp_peer_new_connection(g_webrtc_client.peer);
+    }
+    g_restarting = false;
+
+    ESP_LOGI(TAG, "[Performance][webrtc_warm_restart_ms]: %" PRIu32,
+             (uint32_t)((esp_timer_get_time() - start_us) / 1000));
+    if (ret != 0) {
+        // 退避后再试，避免在网络不可用时反复生成密钥
+        uint32_t delay_ms = g_restart_delay_ms ? g_restart_delay_ms * 2 : 1000;
+        g_restart_delay_ms = delay_ms < WARM_RESTART_MAX_DELAY_MS ? delay_ms : WARM_RESTART_MAX_DELAY_MS;
+        ESP_LOGE(TAG, "热重启失败: %d，%" PRIu32 "ms后重试", ret, g_restart_delay_ms);
+        g_webrtc_client.state = WEBRTC_CLIENT_STATE_ERROR;
+        notify_state();
+        schedule_restart(g_restart_delay_ms, reason, false);
+    }
+}
+
+// 实际交给esp_peer发送，启用发送调度时在主任务中调用
+static int peer_send_audio(const uint8_t *data, size_t size, uint32_t pts)
+{
+    if (!g_webrtc_client.peer || g_webrtc_client.state != WEBRTC_CLIENT_STATE_CONNECTED) {
+        return -1;
+    }
+    esp_peer_audio_frame_t frame = {};
+    frame.pts = pts;
+    frame.data = (uint8_t *)data;
+    frame.size = (int)size;
+    int ret = esp_peer_send_audio(g_webrtc_client.peer, &frame);
+    if (ret != 0) {
+        ESP_LOGD(TAG, "发送音频帧失败: %d", ret);
+        return ret;
+    }
+    note_media();
+#if CONFIG_WEBRTC_LATENCY_PROBE
+    latency_probe_on_audio_sent(pts);
+#endif
+    return 0;
+}
+
+static int peer_send_video(const uint8_t *data, size_t size, uint32_t pts)
+{
+    if (!g_webrtc_client.peer || g_webrtc_client.state != WEBRTC_CLIENT_STATE_CONNECTED) {
+        return -1;
+    }
+    esp_peer_video_frame_t frame = {};
+    frame.pts = pts;
+    frame.data = (uint8_t *)data;
+    frame.size = (int)size;
+    int ret = esp_peer_send_video(g_webrtc_client.peer, &frame);
+    if (ret != 0) {
+        ESP_LOGD(TAG, "发送视频帧失败: %d", ret);
+        return ret;
+    }
+    note_media();
+    return 0;
+}
+
+#if CONFIG_WEBRTC_EGRESS_SCHEDULER
+static int egress_send_audio(const uint8_t *data, size_t size, uint32_t pts, void *ctx)
+{
+    return peer_send_audio(data, size, pts);
+}
+
+static int egress_send_video(const uint8_t *data, size_t size, uint32_t pts, void *ctx)
+{
+    return peer_send_video(data, size, pts);
+}
+
+static int egress_send_data(int budget, bool *stalled, void *ctx)
+{
+    if constexpr (WEBRTC_CLIENT_HAS_DATA_CHANNEL) {
+        if (g_webrtc_client.peer) {
+            return webrtc_data_channel_flush_budget(g_webrtc_client.peer, budget, stalled);
+        }
+    }
+    return 0;
+}
+
+static uint32_t egress_data_backlog(void *ctx)
+{
+    if constexpr (WEBRTC_CLIENT_HAS_DATA_CHANNEL) {
+        return webrtc_data_channel_total_buffered();
+    }
+    return 0;
+}
+
+static void egress_wake(void *ctx)
+{
+    TaskHandle_t task = g_webrtc_client.main_task_handle;
+    if (task) {
+        xTaskNotifyGive(task);
+    }
+}
+
+static void egress_video_done(const uint8_t *data, bool sent, void *user_data)
+{
+    portENTER_CRITICAL(&g_video_done_lock);
+    g_video_done_sent = sent;
+    g_video_done_seq = (uint32_t)(uintptr_t)user_data;
+    portEXIT_CRITICAL(&g_video_done_lock);
+    xSemaphoreGive(g_video_done_sem);
+}
+
+/**
+ * @brief 等待序号为seq的访问单元完成
+ *
+ * @param timeout 为0时只取已经到达的完成，portMAX_DELAY时一直等待
+ * @return true已完成，sent为是否发出；false超时
+ */
+static bool wait_video_done(uint32_t seq, TickType_t timeout, bool *sent)
+{
+    TickType_t start = xTaskGetTickCount();
+    for (;;) {
+        TickType_t elapsed = xTaskGetTickCount() - start;
+        TickType_t wait = timeout == portMAX_DELAY ? portMAX_DELAY : timeout > elapsed ? timeout - elapsed : 0;
+        if (xSemaphoreTake(g_video_done_sem, wait) != pdTRUE) {
+            return false;
+        }
+        portENTER_CRITICAL(&g_video_done_lock);
+        bool done = g_video_done_seq == seq;
+        if (done) {
+            *sent = g_video_done_sent;
+        }
+        portEXIT_CRITICAL(&g_video_done_lock);
+        if (done) {
+            return true;
+        }
+    }
+}
+#endif
+
 // WebRTC客户端主任务
 static void webrtc_client_main_task(void *pvParameters)
 {
     ESP_LOGI(TAG, "WebRTC客户端主任务启动");
     
     while (g_webrtc_client.is_running) {
+        if (g_restart_requested && esp_timer_get_time() >= g_restart_due_us) {
+            warm_restart();
+        }
         if (g_webrtc_client.peer) {
             esp_peer_main_loop(g_webrtc_client.peer);
+#if CONFIG_WEBRTC_LATENCY_PROBE
+            // 紧接着flush发出，ping的t1与实际发送时间只差本轮处理
+            latency_probe_poll();
+#endif
+#if CONFIG_WEBRTC_EGRESS_SCHEDULER
+            egress_scheduler_run();
+#else
+            if constexpr (WEBRTC_CLIENT_HAS_DATA_CHANNEL) {
+                webrtc_data_channel_flush(g_webrtc_client.peer);
+            }
+#endif
         }
+#if CONFIG_WEBRTC_EGRESS_SCHEDULER
+        // 有音视频提交时提前醒来，音频不必等满10ms
+        ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(10));
+#else
         vTaskDelay(pdMS_TO_TICKS(10));
+#endif
     }
     
     ESP_LOGI(TAG, "WebRTC客户端主任务退出");
+    xEventGroupSetBits(g_main_bits, MAIN_TASK_EXITED);
     vTaskDelete(NULL);
 }
 
@@ -229,54 +699,63 @@ esp_err_t webrtc_client_init(webrtc_client_config_t *config)
     // 初始化全局结构体
     memset(&g_webrtc_client, 0, sizeof(webrtc_client_t));
     memcpy(&g_webrtc_client.config, config, sizeof(webrtc_client_config_t));
-    g_webrtc_client.state = WEBRTC_CLIENT_STATE_INITIALIZING;
-    
-    // 初始化NVS
-    esp_err_t ret = nvs_flash_init();
-    if (ret == ESP_ERR_NVS_NO_FREE_PAGES || ret == ESP_ERR_NVS_NEW_VERSION_FOUND) {
-        ESP_ERROR_CHECK(nvs_flash_erase());
-        ret = nvs_flash_init();
+    if (config->enable_audio && !WEBRTC_CLIENT_HAS_AUDIO) {
+        ESP_LOGW(TAG, "音频未编译（CONFIG_WEBRTC_MEDIA_AUDIO），忽略enable_audio");
+        g_webrtc_client.config.enable_audio = false;
     }
-    ESP_ERROR_CHECK(ret);
-    
-    // 初始化网络接口
-    ESP_ERROR_CHECK(esp_netif_init());
-    
-    // 创建默认事件循环
-    ESP_ERROR_CHECK(esp_event_loop_create_default());
-    
-    // 创建默认网络接口
-    esp_netif_create_default_wifi_sta();
+    if (config->enable_video && !WEBRTC_CLIENT_HAS_VIDEO) {
+        ESP_LOGW(TAG, "视频未编译（CONFIG_WEBRTC_MEDIA_VIDEO），忽略enable_video");
+        g_webrtc_client.config.enable_video = false;
+    }
+    if (config->enable_data_channel && !WEBRTC_CLIENT_HAS_DATA_CHANNEL) {
+        ESP_LOGW(TAG, "数据通道未编译（CONFIG_WEBRTC_MEDIA_DATA_CHANNEL），忽略enable_data_channel");
+        g_webrtc_client.config.enable_data_channel = false;
+    }
+    g_webrtc_client.state = WEBRTC_CLIENT_STATE_WIFI_CONNECTING;
     
-    // 初始化WiFi
-    wifi_init_config_t cfg = WIFI_INIT_CONFIG_DEFAULT();
-    ESP_ERROR_CHECK(esp_wifi_init(&cfg));
+    // NVS、netif和事件循环与MQTT共用，已初始化时直接返回；连接在webrtc_client_start中等待，
+    // 初始化和webrtc_client_prepare可以在联网之前完成
+    esp_err_t ret = app_network_init();
+    if (ret != ESP_OK) {
+        g_webrtc_client.state = WEBRTC_CLIENT_STATE_ERROR;
+        return ret;
+    }
     
-    // 注册WiFi事件处理器
+    // 注册WiFi事件处理器（仅跟踪断线/重连）
     ESP_ERROR_CHECK(esp_event_handler_instance_register(WIFI_EVENT,
-                                                       ESP_EVENT_ANY_ID,
+                                                       WIFI_EVENT_STA_DISCONNECTED,
                                                        &wifi_event_handler,
                                                        NULL,
-                                                       NULL));
+                                                       &g_wifi_event_instance));
     ESP_ERROR_CHECK(esp_event_handler_instance_register(IP_EVENT,
                                                        IP_EVENT_STA_GOT_IP,
                                                        &wifi_event_handler,
                                                        NULL,
-                                                       NULL));
+                                                       &g_ip_event_instance));
     
-    // 设置WiFi模式
-    ESP_ERROR_CHECK(esp_wifi_set_mode(WIFI_MODE_STA));
-    
-    // 配置WiFi连接参数
-    wifi_config_t wifi_config;
-    memset(&wifi_config, 0, sizeof(wifi_config));
-    wifi_config.sta.threshold.authmode = WIFI_AUTH_WPA2_PSK;
-    wifi_config.sta.pmf_cfg.capable = true;
-    wifi_config.sta.pmf_cfg.required = false;
-    strcpy((char*)wifi_config.sta.ssid, config->wifi_ssid);
-    strcpy((char*)wifi_config.sta.password, config->wifi_password);
-    
-    ESP_ERROR_CHECK(esp_wifi_set_config(WIFI_IF_STA, &wifi_config));
+#if CONFIG_WEBRTC_DATA_CHANNEL_SELF_TEST
+    webrtc_data_channel_self_test();
+#endif
+#if CONFIG_WEBRTC_EGRESS_SCHEDULER
+#if CONFIG_WEBRTC_EGRESS_BENCHMARK
+    egress_scheduler_run_benchmark();
+#endif
+    if (!g_video_done_sem) {
+        g_video_done_sem = xSemaphoreCreateBinary();
+    }
+    egress_config_t egress_config = EGRESS_DEFAULT_CONFIG();
+    egress_ops_t egress_ops = {};
+    egress_ops.send_audio = egress_send_audio;
+    egress_ops.send_video = egress_send_video;
+    egress_ops.send_data = egress_send_data;
+    egress_ops.data_backlog = egress_data_backlog;
+    egress_ops.wake = egress_wake;
+    if (!g_video_done_sem || egress_scheduler_init(&egress_config, &egress_ops) != ESP_OK) {
+        ESP_LOGE(TAG, "发送调度初始化失败");
+        g_webrtc_client.state = WEBRTC_CLIENT_STATE_ERROR;
+        return ESP_ERR_NO_MEM;
+    }
+#endif
     
     ESP_LOGI(TAG, "WebRTC客户端初始化完成");
     return ESP_OK;
@@ -287,39 +766,36 @@ esp_err_t webrtc_client_deinit(void)
 {
     ESP_LOGI(TAG, "反初始化WebRTC客户端...");
     
-    // 停止客户端
+    // 停止客户端（网络和NVS由app_network管理，MQTT仍在使用，不在此关闭或擦除）
     webrtc_client_stop();
-    
-    // 关闭WiFi
-    esp_wifi_stop();
-    esp_wifi_deinit();
-    
-    // 销毁事件循环
-    esp_event_loop_delete_default();
-    
-    // 销毁网络接口
-    esp_netif_deinit();
-    
-    // 擦除NVS
-    nvs_flash_erase();
-    
+    if (g_open_pending) {
+        xEventGroupWaitBits(g_open_bits, PEER_OPEN_DONE, pdFALSE, pdTRUE, pdMS_TO_TICKS(PEER_OPEN_TIMEOUT_MS));
+        g_open_pending = false;
+    }
+#if CONFIG_WEBRTC_EGRESS_SCHEDULER
+    egress_scheduler_deinit();
+#endif
+    // 跨会话保留的Peer在此关闭
+    if (g_webrtc_client.peer) {
+        esp_peer_close(g_webrtc_client.peer);
+        g_webrtc_client.peer = NULL;
+    }
+    if (g_wifi_event_instance) {
+        esp_event_handler_instance_unregister(WIFI_EVENT, WIFI_EVENT_STA_DISCONNECTED, g_wifi_event_instance);
+        g_wifi_event_instance = NULL;
+    }
+    if (g_ip_event_instance) {
+        esp_event_handler_instance_unregister(IP_EVENT, IP_EVENT_STA_GOT_IP, g_ip_event_instance);
+        g_ip_event_instance = NULL;
+    }
+
     ESP_LOGI(TAG, "WebRTC客户端反初始化完成");
     return ESP_OK;
 }
 
-// 启动WebRTC客户端
-esp_err_t webrtc_client_start(void)
+// 按配置填写Peer配置（媒体、数据通道、STUN和回调）
+static esp_err_t build_peer_cfg(void)
 {
-    ESP_LOGI(TAG, "启动WebRTC客户端...");
-    
-    if (g_webrtc_client.is_running) {
-        ESP_LOGW(TAG, "WebRTC客户端已经在运行");
-        return ESP_OK;
-    }
-    
-    // 启动WiFi
-    ESP_ERROR_CHECK(esp_wifi_start());
-    
     // 创建ESP Peer配置
     memset(&g_webrtc_client.peer_cfg, 0, sizeof(esp_peer_cfg_t));
     g_webrtc_client.peer_cfg.role = ESP_PEER_ROLE_CONTROLLING;  // 作为控制端
@@ -339,37 +815,44 @@ esp_err_t webrtc_client_start(void)
     g_webrtc_client.peer_cfg.role = ESP_PEER_ROLE_CONTROLLING;
     g_webrtc_client.peer_cfg.ice_trans_policy = ESP_PEER_ICE_TRANS_POLICY_ALL;
     g_webrtc_client.peer_cfg.no_auto_reconnect = false;
-    g_webrtc_client.peer_cfg.enable_data_channel = true;
-    g_webrtc_client.peer_cfg.manual_ch_create = false;
     
+    // 以下各媒体按编译期能力整段保留或丢弃，未编译的回调不会链接进固件
     // 配置音频（如果启用）
-    if (g_webrtc_client.config.enable_audio) {
-        g_webrtc_client.peer_cfg.audio_info.codec = ESP_PEER_AUDIO_CODEC_OPUS;
-        g_webrtc_client.peer_cfg.audio_info.sample_rate = 48000;
-        g_webrtc_client.peer_cfg.audio_info.channel = 1;
-        g_webrtc_client.peer_cfg.audio_dir = ESP_PEER_MEDIA_DIR_SEND_RECV;
+    if constexpr (WEBRTC_CLIENT_HAS_AUDIO) {
+        if (g_webrtc_client.config.enable_audio) {
+            g_webrtc_client.peer_cfg.audio_info.codec = ESP_PEER_AUDIO_CODEC_OPUS;
+            g_webrtc_client.peer_cfg.audio_info.sample_rate = 48000;
+            g_webrtc_client.peer_cfg.audio_info.channel = 1;
+            g_webrtc_client.peer_cfg.audio_dir = ESP_PEER_MEDIA_DIR_SEND_RECV;
+        }
+        g_webrtc_client.peer_cfg.on_audio_data = peer_audio_callback;
     }
     
     // 配置视频（如果启用）
-    if (g_webrtc_client.config.enable_video) {
-        g_webrtc_client.peer_cfg.video_info.codec = ESP_PEER_VIDEO_CODEC_H264;
-        g_webrtc_client.peer_cfg.video_info.width = 640;
-        g_webrtc_client.peer_cfg.video_info.height = 480;
-        g_webrtc_client.peer_cfg.video_info.fps = 30;
-        g_webrtc_client.peer_cfg.video_dir = ESP_PEER_MEDIA_DIR_SEND_RECV;
+    if constexpr (WEBRTC_CLIENT_HAS_VIDEO) {
+        if (g_webrtc_client.config.enable_video) {
+            g_webrtc_client.peer_cfg.video_info.codec = ESP_PEER_VIDEO_CODEC_H264;
+            g_webrtc_client.peer_cfg.video_info.width = 640;
+            g_webrtc_client.peer_cfg.video_info.height = 480;
+            g_webrtc_client.peer_cfg.video_info.fps = 30;
+            g_webrtc_client.peer_cfg.video_dir = ESP_PEER_MEDIA_DIR_SEND_RECV;
+        }
+        g_webrtc_client.peer_cfg.on_video_data = peer_video_callback;
     }
     
     // 配置数据通道（如果启用）
-    if (g_webrtc_client.config.enable_data_channel) {
-        g_webrtc_client.peer_cfg.enable_data_channel = true;
+    if constexpr (WEBRTC_CLIENT_HAS_DATA_CHANNEL) {
+        g_webrtc_client.peer_cfg.enable_data_channel = g_webrtc_client.config.enable_data_channel;
+        // 注册了数据通道时由webrtc_data_channel按配置创建，否则使用默认通道
+        g_webrtc_client.peer_cfg.manual_ch_create = webrtc_data_channel_manual();
+        g_webrtc_client.peer_cfg.on_data = peer_data_callback;
+        g_webrtc_client.peer_cfg.on_channel_open = peer_channel_open_callback;
+        g_webrtc_client.peer_cfg.on_channel_close = peer_channel_close_callback;
     }
     
     // 设置回调函数
     g_webrtc_client.peer_cfg.on_state = peer_state_callback;
     g_webrtc_client.peer_cfg.on_msg = peer_message_callback;
-    g_webrtc_client.peer_cfg.on_audio_data = peer_audio_callback;
-    g_webrtc_client.peer_cfg.on_video_data = peer_video_callback;
-    g_webrtc_client.peer_cfg.on_data = peer_data_callback;
     g_webrtc_client.peer_cfg.ctx = NULL;
     
     // 获取默认的Peer操作接口
@@ -379,24 +862,181 @@ esp_err_t webrtc_client_start(void)
         return ESP_FAIL;
     }
     
-    // 创建Peer连接
+    return ESP_OK;
+}
+
+// esp_peer_open内生成DTLS密钥对和自签名证书，是建立连接前最耗CPU的一步
+static int open_peer(const char *when)
+{
+    int64_t start_us = esp_timer_get_time();
     int ret = esp_peer_open(&g_webrtc_client.peer_cfg, g_webrtc_client.peer_ops, &g_webrtc_client.peer);
+    ESP_LOGI(TAG, "[Performance][peer_open_ms]: %" PRIu32 " (%s)",
+             (uint32_t)((esp_timer_get_time() - start_us) / 1000), when);
     if (ret != 0) {
         ESP_LOGE(TAG, "创建Peer连接失败: %d", ret);
+        g_webrtc_client.peer = NULL;
+    } else {
+        g_peer_opened_us = esp_timer_get_time();
+    }
+    return ret;
+}
+
+/**
+ * @brief 保留的Peer的DTLS身份是否已超过轮换周期（CONFIG_WEBRTC_DTLS_ROTATE_S）
+ *
+ * esp_peer在esp_peer_open内部生成证书和密钥，不提供传入或导出的接口，
+ * 只能通过关闭并重新打开Peer更换身份，也无法跨重启保存
+ */
+static bool peer_identity_expired(void)
+{
+#if CONFIG_WEBRTC_PEER_PREOPEN && CONFIG_WEBRTC_DTLS_ROTATE_S > 0
+    return g_webrtc_client.peer &&
+           esp_timer_get_time() - g_peer_opened_us >= (int64_t)CONFIG_WEBRTC_DTLS_ROTATE_S * 1000000;
+#else
+    return false;
+#endif
+}
+
+#if CONFIG_WEBRTC_PEER_PREOPEN
+static void peer_open_task(void *arg)
+{
+    g_open_result = open_peer("联网期间预打开");
+    xEventGroupSetBits(g_open_bits, PEER_OPEN_DONE);
+    vTaskDelete(NULL);
+}
+#endif
+
+/**
+ * @brief 准备好可用的Peer：等待预打开完成、复用上次会话保留的Peer，或者现在打开
+ */
+static esp_err_t ensure_peer_open(void)
+{
+    if (g_open_pending) {
+        int64_t wait_start_us = esp_timer_get_time();
+        EventBits_t bits = xEventGroupWaitBits(g_open_bits, PEER_OPEN_DONE, pdFALSE, pdTRUE,
+                                               pdMS_TO_TICKS(PEER_OPEN_TIMEOUT_MS));
+        if (!(bits & PEER_OPEN_DONE)) {
+            ESP_LOGE(TAG, "预打开Peer超时");
+            return ESP_ERR_TIMEOUT;
+        }
+        g_open_pending = false;
+        ESP_LOGI(TAG, "[Performance][peer_open_wait_ms]: %" PRIu32,
+                 (uint32_t)((esp_timer_get_time() - wait_start_us) / 1000));
+        return g_open_result == 0 ? ESP_OK : ESP_FAIL;
+    }
+    if (peer_identity_expired()) {
+        ESP_LOGI(TAG, "DTLS身份已使用%" PRIu32 "秒，重新打开Peer轮换",
+                 (uint32_t)((esp_timer_get_time() - g_peer_opened_us) / 1000000));
+        esp_peer_close(g_webrtc_client.peer);
+        g_webrtc_client.peer = NULL;
+    }
+    if (g_webrtc_client.peer) {
+        ESP_LOGI(TAG, "复用已打开的Peer，DTLS密钥和证书不变");
+        return ESP_OK;
+    }
+    esp_err_t ret = build_peer_cfg();
+    if (ret != ESP_OK) {
+        return ret;
+    }
+    return open_peer("启动时打开") == 0 ? ESP_OK : ESP_FAIL;
+}
+
+esp_err_t webrtc_client_prepare(void)
+{
+#if CONFIG_WEBRTC_PEER_PREOPEN
+    if (g_webrtc_client.peer || g_open_pending) {
+        return ESP_OK;
+    }
+    esp_err_t ret = build_peer_cfg();
+    if (ret != ESP_OK) {
+        return ret;
+    }
+    if (!g_open_bits) {
+        g_open_bits = xEventGroupCreate();
+        if (!g_open_bits) {
+            return ESP_ERR_NO_MEM;
+        }
+    }
+    xEventGroupClearBits(g_open_bits, PEER_OPEN_DONE);
+    g_open_pending = true;
+    ret = task_topology_create(APP_TASK_PEER_OPEN, peer_open_task, NULL, NULL);
+    if (ret != ESP_OK) {
+        g_open_pending = false;
+    }
+    return ret;
+#else
+    return ESP_OK;
+#endif
+}
+
+// 启动WebRTC客户端
+esp_err_t webrtc_client_start(void)
+{
+    ESP_LOGI(TAG, "启动WebRTC客户端...");
+    
+    if (g_webrtc_client.is_running) {
+        ESP_LOGW(TAG, "WebRTC客户端已经在运行");
+        return ESP_OK;
+    }
+    
+    int64_t start_us = esp_timer_get_time();
+
+    // app_main已连好网络时直接返回；单独使用时在此等待连接
+    esp_err_t net_ret = app_network_start();
+    if (net_ret != ESP_OK) {
+        g_webrtc_client.state = WEBRTC_CLIENT_STATE_ERROR;
+        return net_ret;
+    }
+    g_webrtc_client.state = WEBRTC_CLIENT_STATE_WIFI_CONNECTED;
+
+    if (ensure_peer_open() != ESP_OK) {
         return ESP_FAIL;
     }
     
     // 创建新连接，开始收集ICE候选
-    ret = esp_peer_new_connection(g_webrtc_client.peer);
+    webrtc_signaling_reset_session();
+    int ret = esp_peer_new_connection(g_webrtc_client.peer);
     if (ret != 0) {
         ESP_LOGE(TAG, "创建新连接失败: %d", ret);
         return ESP_FAIL;
     }
     ESP_LOGI(TAG, "开始收集ICE候选...");
+    ESP_LOGI(TAG, "[Performance][peer_ready_ms]: %" PRIu32 " (开机后%" PRIu32 "，%s)",
+             (uint32_t)((esp_timer_get_time() - start_us) / 1000), (uint32_t)(esp_timer_get_time() / 1000),
+             PEER_PREOPEN ? "预打开" : "启动时打开");
     
     // 启动主任务
+    if (!g_main_bits) {
+        g_main_bits = xEventGroupCreate();
+        if (!g_main_bits) {
+            return ESP_ERR_NO_MEM;
+        }
+    }
+    xEventGroupClearBits(g_main_bits, MAIN_TASK_EXITED);
+    portENTER_CRITICAL(&g_restart_lock);
+    g_restart_requested = false;
+    g_failed_us = 0;
+    g_restart_count = 0;
+    g_restart_delay_ms = 0;
+    g_gap_open = false;
+    g_last_media_us = 0;
+    portEXIT_CRITICAL(&g_restart_lock);
     g_webrtc_client.is_running = true;
-    xTaskCreate(webrtc_client_main_task, "webrtc_main", 8192, NULL, 5, &g_webrtc_client.main_task_handle);
+    if (task_topology_create(APP_TASK_PEER, webrtc_client_main_task, NULL, &g_webrtc_client.main_task_handle) != ESP_OK) {
+        g_webrtc_client.is_running = false;
+        return ESP_FAIL;
+    }
+#if CONFIG_WEBRTC_ICE_RESTART_TEST_S > 0
+    if (!g_net_test_timer) {
+        esp_timer_create_args_t timer_args = {};
+        timer_args.callback = net_test_timer_cb;
+        timer_args.name = "ice_restart_test";
+        esp_timer_create(&timer_args, &g_net_test_timer);
+    }
+    if (g_net_test_timer) {
+        esp_timer_start_periodic(g_net_test_timer, (uint64_t)CONFIG_WEBRTC_ICE_RESTART_TEST_S * 1000000);
+    }
+#endif
     
     ESP_LOGI(TAG, "WebRTC客户端启动完成");
     return ESP_OK;
@@ -412,28 +1052,65 @@ esp_err_t webrtc_client_stop(void)
         return ESP_OK;
     }
     
-    // 停止主任务
+    // 回调运行在主任务中，在此等待主任务退出会死锁；回调中应改用webrtc_client_restart
+    if (xTaskGetCurrentTaskHandle() == g_webrtc_client.main_task_handle) {
+        ESP_LOGE(TAG, "不能在Peer回调中停止客户端");
+        return ESP_ERR_INVALID_STATE;
+    }
+    
+    if (g_net_test_timer) {
+        esp_timer_stop(g_net_test_timer);
+    }
+    
+    // 停止主任务：不从外部删除，等它退出esp_peer_main_loop后自行结束，Peer状态保持一致
     g_webrtc_client.is_running = false;
-    if (g_webrtc_client.main_task_handle) {
-        vTaskDelete(g_webrtc_client.main_task_handle);
-        g_webrtc_client.main_task_handle = NULL;
+    EventBits_t bits = xEventGroupWaitBits(g_main_bits, MAIN_TASK_EXITED, pdTRUE, pdTRUE,
+                                           pdMS_TO_TICKS(MAIN_TASK_STOP_TIMEOUT_MS));
+    if (!(bits & MAIN_TASK_EXITED)) {
+        ESP_LOGE(TAG, "主任务未在%dms内退出", MAIN_TASK_STOP_TIMEOUT_MS);
+        return ESP_ERR_TIMEOUT;
     }
+    g_webrtc_client.main_task_handle = NULL;
+#if CONFIG_WEBRTC_EGRESS_SCHEDULER
+    // 主任务已退出，排队的音视频不会再发出，释放等待中的视频发送方
+    egress_scheduler_drop_all();
+#endif
     
-    // 关闭Peer连接
     if (g_webrtc_client.peer) {
+#if CONFIG_WEBRTC_PEER_PREOPEN
+        // 只断开连接，保留Peer和DTLS身份，下次启动直接esp_peer_new_connection；
+        // 身份到期时关闭并在后台重新打开，轮换不占用下次启动的时间
+        esp_peer_disconnect(g_webrtc_client.peer);
+        if (peer_identity_expired()) {
+            ESP_LOGI(TAG, "DTLS身份到期，后台重新打开Peer");
+            esp_peer_close(g_webrtc_client.peer);
+            g_webrtc_client.peer = NULL;
+            webrtc_client_prepare();
+        }
+#else
         esp_peer_close(g_webrtc_client.peer);
         g_webrtc_client.peer = NULL;
+#endif
     }
     
     g_webrtc_client.state = WEBRTC_CLIENT_STATE_IDLE;
-    if (g_state_callback) {
-        g_state_callback(g_webrtc_client.state, g_user_data);
-    }
+    notify_state();
     
     ESP_LOGI(TAG, "WebRTC客户端停止完成");
     return ESP_OK;
 }
 
+// 热重启Peer连接
+esp_err_t webrtc_client_restart(void)
+{
+    if (!g_webrtc_client.is_running) {
+        ESP_LOGW(TAG, "WebRTC客户端未在运行");
+        return ESP_ERR_INVALID_STATE;
+    }
+    schedule_restart(0, "手动", false);
+    return ESP_OK;
+}
+
 // 设置回调函数
 esp_err_t webrtc_client_set_callbacks(
     webrtc_state_callback_t state_cb,
@@ -443,9 +1120,15 @@ esp_err_t webrtc_client_set_callbacks(
     void *user_data)
 {
     g_state_callback = state_cb;
-    g_audio_callback = audio_cb;
-    g_video_callback = video_cb;
-    g_data_callback = data_cb;
+    if constexpr (WEBRTC_CLIENT_HAS_AUDIO) {
+        g_audio_callback = audio_cb;
+    }
+    if constexpr (WEBRTC_CLIENT_HAS_VIDEO) {
+        g_video_callback = video_cb;
+    }
+    if constexpr (WEBRTC_CLIENT_HAS_DATA_CHANNEL) {
+        g_data_callback = data_cb;
+    }
     g_user_data = user_data;
     
     ESP_LOGI(TAG, "回调函数设置完成");
@@ -460,7 +1143,7 @@ esp_err_t webrtc_client_set_sdp_callbacks(
 {
     g_sdp_offer_callback = sdp_offer_cb;
     g_ice_candidate_callback = ice_candidate_cb;
-    g_user_data = user_data;
+    g_sdp_user_data = user_data;
     
     ESP_LOGI(TAG, "SDP回调函数设置完成");
     return ESP_OK;
@@ -476,6 +1159,15 @@ esp_err_t webrtc_client_create_offer(void)
         return ESP_FAIL;
     }
     
+    // esp_peer已生成本地SDP时直接重新发布，避免覆盖真实的Offer
+    if (g_webrtc_client.local_sdp[0] != '\0') {
+        if (g_sdp_offer_callback) {
+            g_sdp_offer_callback(g_webrtc_client.local_sdp, g_sdp_user_data);
+        }
+        ESP_LOGI(TAG, "使用esp_peer生成的SDP Offer");
+        return ESP_OK;
+    }
+
     // 生成一个简单的SDP Offer（实际应该由esp_peer生成）
     const char *sdp_offer = 
         "v=0\r\n"
@@ -487,20 +1179,18 @@ esp_err_t webrtc_client_create_offer(void)
         "c=IN IP4 0.0.0.0\r\n"
         "a=mid:0\r\n"
         "a=sctp-port:5000\r\n"
-        "a=max-message-size:262144\r\n";
+        "a=max-message-size:" WEBRTC_STR(CONFIG_WEBRTC_DATA_CHANNEL_MAX_MESSAGE) "\r\n";
     
     strncpy(g_webrtc_client.local_sdp, sdp_offer, sizeof(g_webrtc_client.local_sdp) - 1);
     g_webrtc_client.local_sdp[sizeof(g_webrtc_client.local_sdp) - 1] = '\0';
     
     // 更新状态
     g_webrtc_client.state = WEBRTC_CLIENT_STATE_OFFER_CREATED;
-    if (g_state_callback) {
-        g_state_callback(g_webrtc_client.state, g_user_data);
-    }
+    notify_state();
     
     // 通知外部SDP Offer已创建
     if (g_sdp_offer_callback) {
-        g_sdp_offer_callback(g_webrtc_client.local_sdp, g_user_data);
+        g_sdp_offer_callback(g_webrtc_client.local_sdp, g_sdp_user_data);
     }
     
     ESP_LOGI(TAG, "SDP Offer创建完成");
@@ -519,11 +1209,22 @@ esp_err_t webrtc_client_set_answer(const char *answer_sdp)
     strncpy(g_webrtc_client.remote_sdp, answer_sdp, sizeof(g_webrtc_client.remote_sdp) - 1);
     g_webrtc_client.remote_sdp[sizeof(g_webrtc_client.remote_sdp) - 1] = '\0';
     
+    // 将远程SDP交给esp_peer
+    if (g_webrtc_client.peer) {
+        esp_peer_msg_t msg = {};
+        msg.type = ESP_PEER_MSG_TYPE_SDP;
+        msg.data = (uint8_t*)g_webrtc_client.remote_sdp;
+        msg.size = strlen(g_webrtc_client.remote_sdp);
+        int ret = esp_peer_send_msg(g_webrtc_client.peer, &msg);
+        if (ret != 0) {
+            ESP_LOGE(TAG, "设置远程SDP失败: %d", ret);
+            return ESP_FAIL;
+        }
+    }
+    
     // 更新状态
     g_webrtc_client.state = WEBRTC_CLIENT_STATE_ANSWER_RECEIVED;
-    if (g_state_callback) {
-        g_state_callback(g_webrtc_client.state, g_user_data);
-    }
+    notify_state();
     
     ESP_LOGI(TAG, "Answer SDP设置完成");
     return ESP_OK;
@@ -547,9 +1248,80 @@ esp_err_t webrtc_client_add_ice_candidate(const char *candidate)
         g_webrtc_client.ice_candidate_count++;
     }
     
+    // 将远程ICE候选交给esp_peer
+    if (g_webrtc_client.peer) {
+        esp_peer_msg_t msg = {};
+        msg.type = ESP_PEER_MSG_TYPE_CANDIDATE;
+        msg.data = (uint8_t*)candidate;
+        msg.size = strlen(candidate);
+        int ret = esp_peer_send_msg(g_webrtc_client.peer, &msg);
+        if (ret != 0) {
+            ESP_LOGW(TAG, "添加远程ICE候选失败: %d", ret);
+            return ESP_FAIL;
+        }
+    }
+    
     return ESP_OK;
 }
 
+// 发送一帧已编码的音频（Opus），连接建立前返回ESP_ERR_INVALID_STATE
+esp_err_t webrtc_client_send_audio(const uint8_t *data, size_t size, uint32_t pts)
+{
+    if constexpr (!WEBRTC_CLIENT_HAS_AUDIO) {
+        return ESP_ERR_NOT_SUPPORTED;
+    }
+    if (!data || size == 0) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (!g_webrtc_client.peer || g_webrtc_client.state != WEBRTC_CLIENT_STATE_CONNECTED) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+#if CONFIG_WEBRTC_EGRESS_SCHEDULER
+    // 拷贝后立即返回，由主任务优先发出
+    return egress_scheduler_submit_audio(data, size, pts);
+#else
+    return peer_send_audio(data, size, pts) == 0 ? ESP_OK : ESP_FAIL;
+#endif
+}
+
+// 发送一个H.264访问单元（Annex-B），RTP分包由esp_peer完成
+esp_err_t webrtc_client_send_video(const uint8_t *data, size_t size, uint32_t pts)
+{
+    if constexpr (!WEBRTC_CLIENT_HAS_VIDEO) {
+        return ESP_ERR_NOT_SUPPORTED;
+    }
+    if (!data || size == 0) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (!g_webrtc_client.peer || g_webrtc_client.state != WEBRTC_CLIENT_STATE_CONNECTED) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+#if CONFIG_WEBRTC_EGRESS_SCHEDULER
+    // 访问单元只提交引用，等主任务按令牌发出后返回，调用方随后即可复用缓冲区。
+    // 只有视频发送任务调用，序号不需要加锁
+    const uint32_t seq = ++g_video_seq;
+    esp_err_t err = egress_scheduler_submit_video(data, size, pts, egress_video_done, (void *)(uintptr_t)seq);
+    if (err != ESP_OK) {
+        return err;
+    }
+    bool sent = false;
+    if (!wait_video_done(seq, pdMS_TO_TICKS(MAIN_TASK_STOP_TIMEOUT_MS), &sent)) {
+        // 主任务停止或卡住：丢弃排队的访问单元（立即完成）；已在esp_peer发送中的无法撤回，
+        // 缓冲区在发送返回前不能交还调用方，只能一直等到完成
+        egress_scheduler_drop_all();
+        if (!wait_video_done(seq, 0, &sent)) {
+            ESP_LOGW(TAG, "视频访问单元仍在发送，等待完成，pts=%" PRIu32, pts);
+            wait_video_done(seq, portMAX_DELAY, &sent);
+        }
+    }
+    return sent ? ESP_OK : ESP_FAIL;
+#else
+    return peer_send_video(data, size, pts) == 0 ? ESP_OK : ESP_FAIL;
+#endif
+}
+
 // 获取当前状态
 webrtc_client_state_t webrtc_client_get_state(void)
 {
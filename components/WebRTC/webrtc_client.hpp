@@ -1,17 +1,21 @@
 #pragma once
 
-#include "driver/gpio.h"
+#include "sdkconfig.h"
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
-#include "esp_peer.h"
-#include "esp_peer_default.h"
 #include "esp_log.h"
 #include "esp_system.h"
-#include "esp_wifi.h"
 #include "esp_event.h"
+// esp_peer没有linux移植：linux目标上只有信令用到的接口，由webrtc_client_host.cpp实现
+#if !CONFIG_IDF_TARGET_LINUX
+#include "driver/gpio.h"
+#include "esp_peer.h"
+#include "esp_peer_default.h"
+#include "esp_wifi.h"
 #include "nvs_flash.h"
 #include "lwip/err.h"
 #include "lwip/sys.h"
+#endif
 
 #ifdef __cplusplus
 extern "C" {
@@ -33,17 +37,40 @@ typedef enum {
     WEBRTC_CLIENT_STATE_ERROR               // 错误状态
 } webrtc_client_state_t;
 
-// WebRTC客户端配置结构体
+/*
+ * 编译期媒体能力（Kconfig WEBRTC_MEDIA_*）
+ *
+ * 关闭的媒体在编译期整段移除：回调、收发接口、Peer媒体配置和对应源文件都不进入固件。
+ * 运行时的enable_*只能在已编译的能力中选择。
+ */
+#if CONFIG_WEBRTC_MEDIA_AUDIO
+#define WEBRTC_CLIENT_HAS_AUDIO 1
+#else
+#define WEBRTC_CLIENT_HAS_AUDIO 0
+#endif
+
+#if CONFIG_WEBRTC_MEDIA_VIDEO
+#define WEBRTC_CLIENT_HAS_VIDEO 1
+#else
+#define WEBRTC_CLIENT_HAS_VIDEO 0
+#endif
+
+#if CONFIG_WEBRTC_MEDIA_DATA_CHANNEL
+#define WEBRTC_CLIENT_HAS_DATA_CHANNEL 1
+#else
+#define WEBRTC_CLIENT_HAS_DATA_CHANNEL 0
+#endif
+
+// WebRTC客户端配置结构体（Wi-Fi由app_network统一连接，见protocol_examples_common的Kconfig）
 typedef struct {
-    char wifi_ssid[32];                     // WiFi SSID
-    char wifi_password[64];                 // WiFi密码
     char stun_server[64];                   // STUN服务器地址
     uint16_t stun_port;                     // STUN服务器端口
-    bool enable_audio;                      // 是否启用音频
-    bool enable_video;                      // 是否启用视频
-    bool enable_data_channel;               // 是否启用数据通道
+    bool enable_audio;                      // 是否启用音频（需WEBRTC_CLIENT_HAS_AUDIO）
+    bool enable_video;                      // 是否启用视频（需WEBRTC_CLIENT_HAS_VIDEO）
+    bool enable_data_channel;               // 是否启用数据通道（需WEBRTC_CLIENT_HAS_DATA_CHANNEL）
 } webrtc_client_config_t;
 
+#if !CONFIG_IDF_TARGET_LINUX
 // WebRTC客户端结构体
 typedef struct {
     webrtc_client_config_t config;          // 客户端配置
@@ -58,6 +85,7 @@ typedef struct {
     char ice_candidates[10][256];           // ICE候选列表
     int ice_candidate_count;                // ICE候选数量
 } webrtc_client_t;
+#endif
 
 // 回调函数类型定义
 typedef void (*webrtc_state_callback_t)(webrtc_client_state_t state, void *user_data);
@@ -72,8 +100,25 @@ typedef void (*webrtc_ice_candidate_callback_t)(const char *candidate, void *use
 // 函数声明
 esp_err_t webrtc_client_init(webrtc_client_config_t *config);
 esp_err_t webrtc_client_deinit(void);
+
+/**
+ * @brief 在联网期间于后台打开Peer（生成DTLS密钥和证书），需在webrtc_client_init之后、
+ *        数据通道注册完成后调用
+ *
+ * webrtc_client_start会等待其完成后直接使用；未启用CONFIG_WEBRTC_PEER_PREOPEN时不做任何事
+ */
+esp_err_t webrtc_client_prepare(void);
 esp_err_t webrtc_client_start(void);
 esp_err_t webrtc_client_stop(void);
+
+/**
+ * @brief 热重启：只断开并重新建立Peer连接，WiFi、NVS、主任务和Peer保留
+ *
+ * 可在任意任务（包括状态回调）中调用，由主任务在下一轮循环中执行，新Offer经SDP回调重新发布。
+ * 从失败到重新连接的耗时输出为[Performance][webrtc_recovery_ms]。
+ * 注意webrtc_client_stop会等待主任务退出，不能在回调中调用。
+ */
+esp_err_t webrtc_client_restart(void);
 esp_err_t webrtc_client_set_callbacks(
     webrtc_state_callback_t state_cb,
     webrtc_audio_callback_t audio_cb,
@@ -92,6 +137,10 @@ esp_err_t webrtc_client_set_sdp_callbacks(
     void *user_data
 );
 
+// 媒体发送：pts为毫秒，对应媒体未编译时返回ESP_ERR_NOT_SUPPORTED
+esp_err_t webrtc_client_send_audio(const uint8_t *data, size_t size, uint32_t pts);
+esp_err_t webrtc_client_send_video(const uint8_t *data, size_t size, uint32_t pts);
+
 // 获取当前状态和SDP信息
 webrtc_client_state_t webrtc_client_get_state(void);
 const char* webrtc_client_get_local_sdp(void);
@@ -0,0 +1,140 @@
+#include "webrtc_client.hpp"
+#include "webrtc_signaling.hpp"
+
+#include <stdio.h>
+#include <string.h>
+#include <inttypes.h>
+
+/*
+ * linux目标上的Peer替身（tools/fleet_sim.py的虚拟设备使用）
+ *
+ * esp_peer没有linux移植，这里只实现信令用到的webrtc_client接口：每次启动生成一个与esp_peer
+ * 大小相近的Offer和两条主机候选，按esp_peer的顺序交给信令（候选先于Offer到达，由信令攒批），
+ * 收到Answer后即视为连接建立。没有ICE、DTLS和媒体。
+ */
+
+static const char *TAG = "webrtc_host";
+
+#define HOST_CANDIDATE_COUNT 2
+
+static webrtc_client_state_t g_state = WEBRTC_CLIENT_STATE_IDLE;
+static webrtc_state_callback_t g_state_callback = NULL;
+static void *g_user_data = NULL;
+static webrtc_sdp_offer_callback_t g_sdp_offer_callback = NULL;
+static webrtc_ice_candidate_callback_t g_ice_candidate_callback = NULL;
+static void *g_sdp_user_data = NULL;
+static char g_local_sdp[2048];
+static char g_remote_sdp[2048];
+static uint32_t g_session = 0;
+
+static void set_state(webrtc_client_state_t state)
+{
+    g_state = state;
+    if (g_state_callback) {
+        g_state_callback(state, g_user_data);
+    }
+}
+
+// 音频、视频和数据通道各一个m行，长度与esp_peer生成的Offer相当
+static void build_offer(void)
+{
+    int len = snprintf(g_local_sdp, sizeof(g_local_sdp),
+                       "v=0\r\no=- %" PRIu32 " 2 IN IP4 127.0.0.1\r\ns=-\r\nt=0 0\r\na=group:BUNDLE 0 1 2\r\n"
+                       "m=audio 9 UDP/TLS/RTP/SAVPF 111\r\nc=IN IP4 0.0.0.0\r\na=mid:0\r\na=sendrecv\r\n"
+                       "a=rtpmap:111 opus/48000/2\r\na=fmtp:111 minptime=10;useinbandfec=1\r\n"
+                       "m=video 9 UDP/TLS/RTP/SAVPF 96\r\nc=IN IP4 0.0.0.0\r\na=mid:1\r\na=sendonly\r\n"
+                       "a=rtpmap:96 H264/90000\r\na=rtcp-fb:96 nack\r\na=rtcp-fb:96 nack pli\r\n"
+                       "m=application 9 UDP/DTLS/SCTP webrtc-datachannel\r\nc=IN IP4 0.0.0.0\r\na=mid:2\r\n"
+                       "a=sctp-port:5000\r\n",
+                       g_session);
+    // 指纹和ICE凭据按esp_peer的格式补齐长度
+    snprintf(g_local_sdp + len, sizeof(g_local_sdp) - len,
+             "a=ice-ufrag:host%04" PRIX32 "\r\na=ice-pwd:hostfleetsimulatorpassword0000\r\n"
+             "a=fingerprint:sha-256 00:11:22:33:44:55:66:77:88:99:AA:BB:CC:DD:EE:FF:"
+             "00:11:22:33:44:55:66:77:88:99:AA:BB:CC:DD:EE:FF\r\na=setup:actpass\r\n",
+             g_session & 0xFFFF);
+}
+
+esp_err_t webrtc_client_set_callbacks(webrtc_state_callback_t state_cb, webrtc_audio_callback_t audio_cb,
+                                      webrtc_video_callback_t video_cb, webrtc_data_callback_t data_cb,
+                                      void *user_data)
+{
+    g_state_callback = state_cb;
+    g_user_data = user_data;
+    return ESP_OK;
+}
+
+esp_err_t webrtc_client_set_sdp_callbacks(webrtc_sdp_offer_callback_t sdp_offer_cb,
+                                          webrtc_ice_candidate_callback_t ice_candidate_cb, void *user_data)
+{
+    g_sdp_offer_callback = sdp_offer_cb;
+    g_ice_candidate_callback = ice_candidate_cb;
+    g_sdp_user_data = user_data;
+    return ESP_OK;
+}
+
+// 开始一次新会话：与固件相同，先通知信令清空上次会话，再交出候选和Offer
+esp_err_t webrtc_client_start(void)
+{
+    g_session++;
+    g_remote_sdp[0] = '\0';
+    webrtc_signaling_reset_session();
+    set_state(WEBRTC_CLIENT_STATE_PEER_CREATED);
+
+    for (int i = 0; i < HOST_CANDIDATE_COUNT && g_ice_candidate_callback; i++) {
+        char candidate[96];
+        snprintf(candidate, sizeof(candidate), "candidate:%d 1 UDP %d 127.0.0.1 %d typ host",
+                 i + 1, 2122252543 - i, 50000 + i);
+        g_ice_candidate_callback(candidate, g_sdp_user_data);
+    }
+    build_offer();
+    set_state(WEBRTC_CLIENT_STATE_OFFER_CREATED);
+    if (g_sdp_offer_callback) {
+        g_sdp_offer_callback(g_local_sdp, g_sdp_user_data);
+    }
+    ESP_LOGI(TAG, "会话%" PRIu32 "已发出Offer（%d字节）", g_session, (int)strlen(g_local_sdp));
+    return ESP_OK;
+}
+
+esp_err_t webrtc_client_stop(void)
+{
+    set_state(WEBRTC_CLIENT_STATE_IDLE);
+    return ESP_OK;
+}
+
+esp_err_t webrtc_client_restart(void)
+{
+    return webrtc_client_start();
+}
+
+esp_err_t webrtc_client_set_answer(const char *answer_sdp)
+{
+    if (!answer_sdp) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    snprintf(g_remote_sdp, sizeof(g_remote_sdp), "%s", answer_sdp);
+    set_state(WEBRTC_CLIENT_STATE_ANSWER_RECEIVED);
+    // 没有ICE和DTLS，收到Answer即视为连接建立
+    set_state(WEBRTC_CLIENT_STATE_CONNECTED);
+    return ESP_OK;
+}
+
+esp_err_t webrtc_client_add_ice_candidate(const char *candidate)
+{
+    return candidate ? ESP_OK : ESP_ERR_INVALID_ARG;
+}
+
+webrtc_client_state_t webrtc_client_get_state(void)
+{
+    return g_state;
+}
+
+const char* webrtc_client_get_local_sdp(void)
+{
+    return g_local_sdp;
+}
+
+const char* webrtc_client_get_remote_sdp(void)
+{
+    return g_remote_sdp;
+}
@@ -0,0 +1,864 @@
+#include "webrtc_data_channel.hpp"
+
+#include <string.h>
+#include <inttypes.h>
+#include "esp_log.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/ringbuf.h"
+#include "heap_monitor.hpp"
+
+/*
+ * 多数据通道与发送缓冲
+ *
+ * 每个通道一个不分割环形缓冲区，发送方只做拷贝（或只放入引用）不阻塞。
+ * Peer任务在每次esp_peer_main_loop之后按优先级从高到低取出消息，
+ * 每轮最多发送CONFIG_WEBRTC_DATA_CHANNEL_FLUSH_BYTES字节；esp_peer拒绝发送时保留该条
+ * 等下一轮，避免Wi-Fi受阻时继续向SCTP灌数据。
+ * 启用发送调度（egress_scheduler）时由调度器经webrtc_data_channel_flush_budget按令牌给出预算。
+ *
+ * 分帧通道的消息按CONFIG_WEBRTC_DATA_CHANNEL_FRAGMENT_SIZE切片，每片加12字节头，
+ * 在发送时才组帧，缓冲区中只保存原消息。接收端按偏移直接写入池缓冲区，收齐后整体交付一次；
+ * 单片消息直接从esp_peer的缓冲区交付，不拷贝。
+ * 分片来自对端，不可信：总长度须与重组中的消息一致，偏移和长度须落在总长度内；
+ * 按已收到的区间判断是否收齐，重复分片不会让有空洞的消息被交付。
+ */
+
+static const char *TAG = "webrtc_dc";
+
+#define LABEL_LEN 32
+
+// 缓冲区条目头，后接消息内容或消息引用
+typedef struct {
+    uint8_t type;                           // esp_peer_data_channel_type_t
+    uint8_t by_ref;
+    uint16_t msg_id;
+} item_head_t;
+
+typedef struct {
+    const uint8_t *data;
+    size_t size;
+    webrtc_data_channel_done_cb_t done_cb;
+    void *user_data;
+} item_ref_t;
+
+// 已收到的字节区间[start, end)
+typedef struct {
+    uint32_t start;
+    uint32_t end;
+} rx_range_t;
+
+// 不连续区间的上限，乱序或丢片过多时放弃该消息
+#define RX_MAX_RANGES 8
+
+// 正在重组的消息
+typedef struct {
+    uint8_t *buffer;                        // 池缓冲区，NULL表示空闲
+    uint16_t msg_id;
+    uint32_t total;
+    rx_range_t ranges[RX_MAX_RANGES];       // 按起点排序，互不重叠也不相邻
+    int range_count;
+    bool text;
+} reassembly_t;
+
+typedef struct {
+    bool open;
+    bool above_low_water;
+    char label[LABEL_LEN];
+    webrtc_data_channel_config_t config;
+    uint16_t stream_id;
+    uint16_t next_msg_id;
+    RingbufHandle_t ring;
+    // 以下仅Peer任务访问
+    uint8_t *pending;                       // 已取出但未发完的条目
+    size_t pending_size;
+    uint32_t pending_offset;                // 分帧发送进度
+    reassembly_t rx;
+    int32_t rx_skip_id;                     // 超长被丢弃的消息ID，其后续分片直接忽略
+    webrtc_data_channel_low_water_cb_t low_water_cb;
+    void *user_data;
+    webrtc_data_channel_message_cb_t message_cb;
+    void *message_user_data;
+    webrtc_data_channel_stats_t stats;
+} channel_t;
+
+static channel_t g_channels[WEBRTC_DATA_CHANNEL_MAX];
+static int g_order[WEBRTC_DATA_CHANNEL_MAX];    // 按优先级排序的通道号
+static int g_channel_count = 0;
+static portMUX_TYPE g_lock = portMUX_INITIALIZER_UNLOCKED;
+
+// 重组缓冲池，首个分帧通道注册时一次性分配
+static uint8_t *g_pool[CONFIG_WEBRTC_DATA_CHANNEL_POOL_BUFFERS];
+static bool g_pool_busy[CONFIG_WEBRTC_DATA_CHANNEL_POOL_BUFFERS];
+static bool g_pool_ready = false;
+
+// 组帧暂存，仅Peer任务使用
+static uint8_t g_frame[WEBRTC_DATA_CHANNEL_FRAME_HEADER + CONFIG_WEBRTC_DATA_CHANNEL_FRAGMENT_SIZE];
+
+static channel_t *get_channel(int channel)
+{
+    if (channel < 0 || channel >= g_channel_count) {
+        return NULL;
+    }
+    return &g_channels[channel];
+}
+
+static esp_err_t pool_init(void)
+{
+    if (g_pool_ready) {
+        return ESP_OK;
+    }
+    for (int i = 0; i < CONFIG_WEBRTC_DATA_CHANNEL_POOL_BUFFERS; i++) {
+        g_pool[i] = static_cast<uint8_t*>(HEAP_MALLOC(HEAP_COMP_WEBRTC, CONFIG_WEBRTC_DATA_CHANNEL_MAX_MESSAGE));
+        if (!g_pool[i]) {
+            ESP_LOGE(TAG, "重组缓冲池分配失败");
+            return ESP_ERR_NO_MEM;
+        }
+    }
+    g_pool_ready = true;
+    return ESP_OK;
+}
+
+static uint8_t *pool_get(void)
+{
+    for (int i = 0; i < CONFIG_WEBRTC_DATA_CHANNEL_POOL_BUFFERS; i++) {
+        if (!g_pool_busy[i]) {
+            g_pool_busy[i] = true;
+            return g_pool[i];
+        }
+    }
+    return NULL;
+}
+
+static void pool_put(uint8_t *buffer)
+{
+    for (int i = 0; i < CONFIG_WEBRTC_DATA_CHANNEL_POOL_BUFFERS; i++) {
+        if (g_pool[i] == buffer) {
+            g_pool_busy[i] = false;
+            return;
+        }
+    }
+}
+
+int webrtc_data_channel_create(const webrtc_data_channel_config_t *config,
+                               webrtc_data_channel_low_water_cb_t low_water_cb, void *user_data)
+{
+    if (!config || !config->label || g_channel_count >= WEBRTC_DATA_CHANNEL_MAX) {
+        return -1;
+    }
+    if (config->framed && pool_init() != ESP_OK) {
+        return -1;
+    }
+    int id = g_channel_count;
+    channel_t *ch = &g_channels[id];
+    memset(ch, 0, sizeof(*ch));
+    strncpy(ch->label, config->label, LABEL_LEN - 1);
+    ch->config = *config;
+    ch->config.label = ch->label;
+    if (ch->config.buffer_size == 0) {
+        ch->config.buffer_size = CONFIG_WEBRTC_DATA_CHANNEL_BUFFER_SIZE;
+    }
+    if (ch->config.low_water_mark == 0 || ch->config.low_water_mark >= ch->config.buffer_size) {
+        ch->config.low_water_mark = ch->config.buffer_size / 4;
+    }
+    ch->ring = xRingbufferCreate(ch->config.buffer_size, RINGBUF_TYPE_NOSPLIT);
+    if (!ch->ring) {
+        ESP_LOGE(TAG, "通道%s缓冲区分配失败", ch->label);
+        return -1;
+    }
+    ch->rx_skip_id = -1;
+    ch->low_water_cb = low_water_cb;
+    ch->user_data = user_data;
+
+    // 插入排序，优先级相同时保持注册顺序
+    int pos = g_channel_count;
+    while (pos > 0 && g_channels[g_order[pos - 1]].config.priority > config->priority) {
+        g_order[pos] = g_order[pos - 1];
+        pos--;
+    }
+    g_order[pos] = id;
+    g_channel_count++;
+
+    ESP_LOGI(TAG, "注册数据通道%d: %s %s%s 优先级%u 缓冲%" PRIu32 "字节", id, ch->label,
+             config->reliable ? "可靠有序" : "不可靠无序", config->framed ? " 分帧" : "",
+             config->priority, ch->config.buffer_size);
+    return id;
+}
+
+esp_err_t webrtc_data_channel_set_message_callback(int channel, webrtc_data_channel_message_cb_t cb, void *user_data)
+{
+    channel_t *ch = get_channel(channel);
+    if (!ch) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    ch->message_cb = cb;
+    ch->message_user_data = user_data;
+    return ESP_OK;
+}
+
+// 解析条目：返回消息内容和长度；引用按字节拷出，条目内不保证指针对齐
+static const uint8_t *item_payload(const uint8_t *item, size_t item_size, size_t *size, item_ref_t *ref)
+{
+    const item_head_t *head = reinterpret_cast<const item_head_t*>(item);
+    if (head->by_ref) {
+        memcpy(ref, item + sizeof(item_head_t), sizeof(*ref));
+        *size = ref->size;
+        return ref->data;
+    }
+    memset(ref, 0, sizeof(*ref));
+    *size = item_size - sizeof(item_head_t);
+    return item + sizeof(item_head_t);
+}
+
+// 释放条目；unsent为尚未交给esp_peer的字节数
+static void release_item(channel_t *ch, uint8_t *item, size_t item_size, uint32_t unsent, bool dropped)
+{
+    size_t size;
+    item_ref_t ref;
+    item_payload(item, item_size, &size, &ref);
+    vRingbufferReturnItem(ch->ring, item);
+
+    portENTER_CRITICAL(&g_lock);
+    ch->stats.buffered -= unsent;
+    if (dropped) {
+        ch->stats.dropped++;
+    } else {
+        ch->stats.sent_messages++;
+    }
+    portEXIT_CRITICAL(&g_lock);
+    if (ref.done_cb) {
+        ref.done_cb(ref.data, ref.user_data);
+    }
+}
+
+// 丢弃缓冲区中最旧的一条，用于不可靠通道腾出空间
+static bool drop_oldest(channel_t *ch)
+{
+    size_t item_size = 0;
+    uint8_t *item = static_cast<uint8_t*>(xRingbufferReceive(ch->ring, &item_size, 0));
+    if (!item) {
+        return false;
+    }
+    size_t size;
+    item_ref_t ref;
+    item_payload(item, item_size, &size, &ref);
+    release_item(ch, item, item_size, size, true);
+    return true;
+}
+
+static int enqueue(channel_t *ch, const void *data, size_t size, bool text,
+                   webrtc_data_channel_done_cb_t done_cb, void *user_data)
+{
+    bool by_ref = done_cb != NULL;
+    size_t item_size = sizeof(item_head_t) + (by_ref ? sizeof(item_ref_t) : size);
+    if (size == 0 || item_size > xRingbufferGetMaxItemSize(ch->ring) ||
+        (ch->config.framed && size > CONFIG_WEBRTC_DATA_CHANNEL_MAX_MESSAGE)) {
+        return -1;
+    }
+
+    void *item = NULL;
+    while (xRingbufferSendAcquire(ch->ring, &item, item_size, 0) != pdTRUE) {
+        if (ch->config.reliable || !drop_oldest(ch)) {
+            portENTER_CRITICAL(&g_lock);
+            ch->stats.rejected++;
+            portEXIT_CRITICAL(&g_lock);
+            return -1;
+        }
+    }
+    item_head_t *head = static_cast<item_head_t*>(item);
+    head->type = text ? ESP_PEER_DATA_CHANNEL_STRING : ESP_PEER_DATA_CHANNEL_DATA;
+    head->by_ref = by_ref;
+    uint8_t *body = static_cast<uint8_t*>(item) + sizeof(item_head_t);
+    if (by_ref) {
+        item_ref_t ref = { static_cast<const uint8_t*>(data), size, done_cb, user_data };
+        memcpy(body, &ref, sizeof(ref));
+    } else {
+        memcpy(body, data, size);
+    }
+
+    portENTER_CRITICAL(&g_lock);
+    head->msg_id = ch->next_msg_id++;
+    ch->stats.buffered += size;
+    if (ch->stats.buffered > ch->stats.buffered_high_water) {
+        ch->stats.buffered_high_water = ch->stats.buffered;
+    }
+    if (ch->stats.buffered > ch->config.low_water_mark) {
+        ch->above_low_water = true;
+    }
+    uint32_t buffered = ch->stats.buffered;
+    portEXIT_CRITICAL(&g_lock);
+    xRingbufferSendComplete(ch->ring, item);
+    return buffered;
+}
+
+int webrtc_data_channel_send(int channel, const void *data, size_t size, bool text)
+{
+    channel_t *ch = get_channel(channel);
+    if (!ch || !data) {
+        return -1;
+    }
+    return enqueue(ch, data, size, text, NULL, NULL);
+}
+
+int webrtc_data_channel_send_ref(int channel, const void *data, size_t size, bool text,
+                                 webrtc_data_channel_done_cb_t done_cb, void *user_data)
+{
+    channel_t *ch = get_channel(channel);
+    if (!ch || !data || !done_cb || !ch->config.framed) {
+        return -1;
+    }
+    return enqueue(ch, data, size, text, done_cb, user_data);
+}
+
+uint32_t webrtc_data_channel_buffered_amount(int channel)
+{
+    channel_t *ch = get_channel(channel);
+    if (!ch) {
+        return 0;
+    }
+    portENTER_CRITICAL(&g_lock);
+    uint32_t buffered = ch->stats.buffered;
+    portEXIT_CRITICAL(&g_lock);
+    return buffered;
+}
+
+bool webrtc_data_channel_is_open(int channel)
+{
+    channel_t *ch = get_channel(channel);
+    return ch && ch->open;
+}
+
+esp_err_t webrtc_data_channel_get_stats(int channel, webrtc_data_channel_stats_t *stats)
+{
+    channel_t *ch = get_channel(channel);
+    if (!ch || !stats) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    portENTER_CRITICAL(&g_lock);
+    *stats = ch->stats;
+    portEXIT_CRITICAL(&g_lock);
+    stats->open = ch->open;
+    return ESP_OK;
+}
+
+bool webrtc_data_channel_manual(void)
+{
+    return g_channel_count > 0;
+}
+
+void webrtc_data_channel_on_connected(esp_peer_handle_t peer)
+{
+    for (int i = 0; i < g_channel_count; i++) {
+        channel_t *ch = &g_channels[i];
+        esp_peer_data_channel_cfg_t cfg = {};
+        cfg.label = ch->label;
+        if (ch->config.reliable) {
+            cfg.type = ESP_PEER_DATA_CHANNEL_RELIABLE;
+            cfg.ordered = true;
+        } else {
+            cfg.type = ESP_PEER_DATA_CHANNEL_PARTIAL_RELIABLE_RETX;
+            cfg.ordered = false;
+            cfg.max_retransmit_count = 0;
+        }
+        int ret = esp_peer_create_data_channel(peer, &cfg);
+        if (ret != 0) {
+            ESP_LOGE(TAG, "创建数据通道%s失败: %d", ch->label, ret);
+        }
+    }
+}
+
+static void reassembly_reset(channel_t *ch, bool dropped)
+{
+    if (!ch->rx.buffer) {
+        return;
+    }
+    pool_put(ch->rx.buffer);
+    ch->rx.buffer = NULL;
+    if (dropped) {
+        ch->stats.reassembly_dropped++;
+    }
+}
+
+void webrtc_data_channel_on_disconnected(void)
+{
+    for (int i = 0; i < g_channel_count; i++) {
+        channel_t *ch = &g_channels[i];
+        ch->open = false;
+        reassembly_reset(ch, true);
+        if (ch->config.reliable) {
+            continue;
+        }
+        // 不可靠通道的积压消息已过时，断开时清空
+        if (ch->pending) {
+            size_t size;
+            item_ref_t ref;
+            item_payload(ch->pending, ch->pending_size, &size, &ref);
+            release_item(ch, ch->pending, ch->pending_size, size - ch->pending_offset, true);
+            ch->pending = NULL;
+        }
+        while (drop_oldest(ch)) {
+        }
+    }
+}
+
+void webrtc_data_channel_on_open(const esp_peer_data_channel_info_t *info)
+{
+    for (int i = 0; i < g_channel_count; i++) {
+        if (info->label && strcmp(g_channels[i].label, info->label) == 0) {
+            g_channels[i].stream_id = info->stream_id;
+            g_channels[i].open = true;
+            ESP_LOGI(TAG, "数据通道%s已打开，流ID %u", g_channels[i].label, info->stream_id);
+            return;
+        }
+    }
+}
+
+void webrtc_data_channel_on_close(const esp_peer_data_channel_info_t *info)
+{
+    int id = webrtc_data_channel_find(info->stream_id);
+    if (id >= 0) {
+        g_channels[id].open = false;
+        reassembly_reset(&g_channels[id], true);
+        ESP_LOGI(TAG, "数据通道%s已关闭", g_channels[id].label);
+    }
+}
+
+int webrtc_data_channel_find(uint16_t stream_id)
+{
+    for (int i = 0; i < g_channel_count; i++) {
+        if (g_channels[i].open && g_channels[i].stream_id == stream_id) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+static void put_u16(uint8_t *p, uint16_t v)
+{
+    p[0] = v >> 8;
+    p[1] = v;
+}
+
+static void put_u32(uint8_t *p, uint32_t v)
+{
+    p[0] = v >> 24;
+    p[1] = v >> 16;
+    p[2] = v >> 8;
+    p[3] = v;
+}
+
+static uint32_t get_u32(const uint8_t *p)
+{
+    return (uint32_t)p[0] << 24 | (uint32_t)p[1] << 16 | (uint32_t)p[2] << 8 | p[3];
+}
+
+/**
+ * @brief 发送当前条目的剩余部分
+ *
+ * @return 已交给esp_peer的字节数；*stalled为true表示esp_peer拒绝发送
+ */
+static int send_pending(esp_peer_handle_t peer, channel_t *ch, int budget, bool *stalled)
+{
+    const item_head_t *head = reinterpret_cast<const item_head_t*>(ch->pending);
+    size_t size;
+    item_ref_t ref;
+    const uint8_t *payload = item_payload(ch->pending, ch->pending_size, &size, &ref);
+
+    esp_peer_data_frame_t frame = {};
+    frame.type = static_cast<esp_peer_data_channel_type_t>(head->type);
+    frame.stream_id = ch->stream_id;
+
+    if (!ch->config.framed) {
+        frame.data = const_cast<uint8_t*>(payload);
+        frame.size = size;
+        if (esp_peer_send_data(peer, &frame) != 0) {
+            *stalled = true;
+            return 0;
+        }
+        ch->pending_offset = size;
+        return size;
+    }
+
+    int sent = 0;
+    while (ch->pending_offset < size && sent < budget) {
+        uint32_t chunk = size - ch->pending_offset;
+        if (chunk > CONFIG_WEBRTC_DATA_CHANNEL_FRAGMENT_SIZE) {
+            chunk = CONFIG_WEBRTC_DATA_CHANNEL_FRAGMENT_SIZE;
+        }
+        uint8_t flags = 0;
+        flags |= ch->pending_offset == 0 ? WEBRTC_DATA_CHANNEL_FRAME_FIRST : 0;
+        flags |= ch->pending_offset + chunk == size ? WEBRTC_DATA_CHANNEL_FRAME_LAST : 0;
+        flags |= head->type == ESP_PEER_DATA_CHANNEL_STRING ? WEBRTC_DATA_CHANNEL_FRAME_TEXT : 0;
+        g_frame[0] = WEBRTC_DATA_CHANNEL_FRAME_MAGIC;
+        g_frame[1] = flags;
+        put_u16(g_frame + 2, head->msg_id);
+        put_u32(g_frame + 4, ch->pending_offset);
+        put_u32(g_frame + 8, size);
+        memcpy(g_frame + WEBRTC_DATA_CHANNEL_FRAME_HEADER, payload + ch->pending_offset, chunk);
+
+        // 分片一律按二进制发送，文本标志在帧头中
+        frame.type = ESP_PEER_DATA_CHANNEL_DATA;
+        frame.data = g_frame;
+        frame.size = WEBRTC_DATA_CHANNEL_FRAME_HEADER + chunk;
+        if (esp_peer_send_data(peer, &frame) != 0) {
+            *stalled = true;
+            break;
+        }
+        ch->pending_offset += chunk;
+        sent += chunk;
+        ch->stats.fragments_sent++;
+    }
+    return sent;
+}
+
+void webrtc_data_channel_flush(esp_peer_handle_t peer)
+{
+    bool stalled = false;
+    webrtc_data_channel_flush_budget(peer, CONFIG_WEBRTC_DATA_CHANNEL_FLUSH_BYTES, &stalled);
+}
+
+int webrtc_data_channel_flush_budget(esp_peer_handle_t peer, int budget, bool *stalled_out)
+{
+    int total = budget;
+    bool stalled = false;
+
+    for (int n = 0; n < g_channel_count && !stalled; n++) {
+        int id = g_order[n];
+        channel_t *ch = &g_channels[id];
+        if (!ch->open) {
+            continue;
+        }
+        while (budget > 0 && !stalled) {
+            if (!ch->pending) {
+                ch->pending = static_cast<uint8_t*>(xRingbufferReceive(ch->ring, &ch->pending_size, 0));
+                ch->pending_offset = 0;
+                if (!ch->pending) {
+                    break;
+                }
+            }
+            uint32_t before = ch->pending_offset;
+            int sent = send_pending(peer, ch, budget, &stalled);
+            budget -= sent;
+            portENTER_CRITICAL(&g_lock);
+            ch->stats.buffered -= ch->pending_offset - before;
+            ch->stats.sent_bytes += ch->pending_offset - before;
+            portEXIT_CRITICAL(&g_lock);
+
+            size_t size;
+            item_ref_t ref;
+            item_payload(ch->pending, ch->pending_size, &size, &ref);
+            if (ch->pending_offset == size) {
+                release_item(ch, ch->pending, ch->pending_size, 0, false);
+                ch->pending = NULL;
+            }
+        }
+        if (stalled) {
+            // SCTP发送缓冲已满，本轮不再发送任何通道
+            portENTER_CRITICAL(&g_lock);
+            ch->stats.send_stalls++;
+            portEXIT_CRITICAL(&g_lock);
+        }
+
+        portENTER_CRITICAL(&g_lock);
+        bool notify = ch->above_low_water && ch->stats.buffered <= ch->config.low_water_mark;
+        if (notify) {
+            ch->above_low_water = false;
+        }
+        uint32_t buffered = ch->stats.buffered;
+        portEXIT_CRITICAL(&g_lock);
+        if (notify && ch->low_water_cb) {
+            ch->low_water_cb(id, buffered, ch->user_data);
+        }
+    }
+    if (stalled_out) {
+        *stalled_out = stalled;
+    }
+    return total - budget;
+}
+
+uint32_t webrtc_data_channel_total_buffered(void)
+{
+    uint32_t total = 0;
+    portENTER_CRITICAL(&g_lock);
+    for (int id = 0; id < g_channel_count; id++) {
+        if (g_channels[id].open) {
+            total += g_channels[id].stats.buffered;
+        }
+    }
+    portEXIT_CRITICAL(&g_lock);
+    return total;
+}
+
+static void deliver(channel_t *ch, int id, const uint8_t *data, size_t size, bool text)
+{
+    ch->stats.received_messages++;
+    if (ch->message_cb) {
+        ch->message_cb(id, data, size, text, ch->message_user_data);
+    }
+}
+
+/**
+ * @brief 记录收到的区间[start, end)，与重叠或相邻的区间合并
+ *
+ * @return 不连续区间超过RX_MAX_RANGES时返回false
+ */
+static bool rx_add_range(reassembly_t *rx, uint32_t start, uint32_t end)
+{
+    int first = 0;
+    while (first < rx->range_count && rx->ranges[first].end < start) {
+        first++;
+    }
+    int last = first;
+    while (last < rx->range_count && rx->ranges[last].start <= end) {
+        if (rx->ranges[last].start < start) {
+            start = rx->ranges[last].start;
+        }
+        if (rx->ranges[last].end > end) {
+            end = rx->ranges[last].end;
+        }
+        last++;
+    }
+    int merged = last - first;
+    if (merged == 0) {
+        if (rx->range_count == RX_MAX_RANGES) {
+            return false;
+        }
+        memmove(&rx->ranges[first + 1], &rx->ranges[first], (rx->range_count - first) * sizeof(rx_range_t));
+        rx->range_count++;
+    } else if (merged > 1) {
+        memmove(&rx->ranges[first + 1], &rx->ranges[last], (rx->range_count - last) * sizeof(rx_range_t));
+        rx->range_count -= merged - 1;
+    }
+    rx->ranges[first].start = start;
+    rx->ranges[first].end = end;
+    return true;
+}
+
+// 分帧通道收到一个分片
+static void on_fragment(channel_t *ch, int id, const uint8_t *data, size_t size)
+{
+    if (size < WEBRTC_DATA_CHANNEL_FRAME_HEADER || data[0] != WEBRTC_DATA_CHANNEL_FRAME_MAGIC) {
+        ch->stats.bad_frames++;
+        return;
+    }
+    uint8_t flags = data[1];
+    uint16_t msg_id = (uint16_t)(data[2] << 8 | data[3]);
+    uint32_t offset = get_u32(data + 4);
+    uint32_t total = get_u32(data + 8);
+    const uint8_t *payload = data + WEBRTC_DATA_CHANNEL_FRAME_HEADER;
+    uint32_t len = size - WEBRTC_DATA_CHANNEL_FRAME_HEADER;
+    bool text = flags & WEBRTC_DATA_CHANNEL_FRAME_TEXT;
+
+    // 不用offset + len，避免uint32回绕
+    if (offset > total || len > total - offset) {
+        ch->stats.bad_frames++;
+        return;
+    }
+    // 单片消息直接交付，不经过缓冲池
+    if (offset == 0 && len == total) {
+        deliver(ch, id, payload, len, text);
+        return;
+    }
+    if (ch->rx_skip_id == msg_id) {
+        return;
+    }
+    if (!ch->rx.buffer || ch->rx.msg_id != msg_id) {
+        // 新消息开始时上一条仍未收齐（不可靠通道丢片），放弃上一条
+        reassembly_reset(ch, true);
+        if (total > CONFIG_WEBRTC_DATA_CHANNEL_MAX_MESSAGE) {
+            ESP_LOGW(TAG, "通道%s消息%" PRIu32 "字节超过上限", ch->label, total);
+            ch->rx_skip_id = msg_id;
+            ch->stats.reassembly_dropped++;
+            return;
+        }
+        ch->rx.buffer = pool_get();
+        if (!ch->rx.buffer) {
+            ch->rx_skip_id = msg_id;
+            ch->stats.reassembly_dropped++;
+            return;
+        }
+        ch->rx.msg_id = msg_id;
+        ch->rx.total = total;
+        ch->rx.range_count = 0;
+        ch->rx.text = text;
+    } else if (total != ch->rx.total) {
+        // 同一消息的总长度变化，分片不可信，放弃整条消息
+        ch->stats.bad_frames++;
+        reassembly_reset(ch, true);
+        ch->rx_skip_id = msg_id;
+        return;
+    }
+    if (len == 0) {
+        return;
+    }
+    // 此时total == rx.total <= MAX_MESSAGE，且offset + len <= total
+    if (!rx_add_range(&ch->rx, offset, offset + len)) {
+        reassembly_reset(ch, true);
+        ch->rx_skip_id = msg_id;
+        return;
+    }
+    memcpy(ch->rx.buffer + offset, payload, len);
+    if (ch->rx.range_count == 1 && ch->rx.ranges[0].start == 0 && ch->rx.ranges[0].end == ch->rx.total) {
+        ch->stats.reassembled_messages++;
+        deliver(ch, id, ch->rx.buffer, ch->rx.total, ch->rx.text);
+        reassembly_reset(ch, false);
+    }
+}
+
+bool webrtc_data_channel_on_data(const esp_peer_data_frame_t *frame)
+{
+    int id = webrtc_data_channel_find(frame->stream_id);
+    if (id < 0) {
+        return false;
+    }
+    channel_t *ch = &g_channels[id];
+    if (ch->config.framed) {
+        on_fragment(ch, id, frame->data, frame->size);
+        return true;
+    }
+    if (!ch->message_cb) {
+        return false;
+    }
+    deliver(ch, id, frame->data, frame->size, frame->type == ESP_PEER_DATA_CHANNEL_STRING);
+    return true;
+}
+
+#if CONFIG_WEBRTC_DATA_CHANNEL_SELF_TEST
+
+/*
+ * 分片重组自检：在一个不注册的本地通道上喂入构造的分片，检查越界、总长度变化、
+ * 偏移回绕、重复分片和空洞都不会写出缓冲区或交付不完整的消息
+ */
+
+#define SELF_TEST_FRAGMENT 64
+
+typedef struct {
+    int delivered;
+    size_t size;
+    bool content_ok;
+} self_test_result_t;
+
+static void self_test_on_message(int channel, const uint8_t *data, size_t size, bool text, void *user_data)
+{
+    self_test_result_t *result = static_cast<self_test_result_t*>(user_data);
+    result->delivered++;
+    result->size = size;
+    result->content_ok = true;
+    for (size_t i = 0; i < size; i++) {
+        if (data[i] != (uint8_t)i) {
+            result->content_ok = false;
+            break;
+        }
+    }
+}
+
+// 构造一片：内容为消息中的字节序号，便于检查重组结果
+static void self_test_feed(channel_t *ch, uint16_t msg_id, uint32_t offset, uint32_t len, uint32_t total)
+{
+    uint8_t frame[WEBRTC_DATA_CHANNEL_FRAME_HEADER + SELF_TEST_FRAGMENT];
+    frame[0] = WEBRTC_DATA_CHANNEL_FRAME_MAGIC;
+    frame[1] = 0;
+    put_u16(frame + 2, msg_id);
+    put_u32(frame + 4, offset);
+    put_u32(frame + 8, total);
+    for (uint32_t i = 0; i < len; i++) {
+        frame[WEBRTC_DATA_CHANNEL_FRAME_HEADER + i] = (uint8_t)(offset + i);
+    }
+    on_fragment(ch, 0, frame, WEBRTC_DATA_CHANNEL_FRAME_HEADER + len);
+}
+
+int webrtc_data_channel_self_test(void)
+{
+    if (pool_init() != ESP_OK) {
+        return -1;
+    }
+    channel_t *ch = static_cast<channel_t*>(HEAP_MALLOC(HEAP_COMP_WEBRTC, sizeof(channel_t)));
+    if (!ch) {
+        return -1;
+    }
+    const uint32_t F = SELF_TEST_FRAGMENT;
+    int passed = 0;
+    int cases = 0;
+    self_test_result_t result;
+
+#define SELF_TEST_CASE(name, expect_delivered, expect_bad)                                          \
+    do {                                                                                            \
+        cases++;                                                                                    \
+        bool ok = result.delivered == (expect_delivered) && ch->stats.bad_frames == (expect_bad) && \
+                  (result.delivered == 0 || result.content_ok);                                     \
+        passed += ok;                                                                               \
+        if (!ok) {                                                                                  \
+            ESP_LOGE(TAG, "分片自检失败: %s (交付%d 坏帧%" PRIu32 ")", name, result.delivered,        \
+                     ch->stats.bad_frames);                                                         \
+        }                                                                                           \
+    } while (0)
+
+#define SELF_TEST_RESET()                                                                           \
+    do {                                                                                            \
+        reassembly_reset(ch, false);                                                                \
+        memset(ch, 0, sizeof(*ch));                                                                 \
+        ch->rx_skip_id = -1;                                                                        \
+        ch->message_cb = self_test_on_message;                                                      \
+        ch->message_user_data = &result;                                                            \
+        memset(&result, 0, sizeof(result));                                                         \
+    } while (0)
+
+    memset(ch, 0, sizeof(*ch));
+    SELF_TEST_RESET();
+    // 重组中途同一消息ID声明更大的总长度，偏移远超缓冲池
+    self_test_feed(ch, 7, 0, F, 100);
+    self_test_feed(ch, 7, 200000, 10, 1000000);
+    self_test_feed(ch, 7, F, 100 - F, 100);
+    SELF_TEST_CASE("total changed", 0, 1);
+
+    SELF_TEST_RESET();
+    // offset + len回绕到总长度以内
+    self_test_feed(ch, 1, 0xFFFFFFF0u, 32, 100);
+    SELF_TEST_CASE("offset wrap", 0, 1);
+
+    SELF_TEST_RESET();
+    // 同一消息的分片越过总长度
+    self_test_feed(ch, 2, 0, F, 100);
+    self_test_feed(ch, 2, 90, 20, 100);
+    SELF_TEST_CASE("past total", 0, 1);
+
+    SELF_TEST_RESET();
+    // 首片没有越界但总长度超过重组上限
+    self_test_feed(ch, 3, 0, F, CONFIG_WEBRTC_DATA_CHANNEL_MAX_MESSAGE + 1);
+    self_test_feed(ch, 3, CONFIG_WEBRTC_DATA_CHANNEL_MAX_MESSAGE, 1, CONFIG_WEBRTC_DATA_CHANNEL_MAX_MESSAGE + 1);
+    SELF_TEST_CASE("over max message", 0, 0);
+
+    SELF_TEST_RESET();
+    // 重复分片凑够字节数，但中间有空洞
+    self_test_feed(ch, 4, 0, F, 3 * F);
+    self_test_feed(ch, 4, 0, F, 3 * F);
+    self_test_feed(ch, 4, 2 * F, F, 3 * F);
+    SELF_TEST_CASE("duplicate with hole", 0, 0);
+    self_test_feed(ch, 4, F, F, 3 * F);
+    SELF_TEST_CASE("hole filled", 1, 0);
+
+    SELF_TEST_RESET();
+    // 乱序和部分重叠的分片
+    self_test_feed(ch, 5, 2 * F, F, 3 * F);
+    self_test_feed(ch, 5, F / 2, F, 3 * F);
+    self_test_feed(ch, 5, 0, F, 3 * F);
+    self_test_feed(ch, 5, F, F, 3 * F);
+    SELF_TEST_CASE("reordered overlap", 1, 0);
+
+    SELF_TEST_RESET();
+    // 空洞过多时放弃消息
+    for (uint32_t i = 0; i <= RX_MAX_RANGES; i++) {
+        self_test_feed(ch, 6, 2 * i * 8, 8, 2 * (RX_MAX_RANGES + 1) * 8);
+    }
+    self_test_feed(ch, 6, 0, 2 * 8, 2 * (RX_MAX_RANGES + 1) * 8);
+    SELF_TEST_CASE("too many holes", 0, 0);
+
+#undef SELF_TEST_CASE
+#undef SELF_TEST_RESET
+
+    reassembly_reset(ch, false);
+    HEAP_FREE(ch);
+    ESP_LOGI(TAG, "分片自检: %d/%d 通过", passed, cases);
+    return cases - passed;
+}
+
+#endif /* CONFIG_WEBRTC_DATA_CHANNEL_SELF_TEST */
@@ -0,0 +1,127 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include "esp_err.h"
+#include "esp_peer.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define WEBRTC_DATA_CHANNEL_MAX 4
+
+/*
+ * 分帧通道的帧格式（大端）：
+ *   [0]    0xDC
+ *   [1]    标志 bit0首片 bit1末片 bit2文本
+ *   [2-3]  消息ID
+ *   [4-7]  本片在消息中的偏移
+ *   [8-11] 消息总长度
+ *   [12-]  数据
+ * 对端需按同一格式收发，未分帧的通道直接透传。
+ */
+#define WEBRTC_DATA_CHANNEL_FRAME_MAGIC  0xDC
+#define WEBRTC_DATA_CHANNEL_FRAME_HEADER 12
+#define WEBRTC_DATA_CHANNEL_FRAME_FIRST  0x01
+#define WEBRTC_DATA_CHANNEL_FRAME_LAST   0x02
+#define WEBRTC_DATA_CHANNEL_FRAME_TEXT   0x04
+
+// 数据通道配置
+typedef struct {
+    const char *label;                      // 通道标签，对端据此区分通道
+    bool reliable;                          // true: 可靠有序；false: 不可靠无序（不重传）
+    bool framed;                            // 大消息分片发送、接收端重组
+    uint8_t priority;                       // 发送优先级，0最高
+    uint32_t buffer_size;                   // 发送缓冲区字节数，0使用CONFIG_WEBRTC_DATA_CHANNEL_BUFFER_SIZE
+    uint32_t low_water_mark;                // 缓冲量降到该值及以下时回调，0使用buffer_size/4
+} webrtc_data_channel_config_t;
+
+// 数据通道统计
+typedef struct {
+    bool open;
+    uint32_t buffered;                      // 当前缓冲字节数
+    uint32_t buffered_high_water;           // 缓冲字节数峰值
+    uint32_t sent_messages;
+    uint32_t sent_bytes;
+    uint32_t dropped;                       // 不可靠通道缓冲区满时丢弃的最旧消息数
+    uint32_t rejected;                      // 可靠通道缓冲区满时拒绝的消息数
+    uint32_t send_stalls;                   // esp_peer拒绝发送（SCTP拥塞）的次数
+    uint32_t fragments_sent;                // 分帧通道发出的分片数
+    uint32_t received_messages;             // 交付给应用的完整消息数
+    uint32_t reassembled_messages;          // 其中经过重组的消息数
+    uint32_t reassembly_dropped;            // 超长、缓冲池耗尽或丢片而放弃的消息数
+    uint32_t bad_frames;                    // 帧头无效的分片数
+} webrtc_data_channel_stats_t;
+
+// 缓冲量从低水位以上降到低水位时在Peer任务中调用
+typedef void (*webrtc_data_channel_low_water_cb_t)(int channel, uint32_t buffered, void *user_data);
+// 收到完整消息时在Peer任务中调用，data仅在回调期间有效（可能指向重组缓冲池）
+typedef void (*webrtc_data_channel_message_cb_t)(int channel, const uint8_t *data, size_t size, bool text, void *user_data);
+// 引用发送的消息发完或被丢弃后调用，之后调用方才可释放data
+typedef void (*webrtc_data_channel_done_cb_t)(const void *data, void *user_data);
+
+/**
+ * @brief 注册数据通道
+ *
+ * 应在webrtc_client_start之前调用。注册了通道后不再创建默认通道，
+ * SCTP连接建立时按注册顺序创建各通道。
+ * @return 通道号，失败返回-1
+ */
+int webrtc_data_channel_create(const webrtc_data_channel_config_t *config,
+                               webrtc_data_channel_low_water_cb_t low_water_cb, void *user_data);
+
+/**
+ * @brief 非阻塞发送：消息拷贝进通道发送缓冲区，由Peer任务按优先级发出
+ *
+ * 缓冲区满时不可靠通道丢弃最旧的消息，可靠通道拒绝本条消息（等待低水位回调后重试）。
+ * @param text true按字符串消息发送，否则按二进制
+ * @return 加入后的缓冲字节数，失败返回-1
+ */
+int webrtc_data_channel_send(int channel, const void *data, size_t size, bool text);
+
+/**
+ * @brief 非阻塞引用发送（仅分帧通道）：缓冲区只保存引用，发送时直接从data切片
+ *
+ * 用于文件、配置等大消息，避免整条拷贝；data须保持有效直到done_cb被调用。
+ * 不可靠通道因缓冲区满丢弃最旧消息时，done_cb可能在发送方任务中调用。
+ * @return 加入后的缓冲字节数，失败返回-1
+ */
+int webrtc_data_channel_send_ref(int channel, const void *data, size_t size, bool text,
+                                 webrtc_data_channel_done_cb_t done_cb, void *user_data);
+
+// 设置通道消息回调；未设置时未分帧通道的数据仍走webrtc_client的数据回调
+esp_err_t webrtc_data_channel_set_message_callback(int channel, webrtc_data_channel_message_cb_t cb, void *user_data);
+
+uint32_t webrtc_data_channel_buffered_amount(int channel);
+bool webrtc_data_channel_is_open(int channel);
+esp_err_t webrtc_data_channel_get_stats(int channel, webrtc_data_channel_stats_t *stats);
+
+// 以下由webrtc_client在Peer任务中调用
+bool webrtc_data_channel_manual(void);
+void webrtc_data_channel_on_connected(esp_peer_handle_t peer);
+void webrtc_data_channel_on_disconnected(void);
+void webrtc_data_channel_on_open(const esp_peer_data_channel_info_t *info);
+void webrtc_data_channel_on_close(const esp_peer_data_channel_info_t *info);
+int webrtc_data_channel_find(uint16_t stream_id);
+// 已处理返回true，否则交给默认数据回调
+bool webrtc_data_channel_on_data(const esp_peer_data_frame_t *frame);
+void webrtc_data_channel_flush(esp_peer_handle_t peer);
+// 按给定预算发送，返回发出的字节数；*stalled为true表示esp_peer拒绝发送（供发送调度使用）
+int webrtc_data_channel_flush_budget(esp_peer_handle_t peer, int budget, bool *stalled);
+// 所有已打开通道的待发送字节数
+uint32_t webrtc_data_channel_total_buffered(void);
+
+#if CONFIG_WEBRTC_DATA_CHANNEL_SELF_TEST
+/**
+ * @brief 分片重组自检：喂入越界、回绕、总长度变化、重复和有空洞的分片
+ *
+ * @return 失败的用例数，初始化失败返回-1
+ */
+int webrtc_data_channel_self_test(void);
+#endif
+
+#ifdef __cplusplus
+}
+#endif
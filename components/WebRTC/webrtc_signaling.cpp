@@ -0,0 +1,436 @@
+#include "webrtc_signaling.hpp"
+#include "signaling_codec.hpp"
+
+#include <string.h>
+#include <stdlib.h>
+#include "esp_timer.h"
+#include "freertos/semphr.h"
+#include "cJSON.h"
+
+// 日志标签
+static const char *TAG = "WebRTC_Signaling";
+
+// 单批候选的最大容量
+#define ICE_BATCH_CAPACITY 16
+#define ICE_CANDIDATE_MAX_LEN 256
+
+// 信令上下文
+static webrtc_signaling_config_t g_config;
+static webrtc_signaling_stats_t g_stats;
+static SemaphoreHandle_t g_lock = NULL;
+static esp_timer_handle_t g_batch_timer = NULL;
+static bool g_offer_sent = false;
+static signaling_codec_t g_codec = SIGNALING_CODEC_JSON;
+
+// 待发送的本地ICE候选
+static char g_batch[ICE_BATCH_CAPACITY][ICE_CANDIDATE_MAX_LEN];
+static int g_batch_count = 0;
+
+/**
+ * @brief 发布一条信令消息
+ *
+ * 使用enqueue而不是publish，消息由MQTT任务发送，不阻塞esp_peer主循环和定时器任务
+ *
+ * @param utf8 JSON消息为true，紧凑格式为二进制帧
+ */
+static int publish_payload(const char *payload, int len, const char *msg_type, bool utf8)
+{
+    if (!payload) {
+        return -1;
+    }
+    const char *topic = g_config.publish_topic ? g_config.publish_topic : MQTT_PUBLISH_TOPIC;
+    int msg_id = mqtt_client_enqueue(topic, payload, len, g_config.qos, msg_type, utf8);
+    if (msg_id >= 0) {
+        g_stats.bytes_sent += len;
+    }
+    return msg_id;
+}
+
+static int publish_signaling(cJSON *json, const char *msg_type)
+{
+    char *payload = HEAP_JSON_PRINT(HEAP_COMP_SIGNALING, json);
+    if (!payload) {
+        return -1;
+    }
+    int msg_id = publish_payload(payload, strlen(payload), msg_type, true);
+    HEAP_JSON_FREE(HEAP_COMP_SIGNALING, payload);
+    return msg_id;
+}
+
+#if CONFIG_WEBRTC_SIGNALING_COMPACT_CODEC
+// 以紧凑格式发布若干文本项，缓冲区按文本总长估算（编码结果不会超过原文长度加转义开销）
+static int publish_compact(signaling_msg_type_t type, const char *const *texts, int count)
+{
+    size_t cap = 32 + strlen(mqtt_client_get_device_id());
+    for (int i = 0; i < count; i++) {
+        cap += strlen(texts[i]) * 2 + 5;
+    }
+    uint8_t *frame = static_cast<uint8_t*>(HEAP_MALLOC(HEAP_COMP_SIGNALING, cap));
+    if (!frame) {
+        return -1;
+    }
+
+    signaling_frame_writer_t w;
+    signaling_frame_begin(&w, frame, cap, type, mqtt_client_get_device_id());
+    for (int i = 0; i < count; i++) {
+        signaling_frame_add_text(&w, texts[i]);
+    }
+    const char *msg_type = type == SIGNALING_MSG_OFFER ? "offer" : "candidates";
+    int msg_id = w.overflow ? -1 : publish_payload(reinterpret_cast<const char*>(frame), w.len, msg_type, false);
+    HEAP_FREE(frame);
+    return msg_id;
+}
+#endif
+
+/**
+ * @brief 发送当前批次的所有候选（调用方持有锁）
+ */
+static void flush_batch_locked(void)
+{
+    if (g_batch_count == 0 || !g_offer_sent) {
+        return;
+    }
+
+    int msg_id;
+#if CONFIG_WEBRTC_SIGNALING_COMPACT_CODEC
+    if (g_codec == SIGNALING_CODEC_COMPACT) {
+        const char *texts[ICE_BATCH_CAPACITY];
+        for (int i = 0; i < g_batch_count; i++) {
+            texts[i] = g_batch[i];
+        }
+        msg_id = publish_compact(SIGNALING_MSG_CANDIDATES, texts, g_batch_count);
+    } else
+#endif
+    {
+        cJSON *json = cJSON_CreateObject();
+        cJSON_AddStringToObject(json, "type", "candidates");
+        cJSON_AddStringToObject(json, "deviceId", mqtt_client_get_device_id());
+        cJSON *candidates = cJSON_AddArrayToObject(json, "candidates");
+        for (int i = 0; i < g_batch_count; i++) {
+            cJSON_AddItemToArray(candidates, cJSON_CreateString(g_batch[i]));
+        }
+        msg_id = publish_signaling(json, "candidates");
+        cJSON_Delete(json);
+    }
+
+    ESP_LOGI(TAG, "🧊 发送%d个ICE候选，msg_id=%d", g_batch_count, msg_id);
+    g_stats.candidate_messages++;
+    g_batch_count = 0;
+}
+
+// 批量窗口到期，发送已收集的候选
+static void batch_timer_callback(void *arg)
+{
+    xSemaphoreTake(g_lock, portMAX_DELAY);
+    flush_batch_locked();
+    xSemaphoreGive(g_lock);
+}
+
+// SDP Offer回调：立即发布Offer，随后发送Offer之前积压的候选
+static void on_local_offer(const char *sdp_offer, void *user_data)
+{
+    int msg_id;
+#if CONFIG_WEBRTC_SIGNALING_COMPACT_CODEC
+    if (g_codec == SIGNALING_CODEC_COMPACT) {
+        msg_id = publish_compact(SIGNALING_MSG_OFFER, &sdp_offer, 1);
+    } else
+#endif
+    {
+        cJSON *json = cJSON_CreateObject();
+        cJSON_AddStringToObject(json, "type", "offer");
+        cJSON_AddStringToObject(json, "deviceId", mqtt_client_get_device_id());
+        cJSON_AddStringToObject(json, "sdp", sdp_offer);
+#if CONFIG_WEBRTC_SIGNALING_COMPACT_CODEC
+        // 声明支持的紧凑编码，服务器以紧凑格式回复即视为协商成功
+        cJSON *codecs = cJSON_AddArrayToObject(json, "codecs");
+        cJSON_AddItemToArray(codecs, cJSON_CreateString(SIGNALING_CODEC_NAME));
+#endif
+        msg_id = publish_signaling(json, "offer");
+        cJSON_Delete(json);
+    }
+
+    if (msg_id < 0) {
+        // 未发出时不计时，候选继续留在批次中
+        ESP_LOGE(TAG, "❌ SDP Offer发布失败");
+        xSemaphoreTake(g_lock, portMAX_DELAY);
+        g_stats.offer_errors++;
+        xSemaphoreGive(g_lock);
+        return;
+    }
+    ESP_LOGI(TAG, "🎯 SDP Offer已发布(%s)，msg_id=%d",
+             g_codec == SIGNALING_CODEC_COMPACT ? SIGNALING_CODEC_NAME : "json", msg_id);
+
+    xSemaphoreTake(g_lock, portMAX_DELAY);
+    g_offer_sent = true;
+    g_stats.offer_sent_us = esp_timer_get_time();
+    g_stats.answer_received_us = 0;
+    g_stats.first_remote_candidate_us = 0;
+    g_stats.connected_us = 0;
+    esp_timer_stop(g_batch_timer);
+    flush_batch_locked();
+    xSemaphoreGive(g_lock);
+}
+
+// ICE候选回调：加入当前批次，窗口内的候选合并为一条消息
+static void on_local_candidate(const char *candidate, void *user_data)
+{
+    xSemaphoreTake(g_lock, portMAX_DELAY);
+    g_stats.local_candidates++;
+
+    if (g_batch_count >= ICE_BATCH_CAPACITY) {
+        flush_batch_locked();
+    }
+    if (g_batch_count < ICE_BATCH_CAPACITY) {
+        strncpy(g_batch[g_batch_count], candidate, ICE_CANDIDATE_MAX_LEN - 1);
+        g_batch[g_batch_count][ICE_CANDIDATE_MAX_LEN - 1] = '\0';
+        g_batch_count++;
+    } else {
+        // Offer发出前候选只能积压，超出批次容量的无法发送
+        g_stats.candidates_dropped++;
+        ESP_LOGW(TAG, "Offer发出前积压的候选超过%d个，丢弃: %s", ICE_BATCH_CAPACITY, candidate);
+    }
+
+    if (g_offer_sent) {
+        if (g_batch_count >= g_config.ice_batch_max || g_config.ice_batch_window_ms == 0) {
+            esp_timer_stop(g_batch_timer);
+            flush_batch_locked();
+        } else if (g_batch_count == 1) {
+            // 第一个候选开启窗口，窗口内的后续候选随之发送
+            esp_timer_start_once(g_batch_timer, (uint64_t)g_config.ice_batch_window_ms * 1000);
+        }
+    }
+    xSemaphoreGive(g_lock);
+}
+
+// 收到远程Answer
+static void handle_answer(const char *sdp)
+{
+    int64_t now = esp_timer_get_time();
+    g_stats.answer_received_us = now;
+    if (g_stats.offer_sent_us) {
+        ESP_LOGI(TAG, "[Performance][signaling_offer_to_answer_ms]: %" PRId64,
+                 (now - g_stats.offer_sent_us) / 1000);
+    }
+    webrtc_client_set_answer(sdp);
+}
+
+// 收到远程ICE候选
+static void handle_remote_candidate(const char *candidate)
+{
+    if (g_stats.first_remote_candidate_us == 0) {
+        g_stats.first_remote_candidate_us = esp_timer_get_time();
+    }
+    webrtc_client_add_ice_candidate(candidate);
+    g_stats.remote_candidates++;
+}
+
+#if CONFIG_WEBRTC_SIGNALING_COMPACT_CODEC
+/**
+ * @brief 处理紧凑格式的信令帧
+ *
+ * 服务器发来紧凑帧说明其支持该编码，此后本设备的上行信令也切换为紧凑格式
+ */
+static void handle_compact_message(const char *data, int data_len)
+{
+    signaling_frame_reader_t r;
+    signaling_msg_type_t type;
+    if (signaling_frame_open(&r, data, data_len, &type, NULL, 0) != 0) {
+        ESP_LOGW(TAG, "紧凑信令帧格式错误，长度: %d", data_len);
+        return;
+    }
+    if (g_codec != SIGNALING_CODEC_COMPACT) {
+        ESP_LOGI(TAG, "服务器支持%s编码，切换上行信令格式", SIGNALING_CODEC_NAME);
+        g_codec = SIGNALING_CODEC_COMPACT;
+    }
+
+    for (;;) {
+        int text_len = signaling_frame_next_text_length(&r);
+        if (text_len < 0) {
+            break;
+        }
+        char *text = static_cast<char*>(HEAP_MALLOC(HEAP_COMP_SIGNALING, text_len + 1));
+        if (!text) {
+            ESP_LOGE(TAG, "信令解码缓冲区分配失败: %d字节", text_len);
+            break;
+        }
+        if (signaling_frame_next_text(&r, text, text_len + 1) >= 0) {
+            if (type == SIGNALING_MSG_ANSWER) {
+                handle_answer(text);
+            } else if (type == SIGNALING_MSG_CANDIDATES) {
+                handle_remote_candidate(text);
+            }
+        }
+        HEAP_FREE(text);
+    }
+}
+#endif
+
+/**
+ * @brief 处理 /result/<deviceId> 主题上的信令消息
+ *
+ * 支持的消息类型：answer、candidate、candidates、codec（JSON或紧凑格式），
+ * 其它消息交回默认处理流程
+ */
+static bool on_mqtt_message(const char *topic, const char *data, int data_len, void *user_data)
+{
+    if (strncmp(topic, MQTT_SUBSCRIBE_TOPIC_PREFIX, strlen(MQTT_SUBSCRIBE_TOPIC_PREFIX)) != 0) {
+        return false;
+    }
+
+#if CONFIG_WEBRTC_SIGNALING_COMPACT_CODEC
+    if (signaling_codec_is_compact(data, data_len)) {
+        handle_compact_message(data, data_len);
+        return true;
+    }
+#endif
+
+    cJSON *json = cJSON_ParseWithLength(data, data_len);
+    if (!json) {
+        return false;
+    }
+
+    bool handled = true;
+    cJSON *type = cJSON_GetObjectItem(json, "type");
+    const char *type_str = cJSON_IsString(type) ? type->valuestring : "";
+
+    if (strcmp(type_str, "answer") == 0) {
+        cJSON *sdp = cJSON_GetObjectItem(json, "sdp");
+        if (cJSON_IsString(sdp)) {
+            handle_answer(sdp->valuestring);
+        }
+    } else if (strcmp(type_str, "candidate") == 0 || strcmp(type_str, "candidates") == 0) {
+        cJSON *single = cJSON_GetObjectItem(json, "candidate");
+        if (cJSON_IsString(single)) {
+            handle_remote_candidate(single->valuestring);
+        }
+        cJSON *item = NULL;
+        cJSON_ArrayForEach(item, cJSON_GetObjectItem(json, "candidates")) {
+            if (cJSON_IsString(item)) {
+                handle_remote_candidate(item->valuestring);
+            }
+        }
+    } else if (strcmp(type_str, "codec") == 0) {
+        // 服务器显式协商编码格式
+        cJSON *codec = cJSON_GetObjectItem(json, "codec");
+#if CONFIG_WEBRTC_SIGNALING_COMPACT_CODEC
+        g_codec = (cJSON_IsString(codec) && strcmp(codec->valuestring, SIGNALING_CODEC_NAME) == 0)
+                  ? SIGNALING_CODEC_COMPACT : SIGNALING_CODEC_JSON;
+#endif
+        ESP_LOGI(TAG, "信令编码协商: %s", cJSON_IsString(codec) ? codec->valuestring : "json");
+    } else {
+        handled = false;
+    }
+
+    cJSON_Delete(json);
+    return handled;
+}
+
+// 初始化信令模块，接管SDP/ICE回调和结果主题
+esp_err_t webrtc_signaling_init(const webrtc_signaling_config_t *config)
+{
+    if (!config) {
+        ESP_LOGE(TAG, "配置参数为空");
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    memcpy(&g_config, config, sizeof(g_config));
+    memset(&g_stats, 0, sizeof(g_stats));
+    g_batch_count = 0;
+    g_offer_sent = false;
+#if CONFIG_WEBRTC_SIGNALING_COMPACT_BY_DEFAULT
+    g_codec = SIGNALING_CODEC_COMPACT;
+#else
+    g_codec = SIGNALING_CODEC_JSON;
+#endif
+
+    if (!g_lock) {
+        g_lock = xSemaphoreCreateMutex();
+        if (!g_lock) {
+            return ESP_ERR_NO_MEM;
+        }
+    }
+    if (!g_batch_timer) {
+        esp_timer_create_args_t timer_args = {};
+        timer_args.callback = batch_timer_callback;
+        timer_args.name = "ice_batch";
+        esp_err_t ret = esp_timer_create(&timer_args, &g_batch_timer);
+        if (ret != ESP_OK) {
+            ESP_LOGE(TAG, "创建ICE批量定时器失败: %s", esp_err_to_name(ret));
+            return ret;
+        }
+    }
+
+    webrtc_client_set_sdp_callbacks(on_local_offer, on_local_candidate, NULL);
+    mqtt_client_set_message_handler(on_mqtt_message, NULL);
+
+    // MQTT已连接时立即订阅，否则在连接成功事件中订阅
+    mqtt_client_subscribe_result_topic();
+
+#if CONFIG_WEBRTC_SIGNALING_CODEC_BENCHMARK
+    signaling_codec_run_benchmark();
+#endif
+
+    ESP_LOGI(TAG, "信令模块初始化完成，ICE批量窗口: %" PRIu32 "ms，单批上限: %d",
+             g_config.ice_batch_window_ms, g_config.ice_batch_max);
+    return ESP_OK;
+}
+
+// 反初始化信令模块
+esp_err_t webrtc_signaling_deinit(void)
+{
+    mqtt_client_set_message_handler(NULL, NULL);
+    webrtc_client_set_sdp_callbacks(NULL, NULL, NULL);
+    if (g_batch_timer) {
+        esp_timer_stop(g_batch_timer);
+        esp_timer_delete(g_batch_timer);
+        g_batch_timer = NULL;
+    }
+    g_batch_count = 0;
+    g_offer_sent = false;
+    return ESP_OK;
+}
+
+/**
+ * @brief 开始新的Peer连接（启动、热重启、ICE重启）前调用
+ *
+ * 新Offer发出前的候选要等它一起发送，上一次会话未发出的候选属于旧连接，直接丢弃
+ */
+void webrtc_signaling_reset_session(void)
+{
+    if (!g_lock) {
+        return;
+    }
+    xSemaphoreTake(g_lock, portMAX_DELAY);
+    if (g_batch_timer) {
+        esp_timer_stop(g_batch_timer);
+    }
+    g_batch_count = 0;
+    g_offer_sent = false;
+    xSemaphoreGive(g_lock);
+}
+
+/**
+ * @brief 由应用的状态回调转发WebRTC状态，用于统计Offer到连接建立的耗时
+ */
+void webrtc_signaling_on_state(webrtc_client_state_t state)
+{
+    if (state != WEBRTC_CLIENT_STATE_CONNECTED || g_stats.connected_us != 0 || g_stats.offer_sent_us == 0) {
+        return;
+    }
+    g_stats.connected_us = esp_timer_get_time();
+    ESP_LOGI(TAG, "[Performance][signaling_offer_to_connected_ms]: %" PRId64,
+             (g_stats.connected_us - g_stats.offer_sent_us) / 1000);
+    ESP_LOGI(TAG, "[Performance][signaling_candidate_messages]: %" PRIu32 " (本地候选%" PRIu32 "个，丢弃%" PRIu32 "个)",
+             g_stats.candidate_messages, g_stats.local_candidates, g_stats.candidates_dropped);
+}
+
+// 获取信令统计信息
+esp_err_t webrtc_signaling_get_stats(webrtc_signaling_stats_t *stats)
+{
+    if (!stats) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    memcpy(stats, &g_stats, sizeof(g_stats));
+    stats->codec = g_codec;
+    return ESP_OK;
+}
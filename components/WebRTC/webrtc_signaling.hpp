@@ -0,0 +1,51 @@
+#pragma once
+
+#include "webrtc_client.hpp"
+#include "mqtt_client.hpp"
+#include "signaling_codec.hpp"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// WebRTC信令配置结构体
+typedef struct {
+    const char *publish_topic;              // 发布主题，NULL时使用MQTT_PUBLISH_TOPIC
+    int qos;                                // 信令消息QoS
+    uint32_t ice_batch_window_ms;           // ICE候选批量发送窗口（毫秒）
+    int ice_batch_max;                      // 单批最多候选数量，达到后立即发送
+} webrtc_signaling_config_t;
+
+// 信令统计信息（时间戳单位：微秒，0表示未发生）
+typedef struct {
+    int64_t offer_sent_us;                  // Offer发布时间
+    int64_t answer_received_us;             // 收到Answer时间
+    int64_t first_remote_candidate_us;      // 收到第一个远程候选时间
+    int64_t connected_us;                   // 连接建立时间
+    uint32_t local_candidates;              // 本地候选数量
+    uint32_t candidate_messages;            // 发布的候选消息数量
+    uint32_t candidates_dropped;            // Offer发出前批次已满而丢弃的本地候选
+    uint32_t offer_errors;                  // Offer发布失败次数
+    uint32_t remote_candidates;             // 远程候选数量
+    uint32_t bytes_sent;                    // 已发布的信令字节数
+    signaling_codec_t codec;                // 当前上行信令编码
+} webrtc_signaling_stats_t;
+
+#define WEBRTC_SIGNALING_DEFAULT_CONFIG() {                         \
+    .publish_topic = NULL,                                          \
+    .qos = 1,                                                       \
+    .ice_batch_window_ms = CONFIG_WEBRTC_SIGNALING_ICE_BATCH_MS,    \
+    .ice_batch_max = CONFIG_WEBRTC_SIGNALING_ICE_BATCH_MAX,         \
+}
+
+// 函数声明
+esp_err_t webrtc_signaling_init(const webrtc_signaling_config_t *config);
+esp_err_t webrtc_signaling_deinit(void);
+// 新的Peer连接开始前清空Offer状态和候选批次，由webrtc_client调用
+void webrtc_signaling_reset_session(void);
+void webrtc_signaling_on_state(webrtc_client_state_t state);
+esp_err_t webrtc_signaling_get_stats(webrtc_signaling_stats_t *stats);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,99 @@
+#include "app_network.hpp"
+
+#include <inttypes.h>
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "esp_event.h"
+#include "esp_netif.h"
+#include "nvs_flash.h"
+#include "protocol_examples_common.h"
+#include "wifi_power.hpp"
+
+/*
+ * 共享网络初始化
+ *
+ * NVS、netif、默认事件循环和Wi-Fi驱动在固件内只能初始化一次。MQTT客户端和WebRTC
+ * 客户端原先各自初始化（一个用example_connect，一个自带Wi-Fi代码），合并后统一由
+ * 这里完成，两个子系统只在网络就绪后启动。
+ */
+
+static const char *TAG = "app_network";
+
+static bool g_inited = false;
+static esp_err_t g_init_result = ESP_ERR_INVALID_STATE;
+static uint32_t g_init_us = 0;
+static bool g_started = false;
+static esp_err_t g_result = ESP_ERR_INVALID_STATE;
+static uint32_t g_ready_ms = 0;
+
+esp_err_t app_network_init(void)
+{
+    if (g_inited) {
+        return g_init_result;
+    }
+    g_inited = true;
+
+    int64_t start_us = esp_timer_get_time();
+    esp_err_t ret = nvs_flash_init();
+    if (ret == ESP_ERR_NVS_NO_FREE_PAGES || ret == ESP_ERR_NVS_NEW_VERSION_FOUND) {
+        // NVS分区已满或版本不兼容：擦除后重建，只在开机时发生
+        ESP_LOGW(TAG, "NVS需要重建: %s", esp_err_to_name(ret));
+        ret = nvs_flash_erase();
+        if (ret == ESP_OK) {
+            ret = nvs_flash_init();
+        }
+    }
+    if (ret == ESP_OK) {
+        ret = esp_netif_init();
+    }
+    if (ret == ESP_OK) {
+        ret = esp_event_loop_create_default();
+    }
+    g_init_result = ret;
+    g_init_us = (uint32_t)(esp_timer_get_time() - start_us);
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "系统网络组件初始化失败: %s", esp_err_to_name(ret));
+    }
+    return ret;
+}
+
+esp_err_t app_network_start(void)
+{
+    if (g_started) {
+        return g_result;
+    }
+    g_started = true;
+
+    esp_err_t ret = app_network_init();
+    int64_t connect_us = esp_timer_get_time();
+    if (ret == ESP_OK) {
+        ret = example_connect();
+    }
+    g_result = ret;
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "网络初始化失败: %s", esp_err_to_name(ret));
+        return ret;
+    }
+
+    int64_t now_us = esp_timer_get_time();
+    g_ready_ms = (uint32_t)(now_us / 1000);
+    ESP_LOGI(TAG, "📶 网络连接成功");
+    uint32_t connect_ms = (uint32_t)((now_us - connect_us) / 1000);
+    ESP_LOGI(TAG, "[Performance][network_bringup_ms]: %" PRIu32 " (系统初始化%" PRIu32 "，连接%" PRIu32 "，开机后%" PRIu32 ")",
+             g_init_us / 1000 + connect_ms, g_init_us / 1000, connect_ms, g_ready_ms);
+#if CONFIG_APP_WIFI_POWER_SAVE
+    // 联网期间保持驱动默认模式，之后由WebRTC会话状态决定是否省电
+    wifi_power_init();
+#endif
+    return ESP_OK;
+}
+
+bool app_network_is_ready(void)
+{
+    return g_started && g_result == ESP_OK;
+}
+
+uint32_t app_network_ready_ms(void)
+{
+    return g_ready_ms;
+}
@@ -0,0 +1,35 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief 初始化NVS、esp_netif和默认事件循环，不连接网络
+ *
+ * 只执行一次，重复调用返回首次的结果。需要在联网期间并行做准备工作的子系统
+ * （如注册事件处理函数、预打开Peer）在此之后、app_network_start之前调用。
+ */
+esp_err_t app_network_init(void);
+
+/**
+ * @brief 启动共享网络：app_network_init之后经example_connect连接Wi-Fi/以太网
+ *
+ * 整个固件只执行一次，重复调用直接返回首次的结果。MQTT和WebRTC都在此之上启动，
+ * 不再各自初始化。连接参数来自protocol_examples_common的Kconfig（EXAMPLE_WIFI_SSID等），
+ * 断线重连也由它负责。需在app_main中调用，拿到IP后返回。
+ */
+esp_err_t app_network_start(void);
+
+bool app_network_is_ready(void);
+
+// 开机到拿到IP的时间，网络未就绪时为0
+uint32_t app_network_ready_ms(void);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,491 @@
+#include "event_capture.hpp"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/event_groups.h"
+#include "freertos/ringbuf.h"
+#include "task_topology.hpp"
+#if CONFIG_APP_EVENT_CAPTURE_SINK_PARTITION
+#include "esp_partition.h"
+#include "spi_flash_mmap.h"
+#elif CONFIG_APP_EVENT_CAPTURE_SINK_UART
+#include "driver/uart.h"
+#endif
+
+/*
+ * 录制路径
+ *
+ *   MQTT任务 / Peer任务 / 媒体任务 → event_capture_record → 环形缓冲区（NOSPLIT，每条记录一项）
+ *                                                               │ 录制任务
+ *                                                               ↓
+ *                                          记录头时间换算为相对上一条的间隔 → 文件/分区/UART
+ *
+ * 回调里只做一次拷贝，缓冲区满时丢弃并计数，从不等待flash或UART。记录在缓冲区中
+ * 暂存的是相对录制开始的绝对时间，由录制任务按写出顺序换算成间隔，多个任务并发
+ * 记录时时间也保持单调。
+ */
+
+#if CONFIG_APP_EVENT_CAPTURE || CONFIG_APP_EVENT_REPLAY
+static const char *TAG = "event_capture";
+#endif
+
+#if CONFIG_APP_EVENT_CAPTURE
+
+#define CAPTURE_EXITED BIT0
+#define CAPTURE_POLL_MS 100
+
+#if CONFIG_APP_EVENT_CAPTURE_MEDIA_PAYLOAD
+#define CAPTURE_MEDIA_PAYLOAD 1
+#else
+#define CAPTURE_MEDIA_PAYLOAD 0
+#endif
+
+static RingbufHandle_t g_ring = NULL;
+static EventGroupHandle_t g_exit_bits = NULL;
+static volatile bool g_running = false;
+static int64_t g_start_us = 0;
+
+static portMUX_TYPE g_stats_lock = portMUX_INITIALIZER_UNLOCKED;
+static event_capture_stats_t g_stats;
+
+/* ---------------- 录制目标 ---------------- */
+
+#if CONFIG_APP_EVENT_CAPTURE_SINK_FILE
+
+static FILE *g_file = NULL;
+
+static esp_err_t sink_open(void)
+{
+    g_file = fopen(CONFIG_APP_EVENT_CAPTURE_FILE, "wb");
+    if (!g_file) {
+        ESP_LOGE(TAG, "无法创建录制文件%s", CONFIG_APP_EVENT_CAPTURE_FILE);
+        return ESP_FAIL;
+    }
+    return ESP_OK;
+}
+
+static bool sink_write(const void *data, size_t size)
+{
+    return fwrite(data, 1, size, g_file) == size;
+}
+
+static void sink_flush(void)
+{
+    fflush(g_file);
+}
+
+static void sink_close(void)
+{
+    fclose(g_file);
+    g_file = NULL;
+}
+
+#elif CONFIG_APP_EVENT_CAPTURE_SINK_PARTITION
+
+static const esp_partition_t *g_partition = NULL;
+static size_t g_offset = 0;
+static size_t g_erased = 0;                 // [0, g_erased)已擦除，按需逐扇区擦除
+
+static esp_err_t sink_open(void)
+{
+    g_partition = esp_partition_find_first(ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_ANY,
+                                           CONFIG_APP_EVENT_CAPTURE_PARTITION);
+    if (!g_partition) {
+        ESP_LOGE(TAG, "分区表中没有%s分区", CONFIG_APP_EVENT_CAPTURE_PARTITION);
+        return ESP_ERR_NOT_FOUND;
+    }
+    g_offset = 0;
+    g_erased = 0;
+    return ESP_OK;
+}
+
+static bool sink_write(const void *data, size_t size)
+{
+    if (g_offset + size > g_partition->size) {
+        return false;
+    }
+    while (g_erased < g_offset + size) {
+        if (esp_partition_erase_range(g_partition, g_erased, SPI_FLASH_SEC_SIZE) != ESP_OK) {
+            return false;
+        }
+        g_erased += SPI_FLASH_SEC_SIZE;
+    }
+    if (esp_partition_write(g_partition, g_offset, data, size) != ESP_OK) {
+        return false;
+    }
+    g_offset += size;
+    return true;
+}
+
+static void sink_flush(void)
+{
+}
+
+static void sink_close(void)
+{
+    // 结尾之后必须是0xFF，回放据此判断结束；正好写满一个扇区时再擦一个
+    if (g_erased == g_offset && g_offset + SPI_FLASH_SEC_SIZE <= g_partition->size) {
+        esp_partition_erase_range(g_partition, g_offset, SPI_FLASH_SEC_SIZE);
+    }
+    ESP_LOGI(TAG, "录制已写入%s分区: %u/%u字节", CONFIG_APP_EVENT_CAPTURE_PARTITION,
+             (unsigned)g_offset, (unsigned)g_partition->size);
+    g_partition = NULL;
+}
+
+#elif CONFIG_APP_EVENT_CAPTURE_SINK_UART
+
+static esp_err_t sink_open(void)
+{
+    uart_config_t uart_cfg = {};
+    uart_cfg.baud_rate = CONFIG_APP_EVENT_CAPTURE_UART_BAUD;
+    uart_cfg.data_bits = UART_DATA_8_BITS;
+    uart_cfg.parity = UART_PARITY_DISABLE;
+    uart_cfg.stop_bits = UART_STOP_BITS_1;
+    uart_cfg.flow_ctrl = UART_HW_FLOWCTRL_DISABLE;
+    uart_cfg.source_clk = UART_SCLK_DEFAULT;
+    // 只发送；TX缓冲区为0时uart_write_bytes阻塞到数据进入FIFO，由录制任务承担等待
+    esp_err_t ret = uart_driver_install(CONFIG_APP_EVENT_CAPTURE_UART_NUM, 256, 0, 0, NULL, 0);
+    if (ret == ESP_OK) {
+        ret = uart_param_config(CONFIG_APP_EVENT_CAPTURE_UART_NUM, &uart_cfg);
+    }
+    if (ret == ESP_OK) {
+        ret = uart_set_pin(CONFIG_APP_EVENT_CAPTURE_UART_NUM, CONFIG_APP_EVENT_CAPTURE_UART_TX_GPIO,
+                           UART_PIN_NO_CHANGE, UART_PIN_NO_CHANGE, UART_PIN_NO_CHANGE);
+    }
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "录制UART初始化失败: %s", esp_err_to_name(ret));
+    }
+    return ret;
+}
+
+static bool sink_write(const void *data, size_t size)
+{
+    return uart_write_bytes(CONFIG_APP_EVENT_CAPTURE_UART_NUM, data, size) == (int)size;
+}
+
+static void sink_flush(void)
+{
+}
+
+static void sink_close(void)
+{
+    uart_wait_tx_done(CONFIG_APP_EVENT_CAPTURE_UART_NUM, pdMS_TO_TICKS(1000));
+    uart_driver_delete(CONFIG_APP_EVENT_CAPTURE_UART_NUM);
+}
+
+#endif
+
+/* ---------------- 录制任务 ---------------- */
+
+static void write_item(uint8_t *item, size_t item_size, uint32_t *last_ts, bool *full)
+{
+    event_capture_record_t *record = reinterpret_cast<event_capture_record_t *>(item);
+    // 缓冲区中是绝对时间，换算成相对上一条的间隔；并发记录的先后差异按0处理
+    uint32_t ts = record->delta_us;
+    int32_t delta = (int32_t)(ts - *last_ts);
+    record->delta_us = delta > 0 ? (uint32_t)delta : 0;
+    if (delta > 0) {
+        *last_ts = ts;
+    }
+
+    bool ok = !*full && sink_write(item, item_size);
+    if (!ok && !*full) {
+        *full = true;
+        ESP_LOGW(TAG, "录制目标已写满或写入失败，之后的记录将被丢弃");
+    }
+    portENTER_CRITICAL(&g_stats_lock);
+    if (ok) {
+        g_stats.records++;
+        g_stats.bytes += item_size;
+    } else {
+        g_stats.dropped++;
+    }
+    portEXIT_CRITICAL(&g_stats_lock);
+}
+
+static void capture_task(void *arg)
+{
+    uint32_t last_ts = 0;
+    bool full = false;
+
+    while (true) {
+        bool running = g_running;
+        size_t item_size = 0;
+        // 停止后不再等待，写完缓冲区中剩余的记录即退出
+        uint8_t *item = static_cast<uint8_t *>(xRingbufferReceive(g_ring, &item_size,
+                                                                  running ? pdMS_TO_TICKS(CAPTURE_POLL_MS) : 0));
+        if (!item) {
+            if (!running) {
+                break;
+            }
+            sink_flush();                   // 空闲时落盘，进程被终止也只丢最近一个周期
+            continue;
+        }
+        write_item(item, item_size, &last_ts, &full);
+        vRingbufferReturnItem(g_ring, item);
+    }
+
+    sink_close();
+    xEventGroupSetBits(g_exit_bits, CAPTURE_EXITED);
+    vTaskDelete(NULL);
+}
+
+/* ---------------- 对外接口 ---------------- */
+
+esp_err_t event_capture_start(void)
+{
+    if (g_running) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    if (!g_exit_bits) {
+        g_exit_bits = xEventGroupCreate();
+        if (!g_exit_bits) {
+            return ESP_ERR_NO_MEM;
+        }
+    }
+    if (!g_ring) {
+        g_ring = xRingbufferCreate(CONFIG_APP_EVENT_CAPTURE_BUFFER_SIZE, RINGBUF_TYPE_NOSPLIT);
+        if (!g_ring) {
+            return ESP_ERR_NO_MEM;
+        }
+    }
+    // 上次停止时正在写入的记录留在缓冲区里，时间基准已失效
+    size_t stale_size = 0;
+    void *stale;
+    while ((stale = xRingbufferReceive(g_ring, &stale_size, 0)) != NULL) {
+        vRingbufferReturnItem(g_ring, stale);
+    }
+    esp_err_t ret = sink_open();
+    if (ret != ESP_OK) {
+        return ret;
+    }
+
+    g_start_us = esp_timer_get_time();
+    event_capture_file_header_t header = {};
+    header.magic = EVENT_CAPTURE_MAGIC;
+    header.version = EVENT_CAPTURE_VERSION;
+    header.flags = CAPTURE_MEDIA_PAYLOAD ? EVENT_CAPTURE_FLAG_MEDIA_PAYLOAD : 0;
+    header.start_us = (uint64_t)g_start_us;
+    if (!sink_write(&header, sizeof(header))) {
+        sink_close();
+        return ESP_FAIL;
+    }
+
+    portENTER_CRITICAL(&g_stats_lock);
+    memset(&g_stats, 0, sizeof(g_stats));
+    g_stats.bytes = sizeof(header);
+    portEXIT_CRITICAL(&g_stats_lock);
+
+    xEventGroupClearBits(g_exit_bits, CAPTURE_EXITED);
+    g_running = true;
+    ret = task_topology_create(APP_TASK_RECORDER, capture_task, NULL, NULL);
+    if (ret != ESP_OK) {
+        g_running = false;
+        sink_close();
+        return ret;
+    }
+    ESP_LOGI(TAG, "📼 事件录制已开始: 缓冲区%d字节，音视频%s", CONFIG_APP_EVENT_CAPTURE_BUFFER_SIZE,
+             (header.flags & EVENT_CAPTURE_FLAG_MEDIA_PAYLOAD) ? "带负载" : "只记录大小");
+    return ESP_OK;
+}
+
+esp_err_t event_capture_stop(void)
+{
+    if (!g_running) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    g_running = false;
+
+    EventBits_t bits = xEventGroupWaitBits(g_exit_bits, CAPTURE_EXITED, pdFALSE, pdTRUE,
+                                           pdMS_TO_TICKS(CAPTURE_POLL_MS * 50));
+    if (!(bits & CAPTURE_EXITED)) {
+        ESP_LOGE(TAG, "录制任务未按时退出");
+        return ESP_ERR_TIMEOUT;
+    }
+    event_capture_report();
+    return ESP_OK;
+}
+
+void event_capture_record(event_capture_src_t src, uint8_t type, uint16_t stream,
+                          const void *head, size_t head_size, const void *data, size_t size)
+{
+    if (!g_running) {
+        return;
+    }
+    bool media = src == EVENT_CAPTURE_SRC_AUDIO || src == EVENT_CAPTURE_SRC_VIDEO;
+    size_t payload_size = head_size + size;
+    size_t stored_size = (media && !CAPTURE_MEDIA_PAYLOAD) ? 0 : payload_size;
+    size_t item_size = sizeof(event_capture_record_t) + stored_size;
+
+    void *item = NULL;
+    if (xRingbufferSendAcquire(g_ring, &item, item_size, 0) != pdTRUE) {
+        portENTER_CRITICAL(&g_stats_lock);
+        g_stats.dropped++;
+        portEXIT_CRITICAL(&g_stats_lock);
+        return;
+    }
+    event_capture_record_t *record = static_cast<event_capture_record_t *>(item);
+    record->delta_us = (uint32_t)(esp_timer_get_time() - g_start_us);
+    record->size = (uint32_t)payload_size;
+    record->src = (uint8_t)src;
+    record->type = type;
+    record->stream = stream;
+    if (stored_size > 0) {
+        uint8_t *payload = static_cast<uint8_t *>(item) + sizeof(event_capture_record_t);
+        if (head_size > 0) {
+            memcpy(payload, head, head_size);
+        }
+        if (size > 0) {
+            memcpy(payload + head_size, data, size);
+        }
+    }
+    xRingbufferSendComplete(g_ring, item);
+
+    size_t used = CONFIG_APP_EVENT_CAPTURE_BUFFER_SIZE - xRingbufferGetCurFreeSize(g_ring);
+    portENTER_CRITICAL(&g_stats_lock);
+    if (used > g_stats.buffer_peak) {
+        g_stats.buffer_peak = used;
+    }
+    portEXIT_CRITICAL(&g_stats_lock);
+}
+
+void event_capture_get_stats(event_capture_stats_t *stats)
+{
+    portENTER_CRITICAL(&g_stats_lock);
+    *stats = g_stats;
+    portEXIT_CRITICAL(&g_stats_lock);
+}
+
+void event_capture_report(void)
+{
+    event_capture_stats_t stats;
+    event_capture_get_stats(&stats);
+    ESP_LOGI(TAG, "[Performance][capture_records]: %" PRIu32 " (丢弃%" PRIu32 ")", stats.records, stats.dropped);
+    ESP_LOGI(TAG, "[Performance][capture_bytes]: %" PRIu32 " (缓冲区峰值%" PRIu32 "/%d字节)",
+             stats.bytes, stats.buffer_peak, CONFIG_APP_EVENT_CAPTURE_BUFFER_SIZE);
+}
+
+#endif /* CONFIG_APP_EVENT_CAPTURE */
+
+/* ---------------- 回放 ---------------- */
+
+#if CONFIG_APP_EVENT_REPLAY
+
+typedef struct {
+    event_replay_handler_t handler;
+    void *ctx;
+} replay_slot_t;
+
+static replay_slot_t g_handlers[EVENT_CAPTURE_SRC_MAX];
+
+void event_replay_set_handler(event_capture_src_t src, event_replay_handler_t handler, void *ctx)
+{
+    if (src <= 0 || src >= EVENT_CAPTURE_SRC_MAX) {
+        return;
+    }
+    g_handlers[src].handler = handler;
+    g_handlers[src].ctx = ctx;
+}
+
+// 等到录制时间线上的capture_us时刻；返回调度滞后
+static uint32_t wait_until(int64_t replay_start_us, uint64_t capture_us, uint32_t speed)
+{
+    int64_t due_us = replay_start_us + (int64_t)(capture_us / speed);
+    int64_t now_us = esp_timer_get_time();
+    if (due_us - now_us >= portTICK_PERIOD_MS * 1000) {
+        vTaskDelay(pdMS_TO_TICKS((due_us - now_us) / 1000));
+    }
+    // 不足一个tick的剩余时间让出CPU等待，保证回放顺序和时间精度
+    while ((now_us = esp_timer_get_time()) < due_us) {
+        taskYIELD();
+    }
+    return (uint32_t)(now_us - due_us);
+}
+
+esp_err_t event_replay_run(uint32_t speed, event_replay_stats_t *stats)
+{
+    FILE *file = fopen(CONFIG_APP_EVENT_CAPTURE_FILE, "rb");
+    if (!file) {
+        ESP_LOGE(TAG, "无法打开录制文件%s", CONFIG_APP_EVENT_CAPTURE_FILE);
+        return ESP_ERR_NOT_FOUND;
+    }
+    event_capture_file_header_t header;
+    if (fread(&header, 1, sizeof(header), file) != sizeof(header) ||
+        header.magic != EVENT_CAPTURE_MAGIC || header.version != EVENT_CAPTURE_VERSION) {
+        ESP_LOGE(TAG, "%s不是录制文件或版本不符", CONFIG_APP_EVENT_CAPTURE_FILE);
+        fclose(file);
+        return ESP_ERR_INVALID_VERSION;
+    }
+
+    event_replay_stats_t result = {};
+    uint8_t *payload = NULL;
+    size_t payload_cap = 0;
+    esp_err_t ret = ESP_OK;
+    uint64_t capture_us = 0;
+    int64_t replay_start_us = esp_timer_get_time();
+    ESP_LOGI(TAG, "▶️ 开始回放%s，%" PRIu32 "倍速%s", CONFIG_APP_EVENT_CAPTURE_FILE, speed,
+             speed == 0 ? "（不等待）" : "");
+
+    event_capture_record_t record;
+    while (fread(&record, 1, sizeof(record), file) == sizeof(record)) {
+        if (record.delta_us == UINT32_MAX && record.size == UINT32_MAX) {
+            break;                          // 从分区导出的文件：擦除区域即结尾
+        }
+        bool media = record.src == EVENT_CAPTURE_SRC_AUDIO || record.src == EVENT_CAPTURE_SRC_VIDEO;
+        size_t stored_size = (media && !(header.flags & EVENT_CAPTURE_FLAG_MEDIA_PAYLOAD)) ? 0 : record.size;
+        if (stored_size > payload_cap) {
+            uint8_t *grown = static_cast<uint8_t *>(realloc(payload, stored_size));
+            if (!grown) {
+                ret = ESP_ERR_NO_MEM;
+                break;
+            }
+            payload = grown;
+            payload_cap = stored_size;
+        }
+        if (stored_size > 0 && fread(payload, 1, stored_size, file) != stored_size) {
+            ESP_LOGW(TAG, "录制文件在记录中间结束");
+            break;
+        }
+        result.records++;
+        capture_us += record.delta_us;
+
+        const replay_slot_t *slot = record.src < EVENT_CAPTURE_SRC_MAX ? &g_handlers[record.src] : NULL;
+        if (!slot || !slot->handler) {
+            result.skipped++;
+            continue;
+        }
+        if (speed > 0) {
+            uint32_t lag_us = wait_until(replay_start_us, capture_us, speed);
+            if (lag_us > result.max_lag_us) {
+                result.max_lag_us = lag_us;
+            }
+        }
+        int64_t handler_start = esp_timer_get_time();
+        slot->handler(&record, stored_size > 0 ? payload : NULL, slot->ctx);
+        result.handler_us += (uint32_t)(esp_timer_get_time() - handler_start);
+        result.dispatched++;
+    }
+    fclose(file);
+    free(payload);
+
+    result.capture_ms = (uint32_t)(capture_us / 1000);
+    result.replay_ms = (uint32_t)((esp_timer_get_time() - replay_start_us) / 1000);
+    ESP_LOGI(TAG, "[Performance][replay_records]: %" PRIu32 " (处理%" PRIu32 "，无处理函数%" PRIu32 ")",
+             result.records, result.dispatched, result.skipped);
+    ESP_LOGI(TAG, "[Performance][replay_ms]: %" PRIu32 " (录制时长%" PRIu32 "ms，最大滞后%" PRIu32 "us)",
+             result.replay_ms, result.capture_ms, result.max_lag_us);
+    ESP_LOGI(TAG, "[Performance][replay_handler_us_per_record]: %" PRIu32,
+             result.dispatched ? result.handler_us / result.dispatched : 0);
+    if (stats) {
+        *stats = result;
+    }
+    return ret;
+}
+
+#endif /* CONFIG_APP_EVENT_REPLAY */
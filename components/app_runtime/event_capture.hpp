@@ -0,0 +1,145 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * 事件录制与回放
+ *
+ * 录制：MQTT事件处理函数和webrtc_client的Peer回调把每条消息、状态变化和媒体帧写入
+ * 紧凑的二进制日志（时间戳+大小，可选负载），经环形缓冲区由后台任务写入flash分区、
+ * 文件（linux目标）或UART，不阻塞回调所在任务。
+ *
+ * 文件格式（小端）：
+ *   文件头 event_capture_file_header_t（16字节）
+ *   记录   event_capture_record_t（12字节）+ 负载stored_size字节，重复到文件末尾
+ *          （flash分区中读到全0xFF的记录头即结束）
+ *
+ * 回放：linux目标上按记录时间间隔（可加速）把日志重新送入同一处理路径，
+ * 处理函数由各组件按来源注册。tools/capture_tool.py可查看日志、从UART接收日志。
+ */
+
+#define EVENT_CAPTURE_MAGIC     0x50435245u     // "ERCP"
+#define EVENT_CAPTURE_VERSION   1
+
+// 记录来源
+typedef enum {
+    EVENT_CAPTURE_SRC_MQTT = 1,             // type: esp_mqtt_event_id_t
+    EVENT_CAPTURE_SRC_PEER_STATE,           // type: esp_peer_state_t，无负载
+    EVENT_CAPTURE_SRC_PEER_MSG,             // type: esp_peer_msg_type_t，负载为SDP/候选
+    EVENT_CAPTURE_SRC_AUDIO,                // 收到的音频帧
+    EVENT_CAPTURE_SRC_VIDEO,                // 收到的视频帧
+    EVENT_CAPTURE_SRC_DATA,                 // type: 数据通道帧类型，stream: SCTP流ID
+    EVENT_CAPTURE_SRC_CHANNEL,              // type: 0打开 1关闭，stream: SCTP流ID，负载为通道名
+    EVENT_CAPTURE_SRC_MAX,
+} event_capture_src_t;
+
+#define EVENT_CAPTURE_FLAG_MEDIA_PAYLOAD 0x01   // 音视频帧带负载；否则只记录大小
+
+typedef struct __attribute__((packed)) {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t flags;
+    uint64_t start_us;                      // 录制开始时的esp_timer时间
+} event_capture_file_header_t;
+
+typedef struct __attribute__((packed)) {
+    uint32_t delta_us;                      // 距上一条记录（第一条距录制开始）的时间
+    uint32_t size;                          // 原始负载大小
+    uint8_t src;                            // event_capture_src_t
+    uint8_t type;
+    uint16_t stream;
+} event_capture_record_t;
+
+// MQTT_EVENT_DATA记录的负载：本头 + 主题 + 本分片数据
+typedef struct __attribute__((packed)) {
+    uint16_t topic_len;
+    uint32_t current_data_offset;
+    uint32_t total_data_len;
+} event_capture_mqtt_data_t;
+
+typedef struct {
+    uint32_t records;
+    uint32_t bytes;                         // 写入目标的字节数（含记录头）
+    uint32_t dropped;                       // 缓冲区满或目标已写满而丢弃的记录
+    uint32_t buffer_peak;                   // 环形缓冲区最高占用字节数
+} event_capture_stats_t;
+
+#if CONFIG_APP_EVENT_CAPTURE
+
+/**
+ * @brief 打开录制目标并启动写入任务（APP_TASK_RECORDER）
+ *
+ * 目标由Kconfig选择：linux目标写文件，设备上写"capture"数据分区或UART
+ */
+esp_err_t event_capture_start(void);
+
+// 写完缓冲区中剩余的记录后关闭目标
+esp_err_t event_capture_stop(void);
+
+/**
+ * @brief 记录一条事件，可在任意任务中调用，不阻塞
+ *
+ * 负载按调用时拷贝；音视频帧在未启用CONFIG_APP_EVENT_CAPTURE_MEDIA_PAYLOAD时只记录大小。
+ * head/head_size为可选的前置负载（如MQTT数据记录的分片信息），与data拼成一条记录。
+ */
+void event_capture_record(event_capture_src_t src, uint8_t type, uint16_t stream,
+                          const void *head, size_t head_size, const void *data, size_t size);
+
+void event_capture_get_stats(event_capture_stats_t *stats);
+
+// 打印录制统计
+void event_capture_report(void);
+
+#define EVENT_CAPTURE(src, type, stream, data, size) \
+    event_capture_record((src), (type), (stream), NULL, 0, (data), (size))
+#define EVENT_CAPTURE_EX(src, type, stream, head, head_size, data, size) \
+    event_capture_record((src), (type), (stream), (head), (head_size), (data), (size))
+
+#else
+
+#define EVENT_CAPTURE(src, type, stream, data, size)                        do {} while (0)
+#define EVENT_CAPTURE_EX(src, type, stream, head, head_size, data, size)    do {} while (0)
+
+#endif /* CONFIG_APP_EVENT_CAPTURE */
+
+/**
+ * @brief 回放处理函数
+ *
+ * payload为NULL表示录制时未保存负载（只有record->size）
+ */
+typedef void (*event_replay_handler_t)(const event_capture_record_t *record, const uint8_t *payload, void *ctx);
+
+typedef struct {
+    uint32_t records;
+    uint32_t dispatched;                    // 交给了处理函数的记录
+    uint32_t skipped;                       // 该来源没有注册处理函数
+    uint32_t capture_ms;                    // 录制时长
+    uint32_t replay_ms;                     // 回放耗时
+    uint32_t max_lag_us;                    // 按时间表回放时最大的调度滞后
+    uint32_t handler_us;                    // 处理函数总耗时
+} event_replay_stats_t;
+
+#if CONFIG_APP_EVENT_REPLAY
+
+// 注册某一来源的回放处理函数，在event_replay_run之前调用
+void event_replay_set_handler(event_capture_src_t src, event_replay_handler_t handler, void *ctx);
+
+/**
+ * @brief 回放CONFIG_APP_EVENT_CAPTURE_FILE，阻塞到文件结束
+ *
+ * @param speed 0为不等待、尽快回放；1为按录制时间；N为N倍速
+ */
+esp_err_t event_replay_run(uint32_t speed, event_replay_stats_t *stats);
+
+#endif /* CONFIG_APP_EVENT_REPLAY */
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,370 @@
+#include "heap_monitor.hpp"
+
+#include <assert.h>
+#include <string.h>
+#include <inttypes.h>
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#if !CONFIG_IDF_TARGET_LINUX
+#include "esp_heap_caps.h"
+#endif
+
+/*
+ * 堆健康与按组件/调用点的分配记账
+ *
+ * 经HEAP_MALLOC分配的块前有8字节头记录组件和大小，释放时据此扣减；
+ * cJSON经钩子用同样的块头分配，解析树和节点计入json组件，HEAP_JSON_PRINT输出的字符串
+ * 再转到调用组件。ESP-MQTT内部的分配不经过这里，不在统计内。
+ * 调用点只统计分配次数和字节数，用于找出热点。
+ * 周期采样空闲总量、最大空闲块和碎片率，并可检查每条消息的分配预算。
+ */
+
+static const char *TAG = "heap_monitor";
+
+static const char *const COMPONENT_NAMES[HEAP_COMP_MAX] = {
+    "mqtt", "signaling", "webrtc", "media", "app", "json",
+};
+
+// cJSON钩子分配的调用点
+static const char JSON_SITE[] = "cJSON";
+
+#define MAX_SITES 48
+#define BLOCK_MAGIC 0xA5C3
+
+typedef struct {
+    uint32_t size;
+    uint16_t comp;
+    uint16_t magic;
+} block_header_t;
+
+typedef struct {
+    const char *site;                       // HEAP_SITE字符串常量，按指针比较
+    uint16_t comp;
+    uint32_t count;
+    uint64_t bytes;
+    uint32_t max_size;
+} site_stats_t;
+
+static portMUX_TYPE g_lock = portMUX_INITIALIZER_UNLOCKED;
+static heap_component_stats_t g_components[HEAP_COMP_MAX];
+static site_stats_t g_sites[MAX_SITES];
+static int g_site_count = 0;
+static heap_health_t g_health;
+
+// 当前采样区间
+static uint32_t g_window_allocs = 0;
+static uint64_t g_window_bytes = 0;
+static uint32_t g_window_messages = 0;
+
+// 调用者持有g_lock
+static void record_site(heap_component_t comp, size_t size, const char *site)
+{
+    site_stats_t *s = NULL;
+    for (int i = 0; i < g_site_count; i++) {
+        if (g_sites[i].site == site) {
+            s = &g_sites[i];
+            break;
+        }
+    }
+    if (!s && g_site_count < MAX_SITES) {
+        s = &g_sites[g_site_count++];
+        s->site = site;
+        s->comp = comp;
+    }
+    if (s) {
+        s->count++;
+        s->bytes += size;
+        if (size > s->max_size) {
+            s->max_size = size;
+        }
+    }
+}
+
+static void record_alloc(heap_component_t comp, size_t size, const char *site)
+{
+    portENTER_CRITICAL(&g_lock);
+    heap_component_stats_t *c = &g_components[comp];
+    c->live_bytes += size;
+    c->live_blocks++;
+    c->allocs++;
+    if (c->live_bytes > c->peak_bytes) {
+        c->peak_bytes = c->live_bytes;
+    }
+    g_window_allocs++;
+    g_window_bytes += size;
+    record_site(comp, size, site);
+    portEXIT_CRITICAL(&g_lock);
+}
+
+static void record_free(heap_component_t comp, size_t size)
+{
+    portENTER_CRITICAL(&g_lock);
+    g_components[comp].live_bytes -= size;
+    g_components[comp].live_blocks--;
+    portEXIT_CRITICAL(&g_lock);
+}
+
+static void record_failure(heap_component_t comp, size_t size, const char *site)
+{
+    portENTER_CRITICAL(&g_lock);
+    g_components[comp].failures++;
+    portEXIT_CRITICAL(&g_lock);
+    ESP_LOGE(TAG, "分配失败 %s %u字节 @%s", COMPONENT_NAMES[comp], (unsigned)size, site);
+}
+
+#if CONFIG_APP_HEAP_ACCOUNTING
+
+void *heap_acct_malloc(heap_component_t comp, size_t size, const char *site)
+{
+    block_header_t *header = (block_header_t *)malloc(sizeof(block_header_t) + size);
+    if (!header) {
+        record_failure(comp, size, site);
+        return NULL;
+    }
+    header->size = size;
+    header->comp = comp;
+    header->magic = BLOCK_MAGIC;
+    record_alloc(comp, size, site);
+    return header + 1;
+}
+
+void heap_acct_free(void *ptr)
+{
+    if (!ptr) {
+        return;
+    }
+    block_header_t *header = (block_header_t *)ptr - 1;
+    assert(header->magic == BLOCK_MAGIC);
+    header->magic = 0;
+    record_free((heap_component_t)header->comp, header->size);
+    free(header);
+}
+
+static void *json_malloc(size_t size)
+{
+    return heap_acct_malloc(HEAP_COMP_JSON, size, JSON_SITE);
+}
+
+void heap_monitor_install_json_hooks(void)
+{
+    cJSON_Hooks hooks = {};
+    hooks.malloc_fn = json_malloc;
+    hooks.free_fn = heap_acct_free;
+    cJSON_InitHooks(&hooks);
+}
+
+char *heap_acct_json_print(heap_component_t comp, const cJSON *item, const char *site)
+{
+    char *str = cJSON_PrintUnformatted(item);
+    if (!str) {
+        record_failure(comp, 0, site);
+        return NULL;
+    }
+    // 分配已由钩子计入json组件和本区间，这里只改记到调用组件和调用点
+    block_header_t *header = (block_header_t *)str - 1;
+    assert(header->magic == BLOCK_MAGIC);
+    portENTER_CRITICAL(&g_lock);
+    g_components[HEAP_COMP_JSON].live_bytes -= header->size;
+    g_components[HEAP_COMP_JSON].live_blocks--;
+    g_components[HEAP_COMP_JSON].allocs--;
+    heap_component_stats_t *c = &g_components[comp];
+    c->live_bytes += header->size;
+    c->live_blocks++;
+    c->allocs++;
+    if (c->live_bytes > c->peak_bytes) {
+        c->peak_bytes = c->live_bytes;
+    }
+    record_site(comp, header->size, site);
+    portEXIT_CRITICAL(&g_lock);
+    header->comp = comp;
+    return str;
+}
+
+void heap_acct_json_free(heap_component_t comp, char *str)
+{
+    // 块头记录了组件，由钩子扣减
+    cJSON_free(str);
+}
+
+#endif /* CONFIG_APP_HEAP_ACCOUNTING */
+
+void heap_monitor_get_component(heap_component_t comp, heap_component_stats_t *stats)
+{
+    portENTER_CRITICAL(&g_lock);
+    *stats = g_components[comp];
+    portEXIT_CRITICAL(&g_lock);
+}
+
+static void sample_health(void)
+{
+#if !CONFIG_IDF_TARGET_LINUX
+    multi_heap_info_t info;
+    heap_caps_get_info(&info, MALLOC_CAP_8BIT);
+    uint32_t fragmentation = info.total_free_bytes ?
+                             100 - (uint32_t)((uint64_t)info.largest_free_block * 100 / info.total_free_bytes) : 0;
+
+    portENTER_CRITICAL(&g_lock);
+    g_health.free_bytes = info.total_free_bytes;
+    g_health.largest_free_block = info.largest_free_block;
+    g_health.min_free_bytes = info.minimum_free_bytes;
+    if (g_health.min_largest_free_block == 0 || info.largest_free_block < g_health.min_largest_free_block) {
+        g_health.min_largest_free_block = info.largest_free_block;
+    }
+    g_health.fragmentation_pct = fragmentation;
+    if (fragmentation > g_health.max_fragmentation_pct) {
+        g_health.max_fragmentation_pct = fragmentation;
+    }
+    portEXIT_CRITICAL(&g_lock);
+#endif
+}
+
+void heap_monitor_get_health(heap_health_t *health)
+{
+    sample_health();
+    portENTER_CRITICAL(&g_lock);
+    *health = g_health;
+    portEXIT_CRITICAL(&g_lock);
+}
+
+void heap_monitor_note_message(void)
+{
+    portENTER_CRITICAL(&g_lock);
+    g_window_messages++;
+    portEXIT_CRITICAL(&g_lock);
+}
+
+// 按分配次数打印前几个调用点
+static void report_top_sites(int top)
+{
+    site_stats_t sites[MAX_SITES];
+    portENTER_CRITICAL(&g_lock);
+    int count = g_site_count;
+    memcpy(sites, g_sites, count * sizeof(site_stats_t));
+    portEXIT_CRITICAL(&g_lock);
+
+    for (int n = 0; n < top && n < count; n++) {
+        int best = n;
+        for (int i = n + 1; i < count; i++) {
+            if (sites[i].count > sites[best].count) {
+                best = i;
+            }
+        }
+        site_stats_t tmp = sites[n];
+        sites[n] = sites[best];
+        sites[best] = tmp;
+        ESP_LOGI(TAG, "  调用点 %s [%s]: %" PRIu32 "次 共%" PRIu64 "字节 最大%" PRIu32,
+                 sites[n].site, COMPONENT_NAMES[sites[n].comp], sites[n].count, sites[n].bytes, sites[n].max_size);
+    }
+}
+
+esp_err_t heap_monitor_report(void)
+{
+    heap_health_t health;
+    heap_monitor_get_health(&health);
+    ESP_LOGI(TAG, "[Performance][heap_free_bytes]: %" PRIu32, health.free_bytes);
+    ESP_LOGI(TAG, "[Performance][heap_largest_free_block]: %" PRIu32 " (最低%" PRIu32 ")",
+             health.largest_free_block, health.min_largest_free_block);
+    ESP_LOGI(TAG, "[Performance][heap_min_free_bytes]: %" PRIu32, health.min_free_bytes);
+    ESP_LOGI(TAG, "[Performance][heap_fragmentation_pct]: %" PRIu32 " (最高%" PRIu32 ")",
+             health.fragmentation_pct, health.max_fragmentation_pct);
+
+    for (int i = 0; i < HEAP_COMP_MAX; i++) {
+        heap_component_stats_t c;
+        heap_monitor_get_component((heap_component_t)i, &c);
+        if (c.allocs == 0) {
+            continue;
+        }
+        ESP_LOGI(TAG, "  组件%-10s 占用%" PRIu32 "字节/%" PRIu32 "块 峰值%" PRIu32 " 分配%" PRIu32 "次 失败%" PRIu32,
+                 COMPONENT_NAMES[i], c.live_bytes, c.live_blocks, c.peak_bytes, c.allocs, c.failures);
+    }
+    report_top_sites(5);
+
+    portENTER_CRITICAL(&g_lock);
+    uint32_t allocs = g_window_allocs;
+    uint64_t bytes = g_window_bytes;
+    uint32_t messages = g_window_messages;
+    g_window_allocs = 0;
+    g_window_bytes = 0;
+    g_window_messages = 0;
+    portEXIT_CRITICAL(&g_lock);
+
+    if (messages == 0) {
+        return ESP_OK;
+    }
+    // 以千分之一为单位，避免浮点
+    uint32_t allocs_per_msg_x1000 = (uint64_t)allocs * 1000 / messages;
+    uint32_t bytes_per_msg = bytes / messages;
+    ESP_LOGI(TAG, "[Performance][heap_allocs_per_message]: %" PRIu32 ".%03" PRIu32,
+             allocs_per_msg_x1000 / 1000, allocs_per_msg_x1000 % 1000);
+    ESP_LOGI(TAG, "[Performance][heap_bytes_per_message]: %" PRIu32, bytes_per_msg);
+
+    bool exceeded = false;
+#if CONFIG_APP_HEAP_BUDGET_ALLOCS_PER_MSG > 0
+    exceeded |= allocs_per_msg_x1000 > CONFIG_APP_HEAP_BUDGET_ALLOCS_PER_MSG * 1000;
+#endif
+#if CONFIG_APP_HEAP_BUDGET_BYTES_PER_MSG > 0
+    exceeded |= bytes_per_msg > CONFIG_APP_HEAP_BUDGET_BYTES_PER_MSG;
+#endif
+    if (!exceeded) {
+        return ESP_OK;
+    }
+    ESP_LOGE(TAG, "❌ 每条消息的分配超出预算 (%" PRIu32 "条消息，%" PRIu32 "次分配，%" PRIu64 "字节)",
+             messages, allocs, bytes);
+#if CONFIG_APP_HEAP_BUDGET_ABORT
+    abort();
+#endif
+    return ESP_FAIL;
+}
+
+#if CONFIG_APP_HEAP_SAMPLE_S > 0
+static void sample_timer_cb(void *arg)
+{
+    heap_monitor_report();
+}
+#endif
+
+esp_err_t heap_monitor_start(void)
+{
+#if CONFIG_APP_HEAP_SAMPLE_S > 0
+    static esp_timer_handle_t timer = NULL;
+    if (timer) {
+        return ESP_OK;
+    }
+    esp_timer_create_args_t timer_args = {};
+    timer_args.callback = sample_timer_cb;
+    timer_args.name = "heap_monitor";
+    esp_err_t ret = esp_timer_create(&timer_args, &timer);
+    if (ret != ESP_OK) {
+        return ret;
+    }
+    return esp_timer_start_periodic(timer, (uint64_t)CONFIG_APP_HEAP_SAMPLE_S * 1000000);
+#else
+    return ESP_OK;
+#endif
+}
+
+void heap_monitor_add_json(cJSON *parent)
+{
+    heap_health_t health;
+    heap_monitor_get_health(&health);
+    cJSON *heap = cJSON_AddObjectToObject(parent, "heap");
+    cJSON_AddNumberToObject(heap, "free", health.free_bytes);
+    cJSON_AddNumberToObject(heap, "largestFree", health.largest_free_block);
+    cJSON_AddNumberToObject(heap, "minFree", health.min_free_bytes);
+    cJSON_AddNumberToObject(heap, "fragPct", health.fragmentation_pct);
+    cJSON_AddNumberToObject(heap, "maxFragPct", health.max_fragmentation_pct);
+
+    cJSON *components = cJSON_AddObjectToObject(heap, "components");
+    for (int i = 0; i < HEAP_COMP_MAX; i++) {
+        heap_component_stats_t c;
+        heap_monitor_get_component((heap_component_t)i, &c);
+        if (c.allocs == 0) {
+            continue;
+        }
+        cJSON *entry = cJSON_AddObjectToObject(components, COMPONENT_NAMES[i]);
+        cJSON_AddNumberToObject(entry, "live", c.live_bytes);
+        cJSON_AddNumberToObject(entry, "peak", c.peak_bytes);
+        cJSON_AddNumberToObject(entry, "allocs", c.allocs);
+    }
+}
@@ -0,0 +1,100 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include "esp_err.h"
+#include "cJSON.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// 内存记账的组件
+typedef enum {
+    HEAP_COMP_MQTT = 0,
+    HEAP_COMP_SIGNALING,
+    HEAP_COMP_WEBRTC,
+    HEAP_COMP_MEDIA,
+    HEAP_COMP_APP,
+    HEAP_COMP_JSON,                         // cJSON内部分配（解析树、节点），未经HEAP_JSON_PRINT归属到组件
+    HEAP_COMP_MAX,
+} heap_component_t;
+
+typedef struct {
+    uint32_t live_bytes;                    // 当前占用
+    uint32_t live_blocks;
+    uint32_t peak_bytes;                    // 占用峰值
+    uint32_t allocs;                        // 累计分配次数
+    uint32_t failures;                      // 分配失败次数
+} heap_component_stats_t;
+
+typedef struct {
+    uint32_t free_bytes;
+    uint32_t largest_free_block;
+    uint32_t min_free_bytes;                // 开机以来最小空闲（系统低水位）
+    uint32_t min_largest_free_block;        // 采样以来最大空闲块的最小值
+    uint32_t fragmentation_pct;             // 100 - 最大空闲块/空闲总量
+    uint32_t max_fragmentation_pct;
+} heap_health_t;
+
+#define HEAP_STR_(x) #x
+#define HEAP_STR(x) HEAP_STR_(x)
+#define HEAP_SITE __FILE__ ":" HEAP_STR(__LINE__)
+
+#if CONFIG_APP_HEAP_ACCOUNTING
+
+/**
+ * @brief 安装cJSON分配钩子，cJSON_Parse、cJSON_Create系列和cJSON_Print的分配都计入记账
+ *
+ * 须在第一次使用cJSON之前调用（app_main开头），之前由cJSON分配的块不能再由cJSON释放。
+ * ESP-MQTT内部的分配（收发缓冲区、outbox）不经过这里，不在统计内
+ */
+void heap_monitor_install_json_hooks(void);
+
+void *heap_acct_malloc(heap_component_t comp, size_t size, const char *site);
+void heap_acct_free(void *ptr);
+// cJSON输出的字符串由钩子记账，这里把它从json组件转到调用组件和调用点，需用heap_acct_json_free释放
+char *heap_acct_json_print(heap_component_t comp, const cJSON *item, const char *site);
+void heap_acct_json_free(heap_component_t comp, char *str);
+
+#define HEAP_MALLOC(comp, size)      heap_acct_malloc((comp), (size), HEAP_SITE)
+#define HEAP_FREE(ptr)               heap_acct_free(ptr)
+#define HEAP_JSON_PRINT(comp, item)  heap_acct_json_print((comp), (item), HEAP_SITE)
+#define HEAP_JSON_FREE(comp, str)    heap_acct_json_free((comp), (str))
+
+#else
+
+#define heap_monitor_install_json_hooks()
+#define HEAP_MALLOC(comp, size)      malloc(size)
+#define HEAP_FREE(ptr)               free(ptr)
+#define HEAP_JSON_PRINT(comp, item)  cJSON_PrintUnformatted(item)
+#define HEAP_JSON_FREE(comp, str)    cJSON_free(str)
+
+#endif /* CONFIG_APP_HEAP_ACCOUNTING */
+
+void heap_monitor_get_component(heap_component_t comp, heap_component_stats_t *stats);
+void heap_monitor_get_health(heap_health_t *health);
+
+/**
+ * @brief 记录处理了一条消息，用于计算每条消息的分配次数和字节数
+ */
+void heap_monitor_note_message(void);
+
+/**
+ * @brief 立即采样并打印堆健康、各组件占用和分配最多的调用点
+ *
+ * 配置了每消息预算时检查本采样区间是否超出
+ * @return 超出预算返回ESP_FAIL
+ */
+esp_err_t heap_monitor_report(void);
+
+// 按CONFIG_APP_HEAP_SAMPLE_S周期采样，0表示不启动
+esp_err_t heap_monitor_start(void);
+
+// 附加到JSON对象（如状态回复）
+void heap_monitor_add_json(cJSON *parent);
+
+#ifdef __cplusplus
+}
+#endif
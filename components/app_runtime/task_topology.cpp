@@ -0,0 +1,190 @@
+#include "task_topology.hpp"
+
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+#include "esp_log.h"
+#include "esp_timer.h"
+
+static const char *TAG = "task_topology";
+
+static app_task_config_t g_tasks[APP_TASK_MAX] = {
+    { "webrtc_main",  CONFIG_APP_TASK_PEER_STACK,      CONFIG_APP_TASK_PEER_PRIORITY,      CONFIG_APP_TASK_PEER_CORE },
+    { "media",        CONFIG_APP_TASK_MEDIA_STACK,     CONFIG_APP_TASK_MEDIA_PRIORITY,     CONFIG_APP_TASK_MEDIA_CORE },
+    { "button_event", CONFIG_APP_TASK_INPUT_STACK,     CONFIG_APP_TASK_INPUT_PRIORITY,     CONFIG_APP_TASK_INPUT_CORE },
+    { "heartbeat",    CONFIG_APP_TASK_HEARTBEAT_STACK, CONFIG_APP_TASK_HEARTBEAT_PRIORITY, CONFIG_APP_TASK_HEARTBEAT_CORE },
+    { "audio_capture", CONFIG_APP_TASK_CAPTURE_STACK,  CONFIG_APP_TASK_CAPTURE_PRIORITY,  CONFIG_APP_TASK_CAPTURE_CORE },
+    { "video_send",   CONFIG_APP_TASK_VIDEO_STACK,     CONFIG_APP_TASK_VIDEO_PRIORITY,     CONFIG_APP_TASK_VIDEO_CORE },
+    { "audio_mixer",  CONFIG_APP_TASK_MIXER_STACK,     CONFIG_APP_TASK_MIXER_PRIORITY,     CONFIG_APP_TASK_MIXER_CORE },
+    { "event_capture", CONFIG_APP_TASK_RECORDER_STACK, CONFIG_APP_TASK_RECORDER_PRIORITY, CONFIG_APP_TASK_RECORDER_CORE },
+    { "peer_open",    CONFIG_APP_TASK_PEER_STACK,      CONFIG_APP_TASK_PEER_PRIORITY,      CONFIG_APP_TASK_PEER_CORE },
+};
+
+const app_task_config_t *task_topology_get(app_task_id_t id)
+{
+    if (id >= APP_TASK_MAX) {
+        return NULL;
+    }
+    return &g_tasks[id];
+}
+
+esp_err_t task_topology_set(app_task_id_t id, const app_task_config_t *config)
+{
+    if (id >= APP_TASK_MAX || !config || config->stack_size < 2048 ||
+        config->priority >= configMAX_PRIORITIES ||
+        (config->core != APP_TASK_NO_AFFINITY && (config->core < 0 || config->core >= portNUM_PROCESSORS))) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    const char *name = config->name ? config->name : g_tasks[id].name;
+    g_tasks[id] = *config;
+    g_tasks[id].name = name;
+    return ESP_OK;
+}
+
+esp_err_t task_topology_create(app_task_id_t id, TaskFunction_t fn, void *arg, TaskHandle_t *handle)
+{
+    const app_task_config_t *cfg = task_topology_get(id);
+    if (!cfg) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    BaseType_t core = cfg->core == APP_TASK_NO_AFFINITY ? tskNO_AFFINITY : cfg->core;
+    if (xTaskCreatePinnedToCore(fn, cfg->name, cfg->stack_size, arg, cfg->priority, handle, core) != pdPASS) {
+        ESP_LOGE(TAG, "创建任务%s失败", cfg->name);
+        return ESP_ERR_NO_MEM;
+    }
+    ESP_LOGI(TAG, "任务%s: 核心%d 优先级%u 栈%" PRIu32, cfg->name, cfg->core, (unsigned)cfg->priority, cfg->stack_size);
+    return ESP_OK;
+}
+
+void task_topology_apply_mqtt(esp_mqtt_client_config_t *cfg)
+{
+    cfg->task.priority = CONFIG_APP_TASK_MQTT_PRIORITY;
+    cfg->task.stack_size = CONFIG_APP_TASK_MQTT_STACK;
+}
+
+#if CONFIG_FREERTOS_GENERATE_RUN_TIME_STATS && CONFIG_FREERTOS_USE_TRACE_FACILITY
+
+// 查询任务数之后到取快照之前可能有新任务创建，多留几项
+#define LOAD_TASK_HEADROOM 4
+
+typedef struct {
+    TaskHandle_t handle;
+    configRUN_TIME_COUNTER_TYPE runtime;
+} load_sample_t;
+
+// 上一次采样，用于计算区间占用
+static load_sample_t *g_prev = NULL;
+static int g_prev_count = 0;
+static configRUN_TIME_COUNTER_TYPE g_prev_total = 0;
+
+static configRUN_TIME_COUNTER_TYPE prev_runtime(TaskHandle_t handle)
+{
+    for (int i = 0; i < g_prev_count; i++) {
+        if (g_prev[i].handle == handle) {
+            return g_prev[i].runtime;
+        }
+    }
+    return 0;
+}
+
+void task_topology_report_cpu_load(void)
+{
+    UBaseType_t capacity = uxTaskGetNumberOfTasks() + LOAD_TASK_HEADROOM;
+    TaskStatus_t *status = (TaskStatus_t *)malloc(capacity * sizeof(TaskStatus_t));
+    if (!status) {
+        ESP_LOGW(TAG, "CPU占用统计: 分配%u个任务的快照失败", (unsigned)capacity);
+        return;
+    }
+    configRUN_TIME_COUNTER_TYPE total = 0;
+    UBaseType_t count = uxTaskGetSystemState(status, capacity, &total);
+    if (count == 0) {
+        // 数组放不下全部任务时FreeRTOS不填写任何一项，保留上一次采样，下次按新的任务数重试
+        ESP_LOGW(TAG, "CPU占用统计: 任务数超过%u，本次跳过", (unsigned)capacity);
+        free(status);
+        return;
+    }
+
+    // 运行时间按每个核心分别累计，总时间需乘以核心数
+    uint64_t elapsed = (uint64_t)(configRUN_TIME_COUNTER_TYPE)(total - g_prev_total) * portNUM_PROCESSORS;
+    if (g_prev_total != 0 && elapsed > 0) {
+        uint64_t core_busy[portNUM_PROCESSORS + 1] = {};
+        for (UBaseType_t i = 0; i < count; i++) {
+            uint64_t delta = (configRUN_TIME_COUNTER_TYPE)(status[i].ulRunTimeCounter - prev_runtime(status[i].xHandle));
+            BaseType_t core = xTaskGetCoreID(status[i].xHandle);
+            bool idle = strncmp(status[i].pcTaskName, "IDLE", 4) == 0;
+            if (!idle) {
+                core_busy[core == tskNO_AFFINITY ? portNUM_PROCESSORS : core] += delta;
+            }
+            uint32_t permille = delta * 1000 / elapsed;
+            if (permille == 0 && !idle) {
+                continue;
+            }
+            ESP_LOGI(TAG, "[Performance][task_cpu_load] %-16s core=%2d prio=%2u cpu=%3" PRIu32 ".%" PRIu32 "%% stack_free=%" PRIu32,
+                     status[i].pcTaskName, core == tskNO_AFFINITY ? -1 : (int)core, (unsigned)status[i].uxCurrentPriority,
+                     permille / 10, permille % 10, (uint32_t)status[i].usStackHighWaterMark);
+        }
+        uint64_t per_core = elapsed / portNUM_PROCESSORS;
+        for (int c = 0; c < portNUM_PROCESSORS; c++) {
+            ESP_LOGI(TAG, "[Performance][core%d_pinned_busy_pct]: %" PRIu32, c, (uint32_t)(core_busy[c] * 100 / per_core));
+        }
+        ESP_LOGI(TAG, "[Performance][unpinned_busy_pct]: %" PRIu32, (uint32_t)(core_busy[portNUM_PROCESSORS] * 100 / elapsed));
+    }
+
+    if (count > (UBaseType_t)g_prev_count) {
+        free(g_prev);
+        g_prev = (load_sample_t *)malloc(count * sizeof(load_sample_t));
+    }
+    if (!g_prev) {
+        // 没有上一次采样时下次只建立基线
+        ESP_LOGW(TAG, "CPU占用统计: 分配%u个任务的采样失败", (unsigned)count);
+        g_prev_count = 0;
+        g_prev_total = 0;
+        free(status);
+        return;
+    }
+    g_prev_count = count;
+    for (UBaseType_t i = 0; i < count; i++) {
+        g_prev[i].handle = status[i].xHandle;
+        g_prev[i].runtime = status[i].ulRunTimeCounter;
+    }
+    g_prev_total = total;
+    free(status);
+}
+
+#else
+
+void task_topology_report_cpu_load(void)
+{
+    ESP_LOGW(TAG, "CPU占用统计需要启用CONFIG_FREERTOS_GENERATE_RUN_TIME_STATS和CONFIG_FREERTOS_USE_TRACE_FACILITY");
+}
+
+#endif
+
+#if CONFIG_APP_TASK_LOAD_REPORT_S > 0
+static void load_report_timer_cb(void *arg)
+{
+    task_topology_report_cpu_load();
+}
+#endif
+
+esp_err_t task_topology_start_load_report(void)
+{
+#if CONFIG_APP_TASK_LOAD_REPORT_S > 0
+    static esp_timer_handle_t timer = NULL;
+    if (timer) {
+        return ESP_OK;
+    }
+    esp_timer_create_args_t timer_args = {};
+    timer_args.callback = load_report_timer_cb;
+    timer_args.name = "task_load";
+    esp_err_t ret = esp_timer_create(&timer_args, &timer);
+    if (ret != ESP_OK) {
+        return ret;
+    }
+    // 先取一次基准样本
+    task_topology_report_cpu_load();
+    return esp_timer_start_periodic(timer, (uint64_t)CONFIG_APP_TASK_LOAD_REPORT_S * 1000000);
+#else
+    return ESP_OK;
+#endif
+}
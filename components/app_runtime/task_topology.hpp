@@ -0,0 +1,68 @@
+#pragma once
+
+#include <stdint.h>
+#include "esp_err.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "mqtt_client.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// 应用任务（ESP-MQTT、Wi-Fi、lwIP任务由各自组件的Kconfig指定核心）
+typedef enum {
+    APP_TASK_PEER = 0,                      // WebRTC Peer主循环（网络I/O）
+    APP_TASK_MEDIA,                         // 媒体采集/编码
+    APP_TASK_INPUT,                         // 按键事件
+    APP_TASK_HEARTBEAT,                     // 心跳与状态打印
+    APP_TASK_CAPTURE,                       // 音频PCM采集
+    APP_TASK_VIDEO,                         // 视频读取与节拍发送
+    APP_TASK_MIXER,                         // 多路音频解码混音
+    APP_TASK_RECORDER,                      // 事件录制写出
+    APP_TASK_PEER_OPEN,                     // 联网期间预打开Peer（DTLS密钥和证书生成），沿用PEER的配置
+    APP_TASK_MAX,
+} app_task_id_t;
+
+#define APP_TASK_NO_AFFINITY (-1)
+
+typedef struct {
+    const char *name;
+    uint32_t stack_size;
+    UBaseType_t priority;
+    int core;                               // APP_TASK_NO_AFFINITY表示不绑定核心
+} app_task_config_t;
+
+/**
+ * @brief 获取任务配置（默认值来自Kconfig）
+ */
+const app_task_config_t *task_topology_get(app_task_id_t id);
+
+/**
+ * @brief 运行时覆盖任务配置，只影响之后创建的任务
+ *
+ * name为NULL时保留原名称
+ */
+esp_err_t task_topology_set(app_task_id_t id, const app_task_config_t *config);
+
+/**
+ * @brief 按拓扑配置创建任务
+ */
+esp_err_t task_topology_create(app_task_id_t id, TaskFunction_t fn, void *arg, TaskHandle_t *handle);
+
+// 在esp_mqtt_client_init之前调用，设置MQTT任务的优先级和栈
+void task_topology_apply_mqtt(esp_mqtt_client_config_t *cfg);
+
+/**
+ * @brief 打印各任务自上次调用以来的CPU占用
+ *
+ * 需启用CONFIG_FREERTOS_GENERATE_RUN_TIME_STATS和CONFIG_FREERTOS_USE_TRACE_FACILITY
+ */
+void task_topology_report_cpu_load(void);
+
+// 按CONFIG_APP_TASK_LOAD_REPORT_S周期打印CPU占用，0表示不启动
+esp_err_t task_topology_start_load_report(void);
+
+#ifdef __cplusplus
+}
+#endif
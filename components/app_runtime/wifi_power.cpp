@@ -0,0 +1,342 @@
+#include "wifi_power.hpp"
+
+#include <string.h>
+#include <inttypes.h>
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#if !CONFIG_IDF_TARGET_LINUX
+#include "esp_wifi.h"
+#endif
+#if CONFIG_APP_WIFI_PS_PING_S > 0
+#include "esp_netif.h"
+#include "ping/ping_sock.h"
+#endif
+
+#if CONFIG_APP_WIFI_POWER_SAVE
+
+/*
+ * Wi-Fi省电策略
+ *
+ * 进入WIFI_PS_NONE立即生效（占用方紧接着就要收发）；退出时延迟一段时间，ICE重启、
+ * 热重启之间的短暂空档不来回切换。切换在调用方的任务中完成，g_apply_lock保证
+ * 并发的占用/释放按最终状态生效。
+ */
+
+static const char *TAG = "wifi_power";
+
+#if CONFIG_APP_WIFI_PS_IDLE_MAX_MODEM
+#define WIFI_POWER_IDLE_MODE WIFI_POWER_MODE_MAX_MODEM
+#else
+#define WIFI_POWER_IDLE_MODE WIFI_POWER_MODE_MIN_MODEM
+#endif
+
+static const char *const MODE_NAMES[WIFI_POWER_MODE_MAX] = {"none", "min_modem", "max_modem"};
+static const uint32_t MODE_CURRENT_MA[WIFI_POWER_MODE_MAX] = {
+    CONFIG_APP_WIFI_PS_CURRENT_NONE_MA,
+    CONFIG_APP_WIFI_PS_CURRENT_MIN_MODEM_MA,
+    CONFIG_APP_WIFI_PS_CURRENT_MAX_MODEM_MA,
+};
+
+static esp_err_t default_set_mode(wifi_power_mode_t mode, void *ctx);
+
+static wifi_power_ops_t g_ops = {default_set_mode, NULL};
+static bool g_ready = false;
+static SemaphoreHandle_t g_apply_lock = NULL;
+static esp_timer_handle_t g_idle_timer = NULL;
+static esp_timer_handle_t g_report_timer = NULL;
+
+static portMUX_TYPE g_lock = portMUX_INITIALIZER_UNLOCKED;
+static uint32_t g_holds = 0;
+static int64_t g_idle_due_us = 0;           // 占用全部释放后进入空闲模式的时间
+static wifi_power_mode_t g_mode = WIFI_POWER_MODE_NONE;
+static int64_t g_mode_since_us = 0;
+static uint64_t g_time_us[WIFI_POWER_MODE_MAX];
+static uint32_t g_switches = 0;
+static uint32_t g_switch_errors = 0;
+static uint64_t g_latency_sum_us[WIFI_POWER_MODE_MAX];
+static uint32_t g_latency_count[WIFI_POWER_MODE_MAX];
+static uint32_t g_latency_max_us[WIFI_POWER_MODE_MAX];
+
+#if CONFIG_IDF_TARGET_LINUX
+// linux目标没有Wi-Fi驱动：只记录模式，策略和统计照常运行
+static esp_err_t default_set_mode(wifi_power_mode_t mode, void *ctx)
+{
+    ESP_LOGD(TAG, "[桩] 省电模式: %s", MODE_NAMES[mode]);
+    return ESP_OK;
+}
+#else
+static esp_err_t default_set_mode(wifi_power_mode_t mode, void *ctx)
+{
+    static const wifi_ps_type_t PS_TYPES[WIFI_POWER_MODE_MAX] = {WIFI_PS_NONE, WIFI_PS_MIN_MODEM, WIFI_PS_MAX_MODEM};
+    return esp_wifi_set_ps(PS_TYPES[mode]);
+}
+#endif
+
+static void apply(void)
+{
+    xSemaphoreTake(g_apply_lock, portMAX_DELAY);
+    int64_t now = esp_timer_get_time();
+    portENTER_CRITICAL(&g_lock);
+    wifi_power_mode_t from = g_mode;
+    wifi_power_mode_t target = from;
+    uint32_t holds = g_holds;
+    if (holds) {
+        target = WIFI_POWER_MODE_NONE;
+    } else if (now >= g_idle_due_us) {
+        target = WIFI_POWER_IDLE_MODE;
+    }
+    portEXIT_CRITICAL(&g_lock);
+
+    if (target != from) {
+        esp_err_t err = g_ops.set_mode(target, g_ops.ctx);
+        int64_t done = esp_timer_get_time();
+        portENTER_CRITICAL(&g_lock);
+        if (err == ESP_OK) {
+            g_time_us[from] += done - g_mode_since_us;
+            g_mode_since_us = done;
+            g_mode = target;
+            g_switches++;
+        } else {
+            g_switch_errors++;
+        }
+        portEXIT_CRITICAL(&g_lock);
+        if (err == ESP_OK) {
+            ESP_LOGI(TAG, "📶 Wi-Fi省电: %s -> %s（占用0x%" PRIx32 "，切换%" PRIu32 "us）",
+                     MODE_NAMES[from], MODE_NAMES[target], holds, (uint32_t)(done - now));
+        } else {
+            ESP_LOGW(TAG, "切换省电模式到%s失败: %s", MODE_NAMES[target], esp_err_to_name(err));
+        }
+    }
+    xSemaphoreGive(g_apply_lock);
+}
+
+static void idle_timer_cb(void *arg)
+{
+    apply();
+}
+
+#if CONFIG_APP_WIFI_PS_REPORT_S > 0
+static void report_timer_cb(void *arg)
+{
+    wifi_power_report();
+}
+#endif
+
+#if CONFIG_APP_WIFI_PS_PING_S > 0
+// 网关ping的往返时延反映下行包在AP处等待设备醒来的时间
+static void ping_success_cb(esp_ping_handle_t handle, void *args)
+{
+    uint32_t elapsed_ms = 0;
+    esp_ping_get_profile(handle, ESP_PING_PROF_TIMEGAP, &elapsed_ms, sizeof(elapsed_ms));
+    wifi_power_note_rx_latency(elapsed_ms * 1000);
+}
+
+static void start_gateway_ping(void)
+{
+    esp_netif_t *netif = esp_netif_get_handle_from_ifkey("WIFI_STA_DEF");
+    esp_netif_ip_info_t info = {};
+    if (!netif || esp_netif_get_ip_info(netif, &info) != ESP_OK || info.gw.addr == 0) {
+        ESP_LOGW(TAG, "没有网关地址，不做时延采样");
+        return;
+    }
+    esp_ping_config_t config = ESP_PING_DEFAULT_CONFIG();
+    config.target_addr.type = IPADDR_TYPE_V4;
+    config.target_addr.u_addr.ip4.addr = info.gw.addr;
+    config.count = ESP_PING_COUNT_INFINITE;
+    config.interval_ms = CONFIG_APP_WIFI_PS_PING_S * 1000;
+    esp_ping_callbacks_t callbacks = {};
+    callbacks.on_ping_success = ping_success_cb;
+    esp_ping_handle_t handle = NULL;
+    if (esp_ping_new_session(&config, &callbacks, &handle) != ESP_OK || esp_ping_start(handle) != ESP_OK) {
+        ESP_LOGW(TAG, "网关ping启动失败");
+    }
+}
+#endif
+
+esp_err_t wifi_power_init(void)
+{
+    if (g_ready) {
+        return ESP_OK;
+    }
+    g_apply_lock = xSemaphoreCreateMutex();
+    if (!g_apply_lock) {
+        return ESP_ERR_NO_MEM;
+    }
+    esp_timer_create_args_t timer_args = {};
+    timer_args.callback = idle_timer_cb;
+    timer_args.name = "wifi_ps_idle";
+    esp_err_t ret = esp_timer_create(&timer_args, &g_idle_timer);
+    if (ret != ESP_OK) {
+        return ret;
+    }
+
+    // 联网过程中驱动处于默认模式，开始计时前先切到空闲模式
+    ret = g_ops.set_mode(WIFI_POWER_IDLE_MODE, g_ops.ctx);
+    if (ret != ESP_OK) {
+        ESP_LOGW(TAG, "设置省电模式失败（未使用Wi-Fi？），省电策略不生效: %s", esp_err_to_name(ret));
+        return ret;
+    }
+    g_mode = WIFI_POWER_IDLE_MODE;
+    g_mode_since_us = esp_timer_get_time();
+    g_ready = true;
+    ESP_LOGI(TAG, "Wi-Fi省电策略已启用: 空闲%s，会话期间none，释放后%dms进入空闲",
+             MODE_NAMES[WIFI_POWER_IDLE_MODE], CONFIG_APP_WIFI_PS_IDLE_DELAY_MS);
+
+#if CONFIG_APP_WIFI_PS_REPORT_S > 0
+    timer_args.callback = report_timer_cb;
+    timer_args.name = "wifi_ps_report";
+    if (esp_timer_create(&timer_args, &g_report_timer) == ESP_OK) {
+        esp_timer_start_periodic(g_report_timer, (uint64_t)CONFIG_APP_WIFI_PS_REPORT_S * 1000000);
+    }
+#endif
+#if CONFIG_APP_WIFI_PS_PING_S > 0
+    start_gateway_ping();
+#endif
+    return ESP_OK;
+}
+
+void wifi_power_set_ops(const wifi_power_ops_t *ops)
+{
+    if (ops && ops->set_mode) {
+        g_ops = *ops;
+    }
+}
+
+void wifi_power_acquire(uint32_t holds)
+{
+    if (!g_ready) {
+        return;
+    }
+    portENTER_CRITICAL(&g_lock);
+    bool changed = (g_holds | holds) != g_holds;
+    g_holds |= holds;
+    portEXIT_CRITICAL(&g_lock);
+    if (changed) {
+        esp_timer_stop(g_idle_timer);
+        apply();
+    }
+}
+
+void wifi_power_release(uint32_t holds)
+{
+    if (!g_ready) {
+        return;
+    }
+    portENTER_CRITICAL(&g_lock);
+    bool idle = g_holds && !(g_holds & ~holds);
+    g_holds &= ~holds;
+    if (idle) {
+        g_idle_due_us = esp_timer_get_time() + (int64_t)CONFIG_APP_WIFI_PS_IDLE_DELAY_MS * 1000;
+    }
+    portEXIT_CRITICAL(&g_lock);
+    if (!idle) {
+        return;
+    }
+    if (CONFIG_APP_WIFI_PS_IDLE_DELAY_MS == 0) {
+        apply();
+    } else {
+        esp_timer_stop(g_idle_timer);
+        esp_timer_start_once(g_idle_timer, (uint64_t)CONFIG_APP_WIFI_PS_IDLE_DELAY_MS * 1000);
+    }
+}
+
+wifi_power_mode_t wifi_power_get_mode(void)
+{
+    return g_mode;
+}
+
+void wifi_power_note_rx_latency(uint32_t us)
+{
+    portENTER_CRITICAL(&g_lock);
+    wifi_power_mode_t mode = g_mode;
+    g_latency_sum_us[mode] += us;
+    g_latency_count[mode]++;
+    if (us > g_latency_max_us[mode]) {
+        g_latency_max_us[mode] = us;
+    }
+    portEXIT_CRITICAL(&g_lock);
+}
+
+void wifi_power_get_stats(wifi_power_stats_t *stats)
+{
+    if (!stats) {
+        return;
+    }
+    memset(stats, 0, sizeof(*stats));
+    int64_t now = esp_timer_get_time();
+    portENTER_CRITICAL(&g_lock);
+    stats->mode = g_mode;
+    stats->holds = g_holds;
+    stats->switches = g_switches;
+    stats->switch_errors = g_switch_errors;
+    for (int i = 0; i < WIFI_POWER_MODE_MAX; i++) {
+        stats->time_us[i] = g_time_us[i];
+        stats->rx_latency[i].count = g_latency_count[i];
+        stats->rx_latency[i].max_us = g_latency_max_us[i];
+        stats->rx_latency[i].avg_us = g_latency_count[i] ? (uint32_t)(g_latency_sum_us[i] / g_latency_count[i]) : 0;
+    }
+    if (g_ready) {
+        stats->time_us[g_mode] += now - g_mode_since_us;
+    }
+    portEXIT_CRITICAL(&g_lock);
+
+    // mA * us / 3.6e6 = uAh
+    uint64_t ma_us = 0;
+    uint64_t total_us = 0;
+    for (int i = 0; i < WIFI_POWER_MODE_MAX; i++) {
+        ma_us += stats->time_us[i] * MODE_CURRENT_MA[i];
+        total_us += stats->time_us[i];
+    }
+    stats->est_charge_uah = (uint32_t)(ma_us / 3600000);
+    stats->est_avg_ma = total_us ? (uint32_t)(ma_us / total_us) : 0;
+}
+
+void wifi_power_add_json(cJSON *json)
+{
+    wifi_power_stats_t stats;
+    wifi_power_get_stats(&stats);
+    cJSON *power = cJSON_AddObjectToObject(json, "power");
+    cJSON_AddStringToObject(power, "mode", MODE_NAMES[stats.mode]);
+    cJSON_AddNumberToObject(power, "switches", stats.switches);
+    cJSON_AddNumberToObject(power, "estAvgMa", stats.est_avg_ma);
+    cJSON_AddNumberToObject(power, "estChargeUah", stats.est_charge_uah);
+    cJSON *modes = cJSON_AddObjectToObject(power, "modes");
+    for (int i = 0; i < WIFI_POWER_MODE_MAX; i++) {
+        if (stats.time_us[i] == 0 && stats.rx_latency[i].count == 0) {
+            continue;
+        }
+        cJSON *entry = cJSON_AddObjectToObject(modes, MODE_NAMES[i]);
+        cJSON_AddNumberToObject(entry, "timeMs", (double)(stats.time_us[i] / 1000));
+        cJSON_AddNumberToObject(entry, "rxLatencyAvgUs", stats.rx_latency[i].avg_us);
+        cJSON_AddNumberToObject(entry, "rxLatencyMaxUs", stats.rx_latency[i].max_us);
+        cJSON_AddNumberToObject(entry, "rxLatencySamples", stats.rx_latency[i].count);
+    }
+}
+
+void wifi_power_report(void)
+{
+    wifi_power_stats_t stats;
+    wifi_power_get_stats(&stats);
+    uint64_t total_us = 0;
+    for (int i = 0; i < WIFI_POWER_MODE_MAX; i++) {
+        total_us += stats.time_us[i];
+    }
+    for (int i = 0; i < WIFI_POWER_MODE_MAX; i++) {
+        if (stats.time_us[i] == 0) {
+            continue;
+        }
+        ESP_LOGI(TAG, "[Performance][wifi_ps_time_pct][%s]: %" PRIu32 " (%" PRIu32 "s，估计%" PRIu32 "mA)",
+                 MODE_NAMES[i], (uint32_t)(stats.time_us[i] * 100 / total_us),
+                 (uint32_t)(stats.time_us[i] / 1000000), MODE_CURRENT_MA[i]);
+        if (stats.rx_latency[i].count) {
+            ESP_LOGI(TAG, "[Performance][wifi_ps_rx_latency_us][%s]: 平均%" PRIu32 " 最大%" PRIu32 " (%" PRIu32 "个样本)",
+                     MODE_NAMES[i], stats.rx_latency[i].avg_us, stats.rx_latency[i].max_us, stats.rx_latency[i].count);
+        }
+    }
+    ESP_LOGI(TAG, "[Performance][wifi_ps_est_current_ma]: %" PRIu32 " (累计%" PRIu32 "uAh，切换%" PRIu32 "次，当前%s)",
+             stats.est_avg_ma, stats.est_charge_uah, stats.switches, MODE_NAMES[stats.mode]);
+}
+
+#endif /* CONFIG_APP_WIFI_POWER_SAVE */
@@ -0,0 +1,86 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "esp_err.h"
+#include "cJSON.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Wi-Fi省电策略（CONFIG_APP_WIFI_POWER_SAVE）
+ *
+ * 有媒体或ICE检查进行时关闭省电（WIFI_PS_NONE），下行包不必等AP的DTIM信标；
+ * 所有占用释放CONFIG_APP_WIFI_PS_IDLE_DELAY_MS后进入空闲模式（默认WIFI_PS_MAX_MODEM），
+ * 只有MQTT连接时也保持空闲模式，保活报文照常收发。
+ *
+ * 统计每种模式的停留时间，按Kconfig中各模式的电流估计值累计电量；接收时延按当时的模式
+ * 分别统计，来源为可选的网关ping（CONFIG_APP_WIFI_PS_PING_S）和wifi_power_note_rx_latency。
+ */
+
+typedef enum {
+    WIFI_POWER_MODE_NONE = 0,               // 不省电
+    WIFI_POWER_MODE_MIN_MODEM,              // 每个DTIM醒来
+    WIFI_POWER_MODE_MAX_MODEM,              // 按listen_interval醒来
+    WIFI_POWER_MODE_MAX,
+} wifi_power_mode_t;
+
+// 需要关闭省电的原因，任一位被占用即为WIFI_POWER_MODE_NONE
+#define WIFI_POWER_HOLD_ICE     (1u << 0)   // ICE候选收集、连通性检查
+#define WIFI_POWER_HOLD_MEDIA   (1u << 1)   // 媒体或数据通道会话
+
+// 实际切换模式的后端，设备上为esp_wifi_set_ps，linux目标为只记录模式的桩；主机测试可替换
+typedef struct {
+    esp_err_t (*set_mode)(wifi_power_mode_t mode, void *ctx);
+    void *ctx;
+} wifi_power_ops_t;
+
+typedef struct {
+    uint32_t avg_us;
+    uint32_t max_us;
+    uint32_t count;
+} wifi_power_latency_t;
+
+typedef struct {
+    wifi_power_mode_t mode;
+    uint32_t holds;
+    uint32_t switches;                      // 实际切换次数
+    uint32_t switch_errors;
+    uint64_t time_us[WIFI_POWER_MODE_MAX];  // 各模式累计停留时间（含当前这段）
+    uint32_t est_charge_uah;                // 按各模式电流估计累计的电量
+    uint32_t est_avg_ma;                    // 平均电流估计
+    wifi_power_latency_t rx_latency[WIFI_POWER_MODE_MAX];
+} wifi_power_stats_t;
+
+/**
+ * @brief 网络连接后调用：进入空闲模式，按配置启动网关ping
+ *
+ * 由app_network_start调用，重复调用直接返回
+ */
+esp_err_t wifi_power_init(void);
+
+// 替换后端，需在wifi_power_init之前调用
+void wifi_power_set_ops(const wifi_power_ops_t *ops);
+
+// 占用/释放，WebRTC客户端按连接状态调用，可在任意任务中调用
+void wifi_power_acquire(uint32_t holds);
+void wifi_power_release(uint32_t holds);
+
+wifi_power_mode_t wifi_power_get_mode(void);
+
+// 记录一次接收时延样本（如时延探测的往返时延），计入当前模式
+void wifi_power_note_rx_latency(uint32_t us);
+
+void wifi_power_get_stats(wifi_power_stats_t *stats);
+
+// 把统计加入设备状态消息（"power"对象）
+void wifi_power_add_json(cJSON *json);
+
+// 打印各模式的停留时间、接收时延和电流估计
+void wifi_power_report(void);
+
+#ifdef __cplusplus
+}
+#endif
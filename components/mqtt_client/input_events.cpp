@@ -0,0 +1,206 @@
+#include "input_events.hpp"
+
+#include <inttypes.h>
+#include "esp_log.h"
+#include "esp_attr.h"
+#include "esp_timer.h"
+#include "freertos/timers.h"
+#if !CONFIG_IDF_TARGET_LINUX
+#include "driver/gpio.h"
+#endif
+
+/*
+ * 中断驱动的按键事件
+ *
+ * 跳变中断只记录时间并重置消抖定时器（期间屏蔽跳变中断），
+ * 定时器到期后读取稳定电平：按下记录起点，释放时按时长分类并投递事件。
+ * 空闲时没有任何周期唤醒。
+ */
+
+static const char *TAG = "input_events";
+
+static const input_source_t *g_source = NULL;
+static QueueHandle_t g_queue = NULL;
+static TimerHandle_t g_debounce_timer = NULL;
+
+static int g_stable_level = 1;              // 上拉，默认高电平
+static volatile int64_t g_edge_us = 0;      // 最近一次跳变时间
+static int64_t g_press_us = 0;
+
+/**
+ * @brief 消抖定时器回调（定时器服务任务中执行）
+ */
+static void debounce_timer_cb(TimerHandle_t timer)
+{
+    int level = g_source->get_level();
+    if (g_source->enable_edge) {
+        g_source->enable_edge(true);
+        // 屏蔽期间电平又变化且无新中断时，重新消抖
+        if (g_source->get_level() != level) {
+            xTimerReset(g_debounce_timer, 0);
+            return;
+        }
+    }
+    if (level == g_stable_level) {
+        return;
+    }
+    g_stable_level = level;
+
+    if (level == 0) {
+        g_press_us = g_edge_us;
+        return;
+    }
+
+    int64_t release_us = g_edge_us;
+    uint32_t press_ms = (release_us - g_press_us) / 1000;
+    if (press_ms < CONFIG_MQTT_CLIENT_BUTTON_MIN_PRESS_MS) {
+        return;
+    }
+    input_event_t event = {};
+    event.type = press_ms >= CONFIG_MQTT_CLIENT_BUTTON_LONG_PRESS_MS ? INPUT_EVENT_LONG_PRESS : INPUT_EVENT_SHORT_PRESS;
+    event.press_ms = press_ms;
+    event.release_us = release_us;
+    if (xQueueSend(g_queue, &event, 0) != pdTRUE) {
+        ESP_LOGW(TAG, "按键事件队列已满，丢弃事件");
+    }
+}
+
+void IRAM_ATTR input_events_notify_edge_from_isr(void)
+{
+    BaseType_t woken = pdFALSE;
+    g_edge_us = esp_timer_get_time();
+    if (g_source->enable_edge) {
+        g_source->enable_edge(false);
+    }
+    xTimerResetFromISR(g_debounce_timer, &woken);
+    if (woken) {
+        portYIELD_FROM_ISR(woken);
+    }
+}
+
+void input_events_notify_edge(void)
+{
+    g_edge_us = esp_timer_get_time();
+    if (g_source->enable_edge) {
+        g_source->enable_edge(false);
+    }
+    xTimerReset(g_debounce_timer, portMAX_DELAY);
+}
+
+#if !CONFIG_IDF_TARGET_LINUX
+
+static void IRAM_ATTR boot_button_isr(void *arg)
+{
+    input_events_notify_edge_from_isr();
+}
+
+static esp_err_t boot_button_init(void)
+{
+    gpio_config_t io_conf = {};
+    io_conf.intr_type = GPIO_INTR_ANYEDGE;
+    io_conf.pin_bit_mask = 1ULL << CONFIG_MQTT_CLIENT_BUTTON_GPIO;
+    io_conf.mode = GPIO_MODE_INPUT;
+    io_conf.pull_up_en = GPIO_PULLUP_ENABLE;
+    io_conf.pull_down_en = GPIO_PULLDOWN_DISABLE;
+    esp_err_t ret = gpio_config(&io_conf);
+    if (ret != ESP_OK) {
+        return ret;
+    }
+    // 其它组件可能已安装ISR服务
+    ret = gpio_install_isr_service(0);
+    if (ret != ESP_OK && ret != ESP_ERR_INVALID_STATE) {
+        return ret;
+    }
+    return gpio_isr_handler_add((gpio_num_t)CONFIG_MQTT_CLIENT_BUTTON_GPIO, boot_button_isr, NULL);
+}
+
+static int boot_button_get_level(void)
+{
+    return gpio_get_level((gpio_num_t)CONFIG_MQTT_CLIENT_BUTTON_GPIO);
+}
+
+static void boot_button_enable_edge(bool enable)
+{
+    if (enable) {
+        gpio_intr_enable((gpio_num_t)CONFIG_MQTT_CLIENT_BUTTON_GPIO);
+    } else {
+        gpio_intr_disable((gpio_num_t)CONFIG_MQTT_CLIENT_BUTTON_GPIO);
+    }
+}
+
+static const input_source_t input_source_boot_button = {
+    .init = boot_button_init,
+    .get_level = boot_button_get_level,
+    .enable_edge = boot_button_enable_edge,
+};
+
+#endif /* !CONFIG_IDF_TARGET_LINUX */
+
+static volatile int g_sim_level = 1;
+
+static esp_err_t sim_init(void)
+{
+    g_sim_level = 1;
+    return ESP_OK;
+}
+
+static int sim_get_level(void)
+{
+    return g_sim_level;
+}
+
+const input_source_t input_source_sim = {
+    .init = sim_init,
+    .get_level = sim_get_level,
+    .enable_edge = NULL,
+};
+
+/**
+ * @brief 设置模拟电平（0为按下），电平变化时产生跳变通知
+ */
+void input_source_sim_set_level(int level)
+{
+    if (g_source != &input_source_sim || level == g_sim_level) {
+        return;
+    }
+    g_sim_level = level;
+    input_events_notify_edge();
+}
+
+esp_err_t input_events_init(const input_source_t *source)
+{
+    if (g_source) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    if (!source) {
+#if CONFIG_IDF_TARGET_LINUX
+        source = &input_source_sim;
+#else
+        source = &input_source_boot_button;
+#endif
+    }
+
+    g_queue = xQueueCreate(4, sizeof(input_event_t));
+    g_debounce_timer = xTimerCreate("debounce", pdMS_TO_TICKS(CONFIG_MQTT_CLIENT_BUTTON_DEBOUNCE_MS),
+                                    pdFALSE, NULL, debounce_timer_cb);
+    if (!g_queue || !g_debounce_timer) {
+        ESP_LOGE(TAG, "创建按键事件队列或消抖定时器失败");
+        return ESP_ERR_NO_MEM;
+    }
+
+    // 信号源初始化后即可能触发中断，需先设置好g_source
+    g_source = source;
+    esp_err_t ret = source->init();
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "按键信号源初始化失败: %s", esp_err_to_name(ret));
+        g_source = NULL;
+        return ret;
+    }
+    g_stable_level = source->get_level();
+    return ESP_OK;
+}
+
+QueueHandle_t input_events_queue(void)
+{
+    return g_queue;
+}
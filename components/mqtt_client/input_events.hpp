@@ -0,0 +1,58 @@
+#ifndef __INPUT_EVENTS_HPP__
+#define __INPUT_EVENTS_HPP__
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "esp_err.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/queue.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef enum {
+    INPUT_EVENT_SHORT_PRESS = 0,
+    INPUT_EVENT_LONG_PRESS,
+} input_event_type_t;
+
+typedef struct {
+    input_event_type_t type;
+    uint32_t press_ms;                      // 按压时长（按下沿到释放沿）
+    int64_t release_us;                     // 释放沿时间，用于统计输入延迟
+} input_event_t;
+
+/**
+ * @brief 按键信号源
+ *
+ * 信号源在电平跳变时调用input_events_notify_edge[_from_isr]()，
+ * 消抖定时器到期后通过get_level读取稳定电平（0为按下）。
+ */
+typedef struct {
+    esp_err_t (*init)(void);
+    int (*get_level)(void);
+    void (*enable_edge)(bool enable);       // 消抖期间屏蔽跳变通知，可为NULL
+} input_source_t;
+
+/**
+ * @brief 启动输入事件子系统
+ *
+ * @param source 信号源，NULL使用BOOT按钮GPIO中断（linux目标下使用模拟信号源）
+ */
+esp_err_t input_events_init(const input_source_t *source);
+
+// 短按/长按事件队列，元素为input_event_t
+QueueHandle_t input_events_queue(void);
+
+void input_events_notify_edge(void);
+void input_events_notify_edge_from_isr(void);
+
+// 模拟信号源：用于linux目标或测试中注入按键
+extern const input_source_t input_source_sim;
+void input_source_sim_set_level(int level);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
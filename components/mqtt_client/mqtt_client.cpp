@@ -7,6 +7,17 @@ static char device_id[32];
 static esp_mqtt_client_handle_t mqtt_client;
 static int message_received_count = 0;
 
+// 外部消息处理回调（如WebRTC信令）
+static mqtt_message_handler_t message_handler = NULL;
+static void *message_handler_ctx = NULL;
+static mqtt_status_handler_t status_handler = NULL;
+static void *status_handler_ctx = NULL;
+
+// 分片消息重组缓冲区（SDP等大消息会超过MQTT接收缓冲区而被拆分）
+static char *rx_topic = NULL;
+static char *rx_data = NULL;
+static int rx_total_len = 0;
+
 // 函数声明
 static void handle_server_command(const char* command, cJSON* json_data);
 static void process_server_response(const char* topic, const char* data, int data_len);
@@ -14,10 +25,19 @@ static void process_server_response(const char* topic, const char* data, int dat
 /**
  * @brief 生成设备唯一ID
  * 
- * 基于设备的MAC地址生成唯一标识符
+ * 基于设备的MAC地址生成唯一标识符；linux目标上可由环境变量MQTT_DEVICE_ID指定，
+ * 同一主机上的多个实例（tools/fleet_sim.py）据此区分
  */
 static void generate_device_id(void)
 {
+#if CONFIG_IDF_TARGET_LINUX
+    const char *env_id = getenv("MQTT_DEVICE_ID");
+    if (env_id && env_id[0]) {
+        snprintf(device_id, sizeof(device_id), "%s", env_id);
+        ESP_LOGI(TAG, "设备ID: %s（MQTT_DEVICE_ID）", device_id);
+        return;
+    }
+#endif
     uint8_t mac[6];
     esp_err_t ret = esp_read_mac(mac, ESP_MAC_WIFI_STA);
     if (ret == ESP_OK) {
@@ -34,7 +54,7 @@ static void generate_device_id(void)
 /**
  * @brief 创建MQTT消息JSON格式
  * 
- * @return 分配的JSON字符串，使用后需要释放
+ * @return 分配的JSON字符串，使用后需用HEAP_JSON_FREE释放
  */
 static char* create_mqtt_message(void)
 {
@@ -45,8 +65,8 @@ static char* create_mqtt_message(void)
     cJSON_AddItemToObject(json, "deviceId", deviceId);
     cJSON_AddItemToObject(json, "type", type);
 
-    // 使用cJSON_PrintUnformatted确保发送紧凑的JSON格式
-    char *json_string = cJSON_PrintUnformatted(json);
+    // 使用cJSON_PrintUnformatted确保发送紧凑的JSON格式，按长度计入MQTT组件
+    char *json_string = HEAP_JSON_PRINT(HEAP_COMP_MQTT, json);
     cJSON_Delete(json);
     
     // 验证生成的JSON
@@ -58,6 +78,49 @@ static char* create_mqtt_message(void)
     return json_string;
 }
 
+/**
+ * @brief 创建设备状态消息，在基础消息上附带发件箱占用、重连和堆统计
+ * 
+ * @return 分配的JSON字符串，使用后需用HEAP_JSON_FREE释放
+ */
+static char* create_status_message(void)
+{
+    cJSON *json = cJSON_CreateObject();
+    cJSON_AddStringToObject(json, "deviceId", device_id);
+    cJSON_AddStringToObject(json, "type", "sfu");
+
+    mqtt_outbox_stats_t outbox;
+    mqtt_outbox_get_stats(&outbox);
+    cJSON *outbox_json = cJSON_AddObjectToObject(json, "outbox");
+    cJSON_AddNumberToObject(outbox_json, "depth", outbox.depth);
+    cJSON_AddNumberToObject(outbox_json, "bytes", outbox.bytes);
+    cJSON_AddNumberToObject(outbox_json, "bytesHighWater", outbox.bytes_high_water);
+    cJSON_AddNumberToObject(outbox_json, "droppedFull", outbox.dropped_full);
+    cJSON_AddNumberToObject(outbox_json, "droppedExpired", outbox.dropped_expired);
+
+    mqtt_reconnect_stats_t reconnect;
+    mqtt_reconnect_get_stats(&reconnect);
+    cJSON *reconnect_json = cJSON_AddObjectToObject(json, "reconnect");
+    cJSON_AddNumberToObject(reconnect_json, "disconnects", reconnect.disconnects);
+    cJSON_AddNumberToObject(reconnect_json, "attempts", reconnect.reconnect_attempts);
+    cJSON_AddNumberToObject(reconnect_json, "lastBackoffMs", reconnect.last_backoff_ms);
+    cJSON_AddNumberToObject(reconnect_json, "lastResubscribedMs", reconnect.last_resubscribed_ms);
+    cJSON_AddNumberToObject(reconnect_json, "maxResubscribedMs", reconnect.max_resubscribed_ms);
+    mqtt_room_add_json(json);
+
+    heap_monitor_add_json(json);
+#if CONFIG_APP_WIFI_POWER_SAVE
+    wifi_power_add_json(json);
+#endif
+    if (status_handler) {
+        status_handler(json, status_handler_ctx);
+    }
+
+    char *json_string = HEAP_JSON_PRINT(HEAP_COMP_MQTT, json);
+    cJSON_Delete(json);
+    return json_string;
+}
+
 /**
  * @brief 处理服务器返回的消息
  * 
@@ -86,17 +149,8 @@ static void process_server_response(const char* topic, const char* data, int dat
         return;
     }
     
-    // 创建以null结尾的字符串
-    char *data_buffer = static_cast<char*>(malloc(data_len + 1));
-    if (!data_buffer) {
-        printf("❌ 错误：内存分配失败！\n");
-        return;
-    }
-    
-    memcpy(data_buffer, data, data_len);
-    data_buffer[data_len] = '\0';
-    
-    printf("📨 收到%s: %s\n", message_type, data_buffer);
+    // 完整负载只在调试日志级别打印（CONFIG_MQTT_CLIENT_DEBUG_LOG），逐条打印会拖慢接收路径
+    ESP_LOGD(TAG, "📨 收到%s: %.*s", message_type, data_len, data);
     
     // // 打印数据的十六进制表示
     // printf("🔍 数据十六进制表示: ");
@@ -105,88 +159,102 @@ static void process_server_response(const char* topic, const char* data, int dat
     // }
     // printf("\n");
     
-    // // 尝试解析JSON
-    // printf("🔧 尝试解析JSON...\n");
-    // cJSON *json = cJSON_Parse(data_buffer);
-    // if (json) {
-    //     printf("✅ JSON解析成功！\n");
-    //     ESP_LOGI(TAG, "✅ JSON解析成功");
-        
-    //     // 打印格式化的JSON
-    //     char *formatted_json = cJSON_Print(json);
-    //     if (formatted_json) {
-    //         printf("📋 格式化JSON:\n%s\n", formatted_json);
-    //         ESP_LOGI(TAG, "📋 格式化JSON:\n%s", formatted_json);
-    //         free(formatted_json);
-    //     }
-        
-    //     // 解析各个字段
-    //     cJSON *deviceId = cJSON_GetObjectItem(json, "deviceId");
-    //     cJSON *type = cJSON_GetObjectItem(json, "type");
-    //     cJSON *command = cJSON_GetObjectItem(json, "command");
-    //     cJSON *data_field = cJSON_GetObjectItem(json, "data");
-    //     cJSON *status = cJSON_GetObjectItem(json, "status");
-    //     cJSON *message = cJSON_GetObjectItem(json, "message");
-        
-    //     printf("🏷️  解析字段:\n");
-        
-    //     if (cJSON_IsString(deviceId)) {
-    //         printf("   📱 设备ID: %s\n", deviceId->valuestring);
-    //         ESP_LOGI(TAG, "📱 设备ID: %s", deviceId->valuestring);
-    //     }
-        
-    //     if (cJSON_IsString(type)) {
-    //         printf("   🏷️  类型: %s\n", type->valuestring);
-    //         ESP_LOGI(TAG, "🏷️  类型: %s", type->valuestring);
-    //     }
-        
-    //     if (cJSON_IsString(command)) {
-    //         printf("   🎯 命令: %s\n", command->valuestring);
-    //         ESP_LOGI(TAG, "🎯 命令: %s", command->valuestring);
-    //         handle_server_command(command->valuestring, json);
-    //     }
-        
-    //     if (data_field) {
-    //         char *data_str = cJSON_Print(data_field);
-    //         if (data_str) {
-    //             printf("   📊 数据字段: %s\n", data_str);
-    //             ESP_LOGI(TAG, "📊 数据字段: %s", data_str);
-    //             free(data_str);
-    //         }
-    //     }
-        
-    //     if (cJSON_IsString(status)) {
-    //         printf("   📈 状态: %s\n", status->valuestring);
-    //         ESP_LOGI(TAG, "📈 状态: %s", status->valuestring);
-    //     }
-        
-    //     if (cJSON_IsString(message)) {
-    //         printf("   💬 消息: %s\n", message->valuestring);
-    //         ESP_LOGI(TAG, "💬 消息: %s", message->valuestring);
-    //     }
-        
-    //     cJSON_Delete(json);
-    // } else {
-    //     printf("⚠️  JSON解析失败，当作普通文本处理\n");
-    //     ESP_LOGW(TAG, "⚠️  JSON解析失败，当作普通文本处理");
-    //     printf("📄 纯文本内容: %s\n", data_buffer);
-    //     ESP_LOGI(TAG, "📄 纯文本内容: %s", data_buffer);
-        
-    //     // 尝试作为键值对解析
-    //     if (strstr(data_buffer, "deviceId=") || strstr(data_buffer, "type=")) {
-    //         printf("🔍 检测到键值对格式\n");
-    //         ESP_LOGI(TAG, "🔍 检测到键值对格式，可能需要转换为JSON");
-    //     }
-        
-    //     // 检查cJSON错误
-    //     const char *error_ptr = cJSON_GetErrorPtr();
-    //     if (error_ptr != NULL) {
-    //         printf("❌ cJSON错误: %s\n", error_ptr);
-    //         ESP_LOGE(TAG, "❌ cJSON错误: %s", error_ptr);
-    //     }
-    // }
-    
-    free(data_buffer);
+    // 服务器命令形如 {"command":"status", ...}，其余JSON和纯文本只打印
+    cJSON *json = cJSON_ParseWithLength(data, data_len);
+    if (json) {
+        cJSON *command = cJSON_GetObjectItem(json, "command");
+        if (cJSON_IsString(command)) {
+            handle_server_command(command->valuestring, json);
+        }
+        cJSON_Delete(json);
+    }
+}
+
+/**
+ * @brief 分发一条完整的订阅消息
+ *
+ * 优先交给外部注册的消息处理回调，未被处理的消息进入默认处理流程；
+ * 未加入房间的消息（通配订阅或退出后仍在途）直接丢弃
+ */
+static void dispatch_message(const char* topic, const char* data, int data_len)
+{
+    if (!mqtt_room_filter(topic)) {
+        return;
+    }
+    if (message_handler && message_handler(topic, data, data_len, message_handler_ctx)) {
+        message_received_count++;
+    } else {
+        process_server_response(topic, data, data_len);
+    }
+    // 处理完成后再计数，负载测试的时延包含完整处理路径
+    mqtt_load_probe_on_message(data, data_len);
+}
+
+/**
+ * @brief 重组MQTT_EVENT_DATA分片
+ *
+ * 主题只出现在第一个分片中，数据按current_data_offset拼接，
+ * 收齐total_data_len后整体分发一次
+ */
+static void handle_mqtt_data(esp_mqtt_event_handle_t event)
+{
+    // 未分片的消息直接分发，避免额外拷贝数据
+    if (event->current_data_offset == 0 && event->data_len == event->total_data_len) {
+        if (event->topic_len <= 0 || event->data_len <= 0) {
+            return;
+        }
+        heap_monitor_note_message();
+        // 常见主题长度放在栈上，过长时才分配
+        char topic_stack[128];
+        char *topic_buffer = topic_stack;
+        if (event->topic_len >= (int)sizeof(topic_stack)) {
+            topic_buffer = static_cast<char*>(HEAP_MALLOC(HEAP_COMP_MQTT, event->topic_len + 1));
+            if (!topic_buffer) {
+                return;
+            }
+        }
+        memcpy(topic_buffer, event->topic, event->topic_len);
+        topic_buffer[event->topic_len] = '\0';
+        dispatch_message(topic_buffer, event->data, event->data_len);
+        if (topic_buffer != topic_stack) {
+            HEAP_FREE(topic_buffer);
+        }
+        return;
+    }
+
+    if (event->current_data_offset == 0) {
+        heap_monitor_note_message();
+        HEAP_FREE(rx_topic);
+        HEAP_FREE(rx_data);
+        rx_topic = static_cast<char*>(HEAP_MALLOC(HEAP_COMP_MQTT, event->topic_len + 1));
+        rx_data = static_cast<char*>(HEAP_MALLOC(HEAP_COMP_MQTT, event->total_data_len + 1));
+        if (!rx_topic || !rx_data) {
+            ESP_LOGE(TAG, "分片消息缓冲区分配失败: %d字节", event->total_data_len);
+            HEAP_FREE(rx_topic);
+            HEAP_FREE(rx_data);
+            rx_topic = NULL;
+            rx_data = NULL;
+            return;
+        }
+        memcpy(rx_topic, event->topic, event->topic_len);
+        rx_topic[event->topic_len] = '\0';
+        rx_total_len = event->total_data_len;
+    }
+
+    if (!rx_data || event->current_data_offset + event->data_len > rx_total_len) {
+        return;
+    }
+    memcpy(rx_data + event->current_data_offset, event->data, event->data_len);
+
+    if (event->current_data_offset + event->data_len == rx_total_len) {
+        rx_data[rx_total_len] = '\0';
+        dispatch_message(rx_topic, rx_data, rx_total_len);
+        HEAP_FREE(rx_topic);
+        HEAP_FREE(rx_data);
+        rx_topic = NULL;
+        rx_data = NULL;
+        rx_total_len = 0;
+    }
 }
 
 /**
@@ -205,9 +273,9 @@ static void handle_server_command(const char* command, cJSON* json_data)
         char *pong_message = create_mqtt_message();
         if (pong_message && mqtt_client) {
             ESP_LOGI(TAG, "发送pong响应: %s", pong_message);
-            int msg_id = esp_mqtt_client_publish(mqtt_client, MQTT_PUBLISH_TOPIC, pong_message, strlen(pong_message), 1, 0);
+            int msg_id = mqtt_client_publish(MQTT_PUBLISH_TOPIC, pong_message, strlen(pong_message), 1, "pong", true);
             ESP_LOGI(TAG, "pong响应发送结果: msg_id=%d", msg_id);
-            free(pong_message);
+            HEAP_JSON_FREE(HEAP_COMP_MQTT, pong_message);
         }
     } else if (strcmp(command, "restart") == 0) {
         ESP_LOGI(TAG, "收到重启命令，准备重启设备");
@@ -217,153 +285,122 @@ static void handle_server_command(const char* command, cJSON* json_data)
     } else if (strcmp(command, "status") == 0) {
         ESP_LOGI(TAG, "收到状态查询命令");
         // 发送设备状态信息
-        char *status_message = create_mqtt_message();
+        char *status_message = create_status_message();
         if (status_message && mqtt_client) {
             ESP_LOGI(TAG, "发送设备状态: %s", status_message);
-            int msg_id = esp_mqtt_client_publish(mqtt_client, MQTT_PUBLISH_TOPIC, status_message, strlen(status_message), 1, 0);
+            int msg_id = mqtt_client_publish(MQTT_PUBLISH_TOPIC, status_message, strlen(status_message), 1, "status", true);
             ESP_LOGI(TAG, "设备状态发送结果: msg_id=%d", msg_id);
-            free(status_message);
+            HEAP_JSON_FREE(HEAP_COMP_MQTT, status_message);
         }
+        mqtt_wire_stats_report();
+        mqtt_room_report();
+#if CONFIG_APP_WIFI_POWER_SAVE
+        wifi_power_report();
+#endif
     } else {
         ESP_LOGW(TAG, "未知命令: %s", command);
     }
 }
 
 /**
- * @brief BOOT按钮轮询任务（无中断）
+ * @brief 短按：先退出房间(发布遗嘱消息)，再加入房间(订阅主题)
+ *
+ * 退出通知、取消订阅和订阅按顺序写入同一连接，broker按序处理，无需延时
+ */
+static void handle_short_press(void)
+{
+    printf("🔘 短按检测到，执行退出→加入房间流程\n");
+    if (!mqtt_client) {
+        return;
+    }
+
+    // 步骤1：先发布遗嘱消息，表示退出房间；未加入时不发送
+    printf("⚰️ 步骤1: 发布遗嘱消息(退出房间)\n");
+    if (mqtt_room_leave(NULL) == 0) {
+        printf("✅ 已退出房间\n");
+    } else {
+        printf("❌ 遗嘱消息发布失败\n");
+    }
+
+    // 步骤2：订阅主题，表示加入房间
+    printf("🏠 步骤2: 订阅主题(加入房间)\n");
+    int msg_id = mqtt_room_join(NULL);
+    if (msg_id >= 0) {
+        printf("✅ 主题订阅成功(已加入房间)，等待服务器响应\n");
+    } else {
+        printf("❌ 主题订阅失败\n");
+    }
+}
+
+/**
+ * @brief 长按：发布MQTT消息
+ */
+static void handle_long_press(void)
+{
+    printf("🔘 长按检测到，发布消息\n");
+    char *message = create_mqtt_message();
+    if (message && mqtt_client) {
+        int msg_id = mqtt_client_publish(MQTT_PUBLISH_TOPIC, message, strlen(message), 1, "sfu", true);
+        if (msg_id >= 0) {
+            printf("📤 消息发布成功\n");
+        } else {
+            printf("❌ 消息发布失败\n");
+        }
+    }
+    HEAP_JSON_FREE(HEAP_COMP_MQTT, message);
+}
+
+/**
+ * @brief BOOT按钮事件任务
  * 
- * 处理BOOT按钮按下事件：
+ * 阻塞等待输入事件队列，无按键时不唤醒：
  * - 短按：订阅主题
  * - 长按：发布MQTT消息
  */
-static void button_poll_task(void* arg)
+static void button_event_task(void* arg)
 {
+    QueueHandle_t queue = input_events_queue();
     TickType_t last_operation_time = 0;
     const TickType_t min_operation_interval = pdMS_TO_TICKS(3000); // 3秒最小间隔，防止重复触发
-    bool last_button_state = true; // GPIO0默认高电平（上拉）
-    
-    printf("🔘 按钮轮询任务启动\n");
-    
+    input_event_t event;
+
+    printf("🔘 按钮事件任务启动\n");
+
     for(;;) {
-        // 每50ms检查一次按钮状态
-        vTaskDelay(50 / portTICK_PERIOD_MS);
-        
-        bool current_button_state = gpio_get_level(BOOT_BUTTON_GPIO);
-        
-        // 检测按钮按下（从高到低的跳变）
-        if (last_button_state == true && current_button_state == false) {
-            TickType_t current_time = xTaskGetTickCount();
-            
-            // 检查是否在最小间隔内，防止重复触发
-            if (current_time - last_operation_time < min_operation_interval) {
-                last_button_state = current_button_state;
-                continue;
-            }
-            
-            printf("🔘 按钮按下，检测按压时间...\n");
-            
-            // 防抖延时
-            vTaskDelay(30 / portTICK_PERIOD_MS);
-            
-            // 再次确认按钮确实被按下
-            if (gpio_get_level(BOOT_BUTTON_GPIO) == 0) {
-                TickType_t press_start_time = xTaskGetTickCount();
-                
-                // 等待按钮释放，同时计算按压时间
-                while(gpio_get_level(BOOT_BUTTON_GPIO) == 0) {
-                    vTaskDelay(10 / portTICK_PERIOD_MS);
-                    TickType_t current_press_time = xTaskGetTickCount();
-                    
-                    // 防止无限等待（最大3秒）
-                    if ((current_press_time - press_start_time) > pdMS_TO_TICKS(3000)) {
-                        printf("⚠️ 按钮长时间按下，跳过处理\n");
-                        break;
-                    }
-                }
-                
-                TickType_t press_end_time = xTaskGetTickCount();
-                int press_time_ms = (press_end_time - press_start_time) * portTICK_PERIOD_MS;
-                
-                last_operation_time = current_time;
-                
-                printf("🔘 按钮释放，按压时间: %d毫秒\n", press_time_ms);
-                
-                if (press_time_ms >= 1000) {
-                    // 长按：发布消息
-                    printf("🔘 长按检测到，发布消息\n");
-                    
-                    char *message = create_mqtt_message();
-                    if (message && mqtt_client) {
-                        int msg_id = esp_mqtt_client_publish(mqtt_client, MQTT_PUBLISH_TOPIC, message, strlen(message), 1, 0);
-                        if (msg_id >= 0) {
-                            printf("📤 消息发布成功\n");
-                        } else {
-                            printf("❌ 消息发布失败\n");
-                        }
-                        free(message);
-                    }
-                } else if (press_time_ms >= 50) { // 至少50ms才算有效按键
-                    // 短按：先退出房间(发布遗嘱消息)，再加入房间(订阅主题)
-                    printf("🔘 短按检测到，执行退出→加入房间流程\n");
-                    
-                    if (mqtt_client) {
-                        // 步骤1：先发布遗嘱消息，表示退出房间
-                        printf("⚰️ 步骤1: 发布遗嘱消息(退出房间)\n");
-                        char *will_message = create_mqtt_message();
-                        if (will_message) {
-                            int will_msg_id = esp_mqtt_client_publish(mqtt_client, MQTT_LAST_WILL_TOPIC, will_message, strlen(will_message), 1, 0);
-                            if (will_msg_id >= 0) {
-                                printf("✅ 遗嘱消息发布成功(已退出房间)\n");
-                            } else {
-                                printf("❌ 遗嘱消息发布失败\n");
-                            }
-                            free(will_message);
-                        }
-                        
-                        // 小延时，确保遗嘱消息先发送
-                        vTaskDelay(100 / portTICK_PERIOD_MS);
-                        
-                        // 步骤2：订阅主题，表示加入房间
-                        printf("🏠 步骤2: 订阅主题(加入房间)\n");
-                        char subscribe_topic[128];
-                        snprintf(subscribe_topic, sizeof(subscribe_topic), "%s%s", MQTT_SUBSCRIBE_TOPIC_PREFIX, device_id);
-                        
-                        printf("📡 订阅服务器响应主题: %s\n", subscribe_topic);
-                        
-                        int msg_id = esp_mqtt_client_subscribe(mqtt_client, subscribe_topic, 1);
-                        if (msg_id >= 0) {
-                            printf("✅ 主题订阅成功(已加入房间)，等待服务器响应\n");
-                        } else {
-                            printf("❌ 主题订阅失败\n");
-                        }
-                    }
-                }
-            }
+        if (xQueueReceive(queue, &event, portMAX_DELAY) != pdTRUE) {
+            continue;
+        }
+        ESP_LOGI(TAG, "[Performance][input_release_to_dispatch_us]: %" PRId64, esp_timer_get_time() - event.release_us);
+        printf("🔘 按钮释放，按压时间: %" PRIu32 "毫秒\n", event.press_ms);
+
+        TickType_t current_time = xTaskGetTickCount();
+        if (last_operation_time != 0 && current_time - last_operation_time < min_operation_interval) {
+            continue;
+        }
+        last_operation_time = current_time;
+
+        if (event.type == INPUT_EVENT_LONG_PRESS) {
+            handle_long_press();
+        } else {
+            handle_short_press();
         }
-        
-        last_button_state = current_button_state;
     }
 }
 
 /**
- * @brief 初始化GPIO（无中断方式）
+ * @brief 初始化BOOT按钮（跳变中断+定时器消抖）
  */
 static void init_gpio(void)
 {
-    gpio_config_t io_conf = {};
-    
-    // 配置BOOT按钮（GPIO0）为输入，带上拉，无中断
-    io_conf.intr_type = GPIO_INTR_DISABLE;  // 完全禁用中断
-    io_conf.pin_bit_mask = GPIO_INPUT_PIN_SEL;
-    io_conf.mode = GPIO_MODE_INPUT;
-    io_conf.pull_up_en = GPIO_PULLUP_ENABLE;
-    io_conf.pull_down_en = GPIO_PULLDOWN_DISABLE;
-    gpio_config(&io_conf);
-    
-    // 创建按钮轮询任务（无中断）
-    xTaskCreate(button_poll_task, "button_poll", 4096, NULL, 5, NULL);
-    
-    printf("🔘 BOOT按钮轮询模式已配置在GPIO%d\n", BOOT_BUTTON_GPIO);
+    esp_err_t ret = input_events_init(NULL);
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "按键事件初始化失败: %s", esp_err_to_name(ret));
+        return;
+    }
+
+    task_topology_create(APP_TASK_INPUT, button_event_task, NULL, NULL);
+
+    printf("🔘 BOOT按钮中断模式已配置在GPIO%d\n", CONFIG_MQTT_CLIENT_BUTTON_GPIO);
 }
 
 static void log_error_if_nonzero(const char *message, int error_code)
@@ -383,6 +420,39 @@ static void log_error_if_nonzero(const char *message, int error_code)
  * @param event_id 接收到的事件的 ID。
  * @param event_data 事件的数据，esp_mqtt_event_handle_t。
  */
+#if CONFIG_APP_EVENT_CAPTURE
+#define CAPTURE_MQTT_TOPIC_MAX 128
+
+/**
+ * @brief 录制一个MQTT事件
+ *
+ * 数据事件记录分片信息、主题和本分片数据（按收到的分片记录，回放时走同样的重组路径）；
+ * 连接事件记录session_present，其余事件只记录msg_id
+ */
+static void capture_mqtt_event(int32_t event_id, esp_mqtt_event_handle_t event)
+{
+    if (event_id == MQTT_EVENT_DATA) {
+        uint8_t head[sizeof(event_capture_mqtt_data_t) + CAPTURE_MQTT_TOPIC_MAX];
+        event_capture_mqtt_data_t info = {};
+        int topic_len = event->topic_len > 0 ? event->topic_len : 0;
+        info.topic_len = topic_len < CAPTURE_MQTT_TOPIC_MAX ? topic_len : CAPTURE_MQTT_TOPIC_MAX;
+        info.current_data_offset = event->current_data_offset;
+        info.total_data_len = event->total_data_len;
+        memcpy(head, &info, sizeof(info));
+        if (info.topic_len > 0) {
+            memcpy(head + sizeof(info), event->topic, info.topic_len);
+        }
+        EVENT_CAPTURE_EX(EVENT_CAPTURE_SRC_MQTT, MQTT_EVENT_DATA, 0, head, sizeof(info) + info.topic_len,
+                         event->data, event->data_len > 0 ? event->data_len : 0);
+    } else if (event_id == MQTT_EVENT_CONNECTED) {
+        uint8_t session_present = event->session_present ? 1 : 0;
+        EVENT_CAPTURE(EVENT_CAPTURE_SRC_MQTT, MQTT_EVENT_CONNECTED, 0, &session_present, 1);
+    } else {
+        EVENT_CAPTURE(EVENT_CAPTURE_SRC_MQTT, (uint8_t)event_id, (uint16_t)event->msg_id, NULL, 0);
+    }
+}
+#endif
+
 static void mqtt_event_handler(void *handler_args, esp_event_base_t base, int32_t event_id, void *event_data)
 {
     ESP_LOGD(TAG, "Event dispatched from event loop base=%s, event_id=%" PRIi32 "", base, event_id);
@@ -390,18 +460,32 @@ static void mqtt_event_handler(void *handler_args, esp_event_base_t base, int32_
     esp_mqtt_client_handle_t client = event->client;
     int msg_id;
     
+#if CONFIG_APP_EVENT_CAPTURE
+    capture_mqtt_event(event_id, event);
+#endif
+
     switch ((esp_mqtt_event_id_t)event_id) {
     case MQTT_EVENT_CONNECTED:
         ESP_LOGI(TAG , "🎉 MQTT连接成功！\n");
-        
+        mqtt_v5_on_connected();
+        // 有外部消息处理者（如WebRTC信令）或启用负载探针时保存结果主题订阅，由重连管理统一发送
+        if (message_handler || MQTT_LOAD_PROBE_ENABLED) {
+            mqtt_client_subscribe_result_topic();
+        }
+        // 重新发送已保存的订阅；MQTT v5会话仍在时订阅已由broker保留
+        mqtt_reconnect_on_connected(event->session_present);
+        mqtt_room_on_subscribed();
         break;
         
     case MQTT_EVENT_DISCONNECTED:
         printf("💔 MQTT连接断开\n");
+        mqtt_reconnect_on_disconnected();
         break;
 
     case MQTT_EVENT_SUBSCRIBED:
-        break; // 静默处理订阅成功
+        mqtt_reconnect_on_subscribed(event->msg_id);
+        mqtt_room_on_subscribed();
+        break;
         
     case MQTT_EVENT_UNSUBSCRIBED:
         break; // 静默处理取消订阅
@@ -411,19 +495,7 @@ static void mqtt_event_handler(void *handler_args, esp_event_base_t base, int32_
         break;
         
     case MQTT_EVENT_DATA:
-        if (event->topic_len > 0 && event->data_len > 0) {
-            // 创建主题字符串
-            char *topic_buffer = static_cast<char*>(malloc(event->topic_len + 1));
-            if (topic_buffer) {
-                memcpy(topic_buffer, event->topic, event->topic_len);
-                topic_buffer[event->topic_len] = '\0';
-                
-                // 使用新的处理函数
-                process_server_response(topic_buffer, event->data, event->data_len);
-                
-                free(topic_buffer);
-            }
-        }
+        handle_mqtt_data(event);
         break;
         
     case MQTT_EVENT_ERROR:
@@ -461,6 +533,7 @@ static void safe_shutdown_handler(void)
     // 注意：正常关机时不发送遗嘱消息，遗嘱消息只在意外断线时由MQTT broker自动发送
     
     // 断开MQTT连接
+    mqtt_reconnect_stop();
     if (mqtt_client) {
         esp_mqtt_client_disconnect(mqtt_client);
         vTaskDelay(500 / portTICK_PERIOD_MS);  // 等待断开完成
@@ -485,8 +558,14 @@ static void mqtt_app_start(void)
     mqtt_cfg.session.last_will.qos = 1;
     mqtt_cfg.session.last_will.retain = 0;
     mqtt_cfg.session.keepalive = 60;
-    mqtt_cfg.network.reconnect_timeout_ms = 5000;
     mqtt_cfg.network.timeout_ms = 5000;
+#if CONFIG_IDF_TARGET_LINUX
+    // 同一主机上的实例MAC相同，客户端ID改用设备ID，否则broker会互相踢下线
+    mqtt_cfg.credentials.client_id = device_id;
+#endif
+    mqtt_reconnect_apply_config(&mqtt_cfg);
+    task_topology_apply_mqtt(&mqtt_cfg);
+    mqtt_v5_apply_config(&mqtt_cfg);
 
 #if CONFIG_BROKER_URL_FROM_STDIN
     char line[128];
@@ -523,11 +602,15 @@ static void mqtt_app_start(void)
     if (mqtt_client == NULL) {
         ESP_LOGE(TAG, "MQTT客户端初始化失败");
         if (last_will_message) {
-            free(last_will_message);
+            HEAP_JSON_FREE(HEAP_COMP_MQTT, last_will_message);
         }
         return;
     }
 
+    mqtt_v5_set_connect_property(mqtt_client);
+    mqtt_reconnect_init(mqtt_client);
+    mqtt_room_init();
+
     /* 注册MQTT事件处理程序 */
     esp_mqtt_client_register_event(mqtt_client, static_cast<esp_mqtt_event_id_t>(ESP_EVENT_ANY_ID), mqtt_event_handler, NULL);
     esp_mqtt_client_start(mqtt_client);
@@ -539,10 +622,122 @@ static void mqtt_app_start(void)
     
     // 清理临时分配的遗嘱消息内存
     if (last_will_message) {
-        free(last_will_message);
+        HEAP_JSON_FREE(HEAP_COMP_MQTT, last_will_message);
+    }
+}
+
+
+#if CONFIG_APP_EVENT_REPLAY
+// 只回放数据事件；连接、订阅等事件依赖真实的broker连接，只保留在时间线上
+static void replay_mqtt_event(const event_capture_record_t *record, const uint8_t *payload, void *ctx)
+{
+    event_capture_mqtt_data_t info;
+    if (record->type != MQTT_EVENT_DATA || !payload || record->size < sizeof(info)) {
+        return;
+    }
+    memcpy(&info, payload, sizeof(info));
+    if (sizeof(info) + info.topic_len > record->size) {
+        return;
+    }
+    esp_mqtt_event_t event = {};
+    event.event_id = MQTT_EVENT_DATA;
+    event.client = mqtt_client;
+    event.topic = (char *)payload + sizeof(info);
+    event.topic_len = info.topic_len;
+    event.data = (char *)payload + sizeof(info) + info.topic_len;
+    event.data_len = record->size - sizeof(info) - info.topic_len;
+    event.current_data_offset = info.current_data_offset;
+    event.total_data_len = info.total_data_len;
+    mqtt_event_handler(NULL, "replay", MQTT_EVENT_DATA, &event);
+}
+
+void mqtt_client_attach_replay(void)
+{
+    event_replay_set_handler(EVENT_CAPTURE_SRC_MQTT, replay_mqtt_event, NULL);
+}
+#endif
+
+/**
+ * @brief 设置外部订阅消息处理回调
+ */
+void mqtt_client_set_message_handler(mqtt_message_handler_t handler, void *user_data)
+{
+    message_handler = handler;
+    message_handler_ctx = user_data;
+}
+
+void mqtt_client_set_status_handler(mqtt_status_handler_t handler, void *user_data)
+{
+    status_handler = handler;
+    status_handler_ctx = user_data;
+}
+
+esp_mqtt_client_handle_t mqtt_client_get_handle(void)
+{
+    return mqtt_client;
+}
+
+const char* mqtt_client_get_device_id(void)
+{
+    return device_id;
+}
+
+/**
+ * @brief 发布消息
+ *
+ * 所有发布都经过此处：MQTT v5模式下自动附加主题别名和消息类型用户属性
+ *
+ * @param msg_type 消息类型，v5模式下作为用户属性"msg"发送，可为NULL
+ * @param utf8 负载为UTF-8文本（如JSON）时为true，v5模式下作为Payload Format Indicator发送
+ * @return 消息ID，失败返回-1；v5模式下在MQTT事件回调中与其他任务的发布冲突时排队发送，返回0
+ */
+int mqtt_client_publish(const char *topic, const char *data, int len, int qos, const char *msg_type, bool utf8)
+{
+    if (!mqtt_client) {
+        return -1;
+    }
+    return mqtt_v5_publish(mqtt_client, topic, data, len, qos, msg_type, utf8, false);
+}
+
+/**
+ * @brief 非阻塞发布：消息放入发件箱，由MQTT任务发送
+ */
+int mqtt_client_enqueue(const char *topic, const char *data, int len, int qos, const char *msg_type, bool utf8)
+{
+    if (!mqtt_client) {
+        return -1;
     }
+    return mqtt_v5_publish(mqtt_client, topic, data, len, qos, msg_type, utf8, true);
 }
 
+/**
+ * @brief 加入默认房间，即订阅本设备的服务器响应主题 /result/<deviceId>
+ *
+ * 订阅会被保存，断线重连后自动重新订阅；已加入时不重复订阅
+ *
+ * @return 订阅消息ID，已加入或未连接时返回0（连接后订阅），失败返回-1
+ */
+int mqtt_client_subscribe_result_topic(void)
+{
+    if (!mqtt_client) {
+        return -1;
+    }
+    return mqtt_room_join(NULL);
+}
+
+/**
+ * @brief 在已就绪的网络上启动MQTT客户端
+ *
+ * 不初始化NVS/netif/事件循环（见app_network_start），已启动时直接返回，
+ * MQTT子系统和WebRTC信令可以各自调用
+ */
+void mqtt_client_start(void)
+{
+    if (mqtt_client) {
+        return;
+    }
+    mqtt_app_start();
+}
 
 /*
  * @brief 应用程序的主入口点
@@ -555,28 +750,24 @@ void mqtt_DoNow(){
     printf("\n🚀 ESP32 MQTT设备启动\n");
     
     esp_log_level_set("*", ESP_LOG_INFO);
+#if CONFIG_MQTT_CLIENT_DEBUG_LOG
     esp_log_level_set("mqtt_client", ESP_LOG_VERBOSE);
     esp_log_level_set("mqtt_report", ESP_LOG_VERBOSE);
     esp_log_level_set("transport_base", ESP_LOG_VERBOSE);
     esp_log_level_set("esp-tls", ESP_LOG_VERBOSE);
     esp_log_level_set("transport", ESP_LOG_VERBOSE);
     esp_log_level_set("outbox", ESP_LOG_VERBOSE);
+#endif
 
-    ESP_ERROR_CHECK(nvs_flash_init());
-    ESP_ERROR_CHECK(esp_netif_init());
-    ESP_ERROR_CHECK(esp_event_loop_create_default());
-
-    ESP_ERROR_CHECK(example_connect());
-    printf("📶 网络连接成功\n");
+    // 网络由app_network统一初始化，已就绪时直接返回；example_connect返回时已拿到IP，无需再等待
+    ESP_ERROR_CHECK(app_network_start());
 
-    // 延时确保网络稳定
-    vTaskDelay(pdMS_TO_TICKS(1000));
-
-    mqtt_app_start();
+    mqtt_client_start();
     
-    // 等待MQTT稳定后再初始化GPIO（无中断轮询模式更安全）
-    vTaskDelay(pdMS_TO_TICKS(3000));
+    // 连接建立前按键的订阅会失败并打印，QoS1发布进入发件箱，无需等待连接
     init_gpio();
+    task_topology_start_load_report();
+    heap_monitor_start();
     
     printf("✅ 设备配置完成\n");
     printf("   🔘 短按BOOT键(<1秒): 退出房间→加入房间\n");
@@ -18,16 +18,24 @@
 #include "cJSON.h"
 #include "esp_log.h"
 #include "mqtt_client.h"
+#include "mqtt_v5.hpp"
+#include "mqtt_outbox_ring.hpp"
+#include "mqtt_reconnect.hpp"
+#include "mqtt_room.hpp"
+#include "mqtt_load_probe.hpp"
+#include "input_events.hpp"
+#include "task_topology.hpp"
+#include "heap_monitor.hpp"
+#include "app_network.hpp"
+#include "event_capture.hpp"
+#include "wifi_power.hpp"
+#include "esp_timer.h"
 
 // MQTT主题定义
 #define MQTT_SUBSCRIBE_TOPIC_PREFIX "/public/striped-kind-tiger/result/"
 #define MQTT_PUBLISH_TOPIC "/public/striped-kind-tiger/invoke/"
 #define MQTT_LAST_WILL_TOPIC "/device/end"
 
-// GPIO定义 - BOOT按钮
-#define BOOT_BUTTON_GPIO GPIO_NUM_0
-#define GPIO_INPUT_PIN_SEL (1ULL << BOOT_BUTTON_GPIO)
-
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -39,7 +47,11 @@ static void process_server_response(const char* topic, const char* data, int dat
 
 static void handle_server_command(const char* command, cJSON* json_data);
 
-static void button_poll_task(void* arg);
+static void handle_short_press(void);
+
+static void handle_long_press(void);
+
+static void button_event_task(void* arg);
 
 static void init_gpio(void);
 
@@ -51,6 +63,43 @@ static void safe_shutdown_handler(void);
 
 static void mqtt_app_start(void);
 
+/**
+ * @brief 订阅消息回调
+ *
+ * 在MQTT任务中调用，分片消息已重组为完整消息。
+ * 返回true表示消息已被处理，不再进入默认的服务器响应处理流程。
+ */
+typedef bool (*mqtt_message_handler_t)(const char *topic, const char *data, int data_len, void *user_data);
+
+void mqtt_client_set_message_handler(mqtt_message_handler_t handler, void *user_data);
+
+/**
+ * @brief 状态消息扩展回调
+ *
+ * 回复"status"命令时在MQTT任务中调用，可向status对象添加其他组件的统计（如WebRTC时延）
+ */
+typedef void (*mqtt_status_handler_t)(cJSON *status, void *user_data);
+
+void mqtt_client_set_status_handler(mqtt_status_handler_t handler, void *user_data);
+esp_mqtt_client_handle_t mqtt_client_get_handle(void);
+const char* mqtt_client_get_device_id(void);
+int mqtt_client_subscribe_result_topic(void);
+int mqtt_client_publish(const char *topic, const char *data, int len, int qos, const char *msg_type, bool utf8);
+int mqtt_client_enqueue(const char *topic, const char *data, int len, int qos, const char *msg_type, bool utf8);
+void mqtt_client_start(void);
+
+#if CONFIG_APP_EVENT_REPLAY
+/**
+ * @brief 把录制中的MQTT数据事件注册到回放，经mqtt_event_handler重新处理
+ *
+ * 不需要启动客户端；回复类发布在没有连接时直接失败，只计入接收路径耗时
+ */
+void mqtt_client_attach_replay(void);
+#endif
+
+/**
+ * @brief MQTT子系统入口：确保网络就绪（app_network_start），启动MQTT客户端和按键
+ */
 void mqtt_DoNow();
 #ifdef __cplusplus
 }
@@ -0,0 +1,59 @@
+#include "mqtt_load_probe.hpp"
+#include "mqtt_client.hpp"
+
+#include <string.h>
+#include <inttypes.h>
+
+#if CONFIG_MQTT_CLIENT_LOAD_PROBE
+
+#define LOAD_PREFIX     "{\"type\":\"load\",\"seq\":"
+#define LOAD_ACK_FIELD  ",\"ack\":1"
+
+static mqtt_load_probe_stats_t g_stats;
+
+void mqtt_load_probe_on_message(const char *data, int data_len)
+{
+    const int prefix_len = sizeof(LOAD_PREFIX) - 1;
+    if (data_len <= prefix_len || strncmp(data, LOAD_PREFIX, prefix_len) != 0) {
+        return;
+    }
+    // 只在MQTT任务中调用，无需加锁
+    g_stats.received++;
+    g_stats.bytes += data_len;
+
+    // 未分片的消息数据不以'\0'结尾，按长度解析序号
+    unsigned long seq = 0;
+    int pos = prefix_len;
+    while (pos < data_len && data[pos] >= '0' && data[pos] <= '9') {
+        seq = seq * 10 + (data[pos++] - '0');
+    }
+    const int ack_len = sizeof(LOAD_ACK_FIELD) - 1;
+    if (pos + ack_len > data_len || strncmp(data + pos, LOAD_ACK_FIELD, ack_len) != 0) {
+        return;
+    }
+
+    char ack[96];
+    int len = snprintf(ack, sizeof(ack), "{\"type\":\"loadAck\",\"seq\":%lu,\"received\":%" PRIu32 ",\"bytes\":%" PRIu32 "}",
+                       seq, g_stats.received, g_stats.bytes);
+    if (mqtt_client_enqueue(MQTT_PUBLISH_TOPIC, ack, len, 0, "loadAck", true) >= 0) {
+        g_stats.acks++;
+    }
+}
+
+void mqtt_load_probe_get_stats(mqtt_load_probe_stats_t *stats)
+{
+    *stats = g_stats;
+}
+
+#else
+
+void mqtt_load_probe_on_message(const char *data, int data_len)
+{
+}
+
+void mqtt_load_probe_get_stats(mqtt_load_probe_stats_t *stats)
+{
+    memset(stats, 0, sizeof(*stats));
+}
+
+#endif /* CONFIG_MQTT_CLIENT_LOAD_PROBE */
@@ -0,0 +1,38 @@
+#ifndef __MQTT_LOAD_PROBE_HPP__
+#define __MQTT_LOAD_PROBE_HPP__
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * 负载探针：配合主机端负载发生器（pytest_mqtt_tcp.py）测量MQTT接收路径吞吐
+ *
+ * 负载消息格式固定为 {"type":"load","seq":N,"ack":0|1,"pad":"..."}，
+ * 在消息完整处理后计数；ack为1时回复 {"type":"loadAck","seq":N,"received":C,"bytes":B}
+ * 到发布主题，主机据此计算端到端时延和丢失率。
+ */
+
+#if CONFIG_MQTT_CLIENT_LOAD_PROBE
+#define MQTT_LOAD_PROBE_ENABLED 1
+#else
+#define MQTT_LOAD_PROBE_ENABLED 0
+#endif
+
+typedef struct {
+    uint32_t received;                      // 收到的负载消息数
+    uint32_t bytes;                         // 负载消息总字节数
+    uint32_t acks;                          // 已回复的确认数
+} mqtt_load_probe_stats_t;
+
+// 每条完整消息处理后调用；非负载消息直接忽略
+void mqtt_load_probe_on_message(const char *data, int data_len);
+void mqtt_load_probe_get_stats(mqtt_load_probe_stats_t *stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
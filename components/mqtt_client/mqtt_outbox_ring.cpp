@@ -0,0 +1,385 @@
+#include "mqtt_outbox_ring.hpp"
+
+#include <string.h>
+#include <inttypes.h>
+#include "esp_log.h"
+#include "freertos/FreeRTOS.h"
+
+#if CONFIG_MQTT_CUSTOM_OUTBOX
+
+extern "C" {
+#include "mqtt_outbox.h"
+}
+
+/*
+ * 固定大小环形区发件箱，替换ESP-MQTT默认的逐条malloc实现
+ *
+ * - 所有消息存放在一块静态环形区中，入队按顺序追加，空间不足时丢弃最旧的消息
+ * - 中间消息被确认删除后只做标记，等其前面的消息都删除后再统一回收空间
+ * - 每条消息自入队起超过CONFIG_MQTT_CLIENT_OUTBOX_EXPIRY_MS即被丢弃
+ *
+ * ESP-MQTT在客户端锁内调用以下接口，统计数据另用自旋锁保护以便其它任务读取。
+ */
+
+// 保持与默认实现相同的日志标签和格式，pytest依赖 "outbox: ENQUEUE/DELETED msgid=" 日志
+static const char *TAG = "outbox";
+
+#define ARENA_SIZE CONFIG_MQTT_CLIENT_OUTBOX_ARENA_SIZE
+#define MAX_ITEMS  CONFIG_MQTT_CLIENT_OUTBOX_MAX_ITEMS
+
+struct outbox_item {
+    uint32_t offset;                        // 数据在环形区中的起始位置
+    uint32_t len;                           // 数据长度
+    uint32_t span;                          // 占用的环形区字节（含回绕时跳过的尾部）
+    int msg_id;
+    int msg_type;
+    int msg_qos;
+    pending_state_t pending;
+    outbox_tick_t tick;                     // ESP-MQTT用于重传判断的时间
+    outbox_tick_t enqueued_tick;            // 入队时间，用于有效期判断
+    bool live;
+};
+
+struct outbox_t {
+    struct outbox_item items[MAX_ITEMS];    // 按入队顺序排列的描述符环
+    uint32_t item_head;
+    uint32_t item_count;                    // 含已删除但未回收的描述符
+    uint32_t byte_tail;
+    uint32_t byte_used;
+    bool in_use;
+};
+
+static uint8_t s_arena[ARENA_SIZE];
+static struct outbox_t s_outbox;
+static mqtt_outbox_stats_t s_stats;
+static portMUX_TYPE s_stats_lock = portMUX_INITIALIZER_UNLOCKED;
+
+static inline struct outbox_item *item_at(outbox_handle_t outbox, uint32_t i)
+{
+    return &outbox->items[(outbox->item_head + i) % MAX_ITEMS];
+}
+
+// 回收队头所有已删除消息占用的空间
+static void reclaim(outbox_handle_t outbox)
+{
+    while (outbox->item_count > 0 && !outbox->items[outbox->item_head].live) {
+        outbox->byte_used -= outbox->items[outbox->item_head].span;
+        outbox->item_head = (outbox->item_head + 1) % MAX_ITEMS;
+        outbox->item_count--;
+    }
+    if (outbox->item_count == 0) {
+        outbox->byte_used = 0;
+        outbox->byte_tail = 0;
+    }
+    portENTER_CRITICAL(&s_stats_lock);
+    s_stats.arena_used = outbox->byte_used;
+    portEXIT_CRITICAL(&s_stats_lock);
+}
+
+// 只做删除标记，遍历结束后再调用reclaim()，避免遍历中队头移动
+static void remove_item(struct outbox_item *item)
+{
+    item->live = false;
+    portENTER_CRITICAL(&s_stats_lock);
+    s_stats.depth--;
+    s_stats.bytes -= item->len;
+    portEXIT_CRITICAL(&s_stats_lock);
+}
+
+// 丢弃最旧的一条消息，返回false表示发件箱已空
+static bool drop_oldest(outbox_handle_t outbox)
+{
+    for (uint32_t i = 0; i < outbox->item_count; i++) {
+        struct outbox_item *item = item_at(outbox, i);
+        if (item->live) {
+            ESP_LOGW(TAG, "发件箱已满，丢弃最旧消息 msgid=%d, len=%" PRIu32, item->msg_id, item->len);
+            remove_item(item);
+            reclaim(outbox);
+            portENTER_CRITICAL(&s_stats_lock);
+            s_stats.dropped_full++;
+            portEXIT_CRITICAL(&s_stats_lock);
+            return true;
+        }
+    }
+    return false;
+}
+
+// 丢弃超过有效期的消息
+static void drop_expired(outbox_handle_t outbox, outbox_tick_t now)
+{
+    for (uint32_t i = 0; i < outbox->item_count; i++) {
+        struct outbox_item *item = item_at(outbox, i);
+        if (item->live && now - item->enqueued_tick > CONFIG_MQTT_CLIENT_OUTBOX_EXPIRY_MS) {
+            ESP_LOGD(TAG, "消息过期 msgid=%d", item->msg_id);
+            remove_item(item);
+            portENTER_CRITICAL(&s_stats_lock);
+            s_stats.dropped_expired++;
+            portEXIT_CRITICAL(&s_stats_lock);
+        }
+    }
+    reclaim(outbox);
+}
+
+/**
+ * @brief 在环形区中分配连续空间
+ *
+ * @return 起始偏移，空间不足返回-1；span返回实际占用（含回绕跳过的尾部）
+ */
+static int arena_alloc(outbox_handle_t outbox, uint32_t len, uint32_t *span)
+{
+    if (outbox->item_count >= MAX_ITEMS || outbox->byte_used >= ARENA_SIZE) {
+        return -1;
+    }
+    uint32_t tail = outbox->byte_tail;
+    uint32_t head = (tail + ARENA_SIZE - outbox->byte_used) % ARENA_SIZE;
+
+    if (outbox->byte_used == 0 || tail > head) {
+        if (len <= ARENA_SIZE - tail) {
+            *span = len;
+            return tail;
+        }
+        if (len <= head) {
+            *span = (ARENA_SIZE - tail) + len;
+            return 0;
+        }
+        return -1;
+    }
+    if (len <= head - tail) {
+        *span = len;
+        return tail;
+    }
+    return -1;
+}
+
+extern "C" {
+
+outbox_handle_t outbox_init(void)
+{
+    if (s_outbox.in_use) {
+        ESP_LOGE(TAG, "环形发件箱只支持一个MQTT客户端");
+        return NULL;
+    }
+    memset(&s_outbox, 0, sizeof(s_outbox));
+    s_outbox.in_use = true;
+    portENTER_CRITICAL(&s_stats_lock);
+    memset(&s_stats, 0, sizeof(s_stats));
+    s_stats.arena_size = ARENA_SIZE;
+    portEXIT_CRITICAL(&s_stats_lock);
+    return &s_outbox;
+}
+
+outbox_item_handle_t outbox_enqueue(outbox_handle_t outbox, outbox_message_handle_t message, outbox_tick_t tick)
+{
+    uint32_t len = message->len + message->remaining_len;
+    if (len > ARENA_SIZE) {
+        ESP_LOGE(TAG, "消息过大无法入队: %" PRIu32 " > %d", len, ARENA_SIZE);
+        portENTER_CRITICAL(&s_stats_lock);
+        s_stats.rejected++;
+        portEXIT_CRITICAL(&s_stats_lock);
+        return NULL;
+    }
+
+    drop_expired(outbox, tick);
+
+    uint32_t span = 0;
+    int offset;
+    while ((offset = arena_alloc(outbox, len, &span)) < 0) {
+        if (!drop_oldest(outbox)) {
+            return NULL;
+        }
+    }
+
+    struct outbox_item *item = &outbox->items[(outbox->item_head + outbox->item_count) % MAX_ITEMS];
+    item->offset = offset;
+    item->len = len;
+    item->span = span;
+    item->msg_id = message->msg_id;
+    item->msg_type = message->msg_type;
+    item->msg_qos = message->msg_qos;
+    item->pending = QUEUED;
+    item->tick = tick;
+    item->enqueued_tick = tick;
+    item->live = true;
+    memcpy(s_arena + offset, message->data, message->len);
+    if (message->remaining_data) {
+        memcpy(s_arena + offset + message->len, message->remaining_data, message->remaining_len);
+    }
+
+    outbox->item_count++;
+    outbox->byte_used += span;
+    outbox->byte_tail = (offset + len) % ARENA_SIZE;
+
+    portENTER_CRITICAL(&s_stats_lock);
+    s_stats.depth++;
+    s_stats.bytes += len;
+    s_stats.enqueued++;
+    s_stats.arena_used = outbox->byte_used;
+    if (s_stats.depth > s_stats.depth_high_water) {
+        s_stats.depth_high_water = s_stats.depth;
+    }
+    if (s_stats.bytes > s_stats.bytes_high_water) {
+        s_stats.bytes_high_water = s_stats.bytes;
+    }
+    portEXIT_CRITICAL(&s_stats_lock);
+
+    ESP_LOGD(TAG, "ENQUEUE msgid=%d, msg_type=%d, len=%" PRIu32 ", size=%" PRIu32,
+             message->msg_id, message->msg_type, len, s_stats.bytes);
+    return item;
+}
+
+outbox_item_handle_t outbox_get(outbox_handle_t outbox, int msg_id)
+{
+    for (uint32_t i = 0; i < outbox->item_count; i++) {
+        struct outbox_item *item = item_at(outbox, i);
+        if (item->live && item->msg_id == msg_id) {
+            return item;
+        }
+    }
+    return NULL;
+}
+
+outbox_item_handle_t outbox_dequeue(outbox_handle_t outbox, pending_state_t pending, outbox_tick_t *tick)
+{
+    for (uint32_t i = 0; i < outbox->item_count; i++) {
+        struct outbox_item *item = item_at(outbox, i);
+        if (item->live && item->pending == pending) {
+            if (tick) {
+                *tick = item->tick;
+            }
+            return item;
+        }
+    }
+    return NULL;
+}
+
+uint8_t *outbox_item_get_data(outbox_item_handle_t item, size_t *len, uint16_t *msg_id, int *msg_type, int *qos)
+{
+    if (!item) {
+        return NULL;
+    }
+    *len = item->len;
+    *msg_id = item->msg_id;
+    *msg_type = item->msg_type;
+    *qos = item->msg_qos;
+    return s_arena + item->offset;
+}
+
+esp_err_t outbox_delete_item(outbox_handle_t outbox, outbox_item_handle_t item_to_delete)
+{
+    if (!item_to_delete || !item_to_delete->live) {
+        return ESP_FAIL;
+    }
+    remove_item(item_to_delete);
+    reclaim(outbox);
+    return ESP_OK;
+}
+
+esp_err_t outbox_delete(outbox_handle_t outbox, int msg_id, int msg_type)
+{
+    for (uint32_t i = 0; i < outbox->item_count; i++) {
+        struct outbox_item *item = item_at(outbox, i);
+        if (item->live && item->msg_id == msg_id && (0xFF & item->msg_type) == msg_type) {
+            remove_item(item);
+            reclaim(outbox);
+            ESP_LOGD(TAG, "DELETED msgid=%d, msg_type=%d, remain size=%" PRIu32, msg_id, msg_type, s_stats.bytes);
+            return ESP_OK;
+        }
+    }
+    return ESP_FAIL;
+}
+
+esp_err_t outbox_set_pending(outbox_handle_t outbox, int msg_id, pending_state_t pending)
+{
+    outbox_item_handle_t item = outbox_get(outbox, msg_id);
+    if (!item) {
+        return ESP_FAIL;
+    }
+    item->pending = pending;
+    return ESP_OK;
+}
+
+pending_state_t outbox_item_get_pending(outbox_item_handle_t item)
+{
+    return item ? item->pending : QUEUED;
+}
+
+esp_err_t outbox_set_tick(outbox_handle_t outbox, int msg_id, outbox_tick_t tick)
+{
+    outbox_item_handle_t item = outbox_get(outbox, msg_id);
+    if (!item) {
+        return ESP_FAIL;
+    }
+    item->tick = tick;
+    return ESP_OK;
+}
+
+int outbox_delete_single_expired(outbox_handle_t outbox, outbox_tick_t current_tick, outbox_tick_t timeout)
+{
+    for (uint32_t i = 0; i < outbox->item_count; i++) {
+        struct outbox_item *item = item_at(outbox, i);
+        if (item->live && current_tick - item->tick > timeout) {
+            int msg_id = item->msg_id;
+            remove_item(item);
+            reclaim(outbox);
+            return msg_id;
+        }
+    }
+    return -1;
+}
+
+int outbox_delete_expired(outbox_handle_t outbox, outbox_tick_t current_tick, outbox_tick_t timeout)
+{
+    int deleted = 0;
+    for (uint32_t i = 0; i < outbox->item_count; i++) {
+        struct outbox_item *item = item_at(outbox, i);
+        if (item->live && current_tick - item->tick > timeout) {
+            remove_item(item);
+            deleted++;
+        }
+    }
+    reclaim(outbox);
+    return deleted;
+}
+
+uint64_t outbox_get_size(outbox_handle_t outbox)
+{
+    portENTER_CRITICAL(&s_stats_lock);
+    uint64_t size = s_stats.bytes;
+    portEXIT_CRITICAL(&s_stats_lock);
+    return size;
+}
+
+void outbox_delete_all_items(outbox_handle_t outbox)
+{
+    for (uint32_t i = 0; i < outbox->item_count; i++) {
+        struct outbox_item *item = item_at(outbox, i);
+        if (item->live) {
+            remove_item(item);
+        }
+    }
+    reclaim(outbox);
+}
+
+void outbox_destroy(outbox_handle_t outbox)
+{
+    outbox_delete_all_items(outbox);
+    outbox->in_use = false;
+}
+
+} // extern "C"
+
+void mqtt_outbox_get_stats(mqtt_outbox_stats_t *stats)
+{
+    portENTER_CRITICAL(&s_stats_lock);
+    *stats = s_stats;
+    portEXIT_CRITICAL(&s_stats_lock);
+}
+
+#else
+
+void mqtt_outbox_get_stats(mqtt_outbox_stats_t *stats)
+{
+    memset(stats, 0, sizeof(*stats));
+}
+
+#endif /* CONFIG_MQTT_CUSTOM_OUTBOX */
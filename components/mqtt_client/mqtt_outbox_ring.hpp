@@ -0,0 +1,31 @@
+#ifndef __MQTT_OUTBOX_RING_HPP__
+#define __MQTT_OUTBOX_RING_HPP__
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// 发件箱统计
+typedef struct {
+    uint32_t depth;                         // 当前消息数量
+    uint32_t bytes;                         // 当前消息字节数
+    uint32_t arena_used;                    // 环形区占用（含已删除未回收和回绕填充）
+    uint32_t arena_size;                    // 环形区总大小
+    uint32_t depth_high_water;              // 消息数量峰值
+    uint32_t bytes_high_water;              // 字节数峰值
+    uint32_t enqueued;                      // 累计入队
+    uint32_t dropped_full;                  // 空间不足丢弃的最旧消息
+    uint32_t dropped_expired;               // 超过有效期丢弃的消息
+    uint32_t rejected;                      // 超过环形区大小被拒绝的消息
+} mqtt_outbox_stats_t;
+
+// 未启用CONFIG_MQTT_CUSTOM_OUTBOX时返回全0统计
+void mqtt_outbox_get_stats(mqtt_outbox_stats_t *stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,344 @@
+#include "mqtt_reconnect.hpp"
+
+#include <string.h>
+#include <inttypes.h>
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "esp_random.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+
+/*
+ * 重连管理
+ *
+ * ESP-MQTT断线后按固定的reconnect_timeout_ms等待重连。这里把该值设为退避上限作为兜底，
+ * 断线时按抖动指数退避启动定时器，到期调用esp_mqtt_client_reconnect()提前结束等待：
+ * - 第1次重连在[0, base)内随机等待（快速路径），之后在[cap/2, cap)内随机，cap = base * 2^n
+ * - 连接成功后重置退避，并重新发送已保存的订阅
+ * - 统计从断线到所有订阅被确认的时间
+ *
+ * 订阅表由自身互斥锁保护；调用ESP-MQTT接口前先释放，避免与客户端锁交叉等待。
+ * 统计在MQTT事件、退避定时器和状态回复中读写，由g_stats_lock保护。
+ */
+
+static const char *TAG = "mqtt_reconnect";
+
+typedef struct {
+    char topic[MQTT_RECONNECT_TOPIC_LEN];
+    int qos;
+    int msg_id;                             // 最近一次发送的订阅消息ID
+    bool used;
+    bool acked;                             // broker已确认，当前连接上有效
+} subscription_t;
+
+static esp_mqtt_client_handle_t g_client = NULL;
+static esp_timer_handle_t g_timer = NULL;
+static SemaphoreHandle_t g_lock = NULL;
+static subscription_t g_subs[MQTT_RECONNECT_MAX_SUBSCRIPTIONS];
+static bool g_connected = false;
+static bool g_stopped = false;
+static uint32_t g_attempt = 0;
+
+// 断线时间，重新订阅完成后清零
+static int64_t g_disconnect_us = 0;
+// 重连后等待确认的订阅消息ID
+static int g_pending_ids[MQTT_RECONNECT_MAX_SUBSCRIPTIONS];
+static int g_pending_count = 0;
+
+static portMUX_TYPE g_stats_lock = portMUX_INITIALIZER_UNLOCKED;
+static mqtt_reconnect_stats_t g_stats;
+
+// 订阅消息ID写入订阅表之前就到达的SUBACK，写入时再认领
+#define UNMATCHED_ACKS 4
+static int g_unmatched_acks[UNMATCHED_ACKS];
+static int g_unmatched_next = 0;
+
+static uint32_t backoff_ms(uint32_t attempt)
+{
+    const uint32_t base = CONFIG_MQTT_CLIENT_RECONNECT_BASE_MS;
+    if (attempt == 0) {
+        return esp_random() % base;
+    }
+    uint32_t cap = CONFIG_MQTT_CLIENT_RECONNECT_MAX_MS;
+    if (attempt < 16 && (base << attempt) < cap) {
+        cap = base << attempt;
+    }
+    return cap / 2 + esp_random() % (cap / 2 + 1);
+}
+
+static void reconnect_timer_cb(void *arg)
+{
+    if (g_stopped || g_connected) {
+        return;
+    }
+    portENTER_CRITICAL(&g_stats_lock);
+    g_stats.reconnect_attempts++;
+    portEXIT_CRITICAL(&g_stats_lock);
+    ESP_LOGI(TAG, "🔄 第%" PRIu32 "次重连", g_attempt);
+    esp_mqtt_client_reconnect(g_client);
+}
+
+// 调用者持有g_lock
+static void set_msg_id(subscription_t *sub, int msg_id)
+{
+    sub->msg_id = msg_id;
+    if (msg_id <= 0) {
+        return;
+    }
+    for (int i = 0; i < UNMATCHED_ACKS; i++) {
+        if (g_unmatched_acks[i] == msg_id) {
+            g_unmatched_acks[i] = 0;
+            sub->acked = true;
+            return;
+        }
+    }
+}
+
+// 断线到重新订阅完成
+static void report_resubscribed(void)
+{
+    if (g_disconnect_us == 0) {
+        return;
+    }
+    uint32_t elapsed_ms = (esp_timer_get_time() - g_disconnect_us) / 1000;
+    g_disconnect_us = 0;
+    portENTER_CRITICAL(&g_stats_lock);
+    g_stats.last_resubscribed_ms = elapsed_ms;
+    if (elapsed_ms > g_stats.max_resubscribed_ms) {
+        g_stats.max_resubscribed_ms = elapsed_ms;
+    }
+    portEXIT_CRITICAL(&g_stats_lock);
+    ESP_LOGI(TAG, "[Performance][mqtt_disconnect_to_resubscribed_ms]: %" PRIu32, elapsed_ms);
+}
+
+void mqtt_reconnect_apply_config(esp_mqtt_client_config_t *cfg)
+{
+    // 固定间隔仅作兜底，实际由退避定时器提前触发
+    cfg->network.reconnect_timeout_ms = CONFIG_MQTT_CLIENT_RECONNECT_MAX_MS;
+}
+
+void mqtt_reconnect_init(esp_mqtt_client_handle_t client)
+{
+    g_client = client;
+    g_stopped = false;
+    if (!g_lock) {
+        g_lock = xSemaphoreCreateMutex();
+    }
+    if (!g_timer) {
+        esp_timer_create_args_t timer_args = {};
+        timer_args.callback = reconnect_timer_cb;
+        timer_args.name = "mqtt_reconnect";
+        esp_timer_create(&timer_args, &g_timer);
+    }
+}
+
+void mqtt_reconnect_stop(void)
+{
+    g_stopped = true;
+    if (g_timer) {
+        esp_timer_stop(g_timer);
+    }
+}
+
+void mqtt_reconnect_on_disconnected(void)
+{
+    g_connected = false;
+    portENTER_CRITICAL(&g_stats_lock);
+    g_stats.disconnects++;
+    portEXIT_CRITICAL(&g_stats_lock);
+    if (g_disconnect_us == 0) {
+        g_disconnect_us = esp_timer_get_time();
+    }
+    g_pending_count = 0;
+    xSemaphoreTake(g_lock, portMAX_DELAY);
+    for (int i = 0; i < MQTT_RECONNECT_MAX_SUBSCRIPTIONS; i++) {
+        g_subs[i].acked = false;
+    }
+    memset(g_unmatched_acks, 0, sizeof(g_unmatched_acks));
+    xSemaphoreGive(g_lock);
+    if (g_stopped || !g_timer) {
+        return;
+    }
+
+    uint32_t delay_ms = backoff_ms(g_attempt);
+    g_attempt++;
+    portENTER_CRITICAL(&g_stats_lock);
+    g_stats.last_backoff_ms = delay_ms;
+    portEXIT_CRITICAL(&g_stats_lock);
+    ESP_LOGI(TAG, "💔 断线，%" PRIu32 "毫秒后重连", delay_ms);
+    esp_timer_stop(g_timer);
+    esp_timer_start_once(g_timer, (uint64_t)delay_ms * 1000);
+}
+
+void mqtt_reconnect_on_connected(bool session_present)
+{
+    g_connected = true;
+    g_attempt = 0;
+    if (g_timer) {
+        esp_timer_stop(g_timer);
+    }
+
+    subscription_t subs[MQTT_RECONNECT_MAX_SUBSCRIPTIONS];
+    xSemaphoreTake(g_lock, portMAX_DELAY);
+    memcpy(subs, g_subs, sizeof(subs));
+    xSemaphoreGive(g_lock);
+
+    // MQTT v5会话仍在时broker保留了订阅，无需重新发送
+    g_pending_count = 0;
+    for (int i = 0; i < MQTT_RECONNECT_MAX_SUBSCRIPTIONS; i++) {
+        if (!subs[i].used) {
+            continue;
+        }
+        int msg_id = 0;
+        if (!session_present) {
+            msg_id = esp_mqtt_client_subscribe(g_client, subs[i].topic, subs[i].qos);
+            ESP_LOGI(TAG, "📡 重新订阅 %s, msg_id=%d", subs[i].topic, msg_id);
+            if (msg_id > 0) {
+                g_pending_ids[g_pending_count++] = msg_id;
+            }
+        }
+        xSemaphoreTake(g_lock, portMAX_DELAY);
+        if (g_subs[i].used && strcmp(g_subs[i].topic, subs[i].topic) == 0) {
+            g_subs[i].acked = session_present;
+            set_msg_id(&g_subs[i], msg_id);
+        }
+        xSemaphoreGive(g_lock);
+    }
+    if (g_pending_count == 0) {
+        report_resubscribed();
+    }
+}
+
+void mqtt_reconnect_on_subscribed(int msg_id)
+{
+    bool matched = false;
+    xSemaphoreTake(g_lock, portMAX_DELAY);
+    for (int i = 0; i < MQTT_RECONNECT_MAX_SUBSCRIPTIONS; i++) {
+        if (g_subs[i].used && g_subs[i].msg_id == msg_id) {
+            g_subs[i].acked = true;
+            matched = true;
+        }
+    }
+    // 其他任务调用订阅时，SUBACK可能在esp_mqtt_client_subscribe返回之前到达
+    if (!matched && msg_id > 0) {
+        g_unmatched_acks[g_unmatched_next] = msg_id;
+        g_unmatched_next = (g_unmatched_next + 1) % UNMATCHED_ACKS;
+    }
+    xSemaphoreGive(g_lock);
+
+    for (int i = 0; i < g_pending_count; i++) {
+        if (g_pending_ids[i] == msg_id) {
+            g_pending_ids[i] = g_pending_ids[--g_pending_count];
+            if (g_pending_count == 0) {
+                report_resubscribed();
+            }
+            return;
+        }
+    }
+}
+
+int mqtt_reconnect_subscribe(const char *topic, int qos)
+{
+    if (!g_lock || strlen(topic) >= MQTT_RECONNECT_TOPIC_LEN) {
+        return -1;
+    }
+
+    xSemaphoreTake(g_lock, portMAX_DELAY);
+    subscription_t *slot = NULL;
+    for (int i = 0; i < MQTT_RECONNECT_MAX_SUBSCRIPTIONS; i++) {
+        if (g_subs[i].used && strcmp(g_subs[i].topic, topic) == 0) {
+            slot = &g_subs[i];
+            break;
+        }
+        if (!g_subs[i].used && !slot) {
+            slot = &g_subs[i];
+        }
+    }
+    if (!slot) {
+        xSemaphoreGive(g_lock);
+        ESP_LOGE(TAG, "订阅表已满，无法保存 %s", topic);
+        return -1;
+    }
+    if (!slot->used) {
+        strcpy(slot->topic, topic);
+        slot->used = true;
+        portENTER_CRITICAL(&g_stats_lock);
+        g_stats.subscriptions++;
+        portEXIT_CRITICAL(&g_stats_lock);
+    }
+    // 重新订阅（如退出后立即加入）时之前的确认可能属于已取消的订阅，等待这次的SUBACK
+    slot->qos = qos;
+    slot->msg_id = 0;
+    slot->acked = false;
+    xSemaphoreGive(g_lock);
+
+    // 未连接时只保存，连接成功后统一订阅
+    if (!g_connected) {
+        return 0;
+    }
+    int msg_id = esp_mqtt_client_subscribe(g_client, topic, qos);
+    xSemaphoreTake(g_lock, portMAX_DELAY);
+    if (slot->used && strcmp(slot->topic, topic) == 0) {
+        set_msg_id(slot, msg_id);
+    }
+    xSemaphoreGive(g_lock);
+    return msg_id;
+}
+
+int mqtt_reconnect_unsubscribe(const char *topic)
+{
+    if (!g_lock) {
+        return -1;
+    }
+    xSemaphoreTake(g_lock, portMAX_DELAY);
+    for (int i = 0; i < MQTT_RECONNECT_MAX_SUBSCRIPTIONS; i++) {
+        if (g_subs[i].used && strcmp(g_subs[i].topic, topic) == 0) {
+            g_subs[i].used = false;
+            portENTER_CRITICAL(&g_stats_lock);
+            g_stats.subscriptions--;
+            portEXIT_CRITICAL(&g_stats_lock);
+            break;
+        }
+    }
+    xSemaphoreGive(g_lock);
+
+    if (!g_connected) {
+        return 0;
+    }
+    return esp_mqtt_client_unsubscribe(g_client, topic);
+}
+
+bool mqtt_reconnect_is_active(const char *topic)
+{
+    if (!g_lock) {
+        return false;
+    }
+    bool active = false;
+    xSemaphoreTake(g_lock, portMAX_DELAY);
+    for (int i = 0; i < MQTT_RECONNECT_MAX_SUBSCRIPTIONS; i++) {
+        if (g_subs[i].used && strcmp(g_subs[i].topic, topic) == 0) {
+            active = g_subs[i].acked;
+            break;
+        }
+    }
+    xSemaphoreGive(g_lock);
+    return active;
+}
+
+void mqtt_reconnect_get_stats(mqtt_reconnect_stats_t *stats)
+{
+    portENTER_CRITICAL(&g_stats_lock);
+    *stats = g_stats;
+    portEXIT_CRITICAL(&g_stats_lock);
+    stats->active = 0;
+    if (!g_lock) {
+        return;
+    }
+    xSemaphoreTake(g_lock, portMAX_DELAY);
+    for (int i = 0; i < MQTT_RECONNECT_MAX_SUBSCRIPTIONS; i++) {
+        if (g_subs[i].used && g_subs[i].acked) {
+            stats->active++;
+        }
+    }
+    xSemaphoreGive(g_lock);
+}
@@ -0,0 +1,54 @@
+#ifndef __MQTT_RECONNECT_HPP__
+#define __MQTT_RECONNECT_HPP__
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "mqtt_client.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define MQTT_RECONNECT_MAX_SUBSCRIPTIONS 8
+#define MQTT_RECONNECT_TOPIC_LEN         128
+
+// 重连统计
+typedef struct {
+    uint32_t disconnects;                   // 断线次数（含连接失败）
+    uint32_t reconnect_attempts;            // 重连尝试次数
+    uint32_t last_backoff_ms;               // 最近一次退避时间
+    uint32_t last_resubscribed_ms;          // 最近一次断线到重新订阅完成的时间
+    uint32_t max_resubscribed_ms;           // 断线到重新订阅完成的最大时间
+    uint32_t subscriptions;                 // 已保存的订阅数量
+    uint32_t active;                        // 其中broker已确认、当前连接上有效的数量
+} mqtt_reconnect_stats_t;
+
+// 在esp_mqtt_client_init之前调用：关闭ESP-MQTT固定间隔的自动重连
+void mqtt_reconnect_apply_config(esp_mqtt_client_config_t *cfg);
+void mqtt_reconnect_init(esp_mqtt_client_handle_t client);
+// 主动断开（如关机）前调用，停止自动重连
+void mqtt_reconnect_stop(void);
+
+// 以下在MQTT事件处理中调用
+void mqtt_reconnect_on_connected(bool session_present);
+void mqtt_reconnect_on_disconnected(void);
+void mqtt_reconnect_on_subscribed(int msg_id);
+
+/**
+ * @brief 订阅并保存主题，重连后自动重新订阅
+ *
+ * 重复添加同一主题只更新QoS并重新发送订阅。
+ * @return 订阅消息ID；未连接时返回0（连接后再订阅），失败返回-1
+ */
+int mqtt_reconnect_subscribe(const char *topic, int qos);
+int mqtt_reconnect_unsubscribe(const char *topic);
+// 主题已保存且在当前连接上被broker确认
+bool mqtt_reconnect_is_active(const char *topic);
+
+void mqtt_reconnect_get_stats(mqtt_reconnect_stats_t *stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
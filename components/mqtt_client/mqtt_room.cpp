@@ -0,0 +1,350 @@
+#include "mqtt_room.hpp"
+#include "mqtt_client.hpp"
+
+#include <string.h>
+#include <inttypes.h>
+#include "freertos/semphr.h"
+
+/*
+ * 房间表由自身互斥锁保护，只在锁内做决定；订阅、取消订阅和发布在释放锁后调用，
+ * 与重连管理相同，避免MQTT任务在事件回调中调用时与客户端锁交叉等待。
+ */
+
+static const char *TAG = "mqtt_room";
+
+#define ROOM_WILDCARD_TOPIC MQTT_ROOM_TOPIC_PREFIX "+"
+
+typedef struct {
+    char name[MQTT_ROOM_NAME_LEN];
+    int64_t join_us;                        // 等待订阅确认时为加入时间，确认后清零
+    bool used;
+} room_t;
+
+static SemaphoreHandle_t g_lock = NULL;
+static room_t g_rooms[CONFIG_MQTT_CLIENT_ROOM_MAX];
+static bool g_wildcard = false;
+static mqtt_room_stats_t g_stats;
+
+static const char *room_name(const char *room)
+{
+    return room ? room : mqtt_client_get_device_id();
+}
+
+static bool is_default_room(const char *room)
+{
+    return strcmp(room, mqtt_client_get_device_id()) == 0;
+}
+
+// 默认房间是设备自己的结果主题，其他房间在房间命名空间下
+static void room_topic(const char *room, char *topic, size_t size)
+{
+    snprintf(topic, size, "%s%s", is_default_room(room) ? MQTT_SUBSCRIBE_TOPIC_PREFIX : MQTT_ROOM_TOPIC_PREFIX, room);
+}
+
+// 调用者持有g_lock
+static room_t *find_room(const char *room)
+{
+    for (int i = 0; i < CONFIG_MQTT_CLIENT_ROOM_MAX; i++) {
+        if (g_rooms[i].used && strcmp(g_rooms[i].name, room) == 0) {
+            return &g_rooms[i];
+        }
+    }
+    return NULL;
+}
+
+// 调用者持有g_lock；通配订阅只覆盖房间命名空间，不计默认房间
+static uint32_t named_room_count(void)
+{
+    uint32_t count = 0;
+    for (int i = 0; i < CONFIG_MQTT_CLIENT_ROOM_MAX; i++) {
+        if (g_rooms[i].used && !is_default_room(g_rooms[i].name)) {
+            count++;
+        }
+    }
+    return count;
+}
+
+// 房间名作为单级主题，不能为空或包含层级分隔符和通配符
+static bool valid_room_name(const char *room)
+{
+    size_t len = strlen(room);
+    return len > 0 && len < MQTT_ROOM_NAME_LEN && strpbrk(room, "/+#") == NULL;
+}
+
+// 检查等待确认的加入，覆盖该房间的订阅已被broker确认时记录时延
+static void check_pending(void)
+{
+    char topic[MQTT_RECONNECT_TOPIC_LEN];
+    int64_t now = esp_timer_get_time();
+
+    xSemaphoreTake(g_lock, portMAX_DELAY);
+    for (int i = 0; i < CONFIG_MQTT_CLIENT_ROOM_MAX; i++) {
+        room_t *r = &g_rooms[i];
+        if (!r->used || r->join_us == 0) {
+            continue;
+        }
+        if (g_wildcard && !is_default_room(r->name)) {
+            strcpy(topic, ROOM_WILDCARD_TOPIC);
+        } else {
+            room_topic(r->name, topic, sizeof(topic));
+        }
+        if (!mqtt_reconnect_is_active(topic)) {
+            continue;
+        }
+        uint32_t elapsed_ms = (now - r->join_us) / 1000;
+        r->join_us = 0;
+        g_stats.last_join_ms = elapsed_ms;
+        if (elapsed_ms > g_stats.max_join_ms) {
+            g_stats.max_join_ms = elapsed_ms;
+        }
+        ESP_LOGI(TAG, "[Performance][mqtt_room_join_ms]: %" PRIu32 " (%s)", elapsed_ms, r->name);
+    }
+    xSemaphoreGive(g_lock);
+}
+
+// 退出通知，默认房间保持原来的 {"deviceId","type"} 格式
+static int publish_leave(const char *room)
+{
+    cJSON *json = cJSON_CreateObject();
+    cJSON_AddStringToObject(json, "deviceId", mqtt_client_get_device_id());
+    cJSON_AddStringToObject(json, "type", "sfu");
+    if (!is_default_room(room)) {
+        cJSON_AddStringToObject(json, "room", room);
+    }
+    char *message = HEAP_JSON_PRINT(HEAP_COMP_MQTT, json);
+    cJSON_Delete(json);
+    if (!message) {
+        return -1;
+    }
+    int msg_id = mqtt_client_publish(MQTT_LAST_WILL_TOPIC, message, strlen(message), 1, "leave", true);
+    HEAP_JSON_FREE(HEAP_COMP_MQTT, message);
+    return msg_id;
+}
+
+void mqtt_room_init(void)
+{
+    if (!g_lock) {
+        g_lock = xSemaphoreCreateMutex();
+    }
+}
+
+int mqtt_room_join(const char *room)
+{
+    room = room_name(room);
+    if (!g_lock || !valid_room_name(room)) {
+        return -1;
+    }
+
+    // 切换到通配订阅时需要取消的房间订阅
+    char names[CONFIG_MQTT_CLIENT_ROOM_MAX][MQTT_ROOM_NAME_LEN];
+    int name_count = 0;
+    bool switch_wildcard = false;
+
+    xSemaphoreTake(g_lock, portMAX_DELAY);
+    if (find_room(room)) {
+        g_stats.duplicates++;
+        xSemaphoreGive(g_lock);
+        return 0;
+    }
+    room_t *slot = NULL;
+    for (int i = 0; i < CONFIG_MQTT_CLIENT_ROOM_MAX && !slot; i++) {
+        if (!g_rooms[i].used) {
+            slot = &g_rooms[i];
+        }
+    }
+    if (!slot) {
+        xSemaphoreGive(g_lock);
+        ESP_LOGE(TAG, "房间数已达上限%d，无法加入 %s", CONFIG_MQTT_CLIENT_ROOM_MAX, room);
+        return -1;
+    }
+    strcpy(slot->name, room);
+    slot->join_us = esp_timer_get_time();
+    slot->used = true;
+    g_stats.joined++;
+    g_stats.joins++;
+    const bool named = !is_default_room(room);
+    const bool covered = named && g_wildcard;
+    if (named && !g_wildcard && CONFIG_MQTT_CLIENT_ROOM_WILDCARD_MIN_ROOMS > 0 &&
+        named_room_count() >= CONFIG_MQTT_CLIENT_ROOM_WILDCARD_MIN_ROOMS) {
+        g_wildcard = true;
+        switch_wildcard = true;
+        for (int i = 0; i < CONFIG_MQTT_CLIENT_ROOM_MAX; i++) {
+            if (g_rooms[i].used && &g_rooms[i] != slot && !is_default_room(g_rooms[i].name)) {
+                strcpy(names[name_count++], g_rooms[i].name);
+            }
+        }
+    }
+    xSemaphoreGive(g_lock);
+
+    char topic[MQTT_RECONNECT_TOPIC_LEN];
+    int msg_id = 0;
+    if (switch_wildcard) {
+        // 先订阅通配再取消各房间订阅，broker按序处理，切换过程中不漏消息
+        msg_id = mqtt_reconnect_subscribe(ROOM_WILDCARD_TOPIC, 1);
+        if (msg_id >= 0) {
+            ESP_LOGI(TAG, "🏠 已加入%d个房间，改用通配订阅 %s", name_count + 1, ROOM_WILDCARD_TOPIC);
+            for (int i = 0; i < name_count; i++) {
+                room_topic(names[i], topic, sizeof(topic));
+                mqtt_reconnect_unsubscribe(topic);
+            }
+        } else {
+            // 订阅表已满时保持逐个订阅
+            xSemaphoreTake(g_lock, portMAX_DELAY);
+            g_wildcard = false;
+            xSemaphoreGive(g_lock);
+            switch_wildcard = false;
+        }
+    }
+    if (!covered && !switch_wildcard) {
+        room_topic(room, topic, sizeof(topic));
+        msg_id = mqtt_reconnect_subscribe(topic, 1);
+    }
+    if (msg_id < 0) {
+        xSemaphoreTake(g_lock, portMAX_DELAY);
+        slot->used = false;
+        g_stats.joined--;
+        g_stats.joins--;
+        xSemaphoreGive(g_lock);
+        ESP_LOGE(TAG, "加入房间失败: %s", room);
+        return -1;
+    }
+
+    ESP_LOGI(TAG, "🏠 加入房间 %s%s", room, covered ? "（通配订阅已覆盖）" : "");
+    // 已有订阅覆盖时立即完成
+    check_pending();
+    return msg_id;
+}
+
+int mqtt_room_leave(const char *room)
+{
+    room = room_name(room);
+    if (!g_lock) {
+        return -1;
+    }
+
+    char topic[MQTT_RECONNECT_TOPIC_LEN];
+    bool unsubscribe = false;
+
+    xSemaphoreTake(g_lock, portMAX_DELAY);
+    room_t *slot = find_room(room);
+    if (!slot) {
+        g_stats.duplicates++;
+        xSemaphoreGive(g_lock);
+        return 0;
+    }
+    slot->used = false;
+    g_stats.joined--;
+    g_stats.leaves++;
+    if (!g_wildcard || is_default_room(room)) {
+        room_topic(room, topic, sizeof(topic));
+        unsubscribe = true;
+    } else if (named_room_count() == 0) {
+        strcpy(topic, ROOM_WILDCARD_TOPIC);
+        g_wildcard = false;
+        unsubscribe = true;
+    }
+    xSemaphoreGive(g_lock);
+
+    // 退出通知在取消订阅之前写入连接，服务器先看到退出
+    int msg_id = publish_leave(room);
+    if (unsubscribe) {
+        mqtt_reconnect_unsubscribe(topic);
+    }
+    ESP_LOGI(TAG, "🚪 退出房间 %s, msg_id=%d", room, msg_id);
+    return msg_id < 0 ? -1 : 0;
+}
+
+bool mqtt_room_is_joined(const char *room)
+{
+    room = room_name(room);
+    if (!g_lock) {
+        return false;
+    }
+    xSemaphoreTake(g_lock, portMAX_DELAY);
+    bool joined = find_room(room) != NULL;
+    xSemaphoreGive(g_lock);
+    return joined;
+}
+
+bool mqtt_room_filter(const char *topic)
+{
+    const char *room = NULL;
+    if (strncmp(topic, MQTT_ROOM_TOPIC_PREFIX, strlen(MQTT_ROOM_TOPIC_PREFIX)) == 0) {
+        room = topic + strlen(MQTT_ROOM_TOPIC_PREFIX);
+    } else if (strncmp(topic, MQTT_SUBSCRIBE_TOPIC_PREFIX, strlen(MQTT_SUBSCRIBE_TOPIC_PREFIX)) == 0) {
+        room = topic + strlen(MQTT_SUBSCRIBE_TOPIC_PREFIX);
+    }
+    if (!g_lock || !room) {
+        return true;
+    }
+    char expected[MQTT_RECONNECT_TOPIC_LEN];
+    room_topic(room, expected, sizeof(expected));
+    xSemaphoreTake(g_lock, portMAX_DELAY);
+    // 结果主题只属于默认房间，房间命名空间下不接受设备ID
+    bool joined = strcmp(topic, expected) == 0 && find_room(room) != NULL;
+    if (!joined) {
+        g_stats.filtered++;
+    }
+    xSemaphoreGive(g_lock);
+    return joined;
+}
+
+void mqtt_room_on_subscribed(void)
+{
+    if (g_lock) {
+        check_pending();
+    }
+}
+
+void mqtt_room_get_stats(mqtt_room_stats_t *stats)
+{
+    mqtt_reconnect_stats_t reconnect;
+    mqtt_reconnect_get_stats(&reconnect);
+    if (g_lock) {
+        xSemaphoreTake(g_lock, portMAX_DELAY);
+    }
+    *stats = g_stats;
+    stats->wildcard = g_wildcard;
+    if (g_lock) {
+        xSemaphoreGive(g_lock);
+    }
+    stats->broker_subscriptions = reconnect.active;
+}
+
+void mqtt_room_add_json(cJSON *json)
+{
+    mqtt_room_stats_t stats;
+    mqtt_room_get_stats(&stats);
+    cJSON *rooms = cJSON_AddObjectToObject(json, "rooms");
+    cJSON_AddNumberToObject(rooms, "joined", stats.joined);
+    cJSON_AddBoolToObject(rooms, "wildcard", stats.wildcard);
+    cJSON_AddNumberToObject(rooms, "brokerSubscriptions", stats.broker_subscriptions);
+    cJSON_AddNumberToObject(rooms, "lastJoinMs", stats.last_join_ms);
+    cJSON_AddNumberToObject(rooms, "maxJoinMs", stats.max_join_ms);
+    cJSON_AddNumberToObject(rooms, "duplicates", stats.duplicates);
+    cJSON_AddNumberToObject(rooms, "filtered", stats.filtered);
+
+    // 当前加入的房间名，默认房间为设备ID
+    cJSON *names = cJSON_AddArrayToObject(rooms, "names");
+    if (!g_lock) {
+        return;
+    }
+    xSemaphoreTake(g_lock, portMAX_DELAY);
+    for (int i = 0; i < CONFIG_MQTT_CLIENT_ROOM_MAX; i++) {
+        if (g_rooms[i].used) {
+            cJSON_AddItemToArray(names, cJSON_CreateString(g_rooms[i].name));
+        }
+    }
+    xSemaphoreGive(g_lock);
+}
+
+void mqtt_room_report(void)
+{
+    mqtt_room_stats_t stats;
+    mqtt_room_get_stats(&stats);
+    ESP_LOGI(TAG, "房间: 加入%" PRIu32 "个%s, 累计加入%" PRIu32 "次/退出%" PRIu32 "次, 重复%" PRIu32 ", 丢弃%" PRIu32,
+             stats.joined, stats.wildcard ? "（通配订阅）" : "", stats.joins, stats.leaves,
+             stats.duplicates, stats.filtered);
+    ESP_LOGI(TAG, "[Performance][mqtt_room_broker_subscriptions]: %" PRIu32, stats.broker_subscriptions);
+    ESP_LOGI(TAG, "[Performance][mqtt_room_join_max_ms]: %" PRIu32, stats.max_join_ms);
+}
@@ -0,0 +1,81 @@
+#ifndef __MQTT_ROOM_HPP__
+#define __MQTT_ROOM_HPP__
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "cJSON.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * 房间成员管理
+ *
+ * 房间R对应主题 MQTT_ROOM_TOPIC_PREFIX + R；默认房间为设备ID，对应设备自己的结果主题
+ * MQTT_SUBSCRIBE_TOPIC_PREFIX + deviceId（即原来的/result/<deviceId>），总是单独订阅。
+ * - 加入/退出幂等：重复加入或退出未加入的房间不产生任何报文
+ * - 不等待：退出通知、取消订阅、订阅按顺序直接写入同一连接，broker按序处理
+ * - 同时加入的非默认房间达到CONFIG_MQTT_CLIENT_ROOM_WILDCARD_MIN_ROOMS时改用一个通配订阅
+ *   （MQTT_ROOM_TOPIC_PREFIX + "+"），先订阅通配再取消各房间的订阅，中间不漏消息；通配订阅保持到
+ *   这些房间都退出。通配只覆盖房间命名空间，不会收到其他设备的结果主题
+ * - 通配订阅下收到的未加入房间的消息在分发前丢弃
+ *
+ * 加入时延从调用mqtt_room_join到覆盖该房间的订阅被broker确认，已有订阅覆盖时接近0。
+ */
+
+#define MQTT_ROOM_TOPIC_PREFIX "/public/striped-kind-tiger/room/"
+#define MQTT_ROOM_NAME_LEN 64
+
+typedef struct {
+    uint32_t joined;                        // 当前加入的房间数
+    uint32_t joins;                         // 加入次数（不含重复）
+    uint32_t leaves;                        // 退出次数（不含重复）
+    uint32_t duplicates;                    // 幂等忽略的重复加入/退出
+    uint32_t filtered;                      // 丢弃的未加入房间消息
+    uint32_t last_join_ms;                  // 最近一次加入时延
+    uint32_t max_join_ms;                   // 最大加入时延
+    uint32_t broker_subscriptions;          // broker已确认的订阅数
+    bool wildcard;                          // 是否使用通配订阅
+} mqtt_room_stats_t;
+
+void mqtt_room_init(void);
+
+/**
+ * @brief 加入房间，已加入时直接返回
+ *
+ * @param room 房间名，NULL为默认房间（设备ID）
+ * @return 订阅消息ID；无需订阅或未连接时返回0，失败返回-1
+ */
+int mqtt_room_join(const char *room);
+
+/**
+ * @brief 退出房间：发布退出通知到MQTT_LAST_WILL_TOPIC并取消不再需要的订阅，未加入时直接返回
+ *
+ * @return 0成功，-1失败
+ */
+int mqtt_room_leave(const char *room);
+
+bool mqtt_room_is_joined(const char *room);
+
+/**
+ * @brief 分发前调用：房间主题上未加入房间的消息返回false，其他主题返回true
+ */
+bool mqtt_room_filter(const char *topic);
+
+// 在MQTT_EVENT_SUBSCRIBED和连接成功后调用，统计等待确认的加入时延
+void mqtt_room_on_subscribed(void);
+
+void mqtt_room_get_stats(mqtt_room_stats_t *stats);
+
+// 把统计加入设备状态消息（"rooms"对象）
+void mqtt_room_add_json(cJSON *json);
+
+// 打印加入时延和订阅数量
+void mqtt_room_report(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
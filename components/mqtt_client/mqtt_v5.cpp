@@ -0,0 +1,399 @@
+#include "mqtt_v5.hpp"
+#include "mqtt_client.hpp"
+
+#include "freertos/semphr.h"
+
+static const char *TAG = "mqtt_v5";
+
+static mqtt_wire_stats_t wire_stats;
+static portMUX_TYPE wire_stats_lock = portMUX_INITIALIZER_UNLOCKED;
+
+// 变长整数编码长度
+static int varint_len(int value)
+{
+    int n = 1;
+    while (value >= 128) {
+        value /= 128;
+        n++;
+    }
+    return n;
+}
+
+int mqtt_publish_header_bytes(int topic_len, int payload_len, int qos, int property_len, bool v5)
+{
+    int variable = 2 + topic_len + (qos > 0 ? 2 : 0);
+    if (v5) {
+        variable += varint_len(property_len) + property_len;
+    }
+    return 1 + varint_len(variable + payload_len) + variable;
+}
+
+void mqtt_wire_stats_add(int header_bytes, int payload_len, bool alias_only)
+{
+    portENTER_CRITICAL(&wire_stats_lock);
+    wire_stats.messages++;
+    wire_stats.header_bytes += header_bytes;
+    wire_stats.payload_bytes += payload_len;
+    if (alias_only) {
+        wire_stats.alias_hits++;
+    }
+    portEXIT_CRITICAL(&wire_stats_lock);
+}
+
+void mqtt_wire_stats_get(mqtt_wire_stats_t *stats)
+{
+    portENTER_CRITICAL(&wire_stats_lock);
+    *stats = wire_stats;
+    portEXIT_CRITICAL(&wire_stats_lock);
+}
+
+/**
+ * @brief 输出固定主题单条消息的头部字节对比及累计统计
+ */
+void mqtt_wire_stats_report(void)
+{
+    const int topic_len = strlen(MQTT_PUBLISH_TOPIC);
+    // 用户属性 "msg"="sfu"：标识(1) + 键长度(2) + 键 + 值长度(2) + 值
+    const int user_property_len = 1 + 2 + 3 + 2 + 3;
+    // 主题别名属性：标识(1) + 别名(2)
+    const int alias_property_len = 3;
+
+    int v311 = mqtt_publish_header_bytes(topic_len, 0, 1, 0, false);
+    int v5_first = mqtt_publish_header_bytes(topic_len, 0, 1, alias_property_len + user_property_len, true);
+    int v5_alias = mqtt_publish_header_bytes(0, 0, 1, alias_property_len + user_property_len, true);
+    ESP_LOGI(TAG, "[Performance][mqtt_publish_header_bytes_v311]: %d", v311);
+    ESP_LOGI(TAG, "[Performance][mqtt_publish_header_bytes_v5_first]: %d", v5_first);
+    ESP_LOGI(TAG, "[Performance][mqtt_publish_header_bytes_v5_alias]: %d", v5_alias);
+
+    mqtt_wire_stats_t stats;
+    mqtt_wire_stats_get(&stats);
+    if (stats.messages > 0) {
+        ESP_LOGI(TAG, "[Performance][mqtt_avg_header_bytes]: %" PRIu32 " (消息%" PRIu32 "条，别名%" PRIu32 "条)",
+                 stats.header_bytes / stats.messages, stats.messages, stats.alias_hits);
+    }
+}
+
+#if CONFIG_MQTT_CLIENT_PROTOCOL_V5
+
+/*
+ * 锁的顺序
+ *
+ * ESP-MQTT在MQTT任务中持有客户端锁（MQTT_API_LOCK）分发事件，事件回调中的发布（状态回复、loadAck等）
+ * 进入这里时已持有客户端锁，其他任务的发布在ESP-MQTT接口内才取客户端锁：
+ * - 别名表由自旋锁alias_lock保护，持有期间不调用ESP-MQTT接口；连接事件不等待任何锁，只递增连接代数，
+ *   发布时发现代数变化再清空别名表
+ * - 发布属性由esp_mqtt5_client_set_publish_property设置、供下一次发布使用，两次调用之间不能插入其他发布，
+ *   由send_lock串行。MQTT任务从不等待send_lock：取不到时持有者正在等待客户端锁，消息复制到延迟队列，
+ *   由持有者释放send_lock前发出
+ * - 其他任务选定别名后在等待客户端锁期间可能已经重新连接，只携带别名的消息会发到没有映射的新连接上，
+ *   因此只有MQTT任务（选择和发送之间不会重连）立即发布时才省略主题；enqueue的消息稍后才发出，不记录映射
+ */
+
+#define DEFERRED_PUBLISH_MAX 8
+
+typedef struct deferred_publish {
+    struct deferred_publish *next;
+    char *topic;
+    char *data;
+    char *msg_type;                         // 可为NULL
+    int len;
+    int qos;
+    bool utf8;
+    bool enqueue;
+} deferred_publish_t;
+
+static SemaphoreHandle_t send_lock = NULL;
+// 分发事件的MQTT任务，连接事件中记录
+static TaskHandle_t mqtt_task = NULL;
+
+static portMUX_TYPE alias_lock = portMUX_INITIALIZER_UNLOCKED;
+// 每次连接递增；别名表属于table_generation这次连接
+static uint32_t connection_generation = 0;
+static uint32_t table_generation = 0;
+// 本次连接中已建立映射的别名
+static bool alias_established[MQTT_V5_TOPIC_ALIAS_MAX + 1];
+// 本次连接可用的最大别名，不超过broker在CONNACK中给出的Topic Alias Maximum（未给出时为0）
+static uint16_t alias_max = MQTT_V5_TOPIC_ALIAS_MAX;
+
+static portMUX_TYPE deferred_lock = portMUX_INITIALIZER_UNLOCKED;
+static deferred_publish_t *deferred_head = NULL;
+static deferred_publish_t *deferred_tail = NULL;
+static int deferred_count = 0;
+
+void mqtt_v5_apply_config(esp_mqtt_client_config_t *cfg)
+{
+    cfg->session.protocol_ver = MQTT_PROTOCOL_V_5;
+    // 保留会话：短暂断线后broker仍保存订阅和未确认消息
+    cfg->session.disable_clean_session = true;
+    if (!send_lock) {
+        send_lock = xSemaphoreCreateMutex();
+    }
+}
+
+void mqtt_v5_set_connect_property(esp_mqtt_client_handle_t client)
+{
+    esp_mqtt5_connection_property_config_t connect_property = {};
+    connect_property.session_expiry_interval = CONFIG_MQTT_CLIENT_V5_SESSION_EXPIRY_S;
+    connect_property.topic_alias_maximum = MQTT_V5_TOPIC_ALIAS_MAX;
+    connect_property.request_problem_info = true;
+    connect_property.payload_format_indicator = true;
+
+    esp_err_t ret = esp_mqtt5_client_set_connect_property(client, &connect_property);
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "设置MQTT v5连接属性失败: %s", esp_err_to_name(ret));
+        return;
+    }
+    ESP_LOGI(TAG, "MQTT v5: 会话过期%d秒，主题别名%s", CONFIG_MQTT_CLIENT_V5_SESSION_EXPIRY_S,
+             CONFIG_MQTT_CLIENT_V5_TOPIC_ALIAS ? "启用" : "禁用");
+}
+
+// 在MQTT事件回调中调用（已持有客户端锁），不能等待send_lock
+void mqtt_v5_on_connected(void)
+{
+    TaskHandle_t task = xTaskGetCurrentTaskHandle();
+    portENTER_CRITICAL(&alias_lock);
+    mqtt_task = task;
+    connection_generation++;
+    portEXIT_CRITICAL(&alias_lock);
+}
+
+/**
+ * @brief 选择主题别名并判断能否只携带别名
+ *
+ * 别名表属于之前的连接时先清空
+ * @param may_omit_topic 调用者能保证选择和发送属于同一次连接
+ * @param[out] generation 做出选择时的连接代数，发布成功后据此记录映射
+ */
+static uint16_t topic_alias_for(const char *topic, int qos, bool may_omit_topic, bool *alias_only,
+                                uint32_t *generation)
+{
+    uint16_t alias = 0;
+#if CONFIG_MQTT_CLIENT_V5_TOPIC_ALIAS
+    if (strcmp(topic, MQTT_PUBLISH_TOPIC) == 0) {
+        alias = MQTT_V5_ALIAS_PUBLISH_TOPIC;
+    } else if (strcmp(topic, MQTT_LAST_WILL_TOPIC) == 0) {
+        alias = MQTT_V5_ALIAS_LAST_WILL_TOPIC;
+    }
+#endif
+    portENTER_CRITICAL(&alias_lock);
+    if (table_generation != connection_generation) {
+        table_generation = connection_generation;
+        memset(alias_established, 0, sizeof(alias_established));
+        alias_max = MQTT_V5_TOPIC_ALIAS_MAX;
+    }
+    *generation = table_generation;
+    if (alias > alias_max) {
+        alias = 0;
+    }
+#if CONFIG_MQTT_CLIENT_V5_ALIAS_QOS1
+    *alias_only = may_omit_topic && alias && alias_established[alias];
+#else
+    *alias_only = may_omit_topic && alias && alias_established[alias] && qos == 0;
+#endif
+    portEXIT_CRITICAL(&alias_lock);
+    return alias;
+}
+
+// 调用者持有send_lock：设置发布属性后立即发布，期间没有其他发布插入
+static int send_locked(esp_mqtt_client_handle_t client, const char *topic, const char *data, int len,
+                       int qos, const char *msg_type, bool utf8, bool enqueue, bool in_mqtt_task)
+{
+    esp_mqtt5_publish_property_config_t publish_property = {};
+    publish_property.payload_format_indicator = utf8;
+    int property_len = utf8 ? 2 : 0;
+
+    if (msg_type) {
+        esp_mqtt5_user_property_item_t item = { "msg", msg_type };
+        esp_mqtt5_client_set_user_property(&publish_property.user_property, &item, 1);
+        property_len += 1 + 2 + 3 + 2 + strlen(msg_type);
+    }
+
+    bool alias_only = false;
+    uint32_t generation = 0;
+    uint16_t alias = topic_alias_for(topic, qos, in_mqtt_task && !enqueue, &alias_only, &generation);
+    if (alias) {
+        publish_property.topic_alias = alias;
+        if (esp_mqtt5_client_set_publish_property(client, &publish_property) != ESP_OK) {
+            ESP_LOGW(TAG, "broker的主题别名上限小于%u，本次连接改用完整主题", alias);
+            portENTER_CRITICAL(&alias_lock);
+            if (table_generation == generation && alias_max >= alias) {
+                alias_max = alias - 1;
+            }
+            portEXIT_CRITICAL(&alias_lock);
+            publish_property.topic_alias = 0;
+            alias = 0;
+            alias_only = false;
+        }
+    }
+    if (alias) {
+        property_len += 3;
+    } else {
+        esp_mqtt5_client_set_publish_property(client, &publish_property);
+    }
+
+    const char *wire_topic = alias_only ? "" : topic;
+    int msg_id = enqueue ? esp_mqtt_client_enqueue(client, wire_topic, data, len, qos, 0, true)
+                         : esp_mqtt_client_publish(client, wire_topic, data, len, qos, 0);
+    if (msg_id >= 0 && alias && !enqueue) {
+        // 发布期间重新连接时映射属于旧连接，不记录
+        portENTER_CRITICAL(&alias_lock);
+        if (table_generation == generation) {
+            alias_established[alias] = true;
+        }
+        portEXIT_CRITICAL(&alias_lock);
+    }
+
+    if (publish_property.user_property) {
+        esp_mqtt5_client_delete_user_property(publish_property.user_property);
+    }
+    if (msg_id >= 0) {
+        int topic_len = alias_only ? 0 : strlen(topic);
+        mqtt_wire_stats_add(mqtt_publish_header_bytes(topic_len, len, qos, property_len, true), len, alias_only);
+    }
+    return msg_id;
+}
+
+/**
+ * @brief MQTT任务取不到send_lock时复制消息，等待持有者发出
+ *
+ * @return 0表示已排队（消息ID未知），失败返回-1
+ */
+static int defer_publish(const char *topic, const char *data, int len, int qos, const char *msg_type,
+                         bool utf8, bool enqueue)
+{
+    size_t topic_size = strlen(topic) + 1;
+    size_t type_size = msg_type ? strlen(msg_type) + 1 : 0;
+    deferred_publish_t *item = static_cast<deferred_publish_t*>(
+        HEAP_MALLOC(HEAP_COMP_MQTT, sizeof(deferred_publish_t) + topic_size + type_size + len));
+    if (!item) {
+        return -1;
+    }
+    item->next = NULL;
+    item->topic = (char *)(item + 1);
+    memcpy(item->topic, topic, topic_size);
+    item->msg_type = NULL;
+    if (msg_type) {
+        item->msg_type = item->topic + topic_size;
+        memcpy(item->msg_type, msg_type, type_size);
+    }
+    item->data = item->topic + topic_size + type_size;
+    if (len > 0) {
+        memcpy(item->data, data, len);
+    }
+    item->len = len;
+    item->qos = qos;
+    item->utf8 = utf8;
+    item->enqueue = enqueue;
+
+    portENTER_CRITICAL(&deferred_lock);
+    bool full = deferred_count >= DEFERRED_PUBLISH_MAX;
+    if (!full) {
+        if (deferred_tail) {
+            deferred_tail->next = item;
+        } else {
+            deferred_head = item;
+        }
+        deferred_tail = item;
+        deferred_count++;
+    }
+    portEXIT_CRITICAL(&deferred_lock);
+    if (full) {
+        HEAP_FREE(item);
+        ESP_LOGW(TAG, "延迟发布队列已满，丢弃发往%s的消息", topic);
+        return -1;
+    }
+    return 0;
+}
+
+static deferred_publish_t *pop_deferred(void)
+{
+    portENTER_CRITICAL(&deferred_lock);
+    deferred_publish_t *item = deferred_head;
+    if (item) {
+        deferred_head = item->next;
+        if (!deferred_head) {
+            deferred_tail = NULL;
+        }
+        deferred_count--;
+    }
+    portEXIT_CRITICAL(&deferred_lock);
+    return item;
+}
+
+// 发出延迟队列后释放send_lock；释放前后都可能有MQTT任务排队，能再取到锁时继续发出
+static void release_send_lock(esp_mqtt_client_handle_t client)
+{
+    for (;;) {
+        deferred_publish_t *item;
+        while ((item = pop_deferred()) != NULL) {
+            send_locked(client, item->topic, item->data, item->len, item->qos, item->msg_type, item->utf8, item->enqueue,
+                        false);
+            HEAP_FREE(item);
+        }
+        xSemaphoreGive(send_lock);
+
+        portENTER_CRITICAL(&deferred_lock);
+        bool pending = deferred_head != NULL;
+        portEXIT_CRITICAL(&deferred_lock);
+        if (!pending || xSemaphoreTake(send_lock, 0) != pdTRUE) {
+            return;
+        }
+    }
+}
+
+/**
+ * @brief 以MQTT v5属性发布消息
+ *
+ * 固定主题使用主题别名：本次连接首次立即发布时携带主题和别名建立映射，之后MQTT任务中的立即发布只携带别名。
+ * ESP-MQTT不提供读取CONNACK属性的接口，但设置发布属性时会按CONNACK的Topic Alias Maximum
+ * 校验别名；超出时本次连接的别名上限降到该别名之下，消息改用完整主题发送。
+ * 未确认的QoS1消息会在重连后原样重发，而别名映射不跨连接，
+ * 因此默认只对QoS0消息省略主题，QoS1需显式开启CONFIG_MQTT_CLIENT_V5_ALIAS_QOS1。
+ * MQTT任务中其他任务正在发布时消息进入延迟队列，返回0。
+ */
+int mqtt_v5_publish(esp_mqtt_client_handle_t client, const char *topic, const char *data, int len,
+                    int qos, const char *msg_type, bool utf8, bool enqueue)
+{
+    TaskHandle_t task = xTaskGetCurrentTaskHandle();
+    portENTER_CRITICAL(&alias_lock);
+    bool in_mqtt_task = task == mqtt_task;
+    portEXIT_CRITICAL(&alias_lock);
+    if (xSemaphoreTake(send_lock, in_mqtt_task ? 0 : portMAX_DELAY) != pdTRUE) {
+        int ret = defer_publish(topic, data, len, qos, msg_type, utf8, enqueue);
+        // 排队期间持有者可能已经释放
+        if (ret == 0 && xSemaphoreTake(send_lock, 0) == pdTRUE) {
+            release_send_lock(client);
+        }
+        return ret;
+    }
+    int msg_id = send_locked(client, topic, data, len, qos, msg_type, utf8, enqueue, in_mqtt_task);
+    release_send_lock(client);
+    return msg_id;
+}
+
+#else
+
+void mqtt_v5_apply_config(esp_mqtt_client_config_t *cfg)
+{
+}
+
+void mqtt_v5_set_connect_property(esp_mqtt_client_handle_t client)
+{
+}
+
+void mqtt_v5_on_connected(void)
+{
+}
+
+int mqtt_v5_publish(esp_mqtt_client_handle_t client, const char *topic, const char *data, int len,
+                    int qos, const char *msg_type, bool utf8, bool enqueue)
+{
+    int msg_id = enqueue ? esp_mqtt_client_enqueue(client, topic, data, len, qos, 0, true)
+                         : esp_mqtt_client_publish(client, topic, data, len, qos, 0);
+    if (msg_id >= 0) {
+        mqtt_wire_stats_add(mqtt_publish_header_bytes(strlen(topic), len, qos, 0, false), len, false);
+    }
+    return msg_id;
+}
+
+#endif /* CONFIG_MQTT_CLIENT_PROTOCOL_V5 */
@@ -0,0 +1,42 @@
+#ifndef __MQTT_V5_HPP__
+#define __MQTT_V5_HPP__
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "mqtt_client.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// MQTT v5 固定主题别名（别名仅在一次连接内有效，每次连接后重新建立）
+#define MQTT_V5_ALIAS_PUBLISH_TOPIC     1
+#define MQTT_V5_ALIAS_LAST_WILL_TOPIC   2
+#define MQTT_V5_TOPIC_ALIAS_MAX         2
+
+// 线路字节统计
+typedef struct {
+    uint32_t messages;                      // 发布的消息数量
+    uint32_t payload_bytes;                 // 负载字节数
+    uint32_t header_bytes;                  // 固定头+可变头+属性字节数
+    uint32_t alias_hits;                    // 仅携带主题别名发送的消息数量
+} mqtt_wire_stats_t;
+
+void mqtt_v5_apply_config(esp_mqtt_client_config_t *cfg);
+void mqtt_v5_set_connect_property(esp_mqtt_client_handle_t client);
+void mqtt_v5_on_connected(void);
+// utf8为true时负载是UTF-8文本（JSON），v5模式下设置Payload Format Indicator
+int mqtt_v5_publish(esp_mqtt_client_handle_t client, const char *topic, const char *data, int len,
+                    int qos, const char *msg_type, bool utf8, bool enqueue);
+
+// 估算一条PUBLISH报文的头部字节数（不含负载）
+int mqtt_publish_header_bytes(int topic_len, int payload_len, int qos, int property_len, bool v5);
+void mqtt_wire_stats_add(int header_bytes, int payload_len, bool alias_only);
+void mqtt_wire_stats_get(mqtt_wire_stats_t *stats);
+void mqtt_wire_stats_report(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
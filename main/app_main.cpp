@@ -1,9 +1,77 @@
 #include <stdio.h>
+#include <stdlib.h>
+#include "esp_log.h"
+#include "esp_system.h"
+#include "esp_timer.h"
+#include "app_network.hpp"
+#include "event_capture.hpp"
+#include "heap_monitor.hpp"
 #include "mqtt_client.hpp"
+#if CONFIG_APP_ENABLE_WEBRTC
+#include "esp-rtc.hpp"
+#endif
+#if CONFIG_APP_FLEET_DEVICE
+#include "fleet_device.hpp"
+#endif
+
+static const char *TAG = "app_main";
+
+#if CONFIG_APP_EVENT_CAPTURE
+// 重启前写完缓冲区中的记录
+static void capture_shutdown_handler(void)
+{
+    event_capture_stop();
+}
+#endif
 
 extern "C"{
 void app_main(void)
 {
+    // 在任何cJSON分配之前安装记账钩子
+    heap_monitor_install_json_hooks();
+
+#if CONFIG_APP_EVENT_REPLAY
+    // 回放模式：不联网，把录制的事件按录制时间重新送入MQTT接收路径，结束后退出
+    mqtt_client_attach_replay();
+    esp_err_t replay_ret = event_replay_run(CONFIG_APP_EVENT_REPLAY_SPEED, NULL);
+    heap_monitor_report();
+    exit(replay_ret == ESP_OK ? 0 : 1);
+#endif
+
+#if CONFIG_APP_EVENT_CAPTURE
+    // 在联网前开始录制，连接过程中的事件也在日志里
+    if (event_capture_start() == ESP_OK) {
+        esp_register_shutdown_handler(capture_shutdown_handler);
+    }
+#endif
+
+    // 网络只初始化一次，MQTT与WebRTC两个子系统共用
+    ESP_ERROR_CHECK(app_network_init());
+
+#if CONFIG_APP_ENABLE_WEBRTC
+    // 联网之前完成WebRTC本地准备，Peer（DTLS密钥和证书生成）在后台与联网并行打开
+    esp_err_t ret = webrtc_app_prepare();
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "❌ WebRTC子系统准备失败: %s", esp_err_to_name(ret));
+    }
+#endif
+
+    ESP_ERROR_CHECK(app_network_start());
+
+#if CONFIG_APP_ENABLE_WEBRTC
+    // WebRTC信令复用MQTT连接，失败时不影响MQTT子系统
+    ret = webrtc_app_start();
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "❌ WebRTC子系统启动失败: %s", esp_err_to_name(ret));
+    }
+#endif
+
+    ESP_LOGI(TAG, "[Performance][boot_to_services_ms]: %lld", esp_timer_get_time() / 1000);
+#if CONFIG_APP_FLEET_DEVICE
+    // 虚拟设备：命令来自tools/fleet_sim.py，不返回
+    fleet_device_run();
+#else
     mqtt_DoNow();
+#endif
 }
 }
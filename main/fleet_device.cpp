@@ -0,0 +1,77 @@
+#include "fleet_device.hpp"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "esp_log.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "input_events.hpp"
+#include "mqtt_client.hpp"
+#include "webrtc_client.hpp"
+#include "webrtc_signaling.hpp"
+
+static const char *TAG = "fleet_device";
+
+#define FLEET_PRESS_MAX_MS 10000
+
+static void on_webrtc_state(webrtc_client_state_t state, void *user_data)
+{
+    webrtc_signaling_on_state(state);
+}
+
+/**
+ * @brief 读取一行命令：与读取代理URL相同，标准输入没有数据时让出CPU
+ *
+ * @return 标准输入已关闭时返回false
+ */
+static bool read_line(char *line, size_t size)
+{
+    size_t count = 0;
+    for (;;) {
+        int c = fgetc(stdin);
+        if (c == EOF) {
+            if (feof(stdin)) {
+                return false;
+            }
+            clearerr(stdin);
+            vTaskDelay(pdMS_TO_TICKS(10));
+            continue;
+        }
+        if (c == '\n') {
+            line[count] = '\0';
+            return true;
+        }
+        if (count < size - 1) {
+            line[count++] = (char)c;
+        }
+    }
+}
+
+void fleet_device_run(void)
+{
+    // 与esp-rtc相同：信令先接管SDP回调和结果主题，MQTT连接后订阅
+    webrtc_signaling_config_t signaling_config = WEBRTC_SIGNALING_DEFAULT_CONFIG();
+    ESP_ERROR_CHECK(webrtc_signaling_init(&signaling_config));
+    webrtc_client_set_callbacks(on_webrtc_state, NULL, NULL, NULL, NULL);
+
+    // 从标准输入读取代理URL、连接并启动按键任务（linux目标上为模拟信号源）
+    mqtt_DoNow();
+    ESP_LOGI(TAG, "虚拟设备%s就绪", mqtt_client_get_device_id());
+
+    char line[64];
+    while (read_line(line, sizeof(line))) {
+        int press_ms = 0;
+        if (sscanf(line, "press %d", &press_ms) == 1 && press_ms > 0 && press_ms <= FLEET_PRESS_MAX_MS) {
+            input_source_sim_set_level(0);
+            vTaskDelay(pdMS_TO_TICKS(press_ms));
+            input_source_sim_set_level(1);
+        } else if (strcmp(line, "webrtc") == 0) {
+            webrtc_client_start();
+        } else if (line[0]) {
+            ESP_LOGW(TAG, "未知命令: %s", line);
+        }
+    }
+    ESP_LOGI(TAG, "标准输入已关闭，退出");
+    exit(0);
+}
@@ -0,0 +1,19 @@
+#pragma once
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief 作为tools/fleet_sim.py的一台虚拟设备运行（CONFIG_APP_FLEET_DEVICE，linux目标），不返回
+ *
+ * 启动真实的MQTT客户端、房间和WebRTC信令（Peer由webrtc_client_host代替），读取代理URL后
+ * 从标准输入逐行读取命令，标准输入关闭时退出：
+ *   press <ms>  按下BOOT键ms毫秒后释放，经消抖和按键任务按短按/长按处理
+ *   webrtc      开始新的WebRTC会话，发布Offer和之前攒下的候选
+ */
+void fleet_device_run(void);
+
+#ifdef __cplusplus
+}
+#endif
@@ -1,12 +1,14 @@
 # SPDX-FileCopyrightText: 2022 Espressif Systems (Shanghai) CO LTD
 # SPDX-License-Identifier: Unlicense OR CC0-1.0
+import json
 import logging
 import os
 import socket
 import struct
 import sys
 import time
-from threading import Thread
+from collections import namedtuple
+from threading import Event, Lock, Thread
 
 import pexpect
 import pytest
@@ -15,6 +17,250 @@ from pytest_embedded import Dut
 
 msgid = -1
 
+RESULT_TOPIC_PREFIX = '/public/striped-kind-tiger/result/'
+INVOKE_TOPIC = '/public/striped-kind-tiger/invoke/'
+
+
+def encode_remaining_length(length):  # type: (int) -> bytes
+    out = bytearray()
+    while True:
+        byte = length % 128
+        length //= 128
+        if length > 0:
+            byte |= 0x80
+        out.append(byte)
+        if length == 0:
+            return bytes(out)
+
+
+class MqttBrokerSketch(object):
+    """Minimal MQTT 3.1.1 broker stand-in for a single device connection.
+
+    Answers CONNECT/SUBSCRIBE/UNSUBSCRIBE/PINGREQ, acknowledges QoS1 publishes and hands
+    every PUBLISH from the device to `on_publish(topic, payload)`.
+    """
+
+    def __init__(self, my_ip, port, on_publish=None):  # type: (str, int, object) -> None
+        self.my_ip = my_ip
+        self.port = port
+        self.on_publish = on_publish
+        self.subscriptions = []
+        self.subscribed = Event()
+        self.conn = None
+        self.sock = None
+        self.write_lock = Lock()
+
+    def accept(self, timeout=60):  # type: (int) -> None
+        if self.sock is None:
+            self.sock = socket.socket(socket.AF_INET, socket.SOCK_STREAM)
+            self.sock.setsockopt(socket.SOL_SOCKET, socket.SO_REUSEADDR, 1)
+            self.sock.bind((self.my_ip, self.port))
+            self.sock.listen(1)
+        self.sock.settimeout(timeout)
+        self.conn, _ = self.sock.accept()
+        self.conn.settimeout(30)
+
+    def drop(self):  # type: () -> None
+        """Close the device connection without DISCONNECT, keeping the listener."""
+        self.conn.close()
+        self.conn = None
+        self.subscriptions = []
+        self.subscribed.clear()
+
+    def _send(self, data, chunk=0):  # type: (bytes, int) -> None
+        """Write a whole packet; with `chunk` > 0 split it into separate TCP segments."""
+        with self.write_lock:
+            if not chunk:
+                self.conn.sendall(data)
+                return
+            self.conn.setsockopt(socket.IPPROTO_TCP, socket.TCP_NODELAY, 1)
+            for pos in range(0, len(data), chunk):
+                self.conn.sendall(data[pos:pos + chunk])
+
+    def _recv_exact(self, size):  # type: (int) -> bytes
+        data = b''
+        while len(data) < size:
+            chunk = self.conn.recv(size - len(data))
+            if not chunk:
+                raise ConnectionError('device closed the connection')
+            data += chunk
+        return data
+
+    def read_packet(self):  # type: () -> tuple
+        header = self._recv_exact(1)[0]
+        length, shift = 0, 0
+        while True:
+            byte = self._recv_exact(1)[0]
+            length |= (byte & 0x7F) << shift
+            shift += 7
+            if not byte & 0x80:
+                break
+        return header, self._recv_exact(length) if length else b''
+
+    def publish(self, topic, payload, chunk=0):  # type: (str, bytes, int) -> None
+        topic_bytes = topic.encode()
+        body = struct.pack('>H', len(topic_bytes)) + topic_bytes + payload
+        self._send(bytes([0x30]) + encode_remaining_length(len(body)) + body, chunk)
+
+    def serve_once(self):  # type: () -> None
+        header, body = self.read_packet()
+        packet_type = header >> 4
+        if packet_type == 1:      # CONNECT
+            self._send(bytes([0x20, 0x02, 0x00, 0x00]))
+        elif packet_type == 8:    # SUBSCRIBE
+            pos = 2
+            granted = bytearray()
+            while pos < len(body):
+                topic_len = struct.unpack('>H', body[pos:pos + 2])[0]
+                self.subscriptions.append(body[pos + 2:pos + 2 + topic_len].decode())
+                granted.append(min(body[pos + 2 + topic_len], 1))
+                pos += 3 + topic_len
+            self._send(bytes([0x90, 2 + len(granted)]) + body[0:2] + bytes(granted))
+            self.subscribed.set()
+        elif packet_type == 10:   # UNSUBSCRIBE
+            pos = 2
+            while pos < len(body):
+                topic_len = struct.unpack('>H', body[pos:pos + 2])[0]
+                topic = body[pos + 2:pos + 2 + topic_len].decode()
+                if topic in self.subscriptions:
+                    self.subscriptions.remove(topic)
+                pos += 2 + topic_len
+            self._send(bytes([0xB0, 0x02]) + body[0:2])
+        elif packet_type == 3:    # PUBLISH
+            qos = (header >> 1) & 0x03
+            topic_len = struct.unpack('>H', body[0:2])[0]
+            topic = body[2:2 + topic_len].decode()
+            pos = 2 + topic_len
+            if qos > 0:
+                self._send(bytes([0x40, 0x02]) + body[pos:pos + 2])
+                pos += 2
+            if self.on_publish:
+                self.on_publish(topic, body[pos:])
+        elif packet_type == 12:   # PINGREQ
+            self._send(bytes([0xD0, 0x00]))
+
+    def close(self):  # type: () -> None
+        if self.conn:
+            self.conn.close()
+        if self.sock:
+            self.sock.close()
+
+
+# rate: messages/s (0 = as fast as the socket accepts), size: payload bytes,
+# count: messages, ack_every: request a device ack every n-th message,
+# tcp_chunk: split each packet into TCP writes of this many bytes (0 = off),
+# disconnect_every: drop the connection after every n messages (0 = off)
+LoadScenario = namedtuple('LoadScenario', 'name rate size count ack_every tcp_chunk disconnect_every')
+
+LOAD_SCENARIOS = [
+    LoadScenario('small_paced', 200, 64, 2000, 20, 0, 0),
+    LoadScenario('small_flood', 0, 64, 5000, 50, 0, 0),
+    # larger than the device MQTT buffer: delivered to the app as several DATA fragments
+    LoadScenario('mqtt_fragmented', 50, 4096, 500, 10, 0, 0),
+    LoadScenario('tcp_split', 100, 512, 1000, 20, 7, 0),
+    LoadScenario('disconnects', 200, 256, 2000, 20, 0, 500),
+]
+
+
+def load_scenarios_from_env():  # type: () -> list
+    """Select scenarios with MQTT_LOAD_SCENARIOS=a,b and override fields with
+    MQTT_LOAD_RATE / MQTT_LOAD_SIZE / MQTT_LOAD_COUNT."""
+    names = os.environ.get('MQTT_LOAD_SCENARIOS')
+    scenarios = [s for s in LOAD_SCENARIOS if not names or s.name in names.split(',')]
+    overrides = {}
+    for field in ('rate', 'size', 'count'):
+        value = os.environ.get('MQTT_LOAD_' + field.upper())
+        if value is not None:
+            overrides[field] = int(value)
+    return [s._replace(**overrides) for s in scenarios]
+
+
+class MqttLoadGenerator(object):
+    """Floods the device result topic through a MqttBrokerSketch.
+
+    Load messages look like {"type":"load","seq":N,"ack":0|1,"pad":"..."}; the
+    device load probe (CONFIG_MQTT_CLIENT_LOAD_PROBE) counts them after full
+    processing and answers "ack":1 messages with a loadAck carrying its
+    received count, which gives latency, throughput and drops.
+    """
+
+    def __init__(self, broker, topic):  # type: (MqttBrokerSketch, str) -> None
+        self.broker = broker
+        self.topic = topic
+        self.seq = 0
+        self.sent_at = {}
+        self.acks = {}
+        self.ack_lock = Lock()
+        self.ack_event = Event()
+
+    def on_publish(self, topic, payload):  # type: (str, bytes) -> None
+        if not payload.startswith(b'{"type":"loadAck"'):
+            return
+        message = json.loads(payload.decode())
+        with self.ack_lock:
+            self.acks[message['seq']] = (time.monotonic(), message['received'])
+        self.ack_event.set()
+
+    def _payload(self, seq, ack, size):  # type: (int, bool, int) -> bytes
+        head = '{{"type":"load","seq":{},"ack":{},"pad":"'.format(seq, 1 if ack else 0)
+        return (head + 'x' * max(0, size - len(head) - 2) + '"}').encode()
+
+    def _send(self, ack, size, chunk=0):  # type: (bool, int, int) -> int
+        self.seq += 1
+        if ack:
+            self.sent_at[self.seq] = time.monotonic()
+        self.broker.publish(self.topic, self._payload(self.seq, ack, size), chunk)
+        return self.seq
+
+    def _wait_ack(self, seq, timeout=30):  # type: (int, int) -> tuple
+        deadline = time.monotonic() + timeout
+        while True:
+            with self.ack_lock:
+                if seq in self.acks:
+                    return self.acks[seq]
+                self.ack_event.clear()
+            remaining = deadline - time.monotonic()
+            if remaining <= 0 or not self.ack_event.wait(remaining):
+                raise TimeoutError('no loadAck for seq {}'.format(seq))
+
+    def _reconnect(self):  # type: () -> None
+        # the serving thread sees EOF, drops the connection and accepts the device again
+        self.broker.subscribed.clear()
+        self.broker.conn.shutdown(socket.SHUT_RDWR)
+        assert self.broker.subscribed.wait(60), 'device did not resubscribe'
+
+    def run(self, scenario):  # type: (LoadScenario) -> dict
+        _, base_received = self._wait_ack(self._send(True, 64))
+        interval = 1.0 / scenario.rate if scenario.rate else 0
+        first_seq = self.seq + 1
+        start = time.monotonic()
+        for i in range(scenario.count):
+            if scenario.disconnect_every and i and i % scenario.disconnect_every == 0:
+                self._reconnect()
+            self._send(i % scenario.ack_every == 0, scenario.size, scenario.tcp_chunk)
+            if interval:
+                delay = start + (i + 1) * interval - time.monotonic()
+                if delay > 0:
+                    time.sleep(delay)
+        send_s = time.monotonic() - start
+        done_at, final_received = self._wait_ack(self._send(True, 64))
+
+        received = final_received - base_received - 1
+        with self.ack_lock:
+            latencies = sorted((self.acks[seq][0] - self.sent_at[seq]) * 1000
+                               for seq in self.sent_at if first_seq <= seq < self.seq and seq in self.acks)
+        elapsed = done_at - start
+        return {
+            'sent': scenario.count,
+            'received': received,
+            'drop_pct': 100.0 * (scenario.count - received) / scenario.count,
+            'send_rate': scenario.count / send_s,
+            'msgs_per_s': received / elapsed,
+            'latency_p50_ms': latencies[len(latencies) // 2] if latencies else -1,
+            'latency_p99_ms': latencies[int(len(latencies) * 0.99)] if latencies else -1,
+            'latency_max_ms': latencies[-1] if latencies else -1,
+        }
+
 
 def mqqt_server_sketch(my_ip, port):  # type: (str, str) -> None
     global msgid
@@ -90,3 +336,278 @@ def test_examples_protocol_mqtt_qos1(dut: Dut) -> None:
     else:
         print('Failure!')
         raise ValueError('Mismatch of msgid: received: {}, enqueued {}, deleted {}'.format(msgid, msgid_enqueued, msgid_deleted))
+
+
+@pytest.mark.esp32
+@pytest.mark.ethernet
+def test_examples_webrtc_signaling_over_mqtt(dut: Dut) -> None:
+    """
+    steps: (WebRTC signaling bridge)
+      1. start the broker stand-in and let the DUT connect and subscribe /result/<deviceId>
+      2. wait for the SDP offer, reply with an answer and a batch of remote candidates
+      3. check that no candidate message went out before the offer
+      4. evaluate offer-to-answer latency and how many candidate messages the DUT published;
+         offer-to-connected is reported when a real peer answers (the stub answer cannot connect)
+    """
+    ip_address = dut.expect(r'IPv4 address: (\d+\.\d+\.\d+\.\d+)', timeout=30).group(1).decode()
+    host_ip = get_host_ip4_by_dest_ip(ip_address)
+    offer = {}
+    candidate_messages = []
+    candidates_before_offer = []
+    offer_received = Event()
+
+    def on_publish(topic, payload):  # type: (str, bytes) -> None
+        message = json.loads(payload.decode())
+        if message.get('type') == 'offer':
+            offer.update(message, received_at=time.time())
+            offer_received.set()
+        elif message.get('type') == 'candidates':
+            candidate_messages.append(len(message['candidates']))
+            if not offer_received.is_set():
+                candidates_before_offer.append(message)
+
+    broker = MqttBrokerSketch(host_ip, 1883, on_publish)
+    stop = Event()
+
+    def serve():  # type: () -> None
+        broker.accept()
+        while not stop.is_set():
+            try:
+                broker.serve_once()
+            except socket.timeout:
+                continue
+            except ConnectionError:
+                break
+
+    thread = Thread(target=serve)
+    thread.start()
+    dut.write('mqtt://' + host_ip)
+    try:
+        assert offer_received.wait(60), 'no SDP offer published'
+        topic = RESULT_TOPIC_PREFIX + offer['deviceId']
+        broker.publish(topic, json.dumps({'type': 'answer', 'sdp': 'v=0\r\ns=-\r\nt=0 0\r\n'}).encode())
+        broker.publish(topic, json.dumps({'type': 'candidates', 'candidates': [
+            'candidate:1 1 UDP 2122252543 192.168.1.100 50000 typ host',
+            'candidate:2 1 UDP 1686052607 203.0.113.7 50000 typ srflx']}).encode())
+        latency = dut.expect(r'\[Performance\]\[signaling_offer_to_answer_ms\]: (\d+)', timeout=30).group(1).decode()
+        logging.info('[Performance][signaling_offer_to_answer_ms]: %s', latency)
+        try:
+            connected = dut.expect(r'\[Performance\]\[signaling_offer_to_connected_ms\]: (\d+)', timeout=5).group(1).decode()
+            logging.info('[Performance][signaling_offer_to_connected_ms]: %s', connected)
+        except pexpect.TIMEOUT:
+            logging.info('signaling_offer_to_connected_ms: not reached, no real peer behind the stub answer')
+        logging.info('[Performance][signaling_candidate_messages]: %d (candidates %d)',
+                     len(candidate_messages), sum(candidate_messages))
+        assert not candidates_before_offer, 'candidates published before the offer'
+    finally:
+        stop.set()
+        thread.join()
+        broker.close()
+
+
+@pytest.mark.esp32
+@pytest.mark.generic
+@pytest.mark.parametrize('config', ['data_selftest'], indirect=True)
+def test_examples_webrtc_data_channel_malformed_fragments(dut: Dut) -> None:
+    """
+    steps: (framed data channel reassembly)
+      1. boot the DUT built with CONFIG_WEBRTC_DATA_CHANNEL_SELF_TEST
+      2. the self-test feeds fragments with a changed total, out-of-range and wrapping
+         offsets, duplicates and holes into the reassembler during webrtc_client_init
+      3. evaluate that no case delivered a message or accepted a fragment it should not have
+    """
+    match = dut.expect(r'分片自检: (\d+)/(\d+) 通过', timeout=60)
+    passed, cases = int(match.group(1)), int(match.group(2))
+    assert cases > 0 and passed == cases, '{} of {} reassembly cases failed'.format(cases - passed, cases)
+
+
+def request_status(dut):  # type: (Dut) -> dict
+    """Connect the DUT to a broker stand-in, send {"command":"status"} on its result
+    topic and return the status reply it publishes on the invoke topic."""
+    ip_address = dut.expect(r'IPv4 address: (\d+\.\d+\.\d+\.\d+)', timeout=30).group(1).decode()
+    host_ip = get_host_ip4_by_dest_ip(ip_address)
+    replies = []
+    reply_received = Event()
+
+    def on_publish(topic, payload):  # type: (str, bytes) -> None
+        if topic != INVOKE_TOPIC:
+            return
+        try:
+            message = json.loads(payload.decode())
+        except ValueError:
+            return
+        # offers and pong replies share the invoke topic, only the status reply carries outbox
+        if 'outbox' in message:
+            replies.append(message)
+            reply_received.set()
+
+    broker = MqttBrokerSketch(host_ip, 1883, on_publish)
+    stop = Event()
+
+    def serve():  # type: () -> None
+        broker.accept()
+        while not stop.is_set():
+            try:
+                broker.serve_once()
+            except socket.timeout:
+                continue
+            except ConnectionError:
+                break
+
+    thread = Thread(target=serve)
+    thread.start()
+    dut.write('mqtt://' + host_ip)
+    try:
+        assert broker.subscribed.wait(60), 'result topic not subscribed'
+        topic = next(t for t in broker.subscriptions if t.startswith(RESULT_TOPIC_PREFIX))
+        broker.publish(topic, json.dumps({'command': 'status'}).encode())
+        assert reply_received.wait(30), 'no status reply published'
+        return replies[0]
+    finally:
+        stop.set()
+        thread.join()
+        broker.close()
+
+
+@pytest.mark.esp32
+@pytest.mark.ethernet
+def test_examples_mqtt_status_command(dut: Dut) -> None:
+    """
+    steps: (server command dispatch)
+      1. start the broker stand-in and wait for the DUT to subscribe /result/<deviceId>
+      2. publish {"command":"status"} on the result topic
+      3. evaluate that the reply on the invoke topic carries the outbox, reconnect and heap stats
+    """
+    status = request_status(dut)
+    assert status['deviceId'] and status['type'] == 'sfu'
+    for key in ('depth', 'bytes', 'bytesHighWater', 'droppedFull', 'droppedExpired'):
+        assert key in status['outbox'], 'outbox.{} missing'.format(key)
+    for key in ('disconnects', 'attempts', 'lastBackoffMs', 'lastResubscribedMs', 'maxResubscribedMs'):
+        assert key in status['reconnect'], 'reconnect.{} missing'.format(key)
+    for key in ('free', 'largestFree', 'minFree', 'fragPct', 'maxFragPct', 'components'):
+        assert key in status['heap'], 'heap.{} missing'.format(key)
+    # the default room is joined on connect and confirmed before the status request
+    rooms = status['rooms']
+    for key in ('joined', 'wildcard', 'brokerSubscriptions', 'lastJoinMs', 'maxJoinMs', 'duplicates', 'filtered'):
+        assert key in rooms, 'rooms.{} missing'.format(key)
+    assert status['deviceId'] in rooms['names'], 'default room not listed'
+    assert rooms['joined'] == len(rooms['names'])
+    logging.info('[Performance][mqtt_status_room_join_ms]: %d', rooms['lastJoinMs'])
+    # default config enables CONFIG_APP_WIFI_POWER_SAVE
+    for key in ('mode', 'switches', 'estAvgMa', 'estChargeUah', 'modes'):
+        assert key in status['power'], 'power.{} missing'.format(key)
+    for mode, entry in status['power']['modes'].items():
+        logging.info('[Performance][wifi_ps_status_time_ms][%s]: %d', mode, entry['timeMs'])
+    logging.info('[Performance][mqtt_status_outbox_depth]: %d', status['outbox']['depth'])
+    logging.info('[Performance][mqtt_status_outbox_bytes]: %d', status['outbox']['bytes'])
+
+
+@pytest.mark.esp32
+@pytest.mark.ethernet
+@pytest.mark.parametrize('config', ['latency_probe'], indirect=True)
+def test_examples_webrtc_latency_in_status(dut: Dut) -> None:
+    """
+    steps: (latency probe export)
+      1. boot the DUT built with CONFIG_WEBRTC_LATENCY_PROBE
+      2. send {"command":"status"} on the result topic
+      3. evaluate that the reply carries the latency object with RTT, clock offset and loss
+         (media delay only appears once audio has been received from the peer)
+    """
+    latency = request_status(dut).get('latency')
+    assert latency is not None, 'latency object missing from the status reply'
+    for key in ('samples', 'lost', 'stalePongs', 'rttUs', 'rttMinUs', 'rttAvgUs', 'clockOffsetUs', 'offsetErrorUs'):
+        assert key in latency, 'latency.{} missing'.format(key)
+    if 'mediaDelayUs' in latency:
+        assert 'mediaDelayAvgUs' in latency
+    logging.info('[Performance][latency_status_samples]: %d', latency['samples'])
+
+
+@pytest.mark.esp32
+@pytest.mark.ethernet
+def test_examples_mqtt_reconnect_resubscribe(dut: Dut) -> None:
+    """
+    steps: (reconnect manager)
+      1. start the broker stand-in and wait for the DUT to subscribe /result/<deviceId>
+      2. drop the connection without DISCONNECT and accept the reconnect
+      3. evaluate that the same topics are re-subscribed and report disconnect-to-resubscribed latency
+    """
+    ip_address = dut.expect(r'IPv4 address: (\d+\.\d+\.\d+\.\d+)', timeout=30).group(1).decode()
+    host_ip = get_host_ip4_by_dest_ip(ip_address)
+    broker = MqttBrokerSketch(host_ip, 1883)
+
+    def serve_until_subscribed():  # type: () -> None
+        broker.accept()
+        while not broker.subscribed.is_set():
+            broker.serve_once()
+
+    dut.write('mqtt://' + host_ip)
+    try:
+        serve_until_subscribed()
+        topics = list(broker.subscriptions)
+        assert any(t.startswith(RESULT_TOPIC_PREFIX) for t in topics), 'result topic not subscribed'
+
+        for _ in range(3):
+            dropped_at = time.time()
+            broker.drop()
+            serve_until_subscribed()
+            logging.info('[Performance][mqtt_host_reconnect_to_resubscribed_ms]: %d',
+                         (time.time() - dropped_at) * 1000)
+            assert sorted(broker.subscriptions) == sorted(topics), 'subscriptions differ after reconnect'
+            latency = dut.expect(r'\[Performance\]\[mqtt_disconnect_to_resubscribed_ms\]: (\d+)',
+                                 timeout=60).group(1).decode()
+            logging.info('[Performance][mqtt_disconnect_to_resubscribed_ms]: %s', latency)
+    finally:
+        broker.close()
+
+
+@pytest.mark.linux
+@pytest.mark.host_test
+@pytest.mark.parametrize('config', ['linux_load'], indirect=True)
+def test_examples_mqtt_ingest_load(dut: Dut) -> None:
+    """
+    steps: (MQTT ingest throughput on the linux target, loopback only)
+      1. start the broker stand-in on 127.0.0.1 and let the DUT subscribe /result/<deviceId>
+      2. run each load scenario: paced and unpaced floods, MQTT-level and TCP-level
+         fragmentation, periodic disconnects
+      3. report processed messages per second, ack latency percentiles and drop rate;
+         scenarios without disconnects must not lose messages
+    """
+    port = int(os.environ.get('MQTT_LOAD_PORT', '1883'))
+    broker = MqttBrokerSketch('127.0.0.1', port)
+    stop = Event()
+
+    def serve():  # type: () -> None
+        broker.accept()
+        while not stop.is_set():
+            try:
+                broker.serve_once()
+            except socket.timeout:
+                continue
+            except OSError:
+                if stop.is_set():
+                    break
+                try:
+                    broker.drop()
+                    broker.accept()
+                except OSError:
+                    break
+
+    thread = Thread(target=serve)
+    thread.start()
+    dut.write('mqtt://127.0.0.1:{}'.format(port))
+    try:
+        assert broker.subscribed.wait(60), 'result topic not subscribed'
+        topic = next(t for t in broker.subscriptions if t.startswith(RESULT_TOPIC_PREFIX))
+        generator = MqttLoadGenerator(broker, topic)
+        broker.on_publish = generator.on_publish
+        for scenario in load_scenarios_from_env():
+            result = generator.run(scenario)
+            for key, value in result.items():
+                logging.info('[Performance][mqtt_load_%s_%s]: %s', scenario.name, key,
+                             '{:.1f}'.format(value) if isinstance(value, float) else value)
+            if not scenario.disconnect_every:
+                assert result['received'] == scenario.count, '{} lost messages'.format(scenario.name)
+    finally:
+        stop.set()
+        broker.close()
+        thread.join()
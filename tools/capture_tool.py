@@ -0,0 +1,184 @@
+# SPDX-License-Identifier: Unlicense OR CC0-1.0
+"""Inspect and receive event captures (CONFIG_APP_EVENT_CAPTURE).
+
+Host-side reader for the log written by components/app_runtime/event_capture.cpp.
+The header and record layout must stay identical to event_capture.hpp.
+
+usage:
+    python tools/capture_tool.py dump capture.bin             # per-source summary
+    python tools/capture_tool.py dump capture.bin --records   # one line per record
+    python tools/capture_tool.py gaps capture.bin             # media gaps around reconnects
+    python tools/capture_tool.py recv --port /dev/ttyUSB1 --out capture.bin --seconds 60
+    esptool.py read_flash <offset> <size> capture.bin         # flash partition sink
+"""
+import argparse
+import struct
+import sys
+import time
+
+MAGIC = 0x50435245
+VERSION = 1
+FLAG_MEDIA_PAYLOAD = 0x01
+
+FILE_HEADER = struct.Struct('<IHHQ')
+RECORD_HEADER = struct.Struct('<IIBBH')
+MQTT_DATA_HEADER = struct.Struct('<HII')
+
+SRC_MQTT = 1
+SRC_PEER_STATE = 2
+SRC_AUDIO = 4
+SRC_VIDEO = 5
+SRC_DATA = 6
+SRC_NAMES = {1: 'mqtt', 2: 'peer_state', 3: 'peer_msg', 4: 'audio', 5: 'video', 6: 'data', 7: 'channel'}
+MQTT_EVENT_DATA = 6
+
+# esp_peer_state_t
+PEER_CONNECTED = 6
+PEER_LOST = {0: 'closed', 1: 'disconnected', 2: 'new_connection', 7: 'connect_failed'}
+
+
+def read_capture(path):  # type: (str) -> tuple
+    with open(path, 'rb') as f:
+        blob = f.read()
+    if len(blob) < FILE_HEADER.size:
+        raise ValueError('{}: too short'.format(path))
+    magic, version, flags, start_us = FILE_HEADER.unpack_from(blob, 0)
+    if magic != MAGIC or version != VERSION:
+        raise ValueError('{}: not a capture (magic {:#x}, version {})'.format(path, magic, version))
+
+    records = []
+    pos = FILE_HEADER.size
+    ts_us = 0
+    while pos + RECORD_HEADER.size <= len(blob):
+        delta_us, size, src, rtype, stream = RECORD_HEADER.unpack_from(blob, pos)
+        if delta_us == 0xFFFFFFFF and size == 0xFFFFFFFF:
+            break  # erased flash after the last record
+        pos += RECORD_HEADER.size
+        media = src in (SRC_AUDIO, SRC_VIDEO)
+        stored = 0 if media and not flags & FLAG_MEDIA_PAYLOAD else size
+        if pos + stored > len(blob):
+            print('warning: capture ends inside a record', file=sys.stderr)
+            break
+        ts_us += delta_us
+        records.append((ts_us, src, rtype, stream, size, blob[pos:pos + stored] if stored else None))
+        pos += stored
+    return flags, start_us, records
+
+
+def describe(src, rtype, stream, payload):  # type: (int, int, int, bytes) -> str
+    if src == SRC_MQTT and rtype == MQTT_EVENT_DATA and payload and len(payload) >= MQTT_DATA_HEADER.size:
+        topic_len, offset, total = MQTT_DATA_HEADER.unpack_from(payload, 0)
+        topic = payload[MQTT_DATA_HEADER.size:MQTT_DATA_HEADER.size + topic_len].decode('utf-8', 'replace')
+        return 'topic={} offset={} total={}'.format(topic or '-', offset, total)
+    return 'type={} stream={}'.format(rtype, stream)
+
+
+def dump(args):  # type: (argparse.Namespace) -> int
+    flags, start_us, records = read_capture(args.capture)
+    duration_s = records[-1][0] / 1e6 if records else 0.0
+    print('capture: {} records, {:.3f} s, started at {} us, media payload {}'.format(
+        len(records), duration_s, start_us, 'yes' if flags & FLAG_MEDIA_PAYLOAD else 'no'))
+
+    totals = {}
+    for ts_us, src, rtype, stream, size, payload in records:
+        count, nbytes = totals.get(src, (0, 0))
+        totals[src] = (count + 1, nbytes + size)
+        if args.records:
+            print('{:>12.6f} {:<10} {:>7} B  {}'.format(ts_us / 1e6, SRC_NAMES.get(src, src), size,
+                                                       describe(src, rtype, stream, payload)))
+
+    print('{:<12}{:>10}{:>14}{:>12}'.format('source', 'records', 'bytes', 'rate/s'))
+    for src in sorted(totals):
+        count, nbytes = totals[src]
+        rate = count / duration_s if duration_s > 0 else 0.0
+        print('{:<12}{:>10}{:>14}{:>12.1f}'.format(SRC_NAMES.get(src, src), count, nbytes, rate))
+    return 0
+
+
+def gaps(args):  # type: (argparse.Namespace) -> int
+    """Media gap per outage: last media record before the peer left CONNECTED to the first one after it returned."""
+    _, _, records = read_capture(args.capture)
+    media = {SRC_AUDIO, SRC_VIDEO} if args.no_data else {SRC_AUDIO, SRC_VIDEO, SRC_DATA}
+    connected = False
+    last_media_us = None
+    outage = None       # [cause, lost_us, gap_start_us, reconnected_us]
+    results = []
+    for ts_us, src, rtype, _, _, _ in records:
+        if src == SRC_PEER_STATE:
+            if rtype == PEER_CONNECTED:
+                connected = True
+                if outage and outage[3] is None:
+                    outage[3] = ts_us
+            elif rtype in PEER_LOST and connected:
+                connected = False
+                gap_start = last_media_us if last_media_us is not None else ts_us
+                outage = [PEER_LOST[rtype], ts_us, gap_start, None]
+        elif src in media:
+            if outage and connected:
+                results.append((outage[0], outage[1], outage[3] - outage[1], ts_us - outage[2]))
+                outage = None
+            last_media_us = ts_us
+    if outage:
+        print('capture ends inside an outage ({} at {:.3f} s)'.format(outage[0], outage[1] / 1e6))
+
+    if not results:
+        print('no completed outages')
+        return 0
+    print('{:>10}  {:<16}{:>14}{:>14}'.format('at (s)', 'cause', 'reconnect ms', 'media gap ms'))
+    for cause, lost_us, reconnect_us, gap_us in results:
+        print('{:>10.3f}  {:<16}{:>14.1f}{:>14.1f}'.format(lost_us / 1e6, cause, reconnect_us / 1e3, gap_us / 1e3))
+    gap_ms = sorted(gap_us / 1e3 for _, _, _, gap_us in results)
+    print('[Performance][media_gap_ms]: max {:.1f} median {:.1f} ({} outages)'.format(
+        gap_ms[-1], gap_ms[len(gap_ms) // 2], len(gap_ms)))
+    return 0
+
+
+def recv(args):  # type: (argparse.Namespace) -> int
+    try:
+        import serial  # pyserial, only needed for this command
+    except ImportError:
+        print('recv needs pyserial: pip install pyserial', file=sys.stderr)
+        return 1
+    received = 0
+    deadline = time.monotonic() + args.seconds if args.seconds > 0 else None
+    with serial.Serial(args.port, args.baud, timeout=0.5) as port, open(args.out, 'wb') as out:
+        print('receiving from {} at {} baud, Ctrl+C to stop'.format(args.port, args.baud), file=sys.stderr)
+        try:
+            while deadline is None or time.monotonic() < deadline:
+                chunk = port.read(4096)
+                if chunk:
+                    out.write(chunk)
+                    received += len(chunk)
+        except KeyboardInterrupt:
+            pass
+    print('{} bytes written to {}'.format(received, args.out), file=sys.stderr)
+    return 0
+
+
+def main():  # type: () -> int
+    parser = argparse.ArgumentParser(description='event capture tool')
+    sub = parser.add_subparsers(dest='command', required=True)
+
+    p = sub.add_parser('dump', help='summarise a capture file')
+    p.add_argument('capture')
+    p.add_argument('--records', action='store_true', help='print every record')
+    p.set_defaults(func=dump)
+
+    p = sub.add_parser('gaps', help='media gaps around peer reconnects and ICE restarts')
+    p.add_argument('capture')
+    p.add_argument('--no-data', action='store_true', help='count only audio/video frames as media')
+    p.set_defaults(func=gaps)
+
+    p = sub.add_parser('recv', help='receive a capture streamed over UART')
+    p.add_argument('--port', required=True)
+    p.add_argument('--baud', type=int, default=921600)
+    p.add_argument('--out', default='capture.bin')
+    p.add_argument('--seconds', type=float, default=0, help='stop after this long (0 = until Ctrl+C)')
+    p.set_defaults(func=recv)
+
+    args = parser.parse_args()
+    return args.func(args)
+
+
+if __name__ == '__main__':
+    sys.exit(main())
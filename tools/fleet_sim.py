@@ -0,0 +1,863 @@
+# SPDX-License-Identifier: Unlicense OR CC0-1.0
+"""Device fleet simulator: N virtual devices against a local MQTT broker stand-in.
+
+With --firmware the first --firmware-devices devices are processes of the
+linux build made with sdkconfig.ci.linux_fleet (CONFIG_APP_FLEET_DEVICE):
+the real mqtt_client, mqtt_room, mqtt_reconnect and webrtc_signaling code,
+each with its own MQTT_DEVICE_ID, driven over stdin ("press <ms>",
+"webrtc"). esp_peer has no linux port, so webrtc_client_host.cpp stands in
+for the peer and reports the connection as soon as the answer arrives.
+
+The remaining devices are a model of the same wire behaviour, cheap enough
+to run by the thousand: a CONNECT with the leave message as last will on
+/device/end, the /result/<deviceId> room subscription, a button script
+(short press = leave + unsubscribe + subscribe back to back like mqtt_room,
+long press = publish on the invoke topic), one SDP offer per WebRTC start
+followed right away by the ICE candidates gathered before it (the firmware
+flushes that batch as soon as the offer is out), and reconnects with the same
+jittered exponential backoff as mqtt_reconnect. Presses are at least 3.2 s
+apart on both kinds of device because mqtt_client ignores a press within 3 s
+of the previous one.
+
+The broker stand-in routes publishes between sessions, fires last wills on
+unclean closes and plays the server: it answers offers on the device's
+result topic like the SFU and echoes {"deviceId","type":"sfu"} for a long
+press. Everything on the simulator side runs as coroutines on one asyncio
+loop (no thread per device). The run has three phases: a connect storm of
+all devices, a steady phase with the button script, and a reconnect storm
+after the broker drops every connection. Message rates are averaged over the
+whole phase, idle seconds included.
+
+Limitations:
+  - Modelled devices must be kept in sync with mqtt_room.cpp and
+    webrtc_signaling.cpp. Every run compares their messages with those
+    sources first (--check-shapes only does that and exits non-zero on
+    drift) and, with --firmware, with what the firmware processes actually
+    publish; a difference there fails the run.
+  - Modelled devices speak MQTT 3.1.1 with clean sessions only, like the
+    default firmware configuration: no MQTT v5 session resumption, topic
+    aliases or the compact sdpz1 codec. The broker delivers everything at
+    QoS 0 and never answers in sdpz1.
+  - The loopback link has no loss or latency. Results show how the broker
+    and SFU logic scale, not radio behaviour.
+  - Memory per modelled device is what the simulator allocates for a device
+    and its broker session. For firmware devices the run reports the process
+    RSS and the per-component heap accounting from the status reply.
+
+usage:
+    python tools/fleet_sim.py --devices 1000
+    python tools/fleet_sim.py --devices 2000 --storm-window 0 --duration 60 --presses 5
+    python tools/fleet_sim.py --devices 500 --firmware build/mqtt_tcp.elf --firmware-devices 8
+    python tools/fleet_sim.py --check-shapes
+"""
+import argparse
+import asyncio
+import collections
+import json
+import os
+import random
+import re
+import resource
+import struct
+import sys
+import time
+import tracemalloc
+
+RESULT_TOPIC_PREFIX = '/public/striped-kind-tiger/result/'
+INVOKE_TOPIC = '/public/striped-kind-tiger/invoke/'
+WILL_TOPIC = '/device/end'
+CODEC_NAME = 'sdpz1'                       # SIGNALING_CODEC_NAME, advertised in the JSON offer
+
+CONNECT, CONNACK, PUBLISH, PUBACK = 1, 2, 3, 4
+SUBSCRIBE, SUBACK, UNSUBSCRIBE, UNSUBACK = 8, 9, 10, 11
+PINGREQ, PINGRESP, DISCONNECT = 12, 13, 14
+
+# Roughly the size of an esp_peer offer with audio, video and a data channel.
+OFFER_SDP = ('v=0\r\no=- 0 0 IN IP4 0.0.0.0\r\ns=-\r\nt=0 0\r\na=group:BUNDLE 0 1 2\r\n'
+             + 'a=rtpmap:111 opus/48000/2\r\na=fmtp:111 minptime=10;useinbandfec=1\r\n' * 6
+             + 'a=rtcp-fb:96 nack\r\na=rtcp-fb:96 nack pli\r\n' * 8)
+CANDIDATES = ['candidate:1 1 UDP 2122252543 192.168.1.{} 50000 typ host',
+              'candidate:2 1 UDP 1686052607 203.0.113.{} 50000 typ srflx']
+PRESS_GUARD_S = 3.2                        # mqtt_client drops a press within 3 s of the previous one
+SHORT_PRESS_MS, LONG_PRESS_MS = 200, 1500  # around CONFIG_MQTT_CLIENT_BUTTON_LONG_PRESS_MS (1000)
+PERFORMANCE_LOG = re.compile(r'\[Performance\]\[(\w+)\]: (-?\d+)')
+
+REPO_ROOT = os.path.dirname(os.path.dirname(os.path.abspath(__file__)))
+
+
+def json_bytes(message):  # type: (dict) -> bytes
+    return json.dumps(message, separators=(',', ':')).encode()
+
+
+def device_message(device_id):  # type: (str) -> bytes
+    """create_mqtt_message() / publish_leave() for the default room: last will, leave and long press."""
+    return json_bytes({'deviceId': device_id, 'type': 'sfu'})
+
+
+def offer_message(device_id):  # type: (str) -> bytes
+    """on_local_offer() with the JSON codec and CONFIG_WEBRTC_SIGNALING_COMPACT_CODEC (default y)."""
+    return json_bytes({'type': 'offer', 'deviceId': device_id, 'sdp': OFFER_SDP, 'codecs': [CODEC_NAME]})
+
+
+def candidates_message(device_id, candidates):  # type: (str, list) -> bytes
+    """flush_batch_locked() with the JSON codec."""
+    return json_bytes({'type': 'candidates', 'deviceId': device_id, 'candidates': candidates})
+
+
+# (builder, source file, function, keys only the firmware sends in some cases)
+SHAPES = [
+    (device_message, 'components/mqtt_client/mqtt_client.cpp', 'create_mqtt_message', set()),
+    (device_message, 'components/mqtt_client/mqtt_room.cpp', 'publish_leave', {'room'}),
+    (offer_message, 'components/WebRTC/webrtc_signaling.cpp', 'on_local_offer', set()),
+    (lambda d: candidates_message(d, []), 'components/WebRTC/webrtc_signaling.cpp', 'flush_batch_locked', set()),
+]
+DEFINES = [
+    ('components/mqtt_client/mqtt_client.hpp', 'MQTT_SUBSCRIBE_TOPIC_PREFIX', RESULT_TOPIC_PREFIX),
+    ('components/mqtt_client/mqtt_client.hpp', 'MQTT_PUBLISH_TOPIC', INVOKE_TOPIC),
+    ('components/mqtt_client/mqtt_client.hpp', 'MQTT_LAST_WILL_TOPIC', WILL_TOPIC),
+    ('components/WebRTC/signaling_codec.hpp', 'SIGNALING_CODEC_NAME', CODEC_NAME),
+]
+
+
+def function_body(source, name):  # type: (str, str) -> str
+    match = re.search(r'^[^\n;]*\b' + name + r'\([^)]*\)\s*\{', source, re.M)
+    if not match:
+        return ''
+    depth, pos = 1, match.end()
+    while depth and pos < len(source):
+        depth += {'{': 1, '}': -1}.get(source[pos], 0)
+        pos += 1
+    return source[match.end():pos]
+
+
+def firmware_shapes():  # type: () -> dict
+    """Keys of each simulated message by "type", to compare with what firmware devices publish."""
+    shapes = {}
+    for builder in (device_message, offer_message, lambda d: candidates_message(d, [])):
+        message = json.loads(builder('SIM').decode())
+        shapes[message['type']] = set(message)
+    return shapes
+
+
+def check_shapes(root=REPO_ROOT):  # type: (str) -> list
+    """Compare the simulated message keys and topics with the firmware sources; returns the drifts found."""
+    drifts = []
+    for builder, path, function, optional in SHAPES:
+        with open(os.path.join(root, path), encoding='utf-8') as f:
+            body = function_body(f.read(), function)
+        source_keys = set(re.findall(r'cJSON_Add\w*ToObject\(json, "(\w+)"', body))
+        sim_keys = set(json.loads(builder('SIM').decode()))
+        if not source_keys:
+            drifts.append('{}: {}() not found or builds no JSON'.format(path, function))
+        elif sim_keys != source_keys - optional:
+            drifts.append('{}: {}() sends {}, simulator sends {}'.format(
+                path, function, sorted(source_keys), sorted(sim_keys)))
+    for path, name, value in DEFINES:
+        with open(os.path.join(root, path), encoding='utf-8') as f:
+            match = re.search(r'#define\s+' + name + r'\s+"([^"]*)"', f.read())
+        if not match or match.group(1) != value:
+            drifts.append('{}: {} is {}, simulator uses {!r}'.format(
+                path, name, repr(match.group(1)) if match else 'missing', value))
+    return drifts
+
+
+FIRMWARE_SHAPES = firmware_shapes()
+
+
+def encode_remaining_length(length):  # type: (int) -> bytes
+    out = bytearray()
+    while True:
+        byte = length % 128
+        length //= 128
+        if length > 0:
+            byte |= 0x80
+        out.append(byte)
+        if length == 0:
+            return bytes(out)
+
+
+def mqtt_string(value):  # type: (bytes) -> bytes
+    return struct.pack('>H', len(value)) + value
+
+
+def packet(header, body=b''):  # type: (int, bytes) -> bytes
+    return bytes([header]) + encode_remaining_length(len(body)) + body
+
+
+async def read_packet(reader):  # type: (asyncio.StreamReader) -> tuple
+    header = (await reader.readexactly(1))[0]
+    length, shift = 0, 0
+    while True:
+        byte = (await reader.readexactly(1))[0]
+        length |= (byte & 0x7F) << shift
+        shift += 7
+        if not byte & 0x80:
+            break
+    return header, await reader.readexactly(length) if length else b''
+
+
+def topic_matches(topic_filter, topic):  # type: (str, str) -> bool
+    filter_levels = topic_filter.split('/')
+    levels = topic.split('/')
+    for i, level in enumerate(filter_levels):
+        if level == '#':
+            return True
+        if i >= len(levels) or (level != '+' and level != levels[i]):
+            return False
+    return len(filter_levels) == len(levels)
+
+
+def press_times(duration, presses):  # type: (float, int) -> list
+    """Random press times in [0, duration], PRESS_GUARD_S apart; fewer presses if the phase is too short."""
+    count = min(presses, int(duration / PRESS_GUARD_S) + 1)
+    if count <= 0:
+        return []
+    slack = duration - (count - 1) * PRESS_GUARD_S
+    return [at + i * PRESS_GUARD_S for i, at in enumerate(sorted(random.uniform(0, slack) for _ in range(count)))]
+
+
+def percentile(values, pct):  # type: (list, float) -> float
+    if not values:
+        return -1
+    values = sorted(values)
+    return values[min(len(values) - 1, int(len(values) * pct / 100))]
+
+
+class FleetStats(object):
+    def __init__(self):  # type: () -> None
+        self.phase = 'storm'
+        self.per_second = {}               # (phase, second) -> [from devices, to devices, connects]
+        self.start = time.monotonic()
+        self.phase_span = {'storm': [0.0, None]}
+        self.connect_ms = {}               # phase -> [TCP connect + CONNACK]
+        self.join_ms = []                  # subscribe to SUBACK
+        self.offer_to_answer_ms = []
+        self.offers = 0
+        self.wills = 0
+        self.failed_connects = 0
+        self.firmware_drifts = set()
+        self.firmware_failures = 0
+
+    def set_phase(self, phase):  # type: (str) -> None
+        now = time.monotonic() - self.start
+        self.phase_span[self.phase][1] = now
+        self.phase = phase
+        self.phase_span[phase] = [now, None]
+
+    def count(self, index):  # type: (int) -> None
+        key = (self.phase, int(time.monotonic() - self.start))
+        self.per_second.setdefault(key, [0, 0, 0])[index] += 1
+
+    def rates(self, phase, *indexes):  # type: (str, int) -> tuple
+        """Average per second over the whole phase (idle seconds included) and peak second of the summed counters."""
+        start, end = self.phase_span[phase]
+        elapsed = (end if end is not None else time.monotonic() - self.start) - start
+        values = [sum(v[i] for i in indexes) for (p, _), v in self.per_second.items() if p == phase]
+        if not values:
+            return 0.0, 0
+        return sum(values) / max(elapsed, 1.0), max(values)
+
+
+class BrokerSession(object):
+    __slots__ = ('writer', 'client_id', 'will', 'subscriptions', 'clean_close')
+
+    def __init__(self, writer):  # type: (asyncio.StreamWriter) -> None
+        self.writer = writer
+        self.client_id = ''
+        self.will = None
+        self.subscriptions = set()
+        self.clean_close = False
+
+
+class FleetBroker(object):
+    """MQTT 3.1.1 subset for many sessions on one event loop, plus the SFU side of signaling.
+
+    Exact topic filters are indexed by topic; wildcard filters are matched on
+    every publish, which is what a room wildcard costs a real broker too.
+    """
+
+    def __init__(self, stats):  # type: (FleetStats) -> None
+        self.stats = stats
+        self.sessions = set()
+        self.exact = {}
+        self.wildcards = {}
+        self.server = None
+        self.firmware = {}                 # client id -> FirmwareDevice
+
+    async def start(self, host, port):  # type: (str, int) -> int
+        self.server = await asyncio.start_server(self._serve, host, port, backlog=4096)
+        return self.server.sockets[0].getsockname()[1]
+
+    def subscription_count(self):  # type: () -> int
+        return sum(len(s) for s in self.exact.values()) + sum(len(s) for s in self.wildcards.values())
+
+    def drop_all(self):  # type: () -> None
+        """Close every connection without DISCONNECT, as a broker restart would."""
+        for session in list(self.sessions):
+            session.writer.transport.abort()
+
+    async def close(self):  # type: () -> None
+        self.server.close()
+        self.drop_all()
+        await self.server.wait_closed()
+
+    def _subscribe(self, session, topic_filter):  # type: (BrokerSession, str) -> None
+        index = self.wildcards if '+' in topic_filter or '#' in topic_filter else self.exact
+        index.setdefault(topic_filter, set()).add(session)
+        session.subscriptions.add(topic_filter)
+
+    def _unsubscribe(self, session, topic_filter):  # type: (BrokerSession, str) -> None
+        for index in (self.exact, self.wildcards):
+            subscribers = index.get(topic_filter)
+            if subscribers is not None:
+                subscribers.discard(session)
+                if not subscribers:
+                    del index[topic_filter]
+        session.subscriptions.discard(topic_filter)
+
+    def route(self, topic, payload):  # type: (str, bytes) -> None
+        targets = set(self.exact.get(topic, ()))
+        for topic_filter, subscribers in self.wildcards.items():
+            if topic_matches(topic_filter, topic):
+                targets |= subscribers
+        if not targets:
+            return
+        data = packet(0x30, mqtt_string(topic.encode()) + payload)
+        for session in targets:
+            session.writer.write(data)
+            self.stats.count(1)
+
+    def _server(self, payload):  # type: (bytes) -> None
+        """The server side of the invoke topic: the SFU answers offers, a long press gets its echo back."""
+        if not payload.startswith(b'{'):
+            return
+        message = json.loads(payload.decode())
+        topic = RESULT_TOPIC_PREFIX + message.get('deviceId', '')
+        if message.get('type') == 'offer':
+            self.route(topic, json_bytes({'type': 'answer', 'sdp': 'v=0\r\ns=-\r\nt=0 0\r\n'}))
+            self.route(topic, json_bytes({'type': 'candidates', 'candidates': [
+                c.format(random.randint(2, 254)) for c in CANDIDATES]}))
+        elif message.get('type') == 'sfu' and len(message) == 2:
+            self.route(topic, device_message(message['deviceId']))
+
+    def _connect(self, session, body):  # type: (BrokerSession, bytes) -> None
+        pos = 2 + struct.unpack('>H', body[0:2])[0] + 1
+        flags = body[pos]
+        pos += 3
+        length = struct.unpack('>H', body[pos:pos + 2])[0]
+        session.client_id = body[pos + 2:pos + 2 + length].decode()
+        pos += 2 + length
+        if flags & 0x04:
+            length = struct.unpack('>H', body[pos:pos + 2])[0]
+            will_topic = body[pos + 2:pos + 2 + length].decode()
+            pos += 2 + length
+            length = struct.unpack('>H', body[pos:pos + 2])[0]
+            session.will = (will_topic, body[pos + 2:pos + 2 + length])
+        session.writer.write(bytes([0x20, 0x02, 0x00, 0x00]))
+        self.stats.count(2)
+
+    async def _serve(self, reader, writer):  # type: (asyncio.StreamReader, asyncio.StreamWriter) -> None
+        session = BrokerSession(writer)
+        self.sessions.add(session)
+        try:
+            while True:
+                header, body = await read_packet(reader)
+                packet_type = header >> 4
+                if packet_type == CONNECT:
+                    self._connect(session, body)
+                elif packet_type == PUBLISH:
+                    qos = (header >> 1) & 0x03
+                    topic_len = struct.unpack('>H', body[0:2])[0]
+                    topic = body[2:2 + topic_len].decode()
+                    pos = 2 + topic_len
+                    if qos > 0:
+                        writer.write(bytes([0x40, 0x02]) + body[pos:pos + 2])
+                        pos += 2
+                    self.stats.count(0)
+                    firmware = self.firmware.get(session.client_id)
+                    if firmware:
+                        firmware.on_publish(topic, body[pos:])
+                    self.route(topic, body[pos:])
+                    if topic == INVOKE_TOPIC:
+                        self._server(body[pos:])
+                elif packet_type == SUBSCRIBE:
+                    pos, granted, topics = 2, bytearray(), []
+                    while pos < len(body):
+                        topic_len = struct.unpack('>H', body[pos:pos + 2])[0]
+                        topics.append(body[pos + 2:pos + 2 + topic_len].decode())
+                        self._subscribe(session, topics[-1])
+                        granted.append(min(body[pos + 2 + topic_len], 1))
+                        pos += 3 + topic_len
+                    writer.write(packet(0x90, body[0:2] + bytes(granted)))
+                    firmware = self.firmware.get(session.client_id)
+                    if firmware and RESULT_TOPIC_PREFIX + session.client_id in topics:
+                        firmware.on_subscribed()
+                elif packet_type == UNSUBSCRIBE:
+                    pos = 2
+                    while pos < len(body):
+                        topic_len = struct.unpack('>H', body[pos:pos + 2])[0]
+                        self._unsubscribe(session, body[pos + 2:pos + 2 + topic_len].decode())
+                        pos += 2 + topic_len
+                    writer.write(bytes([0xB0, 0x02]) + body[0:2])
+                elif packet_type == PINGREQ:
+                    writer.write(bytes([0xD0, 0x00]))
+                elif packet_type == DISCONNECT:
+                    session.clean_close = True
+                    break
+                if writer.transport.get_write_buffer_size() > 65536:
+                    await writer.drain()
+        except (asyncio.IncompleteReadError, ConnectionError):
+            pass
+        finally:
+            self.sessions.discard(session)
+            for topic_filter in list(session.subscriptions):
+                self._unsubscribe(session, topic_filter)
+            if session.will and not session.clean_close:
+                self.stats.wills += 1
+                self.route(*session.will)
+            writer.close()
+
+
+class VirtualDevice(object):
+    """One simulated device: connection, room membership, button script and reconnect backoff."""
+
+    def __init__(self, index, args, stats, port):  # type: (int, argparse.Namespace, FleetStats, int) -> None
+        self.device_id = 'SIM_{:06X}'.format(index)
+        self.args = args
+        self.stats = stats
+        self.port = port
+        self.room_topic = RESULT_TOPIC_PREFIX + self.device_id
+        self.joined = False
+        self.writer = None
+        self.packet_id = 0
+        self.pending = {}                  # SUBSCRIBE packet id -> sent at
+        self.offer_at = 0.0
+        self.offered = False
+        self.attempt = 0
+        self.connected = asyncio.Event()
+        self.subscribed = asyncio.Event()
+        self.stopping = False
+
+    def _next_id(self):  # type: () -> int
+        self.packet_id = self.packet_id % 0xFFFF + 1
+        return self.packet_id
+
+    def _publish(self, topic, payload):  # type: (str, bytes) -> None
+        body = mqtt_string(topic.encode()) + struct.pack('>H', self._next_id()) + payload
+        self.writer.write(packet(0x32, body))
+
+    def _subscribe(self):  # type: () -> None
+        packet_id = self._next_id()
+        self.pending[packet_id] = time.monotonic()
+        self.writer.write(packet(0x82, struct.pack('>H', packet_id) + mqtt_string(self.room_topic.encode()) + b'\x01'))
+
+    def _unsubscribe(self):  # type: () -> None
+        self.writer.write(packet(0xA2, struct.pack('>H', self._next_id()) + mqtt_string(self.room_topic.encode())))
+
+    def _backoff_s(self):  # type: () -> float
+        """Same schedule as mqtt_reconnect: [0, base) first, then [cap/2, cap] with cap = base * 2^n."""
+        base, cap = self.args.reconnect_base_ms, self.args.reconnect_max_ms
+        if self.attempt == 0:
+            return random.randrange(base) / 1000.0
+        if self.attempt < 16 and (base << self.attempt) < cap:
+            cap = base << self.attempt
+        return (cap // 2 + random.randint(0, cap // 2)) / 1000.0
+
+    async def _connect(self):  # type: () -> asyncio.StreamReader
+        started = time.monotonic()
+        reader, self.writer = await asyncio.open_connection('127.0.0.1', self.port)
+        will = device_message(self.device_id)
+        body = (mqtt_string(b'MQTT') + bytes([4, 0x02 | 0x04 | 0x08]) + struct.pack('>H', self.args.keepalive)
+                + mqtt_string(self.device_id.encode()) + mqtt_string(WILL_TOPIC.encode()) + mqtt_string(will))
+        self.writer.write(packet(0x10, body))
+        header, _ = await read_packet(reader)
+        if header >> 4 != CONNACK:
+            raise ConnectionError('no CONNACK')
+        self.stats.connect_ms.setdefault(self.stats.phase, []).append((time.monotonic() - started) * 1000)
+        return reader
+
+    def _signal(self):  # type: () -> None
+        """One offer per WebRTC start, then the candidates batched before it, as webrtc_signaling does.
+
+        The firmware enqueues the offer once; the MQTT outbox delivers it after the first connect,
+        behind the result topic subscription. Reconnects and room rejoins do not create a new offer.
+        """
+        self.offered = True
+        self.stats.offers += 1
+        self.offer_at = time.monotonic()
+        self._publish(INVOKE_TOPIC, offer_message(self.device_id))
+        self._publish(INVOKE_TOPIC, candidates_message(self.device_id, [c.format(2) for c in CANDIDATES]))
+
+    def _on_publish(self, body):  # type: (bytes) -> None
+        topic_len = struct.unpack('>H', body[0:2])[0]
+        payload = body[2 + topic_len:]
+        if payload.startswith(b'{"type":"answer"') and self.offer_at:
+            self.stats.offer_to_answer_ms.append((time.monotonic() - self.offer_at) * 1000)
+            self.offer_at = 0.0
+
+    async def _receive(self, reader):  # type: (asyncio.StreamReader) -> None
+        while True:
+            header, body = await read_packet(reader)
+            packet_type = header >> 4
+            if packet_type == SUBACK:
+                sent_at = self.pending.pop(struct.unpack('>H', body[0:2])[0], None)
+                if sent_at is not None and not self.pending:
+                    self.stats.join_ms.append((time.monotonic() - sent_at) * 1000)
+                    self.subscribed.set()
+            elif packet_type == PUBLISH:
+                self._on_publish(body)
+
+    async def _keepalive(self):  # type: () -> None
+        while True:
+            await asyncio.sleep(self.args.keepalive)
+            self.writer.write(bytes([0xC0, 0x00]))
+
+    async def run(self, delay):  # type: (float) -> None
+        await asyncio.sleep(delay)
+        while not self.stopping:
+            try:
+                reader = await self._connect()
+            except (OSError, ConnectionError, asyncio.IncompleteReadError):
+                self.stats.failed_connects += 1
+                await asyncio.sleep(self._backoff_s())
+                self.attempt += 1
+                continue
+            self.attempt = 0
+            self.connected.set()
+            # the result topic is saved by mqtt_reconnect and sent again after every connect
+            self.joined = True
+            self._subscribe()
+            if self.args.signaling and not self.offered:
+                self._signal()
+            keepalive = asyncio.ensure_future(self._keepalive())
+            try:
+                await self._receive(reader)
+            except (asyncio.IncompleteReadError, ConnectionError):
+                pass
+            finally:
+                keepalive.cancel()
+                self.connected.clear()
+                self.subscribed.clear()
+                self.pending.clear()
+                self.writer.close()
+            if not self.stopping:
+                await asyncio.sleep(self._backoff_s())
+                self.attempt += 1
+
+    def short_press(self):  # type: () -> None
+        """Leave (publish + unsubscribe) and join again without waiting in between, like mqtt_room."""
+        if not self.connected.is_set():
+            return
+        if self.joined:
+            self._publish(WILL_TOPIC, device_message(self.device_id))
+            self._unsubscribe()
+        self.joined = True
+        self._subscribe()
+
+    def long_press(self):  # type: () -> None
+        if self.connected.is_set():
+            self._publish(INVOKE_TOPIC, device_message(self.device_id))
+
+    async def button_script(self, duration):  # type: (float) -> None
+        """`presses` short presses spread over the steady phase; every long_every-th press is long."""
+        started = time.monotonic()
+        for i, at in enumerate(press_times(duration, self.args.presses)):
+            await asyncio.sleep(max(0.0, started + at - time.monotonic()))
+            if self.args.long_every and (i + 1) % self.args.long_every == 0:
+                self.long_press()
+            else:
+                self.short_press()
+
+    def disconnect(self):  # type: () -> None
+        self.stopping = True
+        if self.connected.is_set():
+            self.writer.write(bytes([0xE0, 0x00]))
+            self.writer.close()
+
+
+class FirmwareDevice(object):
+    """One device running the linux build in its own process, driven over stdin by fleet_device.cpp.
+
+    The broker stand-in reports its result topic subscriptions and publishes; latencies come
+    from the firmware's own [Performance] log lines.
+    """
+
+    def __init__(self, index, args, stats, port):  # type: (int, argparse.Namespace, FleetStats, int) -> None
+        self.device_id = 'FW_{:06X}'.format(index)
+        self.args = args
+        self.stats = stats
+        self.port = port
+        self.process = None
+        self.offered = False
+        self.subscribed = asyncio.Event()
+        self.status = None
+        self.status_received = asyncio.Event()
+        self.tail = collections.deque(maxlen=20)
+        self.stopping = False
+
+    def _command(self, line):  # type: (str) -> None
+        if self.process and self.process.returncode is None and not self.process.stdin.is_closing():
+            self.process.stdin.write((line + '\n').encode())
+
+    def _on_line(self, line):  # type: (str) -> None
+        self.tail.append(line.rstrip())
+        match = PERFORMANCE_LOG.search(line)
+        if not match:
+            return
+        name, value = match.group(1), int(match.group(2))
+        if name == 'mqtt_room_join_ms':
+            self.stats.join_ms.append(value)
+        elif name == 'signaling_offer_to_answer_ms':
+            self.stats.offer_to_answer_ms.append(value)
+
+    def on_subscribed(self):  # type: () -> None
+        """The result topic subscription reached the broker: start WebRTC once, like esp-rtc after boot."""
+        self.subscribed.set()
+        if self.args.signaling and not self.offered:
+            self.offered = True
+            self.stats.offers += 1
+            self._command('webrtc')
+
+    def on_publish(self, topic, payload):  # type: (str, bytes) -> None
+        """Compare every firmware publish with the message the modelled devices send for the same type."""
+        try:
+            message = json.loads(payload.decode())
+        except ValueError:
+            self.stats.firmware_drifts.add('{}: firmware publishes a non-JSON payload'.format(topic))
+            return
+        if 'outbox' in message:
+            self.status = message
+            self.status_received.set()
+            return
+        expected = FIRMWARE_SHAPES.get(message.get('type'))
+        keys = set(message) - {'room'} if topic == WILL_TOPIC else set(message)
+        if expected is None or keys != expected:
+            self.stats.firmware_drifts.add('{} type {!r}: firmware sends {}, simulator sends {}'.format(
+                topic, message.get('type'), sorted(message), sorted(expected or ())))
+
+    def rss_bytes(self):  # type: () -> int
+        try:
+            with open('/proc/{}/status'.format(self.process.pid)) as f:
+                match = re.search(r'^VmRSS:\s+(\d+) kB', f.read(), re.M)
+        except (OSError, AttributeError):
+            return 0
+        return int(match.group(1)) * 1024 if match else 0
+
+    def heap_live_bytes(self):  # type: () -> int
+        """Live bytes over all components of the heap accounting in the status reply (CONFIG_APP_HEAP_ACCOUNTING)."""
+        components = (self.status or {}).get('heap', {}).get('components', {})
+        return sum(c.get('live', 0) for c in components.values())
+
+    async def run(self, delay):  # type: (float) -> None
+        await asyncio.sleep(delay)
+        self.process = await asyncio.create_subprocess_exec(
+            self.args.firmware, stdin=asyncio.subprocess.PIPE, stdout=asyncio.subprocess.PIPE,
+            stderr=asyncio.subprocess.STDOUT, env=dict(os.environ, MQTT_DEVICE_ID=self.device_id), limit=1 << 20)
+        # the first line answers the FROM_STDIN prompt of mqtt_client
+        self._command('mqtt://127.0.0.1:{}'.format(self.port))
+        while True:
+            line = await self.process.stdout.readline()
+            if not line:
+                break
+            self._on_line(line.decode(errors='replace'))
+        code = await self.process.wait()
+        if not self.stopping:
+            self.stats.firmware_failures += 1
+            print('{} exited with {}:\n  {}'.format(self.device_id, code, '\n  '.join(self.tail)), file=sys.stderr)
+
+    async def button_script(self, duration):  # type: (float) -> None
+        """Same schedule as VirtualDevice; the press is held on the simulated GPIO level for its duration."""
+        started = time.monotonic()
+        for i, at in enumerate(press_times(duration, self.args.presses)):
+            await asyncio.sleep(max(0.0, started + at - time.monotonic()))
+            long_press = self.args.long_every and (i + 1) % self.args.long_every == 0
+            press_ms = LONG_PRESS_MS if long_press else SHORT_PRESS_MS
+            self._command('press {}'.format(press_ms))
+            await asyncio.sleep(press_ms / 1000.0)
+
+    async def stop(self):  # type: () -> None
+        """Closing stdin ends fleet_device_run(); the broker sees an unclean close and fires the last will."""
+        self.stopping = True
+        if not self.process or self.process.returncode is not None:
+            return
+        self.process.stdin.close()
+        try:
+            await asyncio.wait_for(self.process.wait(), 5)
+        except asyncio.TimeoutError:
+            self.process.kill()
+            await self.process.wait()
+
+
+async def wait_all(events, timeout):  # type: (list, float) -> float
+    started = time.monotonic()
+    try:
+        await asyncio.wait_for(asyncio.gather(*(e.wait() for e in events)), timeout)
+    except asyncio.TimeoutError:
+        pass
+    return (time.monotonic() - started) * 1000
+
+
+def report(name, value):  # type: (str, object) -> None
+    print('[Performance][fleet_{}]: {}'.format(name, '{:.1f}'.format(value) if isinstance(value, float) else value))
+
+
+def report_phase(stats, phase):  # type: (FleetStats, str) -> None
+    connects = stats.connect_ms.get(phase, [])
+    avg_in, _ = stats.rates(phase, 0)
+    avg_out, _ = stats.rates(phase, 1)
+    _, peak_msgs = stats.rates(phase, 0, 1)
+    _, peak_connects = stats.rates(phase, 2)
+    if connects:
+        report(phase + '_connects', len(connects))
+        report(phase + '_connect_p50_ms', percentile(connects, 50))
+        report(phase + '_connect_p99_ms', percentile(connects, 99))
+        report(phase + '_connect_max_ms', percentile(connects, 100))
+        report(phase + '_peak_connects_per_s', peak_connects)
+    report(phase + '_msgs_in_per_s', avg_in)
+    report(phase + '_msgs_out_per_s', avg_out)
+    report(phase + '_peak_msgs_per_s', peak_msgs)
+
+
+async def run(args):  # type: (argparse.Namespace) -> int
+    for drift in check_shapes():
+        print('warning: message shape drift: ' + drift, file=sys.stderr)
+    stats = FleetStats()
+    if args.trace_memory:
+        tracemalloc.start()
+    base_traced = tracemalloc.get_traced_memory()[0]
+    base_rss_kb = resource.getrusage(resource.RUSAGE_SELF).ru_maxrss
+
+    broker = FleetBroker(stats)
+    port = await broker.start('127.0.0.1', args.port)
+    firmware_count = min(args.firmware_devices, args.devices) if args.firmware else 0
+    firmware = [FirmwareDevice(i, args, stats, port) for i in range(firmware_count)]
+    models = [VirtualDevice(i, args, stats, port) for i in range(firmware_count, args.devices)]
+    devices = firmware + models
+    for device in firmware:
+        broker.firmware[device.device_id] = device
+
+    # Phase 1: connect storm, every device starts inside storm_window seconds
+    tasks = [asyncio.ensure_future(d.run(random.uniform(0, args.storm_window))) for d in devices]
+    all_joined_ms = await wait_all([d.subscribed for d in devices], args.timeout)
+    joined = sum(d.subscribed.is_set() for d in devices)
+    # firmware processes have their own address space, this is the simulator's share per modelled device
+    traced_per_device = (tracemalloc.get_traced_memory()[0] - base_traced) / float(max(len(models), 1))
+    tracemalloc.stop()
+    rss_per_device = (resource.getrusage(resource.RUSAGE_SELF).ru_maxrss - base_rss_kb) * 1024.0 / max(len(models), 1)
+    report('devices', args.devices)
+    report('firmware_devices', len(firmware))
+    report('storm_joined', joined)
+    report('storm_all_joined_ms', all_joined_ms)
+    report_phase(stats, 'storm')
+    report('join_p50_ms', percentile(stats.join_ms, 50))
+    report('join_p99_ms', percentile(stats.join_ms, 99))
+    report('broker_subscriptions', broker.subscription_count())
+    if args.trace_memory:
+        report('traced_bytes_per_device', traced_per_device)
+    report('rss_bytes_per_device', rss_per_device)
+
+    # Phase 2: steady state with the button script
+    stats.set_phase('steady')
+    stats.join_ms = []
+    await asyncio.gather(*(d.button_script(args.duration) for d in devices))
+    await asyncio.sleep(1)
+    report_phase(stats, 'steady')
+    report('rejoin_p50_ms', percentile(stats.join_ms, 50))
+    report('rejoin_p99_ms', percentile(stats.join_ms, 99))
+    report('offers', stats.offers)
+    report('offer_to_answer_p50_ms', percentile(stats.offer_to_answer_ms, 50))
+    report('offer_to_answer_p99_ms', percentile(stats.offer_to_answer_ms, 99))
+
+    # Firmware memory: process RSS and the heap accounting from the status reply
+    if firmware:
+        stats.set_phase('status')
+        for device in firmware:
+            broker.route(RESULT_TOPIC_PREFIX + device.device_id, json_bytes({'command': 'status'}))
+        await wait_all([d.status_received for d in firmware], 10)
+        replied = [d for d in firmware if d.status]
+        report('firmware_status_replies', len(replied))
+        if replied:
+            report('firmware_heap_live_bytes_per_device', sum(d.heap_live_bytes() for d in replied) / float(len(replied)))
+        report('firmware_rss_bytes_per_device', sum(d.rss_bytes() for d in firmware) / float(len(firmware)))
+
+    # Phase 3: the broker drops everyone, devices come back with mqtt_reconnect backoff
+    rejoined = joined
+    if args.drop:
+        stats.set_phase('reconnect')
+        wills_before = stats.wills
+        for device in devices:
+            device.subscribed.clear()
+        broker.drop_all()
+        resubscribed_ms = await wait_all([d.subscribed for d in devices], args.timeout)
+        rejoined = sum(d.subscribed.is_set() for d in devices)
+        report('reconnect_resubscribed', rejoined)
+        report('reconnect_all_resubscribed_ms', resubscribed_ms)
+        report('reconnect_wills', stats.wills - wills_before)
+        report_phase(stats, 'reconnect')
+
+    report('failed_connects', stats.failed_connects)
+    if firmware:
+        report('firmware_shape_drifts', len(stats.firmware_drifts))
+        for drift in sorted(stats.firmware_drifts):
+            print('error: firmware message shape drift: ' + drift, file=sys.stderr)
+    for device in models:
+        device.disconnect()
+    await asyncio.gather(*(d.stop() for d in firmware))
+    await asyncio.sleep(0.2)
+    for task in tasks:
+        task.cancel()
+    await asyncio.gather(*tasks, return_exceptions=True)
+    await broker.close()
+    ok = joined == args.devices and rejoined == args.devices
+    return 0 if ok and not stats.firmware_drifts and not stats.firmware_failures else 1
+
+
+def raise_fd_limit(devices):  # type: (int) -> None
+    # two sockets per device on loopback: the device side and the broker side
+    soft, hard = resource.getrlimit(resource.RLIMIT_NOFILE)
+    needed = devices * 2 + 64
+    if soft < needed:
+        resource.setrlimit(resource.RLIMIT_NOFILE, (min(needed, hard), hard))
+        if hard < needed:
+            print('warning: open file limit {} is too low for {} devices'.format(hard, devices), file=sys.stderr)
+
+
+def main():  # type: () -> int
+    parser = argparse.ArgumentParser(description='MQTT device fleet simulator')
+    parser.add_argument('--devices', type=int, default=500)
+    parser.add_argument('--port', type=int, default=0, help='broker stand-in port (0 = any free port)')
+    parser.add_argument('--storm-window', type=float, default=1.0, help='devices start within this many seconds')
+    parser.add_argument('--duration', type=float, default=20.0, help='steady phase length in seconds')
+    parser.add_argument('--presses', type=int, default=3, help='button presses per device in the steady phase')
+    parser.add_argument('--long-every', type=int, default=3, help='every n-th press is long (0 = never)')
+    parser.add_argument('--no-signaling', dest='signaling', action='store_false', help='skip offer/answer/candidates')
+    parser.add_argument('--no-drop', dest='drop', action='store_false', help='skip the reconnect storm')
+    parser.add_argument('--keepalive', type=int, default=60)
+    parser.add_argument('--reconnect-base-ms', type=int, default=200, help='CONFIG_MQTT_CLIENT_RECONNECT_BASE_MS')
+    parser.add_argument('--reconnect-max-ms', type=int, default=30000, help='CONFIG_MQTT_CLIENT_RECONNECT_MAX_MS')
+    parser.add_argument('--timeout', type=float, default=120.0, help='limit for each storm phase in seconds')
+    parser.add_argument('--trace-memory', action='store_true',
+                        help='also count Python allocations per device (slows down the connect storm)')
+    parser.add_argument('--firmware', default=None,
+                        help='linux build with CONFIG_APP_FLEET_DEVICE (sdkconfig.ci.linux_fleet), e.g. build/mqtt_tcp.elf')
+    parser.add_argument('--firmware-devices', type=int, default=4,
+                        help='how many of the devices run the firmware build, one process each')
+    parser.add_argument('--seed', type=int, default=None)
+    parser.add_argument('--check-shapes', action='store_true',
+                        help='only compare the simulated messages with the firmware sources')
+    args = parser.parse_args()
+    if args.check_shapes:
+        drifts = check_shapes()
+        for drift in drifts:
+            print(drift)
+        print('message shapes: {}'.format('{} drift(s)'.format(len(drifts)) if drifts else 'in sync'))
+        return 1 if drifts else 0
+    if args.firmware and not os.access(args.firmware, os.X_OK):
+        parser.error('--firmware {} is not an executable'.format(args.firmware))
+    random.seed(args.seed)
+    raise_fd_limit(args.devices)
+    return asyncio.run(run(args))
+
+
+if __name__ == '__main__':
+    sys.exit(main())
@@ -0,0 +1,364 @@
+# SPDX-License-Identifier: Unlicense OR CC0-1.0
+"""Reference codec for the compact (sdpz1) WebRTC signaling format.
+
+Server-side counterpart of components/WebRTC/signaling_codec.cpp. The frame
+layout and dictionary must stay identical to the device implementation.
+
+usage:
+    python tools/signaling_codec.py decode frame.bin
+    python tools/signaling_codec.py encode offer sdp.txt frame.bin --device-id ESP32_XXXX
+    python tools/signaling_codec.py bench [sdp.txt]
+"""
+import argparse
+import json
+import sys
+import time
+
+MAGIC = 0xB5
+VERSION = 1
+ESCAPE = 0x7F
+DICT_BASE = 0x80
+
+MSG_OFFER = 1
+MSG_ANSWER = 2
+MSG_CANDIDATES = 3
+MSG_NAMES = {MSG_OFFER: 'offer', MSG_ANSWER: 'answer', MSG_CANDIDATES: 'candidates'}
+
+# Order is the encoding: append only.
+DICTIONARY = [
+    '\r\n',
+    'a=candidate:',
+    'a=rtpmap:',
+    'a=fmtp:',
+    'a=rtcp-fb:',
+    'a=extmap:',
+    'a=ssrc:',
+    'a=mid:',
+    'a=ice-ufrag:',
+    'a=ice-pwd:',
+    'a=ice-options:trickle',
+    'a=fingerprint:sha-256 ',
+    'a=setup:actpass',
+    'a=setup:active',
+    'a=setup:passive',
+    'a=sendrecv',
+    'a=sendonly',
+    'a=recvonly',
+    'a=inactive',
+    'a=rtcp-mux',
+    'a=rtcp-rsize',
+    'a=group:BUNDLE ',
+    'a=msid-semantic: WMS',
+    'a=msid:',
+    'a=sctp-port:5000',
+    'a=max-message-size:262144',
+    'a=max-message-size:',
+    'a=end-of-candidates',
+    'a=rtcp:9 IN IP4 0.0.0.0',
+    'a=ssrc-group:FID ',
+    'a=sctpmap:5000 webrtc-datachannel 1024',
+    'm=audio 9 UDP/TLS/RTP/SAVPF ',
+    'm=video 9 UDP/TLS/RTP/SAVPF ',
+    'm=application 9 UDP/DTLS/SCTP webrtc-datachannel',
+    'm=application 9 DTLS/SCTP 5000',
+    'c=IN IP4 0.0.0.0',
+    'c=IN IP4 ',
+    'v=0',
+    'o=- ',
+    ' IN IP4 127.0.0.1',
+    's=-',
+    't=0 0',
+    'candidate:',
+    ' typ host',
+    ' typ srflx',
+    ' typ prflx',
+    ' typ relay',
+    ' raddr ',
+    ' rport ',
+    ' generation 0',
+    ' network-id ',
+    ' network-cost ',
+    ' ufrag ',
+    ' UDP ',
+    ' udp ',
+    ' TCP ',
+    ' tcp ',
+    ' tcptype active',
+    ' tcptype passive',
+    'opus/48000/2',
+    'H264/90000',
+    'VP8/90000',
+    'VP9/90000',
+    'rtx/90000',
+    'red/90000',
+    'ulpfec/90000',
+    'PCMU/8000',
+    'PCMA/8000',
+    'G722/8000',
+    'telephone-event/8000',
+    'telephone-event/48000',
+    'minptime=10;useinbandfec=1',
+    'level-asymmetry-allowed=1;packetization-mode=1;profile-level-id=',
+    'packetization-mode=1',
+    'profile-level-id=42e01f',
+    'goog-remb',
+    'transport-cc',
+    'ccm fir',
+    'nack pli',
+    'nack',
+    'apt=',
+    'urn:ietf:params:rtp-hdrext:',
+    'sdes:mid',
+    'sdes:rtp-stream-id',
+    'sdes:repaired-rtp-stream-id',
+    'ssrc-audio-level',
+    'toffset',
+    'http://www.webrtc.org/experiments/rtp-hdrext/',
+    'abs-send-time',
+    'http://www.ietf.org/id/draft-holmer-rmcat-transport-wide-cc-extensions-01',
+    ' cname:',
+    ' msid:',
+    ' mslabel:',
+    ' label:',
+    'webrtc-datachannel',
+    'UDP/TLS/RTP/SAVPF',
+    '0.0.0.0',
+    '127.0.0.1',
+    '192.168.',
+    '10.0.',
+    '172.16.',
+    ' 1 UDP ',
+    ' 2 UDP ',
+    ' 1 udp ',
+    ' 2 udp ',
+    '2122260223',
+    '2122252543',
+    '1686052607',
+    '1686052863',
+    '41885439',
+    'a=',
+    'b=AS:',
+    'stun:',
+    'turn:',
+    '.local',
+    'sdpMid',
+    'sdpMLineIndex',
+]
+assert len(DICTIONARY) <= 128
+
+_DICT_BYTES = [entry.encode() for entry in DICTIONARY]
+_BY_FIRST = {}
+for _index, _entry in enumerate(_DICT_BYTES):
+    _BY_FIRST.setdefault(_entry[0], []).append(_index)
+for _candidates in _BY_FIRST.values():
+    _candidates.sort(key=lambda i: -len(_DICT_BYTES[i]))
+
+
+def encode_text(text):  # type: (str) -> bytes
+    data = text.encode()
+    out = bytearray()
+    pos = 0
+    while pos < len(data):
+        for index in _BY_FIRST.get(data[pos], ()):
+            entry = _DICT_BYTES[index]
+            if data.startswith(entry, pos):
+                out.append(DICT_BASE + index)
+                pos += len(entry)
+                break
+        else:
+            if data[pos] >= ESCAPE:
+                out.append(ESCAPE)
+            out.append(data[pos])
+            pos += 1
+    return bytes(out)
+
+
+def decode_text(data):  # type: (bytes) -> str
+    out = bytearray()
+    pos = 0
+    while pos < len(data):
+        byte = data[pos]
+        if byte >= DICT_BASE:
+            out += _DICT_BYTES[byte - DICT_BASE]
+        else:
+            if byte == ESCAPE:
+                pos += 1
+                byte = data[pos]
+            out.append(byte)
+        pos += 1
+    return out.decode()
+
+
+def _varint(value):  # type: (int) -> bytes
+    out = bytearray()
+    while True:
+        byte = value & 0x7F
+        value >>= 7
+        out.append(byte | 0x80 if value else byte)
+        if not value:
+            return bytes(out)
+
+
+def _read_varint(data, pos):  # type: (bytes, int) -> tuple
+    value, shift = 0, 0
+    while True:
+        byte = data[pos]
+        pos += 1
+        value |= (byte & 0x7F) << shift
+        shift += 7
+        if not byte & 0x80:
+            return value, pos
+
+
+def build_frame(msg_type, device_id, texts):  # type: (int, str, list) -> bytes
+    device = device_id.encode()
+    out = bytearray([MAGIC, (VERSION << 4) | msg_type]) + _varint(len(device)) + device
+    for text in texts:
+        encoded = encode_text(text)
+        out += _varint(len(encoded)) + encoded
+    return bytes(out)
+
+
+def is_compact(payload):  # type: (bytes) -> bool
+    return len(payload) >= 2 and payload[0] == MAGIC
+
+
+def parse_frame(payload):  # type: (bytes) -> dict
+    """Decode a frame into the equivalent JSON signaling message."""
+    if not is_compact(payload) or payload[1] >> 4 != VERSION:
+        raise ValueError('not an sdpz1 frame')
+    msg_type = payload[1] & 0x0F
+    id_len, pos = _read_varint(payload, 2)
+    device_id = payload[pos:pos + id_len].decode()
+    pos += id_len
+    texts = []
+    while pos < len(payload):
+        length, pos = _read_varint(payload, pos)
+        texts.append(decode_text(payload[pos:pos + length]))
+        pos += length
+    message = {'type': MSG_NAMES.get(msg_type, msg_type), 'deviceId': device_id}
+    if msg_type == MSG_CANDIDATES:
+        message['candidates'] = texts
+    else:
+        message['sdp'] = texts[0] if texts else ''
+    return message
+
+
+SAMPLE_SDP = (
+    'v=0\r\n'
+    'o=- 4611731400430051336 2 IN IP4 127.0.0.1\r\n'
+    's=-\r\n'
+    't=0 0\r\n'
+    'a=group:BUNDLE 0 1\r\n'
+    'a=msid-semantic: WMS\r\n'
+    'm=audio 9 UDP/TLS/RTP/SAVPF 111 63 9 0 8 13 110 126\r\n'
+    'c=IN IP4 0.0.0.0\r\n'
+    'a=rtcp:9 IN IP4 0.0.0.0\r\n'
+    'a=ice-ufrag:8hhY\r\n'
+    'a=ice-pwd:asd88fgpdd777uzjYhagZg+tU5\r\n'
+    'a=ice-options:trickle\r\n'
+    'a=fingerprint:sha-256 D2:FA:0E:C3:22:59:5E:14:95:69:92:3D:13:B4:84:24:2C:C2:A2:C0:3E:FD:34:8E:5E:EA:6F:AF:52:CE:E6:0F\r\n'
+    'a=setup:actpass\r\n'
+    'a=mid:0\r\n'
+    'a=extmap:1 urn:ietf:params:rtp-hdrext:ssrc-audio-level\r\n'
+    'a=extmap:2 http://www.webrtc.org/experiments/rtp-hdrext/abs-send-time\r\n'
+    'a=extmap:3 http://www.ietf.org/id/draft-holmer-rmcat-transport-wide-cc-extensions-01\r\n'
+    'a=extmap:4 urn:ietf:params:rtp-hdrext:sdes:mid\r\n'
+    'a=sendrecv\r\n'
+    'a=msid:- 750f6cfc-bd3b-4a03-9e4d-7e2e8a0e0e8a\r\n'
+    'a=rtcp-mux\r\n'
+    'a=rtcp-rsize\r\n'
+    'a=rtpmap:111 opus/48000/2\r\n'
+    'a=rtcp-fb:111 transport-cc\r\n'
+    'a=fmtp:111 minptime=10;useinbandfec=1\r\n'
+    'a=rtpmap:63 red/48000/2\r\n'
+    'a=fmtp:63 111/111\r\n'
+    'a=rtpmap:9 G722/8000\r\n'
+    'a=rtpmap:0 PCMU/8000\r\n'
+    'a=rtpmap:8 PCMA/8000\r\n'
+    'a=rtpmap:13 CN/8000\r\n'
+    'a=rtpmap:110 telephone-event/48000\r\n'
+    'a=rtpmap:126 telephone-event/8000\r\n'
+    'a=ssrc:2719937484 cname:9zX2a8mH1Ubk6xQF\r\n'
+    'a=ssrc:2719937484 msid:- 750f6cfc-bd3b-4a03-9e4d-7e2e8a0e0e8a\r\n'
+    'm=application 9 UDP/DTLS/SCTP webrtc-datachannel\r\n'
+    'c=IN IP4 0.0.0.0\r\n'
+    'a=ice-ufrag:8hhY\r\n'
+    'a=ice-pwd:asd88fgpdd777uzjYhagZg+tU5\r\n'
+    'a=ice-options:trickle\r\n'
+    'a=fingerprint:sha-256 D2:FA:0E:C3:22:59:5E:14:95:69:92:3D:13:B4:84:24:2C:C2:A2:C0:3E:FD:34:8E:5E:EA:6F:AF:52:CE:E6:0F\r\n'
+    'a=setup:actpass\r\n'
+    'a=mid:1\r\n'
+    'a=sctp-port:5000\r\n'
+    'a=max-message-size:262144\r\n'
+)
+
+SAMPLE_CANDIDATES = [
+    'candidate:1 1 UDP 2122252543 192.168.1.100 50000 typ host',
+    'candidate:2 1 UDP 1686052607 203.0.113.7 50000 typ srflx raddr 192.168.1.100 rport 50000',
+    'candidate:3 1 UDP 41885439 198.51.100.20 3478 typ relay raddr 203.0.113.7 rport 50000',
+]
+
+
+def _time_us(func, iterations):  # type: (object, int) -> float
+    start = time.perf_counter()
+    for _ in range(iterations):
+        func()
+    return (time.perf_counter() - start) * 1e6 / iterations
+
+
+def bench(sdp, iterations=2000):  # type: (str, int) -> dict
+    device_id = 'ESP32_000000000000'
+    offer_json = json.dumps({'type': 'offer', 'deviceId': device_id, 'sdp': sdp}, separators=(',', ':')).encode()
+    offer_frame = build_frame(MSG_OFFER, device_id, [sdp])
+    cand_json = json.dumps({'type': 'candidates', 'deviceId': device_id, 'candidates': SAMPLE_CANDIDATES},
+                           separators=(',', ':')).encode()
+    cand_frame = build_frame(MSG_CANDIDATES, device_id, SAMPLE_CANDIDATES)
+    assert parse_frame(offer_frame)['sdp'] == sdp
+    return {
+        'offer_json_bytes': len(offer_json),
+        'offer_compact_bytes': len(offer_frame),
+        'candidates_json_bytes': len(cand_json),
+        'candidates_compact_bytes': len(cand_frame),
+        'json_encode_us': _time_us(lambda: json.dumps({'type': 'offer', 'deviceId': device_id, 'sdp': sdp}), iterations),
+        'json_decode_us': _time_us(lambda: json.loads(offer_json), iterations),
+        'compact_encode_us': _time_us(lambda: build_frame(MSG_OFFER, device_id, [sdp]), iterations),
+        'compact_decode_us': _time_us(lambda: parse_frame(offer_frame), iterations),
+    }
+
+
+def main():  # type: () -> None
+    parser = argparse.ArgumentParser(description='sdpz1 signaling reference codec')
+    sub = parser.add_subparsers(dest='command', required=True)
+    dec = sub.add_parser('decode', help='decode a binary frame to JSON')
+    dec.add_argument('frame')
+    enc = sub.add_parser('encode', help='encode an SDP file (or candidate lines) into a frame')
+    enc.add_argument('type', choices=['offer', 'answer', 'candidates'])
+    enc.add_argument('input')
+    enc.add_argument('output')
+    enc.add_argument('--device-id', default='')
+    ben = sub.add_parser('bench', help='compare JSON and sdpz1 size and codec time')
+    ben.add_argument('sdp', nargs='?')
+    args = parser.parse_args()
+
+    if args.command == 'decode':
+        with open(args.frame, 'rb') as f:
+            print(json.dumps(parse_frame(f.read()), indent=2))
+    elif args.command == 'encode':
+        with open(args.input, newline='') as f:
+            text = f.read()
+        msg_type = {'offer': MSG_OFFER, 'answer': MSG_ANSWER, 'candidates': MSG_CANDIDATES}[args.type]
+        texts = [line for line in text.splitlines() if line] if msg_type == MSG_CANDIDATES else [text]
+        with open(args.output, 'wb') as f:
+            f.write(build_frame(msg_type, args.device_id, texts))
+    else:
+        sdp = SAMPLE_SDP
+        if args.sdp:
+            with open(args.sdp, newline='') as f:
+                sdp = f.read()
+        for key, value in bench(sdp).items():
+            print('[Performance][signaling_{}]: {}'.format(key, round(value, 2)))
+
+
+if __name__ == '__main__':
+    sys.exit(main())
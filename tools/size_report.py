@@ -0,0 +1,96 @@
+# SPDX-License-Identifier: Unlicense OR CC0-1.0
+"""Firmware size per media configuration.
+
+Builds the project once per sdkconfig fragment (default: sdkconfig.ci.media_*)
+in its own build directory and prints flash/DRAM/IRAM usage relative to the
+first configuration, so the effect of CONFIG_WEBRTC_MEDIA_* can be checked.
+
+usage:
+    python tools/size_report.py
+    python tools/size_report.py --target esp32s3 sdkconfig.ci.media_full sdkconfig.ci.media_data_only
+    python tools/size_report.py --no-build      # re-print the last results from build_size/
+"""
+import argparse
+import json
+import os
+import subprocess
+import sys
+
+PROJECT_DIR = os.path.dirname(os.path.dirname(os.path.abspath(__file__)))
+DEFAULT_FRAGMENTS = ['sdkconfig.ci.media_full', 'sdkconfig.ci.media_audio', 'sdkconfig.ci.media_data_only']
+
+# (column, key in `idf.py size --format json` output)
+COLUMNS = [
+    ('flash_code', 'flash_code'),
+    ('flash_rodata', 'flash_rodata'),
+    ('dram', 'used_dram'),
+    ('iram', 'used_iram'),
+    ('total', 'total_size'),
+]
+
+
+def config_name(fragment):  # type: (str) -> str
+    return os.path.basename(fragment).replace('sdkconfig.ci.', '')
+
+
+def build(fragment, target, build_dir):  # type: (str, str, str) -> str
+    size_file = os.path.join(build_dir, 'size.json')
+    cmd = [
+        'idf.py', '-C', PROJECT_DIR, '-B', build_dir,
+        '-DIDF_TARGET={}'.format(target),
+        '-DSDKCONFIG={}'.format(os.path.join(build_dir, 'sdkconfig')),
+        '-DSDKCONFIG_DEFAULTS={}'.format(os.path.abspath(fragment)),
+        'build', 'size', '--format', 'json', '--output-file', size_file,
+    ]
+    print('building {} ...'.format(config_name(fragment)), file=sys.stderr)
+    subprocess.run(cmd, check=True, stdout=subprocess.DEVNULL)
+    return size_file
+
+
+def load(size_file):  # type: (str) -> dict
+    with open(size_file) as f:
+        data = json.load(f)
+    return {label: int(data.get(key, 0)) for label, key in COLUMNS}
+
+
+def report(results):  # type: (list) -> None
+    base = results[0][1]
+    header = '{:<18}'.format('config') + ''.join('{:>22}'.format(label) for label, _ in COLUMNS)
+    print(header)
+    for name, sizes in results:
+        row = '{:<18}'.format(name)
+        for label, _ in COLUMNS:
+            delta = sizes[label] - base[label]
+            row += '{:>22}'.format('{} ({:+d})'.format(sizes[label], delta))
+        print(row)
+    for name, sizes in results:
+        print('[Performance][firmware_size_bytes][{}]: flash {} dram {} iram {}'.format(
+            name, sizes['flash_code'] + sizes['flash_rodata'], sizes['dram'], sizes['iram']))
+
+
+def main():  # type: () -> int
+    parser = argparse.ArgumentParser(description='firmware size per media configuration')
+    parser.add_argument('fragments', nargs='*', help='sdkconfig fragments, first one is the baseline')
+    parser.add_argument('--target', default='esp32s3')
+    parser.add_argument('--build-root', default=os.path.join(PROJECT_DIR, 'build_size'))
+    parser.add_argument('--no-build', action='store_true', help='only read existing size.json files')
+    args = parser.parse_args()
+
+    fragments = args.fragments or [os.path.join(PROJECT_DIR, f) for f in DEFAULT_FRAGMENTS]
+    results = []
+    for fragment in fragments:
+        build_dir = os.path.join(args.build_root, config_name(fragment))
+        size_file = os.path.join(build_dir, 'size.json')
+        if not args.no_build:
+            size_file = build(fragment, args.target, build_dir)
+        elif not os.path.exists(size_file):
+            print('{}: no size data, run without --no-build first'.format(config_name(fragment)), file=sys.stderr)
+            return 1
+        results.append((config_name(fragment), load(size_file)))
+
+    report(results)
+    return 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())